@@ -0,0 +1,65 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+
+#include "model.h"
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/benchmarks/micro_benchmark.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+/*
+ * Hello World benchmark. Evaluates the runtime performance of the sine model
+ * from examples/hello_world, which is small enough that the per-Invoke
+ * overhead of the interpreter dominates.
+ */
+
+namespace {
+
+using HelloWorldOpResolver = tflite::AllOpsResolver;
+using HelloWorldBenchmarkRunner = MicroBenchmarkRunner<float>;
+
+// Create an area of memory to use for input, output, and intermediate arrays.
+// Align arena to 16 bytes to avoid alignment warnings on certain platforms.
+constexpr int kTensorArenaSize = 2000;
+alignas(16) uint8_t tensor_arena[kTensorArenaSize];
+
+uint8_t op_resolver_buffer[sizeof(HelloWorldOpResolver)];
+uint8_t benchmark_runner_buffer[sizeof(HelloWorldBenchmarkRunner)];
+HelloWorldBenchmarkRunner* benchmark_runner = nullptr;
+
+// Initialize benchmark runner instance explicitly to avoid global init order
+// issues on Sparkfun. Use new since static variables within a method
+// are automatically surrounded by locking, which breaks bluepill and stm32f4.
+void CreateBenchmarkRunner() {
+  // We allocate HelloWorldOpResolver from a global buffer because the object's
+  // lifetime must exceed that of the HelloWorldBenchmarkRunner object.
+  benchmark_runner = new (benchmark_runner_buffer) HelloWorldBenchmarkRunner(
+      g_model, new (op_resolver_buffer) HelloWorldOpResolver(), tensor_arena,
+      kTensorArenaSize);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  tflite::MicroErrorReporter error_reporter;
+  MicroBenchmarkSuite suite(&error_reporter);
+  CreateBenchmarkRunner();
+  const float x = 1.5f;
+  benchmark_runner->SetInput(&x);
+  suite.Run("HelloWorldInvoke",
+            []() { benchmark_runner->RunSingleIteration(); });
+  return suite.Finish(argc, argv);
+}
@@ -0,0 +1,638 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/benchmarks/micro_benchmark.h"
+#include "tensorflow/lite/micro/kernels/conv.h"
+#include "tensorflow/lite/micro/kernels/fully_connected.h"
+#include "tensorflow/lite/micro/kernels/kernel_runner.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/memory_helpers.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_utils.h"
+#include "tensorflow/lite/micro/output_buffer.h"
+#include "tensorflow/lite/micro/test_helpers.h"
+
+/*
+ * Kernel benchmark. Sweeps the shapes, strides, dilations, channel counts and
+ * data types of the compute heavy kernels through KernelRunner, so that the
+ * kernel variant behind a slow model can be found. Besides the latency of
+ * every configuration it reports GOPS, counting a multiply-accumulate as two
+ * operations and every output element (or pooling window element) of the
+ * other kernels as one, and the bytes of all tensors moved per second, or per
+ * cycle when the clock is given with --cpu_mhz=<MHz>.
+ */
+
+namespace {
+
+using tflite::micro::KernelRunner;
+using tflite::testing::IntArrayFromInts;
+
+constexpr int kMaxTensors = 6;
+constexpr int kMaxChannels = 64;
+// Enough for a 1x16x16x32 float tensor, the largest one below.
+constexpr int kTensorBufferSize = 32 * 1024;
+constexpr int kRandomSeed = 42;
+
+alignas(16) uint8_t tensor_buffers[kMaxTensors][kTensorBufferSize];
+
+// Tensors of one kernel configuration, backed by tensor_buffers. Every tensor
+// is filled with random values, which only have to be valid for timing.
+class KernelTensors {
+ public:
+  void Reset() {
+    num_tensors_ = 0;
+    valid_ = true;
+  }
+
+  // Adds a tensor with up to four dimensions and returns its index.
+  int Add(TfLiteType type, float scale, int zero_point, int rank, int d0,
+          int d1 = 1, int d2 = 1, int d3 = 1) {
+    const int index = num_tensors_++;
+    int* dims = dims_[index];
+    dims[0] = rank;
+    dims[1] = d0;
+    dims[2] = d1;
+    dims[3] = d2;
+    dims[4] = d3;
+    TfLiteTensor& tensor = tensors_[index];
+    tensor = {};
+    tensor.type = type;
+    tensor.dims = IntArrayFromInts(dims);
+    tensor.data.data = tensor_buffers[index];
+    tensor.params = {scale, zero_point};
+    tensor.quantization = {kTfLiteAffineQuantization, nullptr};
+    tensor.allocation_type = kTfLiteMemNone;
+    size_t type_size = 0;
+    tflite::TfLiteTypeSizeOf(type, &type_size);
+    tensor.bytes = tflite::ElementCount(*tensor.dims) * type_size;
+    if (tensor.bytes > kTensorBufferSize) {
+      valid_ = false;
+      return index;
+    }
+    FillRandom(&tensor);
+    return index;
+  }
+
+  // Quantizes tensor |index| per channel along |quantized_dimension|, with
+  // its scale for every channel.
+  void SetPerChannel(int index, int quantized_dimension) {
+    TfLiteTensor& tensor = tensors_[index];
+    const int channels = tensor.dims->data[quantized_dimension];
+    if (channels > kMaxChannels) {
+      valid_ = false;
+      return;
+    }
+    scales_[index][0] = channels;
+    zero_points_[index][0] = channels;
+    for (int i = 1; i <= channels; ++i) {
+      scales_[index][i] = tensor.params.scale;
+      zero_points_[index][i] = 0;
+    }
+    TfLiteAffineQuantization& quantization = quantization_[index];
+    quantization.scale = tflite::testing::FloatArrayFromFloats(scales_[index]);
+    quantization.zero_point = IntArrayFromInts(zero_points_[index]);
+    quantization.quantized_dimension = quantized_dimension;
+    tensor.quantization = {kTfLiteAffineQuantization, &quantization};
+  }
+
+  // Marks tensor |index| as constant, which the packed kernel variants need.
+  void SetConstant(int index) {
+    tensors_[index].allocation_type = kTfLiteMmapRo;
+  }
+
+  void SetVariable(int index) { tensors_[index].is_variable = true; }
+
+  TfLiteTensor* tensors() { return tensors_; }
+  int num_tensors() const { return num_tensors_; }
+  bool valid() const { return valid_; }
+
+  // Size of all tensors, the least memory traffic of one Invoke.
+  size_t bytes() const {
+    size_t bytes = 0;
+    for (int i = 0; i < num_tensors_; ++i) {
+      bytes += tensors_[i].bytes;
+    }
+    return bytes;
+  }
+
+ private:
+  static void FillRandom(TfLiteTensor* tensor) {
+    const int count = tflite::ElementCount(*tensor->dims);
+    for (int i = 0; i < count; ++i) {
+      switch (tensor->type) {
+        case kTfLiteInt8:
+          tensor->data.int8[i] = static_cast<int8_t>(std::rand() % 256 - 128);
+          break;
+        case kTfLiteInt16:
+          tensor->data.i16[i] = static_cast<int16_t>(std::rand() % 512 - 256);
+          break;
+        case kTfLiteInt32:
+          tensor->data.i32[i] = std::rand() % 2048 - 1024;
+          break;
+        default:
+          tensor->data.f[i] =
+              static_cast<float>(std::rand()) / RAND_MAX * 2.0f - 1.0f;
+          break;
+      }
+    }
+  }
+
+  TfLiteTensor tensors_[kMaxTensors];
+  int dims_[kMaxTensors][5];
+  float scales_[kMaxTensors][kMaxChannels + 1];
+  int zero_points_[kMaxTensors][kMaxChannels + 1];
+  TfLiteAffineQuantization quantization_[kMaxTensors];
+  int num_tensors_ = 0;
+  bool valid_ = true;
+};
+
+tflite::ErrorReporter* reporter = nullptr;
+MicroBenchmarkSuite* suite = nullptr;
+KernelTensors tensors;
+int cpu_mhz = 0;
+
+void ReportThroughput(const MicroBenchmarkResult& result, uint64_t ops,
+                      uint64_t bytes) {
+  if (result.median_ns == 0) {
+    return;
+  }
+  char line[160];
+  tflite::internal::OutputBuffer out(line, sizeof(line));
+  out.Append(result.name);
+  out.Append(": ");
+  // Operations per nanosecond are GOPS, and bytes per nanosecond are GB/s.
+  out.AppendThousandths(ops * 1000 / result.median_ns);
+  out.Append(" GOPS, ");
+  out.AppendThousandths(bytes * 1000 / result.median_ns);
+  out.Append(" GB/s");
+  if (cpu_mhz > 0) {
+    // One nanosecond is cpu_mhz / 1000 cycles.
+    const uint64_t millicycles = result.median_ns * cpu_mhz;
+    out.Append(", ");
+    out.AppendThousandths(ops * 1000000 / millicycles);
+    out.Append(" ops/cycle, ");
+    out.AppendThousandths(bytes * 1000000 / millicycles);
+    out.Append(" bytes/cycle");
+  }
+  out.Finish();
+  TF_LITE_REPORT_ERROR(reporter, "%s", line);
+}
+
+// Prepares |registration| with the tensors that were added, of which the last
+// one is the output and the others are inputs, and benchmarks its Invoke as
+// |name|. Configurations the kernel does not support are skipped.
+void Benchmark(const char* name, const TfLiteRegistration& registration,
+               void* builtin_data, uint64_t ops) {
+  if (!tensors.valid()) {
+    TF_LITE_REPORT_ERROR(reporter, "%s: tensors too large, skipped", name);
+    return;
+  }
+  const int num_inputs = tensors.num_tensors() - 1;
+  int inputs[kMaxTensors + 1] = {num_inputs};
+  for (int i = 0; i < num_inputs; ++i) {
+    inputs[i + 1] = i;
+  }
+  int outputs[] = {1, num_inputs};
+  KernelRunner runner(registration, tensors.tensors(), tensors.num_tensors(),
+                      IntArrayFromInts(inputs), IntArrayFromInts(outputs),
+                      builtin_data, reporter);
+  if (runner.InitAndPrepare() != kTfLiteOk || runner.Invoke() != kTfLiteOk) {
+    TF_LITE_REPORT_ERROR(reporter, "%s: not supported, skipped", name);
+    return;
+  }
+  const MicroBenchmarkResult* result =
+      suite->Run(name, [&runner]() { runner.Invoke(); });
+  if (result != nullptr) {
+    ReportThroughput(*result, ops, tensors.bytes());
+  }
+}
+
+int OutputSize(TfLitePadding padding, int input_size, int filter_size,
+               int stride, int dilation) {
+  if (padding == kTfLitePaddingSame) {
+    return (input_size + stride - 1) / stride;
+  }
+  const int effective_filter_size = (filter_size - 1) * dilation + 1;
+  return (input_size - effective_filter_size + stride) / stride;
+}
+
+struct ConvConfig {
+  const char* name;
+  TfLiteType type;
+  bool packed;
+  int input_height;
+  int input_width;
+  int input_depth;
+  int filter_height;
+  int filter_width;
+  int output_depth;
+  int stride;
+  int dilation;
+  TfLitePadding padding;
+};
+
+// Covers the 1x1, 1xN and generic int8 paths of CONV_2D, the packed variant,
+// and float.
+const ConvConfig kConvConfigs[] = {
+    {"CONV_2D/int8/1x1/16x16x32->32", kTfLiteInt8, false, 16, 16, 32, 1, 1,
+     32, 1, 1, kTfLitePaddingValid},
+    {"CONV_2D/int8/1x1/16x16x32->32/packed", kTfLiteInt8, true, 16, 16, 32, 1,
+     1, 32, 1, 1, kTfLitePaddingValid},
+    {"CONV_2D/int8/1x8/1x64x16->16", kTfLiteInt8, false, 1, 64, 16, 1, 8, 16,
+     1, 1, kTfLitePaddingSame},
+    {"CONV_2D/int8/3x3/16x16x8->8", kTfLiteInt8, false, 16, 16, 8, 3, 3, 8, 1,
+     1, kTfLitePaddingSame},
+    {"CONV_2D/int8/3x3/16x16x16->16", kTfLiteInt8, false, 16, 16, 16, 3, 3,
+     16, 1, 1, kTfLitePaddingSame},
+    {"CONV_2D/int8/3x3/16x16x32->32", kTfLiteInt8, false, 16, 16, 32, 3, 3,
+     32, 1, 1, kTfLitePaddingSame},
+    {"CONV_2D/int8/3x3/16x16x16->16/stride2", kTfLiteInt8, false, 16, 16, 16,
+     3, 3, 16, 2, 1, kTfLitePaddingSame},
+    {"CONV_2D/int8/3x3/16x16x16->16/dilation2", kTfLiteInt8, false, 16, 16,
+     16, 3, 3, 16, 1, 2, kTfLitePaddingSame},
+    {"CONV_2D/int8/3x3/16x16x16->16/packed", kTfLiteInt8, true, 16, 16, 16, 3,
+     3, 16, 1, 1, kTfLitePaddingSame},
+    {"CONV_2D/float/1x1/16x16x32->32", kTfLiteFloat32, false, 16, 16, 32, 1,
+     1, 32, 1, 1, kTfLitePaddingValid},
+    {"CONV_2D/float/3x3/16x16x16->16", kTfLiteFloat32, false, 16, 16, 16, 3,
+     3, 16, 1, 1, kTfLitePaddingSame},
+};
+
+void BenchmarkConv(const ConvConfig& config) {
+  const bool quantized = config.type == kTfLiteInt8;
+  const int output_height =
+      OutputSize(config.padding, config.input_height, config.filter_height,
+                 config.stride, config.dilation);
+  const int output_width =
+      OutputSize(config.padding, config.input_width, config.filter_width,
+                 config.stride, config.dilation);
+  tensors.Reset();
+  tensors.Add(config.type, 0.05f, 0, 4, 1, config.input_height,
+              config.input_width, config.input_depth);
+  const int filter =
+      tensors.Add(config.type, 0.01f, 0, 4, config.output_depth,
+                  config.filter_height, config.filter_width, config.input_depth);
+  const int bias = tensors.Add(quantized ? kTfLiteInt32 : kTfLiteFloat32,
+                               0.0005f, 0, 1, config.output_depth);
+  tensors.Add(config.type, 0.2f, 0, 4, 1, output_height, output_width,
+              config.output_depth);
+  if (quantized) {
+    tensors.SetPerChannel(filter, 0);
+  }
+  if (config.packed) {
+    tensors.SetConstant(filter);
+    tensors.SetConstant(bias);
+  }
+  TfLiteConvParams params = {config.padding, config.stride,
+                             config.stride,  kTfLiteActNone,
+                             config.dilation, config.dilation};
+  const uint64_t macs = static_cast<uint64_t>(output_height) * output_width *
+                        config.output_depth * config.filter_height *
+                        config.filter_width * config.input_depth;
+  Benchmark(config.name,
+            config.packed ? tflite::Register_CONV_2D_PACKED()
+                          : tflite::Register_CONV_2D(),
+            &params, 2 * macs);
+}
+
+struct DepthwiseConvConfig {
+  const char* name;
+  TfLiteType type;
+  int input_height;
+  int input_width;
+  int input_depth;
+  int filter_height;
+  int filter_width;
+  int depth_multiplier;
+  int stride;
+  int dilation;
+  TfLitePadding padding;
+};
+
+// Covers the 3x3, optimized and generic int8 paths of DEPTHWISE_CONV_2D, and
+// float.
+const DepthwiseConvConfig kDepthwiseConvConfigs[] = {
+    {"DEPTHWISE_CONV_2D/int8/3x3/16x16x8", kTfLiteInt8, 16, 16, 8, 3, 3, 1, 1,
+     1, kTfLitePaddingSame},
+    {"DEPTHWISE_CONV_2D/int8/3x3/16x16x32", kTfLiteInt8, 16, 16, 32, 3, 3, 1,
+     1, 1, kTfLitePaddingSame},
+    {"DEPTHWISE_CONV_2D/int8/3x3/16x16x64", kTfLiteInt8, 16, 16, 64, 3, 3, 1,
+     1, 1, kTfLitePaddingSame},
+    {"DEPTHWISE_CONV_2D/int8/3x3/16x16x32/stride2", kTfLiteInt8, 16, 16, 32, 3,
+     3, 1, 2, 1, kTfLitePaddingSame},
+    {"DEPTHWISE_CONV_2D/int8/3x3/16x16x32/dilation2", kTfLiteInt8, 16, 16, 32,
+     3, 3, 1, 1, 2, kTfLitePaddingSame},
+    {"DEPTHWISE_CONV_2D/int8/5x5/16x16x32", kTfLiteInt8, 16, 16, 32, 5, 5, 1,
+     1, 1, kTfLitePaddingSame},
+    {"DEPTHWISE_CONV_2D/int8/3x3/16x16x16/multiplier2", kTfLiteInt8, 16, 16,
+     16, 3, 3, 2, 1, 1, kTfLitePaddingSame},
+    {"DEPTHWISE_CONV_2D/float/3x3/16x16x32", kTfLiteFloat32, 16, 16, 32, 3, 3,
+     1, 1, 1, kTfLitePaddingSame},
+};
+
+void BenchmarkDepthwiseConv(const DepthwiseConvConfig& config) {
+  const bool quantized = config.type == kTfLiteInt8;
+  const int output_depth = config.input_depth * config.depth_multiplier;
+  const int output_height =
+      OutputSize(config.padding, config.input_height, config.filter_height,
+                 config.stride, config.dilation);
+  const int output_width =
+      OutputSize(config.padding, config.input_width, config.filter_width,
+                 config.stride, config.dilation);
+  tensors.Reset();
+  tensors.Add(config.type, 0.05f, 0, 4, 1, config.input_height,
+              config.input_width, config.input_depth);
+  const int filter = tensors.Add(config.type, 0.01f, 0, 4, 1,
+                                 config.filter_height, config.filter_width,
+                                 output_depth);
+  tensors.Add(quantized ? kTfLiteInt32 : kTfLiteFloat32, 0.0005f, 0, 1,
+              output_depth);
+  tensors.Add(config.type, 0.2f, 0, 4, 1, output_height, output_width,
+              output_depth);
+  if (quantized) {
+    tensors.SetPerChannel(filter, 3);
+  }
+  TfLiteDepthwiseConvParams params = {};
+  params.padding = config.padding;
+  params.stride_width = config.stride;
+  params.stride_height = config.stride;
+  params.depth_multiplier = config.depth_multiplier;
+  params.activation = kTfLiteActNone;
+  params.dilation_width_factor = config.dilation;
+  params.dilation_height_factor = config.dilation;
+  const uint64_t macs = static_cast<uint64_t>(output_height) * output_width *
+                        output_depth * config.filter_height *
+                        config.filter_width;
+  Benchmark(config.name, tflite::Register_DEPTHWISE_CONV_2D(), &params,
+            2 * macs);
+}
+
+struct FullyConnectedConfig {
+  const char* name;
+  TfLiteType type;
+  bool packed;
+  int batches;
+  int input_size;
+  int output_size;
+};
+
+// The packed variant keeps its weights in the 10 KB KernelRunner arena, which
+// limits it to the smaller shape.
+const FullyConnectedConfig kFullyConnectedConfigs[] = {
+    {"FULLY_CONNECTED/int8/1x128->64", kTfLiteInt8, false, 1, 128, 64},
+    {"FULLY_CONNECTED/int8/1x128->64/packed", kTfLiteInt8, true, 1, 128, 64},
+    {"FULLY_CONNECTED/int8/1x256->64", kTfLiteInt8, false, 1, 256, 64},
+    {"FULLY_CONNECTED/int8/8x256->64", kTfLiteInt8, false, 8, 256, 64},
+    {"FULLY_CONNECTED/float/1x128->64", kTfLiteFloat32, false, 1, 128, 64},
+};
+
+void BenchmarkFullyConnected(const FullyConnectedConfig& config) {
+  const bool quantized = config.type == kTfLiteInt8;
+  tensors.Reset();
+  tensors.Add(config.type, 0.05f, 0, 2, config.batches, config.input_size);
+  const int weights = tensors.Add(config.type, 0.01f, 0, 2, config.output_size,
+                                  config.input_size);
+  const int bias = tensors.Add(quantized ? kTfLiteInt32 : kTfLiteFloat32,
+                               0.0005f, 0, 1, config.output_size);
+  tensors.Add(config.type, 0.2f, 0, 2, config.batches, config.output_size);
+  if (config.packed) {
+    tensors.SetConstant(weights);
+    tensors.SetConstant(bias);
+  }
+  TfLiteFullyConnectedParams params = {};
+  params.activation = kTfLiteActNone;
+  params.weights_format = kTfLiteFullyConnectedWeightsFormatDefault;
+  const uint64_t macs = static_cast<uint64_t>(config.batches) *
+                        config.input_size * config.output_size;
+  Benchmark(config.name,
+            config.packed ? tflite::Register_FULLY_CONNECTED_PACKED()
+                          : tflite::Register_FULLY_CONNECTED(),
+            &params, 2 * macs);
+}
+
+struct SvdfConfig {
+  const char* name;
+  TfLiteType type;
+  int batches;
+  int input_size;
+  int num_filters;
+  int memory_size;
+  int rank;
+};
+
+const SvdfConfig kSvdfConfigs[] = {
+    {"SVDF/int8/1x32/filters64/memory10", kTfLiteInt8, 1, 32, 64, 10, 1},
+    {"SVDF/int8/1x64/filters128/memory16/rank2", kTfLiteInt8, 1, 64, 128, 16,
+     2},
+    {"SVDF/float/1x32/filters64/memory10", kTfLiteFloat32, 1, 32, 64, 10, 1},
+    {"SVDF/float/1x64/filters128/memory16/rank2", kTfLiteFloat32, 1, 64, 128,
+     16, 2},
+};
+
+void BenchmarkSvdf(const SvdfConfig& config) {
+  const bool quantized = config.type == kTfLiteInt8;
+  const int num_units = config.num_filters / config.rank;
+  // The bias scale has to be the product of the state and time weight scales.
+  const float weights_time_scale = 1.0f / 1024;
+  const float state_scale = 1.0f / 256;
+  tensors.Reset();
+  tensors.Add(config.type, 0.05f, 0, 2, config.batches, config.input_size);
+  tensors.Add(config.type, 0.01f, 0, 2, config.num_filters, config.input_size);
+  tensors.Add(quantized ? kTfLiteInt16 : kTfLiteFloat32, weights_time_scale, 0,
+              2, config.num_filters, config.memory_size);
+  tensors.Add(quantized ? kTfLiteInt32 : kTfLiteFloat32,
+              state_scale * weights_time_scale, 0, 1, num_units);
+  const int state =
+      tensors.Add(quantized ? kTfLiteInt16 : kTfLiteFloat32, state_scale, 0, 2,
+                  config.batches, config.memory_size * config.num_filters);
+  tensors.Add(config.type, 0.1f, 0, 2, config.batches, num_units);
+  tensors.SetVariable(state);
+  TfLiteSVDFParams params = {};
+  params.rank = config.rank;
+  params.activation = kTfLiteActNone;
+  const uint64_t macs =
+      static_cast<uint64_t>(config.batches) * config.num_filters *
+      (config.input_size + config.memory_size);
+  Benchmark(config.name, tflite::Register_SVDF(), &params, 2 * macs);
+}
+
+struct SoftmaxConfig {
+  const char* name;
+  TfLiteType type;
+  int batches;
+  int depth;
+};
+
+const SoftmaxConfig kSoftmaxConfigs[] = {
+    {"SOFTMAX/int8/1x1024", kTfLiteInt8, 1, 1024},
+    {"SOFTMAX/int8/64x16", kTfLiteInt8, 64, 16},
+    {"SOFTMAX/float/1x1024", kTfLiteFloat32, 1, 1024},
+};
+
+void BenchmarkSoftmax(const SoftmaxConfig& config) {
+  tensors.Reset();
+  tensors.Add(config.type, 0.1f, 0, 2, config.batches, config.depth);
+  // Quantized softmax requires this output quantization.
+  tensors.Add(config.type, 1.0f / 256, -128, 2, config.batches, config.depth);
+  TfLiteSoftmaxParams params = {1.0f};
+  Benchmark(config.name, tflite::Register_SOFTMAX(), &params,
+            static_cast<uint64_t>(config.batches) * config.depth);
+}
+
+struct PoolingConfig {
+  const char* name;
+  TfLiteRegistration (*registration)();
+  TfLiteType type;
+  int input_height;
+  int input_width;
+  int depth;
+  int filter_size;
+  int stride;
+  TfLitePadding padding;
+};
+
+const PoolingConfig kPoolingConfigs[] = {
+    {"AVERAGE_POOL_2D/int8/2x2/16x16x32/stride2",
+     tflite::ops::micro::Register_AVERAGE_POOL_2D, kTfLiteInt8, 16, 16, 32, 2,
+     2, kTfLitePaddingValid},
+    {"MAX_POOL_2D/int8/2x2/16x16x32/stride2",
+     tflite::ops::micro::Register_MAX_POOL_2D, kTfLiteInt8, 16, 16, 32, 2, 2,
+     kTfLitePaddingValid},
+    {"MAX_POOL_2D/int8/3x3/16x16x32/stride2",
+     tflite::ops::micro::Register_MAX_POOL_2D, kTfLiteInt8, 16, 16, 32, 3, 2,
+     kTfLitePaddingSame},
+    {"AVERAGE_POOL_2D/float/2x2/16x16x32/stride2",
+     tflite::ops::micro::Register_AVERAGE_POOL_2D, kTfLiteFloat32, 16, 16, 32,
+     2, 2, kTfLitePaddingValid},
+};
+
+void BenchmarkPooling(const PoolingConfig& config) {
+  const int output_height = OutputSize(config.padding, config.input_height,
+                                       config.filter_size, config.stride, 1);
+  const int output_width = OutputSize(config.padding, config.input_width,
+                                      config.filter_size, config.stride, 1);
+  tensors.Reset();
+  tensors.Add(config.type, 0.05f, 0, 4, 1, config.input_height,
+              config.input_width, config.depth);
+  tensors.Add(config.type, 0.05f, 0, 4, 1, output_height, output_width,
+              config.depth);
+  TfLitePoolParams params = {};
+  params.padding = config.padding;
+  params.stride_width = config.stride;
+  params.stride_height = config.stride;
+  params.filter_width = config.filter_size;
+  params.filter_height = config.filter_size;
+  params.activation = kTfLiteActNone;
+  const uint64_t ops = static_cast<uint64_t>(output_height) * output_width *
+                       config.depth * config.filter_size * config.filter_size;
+  Benchmark(config.name, config.registration(), &params, ops);
+}
+
+struct ElementwiseConfig {
+  const char* name;
+  TfLiteType type;
+  bool broadcast;
+};
+
+// The second input is either the full 1x16x16x32 shape or a 1x1x1x32 vector.
+const ElementwiseConfig kElementwiseConfigs[] = {
+    {"int8/16x16x32", kTfLiteInt8, false},
+    {"int8/16x16x32+1x1x32", kTfLiteInt8, true},
+    {"float/16x16x32", kTfLiteFloat32, false},
+};
+
+constexpr int kMaxNameLength = 64;
+char elementwise_names[2 * sizeof(kElementwiseConfigs) /
+                       sizeof(kElementwiseConfigs[0])][kMaxNameLength];
+int num_elementwise_names = 0;
+
+void BenchmarkElementwise(const char* op, const ElementwiseConfig& config,
+                          const TfLiteRegistration& registration,
+                          void* builtin_data, float output_scale) {
+  // Benchmark names have to outlive the suite.
+  char* name = elementwise_names[num_elementwise_names++];
+  tflite::internal::OutputBuffer out(name, kMaxNameLength);
+  out.Append(op);
+  out.Append("/");
+  out.Append(config.name);
+  out.Finish();
+
+  const int size = config.broadcast ? 1 : 16;
+  tensors.Reset();
+  tensors.Add(config.type, 0.05f, 0, 4, 1, 16, 16, 32);
+  tensors.Add(config.type, 0.05f, 0, 4, 1, size, size, 32);
+  tensors.Add(config.type, output_scale, 0, 4, 1, 16, 16, 32);
+  Benchmark(name, registration, builtin_data, 16 * 16 * 32);
+}
+
+int ParseCpuMhz(int argc, char** argv) {
+  static const char kFlag[] = "--cpu_mhz=";
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], kFlag, sizeof(kFlag) - 1) == 0) {
+      return atoi(argv[i] + sizeof(kFlag) - 1);
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  tflite::MicroErrorReporter error_reporter;
+  reporter = &error_reporter;
+  // Kernels are fast, so fewer samples keep the sweep short.
+  MicroBenchmarkOptions options;
+  options.min_time_ns = 200000000;
+  MicroBenchmarkSuite benchmark_suite(&error_reporter, options);
+  suite = &benchmark_suite;
+  cpu_mhz = ParseCpuMhz(argc, argv);
+  std::srand(kRandomSeed);
+
+  for (const ConvConfig& config : kConvConfigs) {
+    BenchmarkConv(config);
+  }
+  for (const DepthwiseConvConfig& config : kDepthwiseConvConfigs) {
+    BenchmarkDepthwiseConv(config);
+  }
+  for (const FullyConnectedConfig& config : kFullyConnectedConfigs) {
+    BenchmarkFullyConnected(config);
+  }
+  for (const SvdfConfig& config : kSvdfConfigs) {
+    BenchmarkSvdf(config);
+  }
+  for (const SoftmaxConfig& config : kSoftmaxConfigs) {
+    BenchmarkSoftmax(config);
+  }
+  for (const PoolingConfig& config : kPoolingConfigs) {
+    BenchmarkPooling(config);
+  }
+  TfLiteAddParams add_params = {kTfLiteActNone, false};
+  TfLiteMulParams mul_params = {kTfLiteActNone};
+  for (const ElementwiseConfig& config : kElementwiseConfigs) {
+    BenchmarkElementwise("ADD", config, tflite::ops::micro::Register_ADD(),
+                         &add_params, 0.1f);
+  }
+  for (const ElementwiseConfig& config : kElementwiseConfigs) {
+    BenchmarkElementwise("MUL", config, tflite::ops::micro::Register_MUL(),
+                         &mul_params, 0.01f);
+  }
+  return benchmark_suite.Finish(argc, argv);
+}
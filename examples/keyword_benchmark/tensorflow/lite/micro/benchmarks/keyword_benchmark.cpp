@@ -42,9 +42,16 @@ constexpr int kRandomSeed = 42;
 constexpr int kTensorArenaSize = 21 * 1024;
 alignas(16) uint8_t tensor_arena[kTensorArenaSize];
 
+// The batched runner scores kBatchSize independent audio streams per Invoke.
+constexpr int kBatchSize = 8;
+constexpr int kBatchedTensorArenaSize = 96 * 1024;
+alignas(16) uint8_t batched_tensor_arena[kBatchedTensorArenaSize];
+
 uint8_t benchmark_runner_buffer[sizeof(KeywordBenchmarkRunner)];
+uint8_t batched_benchmark_runner_buffer[sizeof(KeywordBenchmarkRunner)];
 uint8_t op_resolver_buffer[sizeof(KeywordOpResolver)];
 KeywordBenchmarkRunner* benchmark_runner = nullptr;
+KeywordBenchmarkRunner* batched_benchmark_runner = nullptr;
 
 // Initialize benchmark runner instance explicitly to avoid global init order
 // issues on Sparkfun. Use new since static variables within a method
@@ -62,29 +69,28 @@ void CreateBenchmarkRunner() {
   benchmark_runner = new (benchmark_runner_buffer)
       KeywordBenchmarkRunner(g_keyword_scrambled_model_data, op_resolver,
                              tensor_arena, kTensorArenaSize);
+  batched_benchmark_runner = new (batched_benchmark_runner_buffer)
+      KeywordBenchmarkRunner(g_keyword_scrambled_model_data, op_resolver,
+                             batched_tensor_arena, kBatchedTensorArenaSize,
+                             kBatchSize);
 }
 
 // Initializes keyword runner and sets random inputs.
 void InitializeKeywordRunner() {
   CreateBenchmarkRunner();
   benchmark_runner->SetRandomInput(kRandomSeed);
-}
-
-// This method assumes InitializeKeywordRunner has already been run.
-void KeywordRunNIerations(int iterations) {
-  for (int i = 0; i < iterations; i++) {
-    benchmark_runner->RunSingleIteration();
-  }
+  batched_benchmark_runner->SetRandomInput(kRandomSeed);
 }
 
 }  //  namespace
 
-TF_LITE_MICRO_BENCHMARKS_BEGIN
-
-TF_LITE_MICRO_BENCHMARK(InitializeKeywordRunner());
-
-TF_LITE_MICRO_BENCHMARK(KeywordRunNIerations(1));
-
-TF_LITE_MICRO_BENCHMARK(KeywordRunNIerations(10));
-
-TF_LITE_MICRO_BENCHMARKS_END
+int main(int argc, char** argv) {
+  tflite::MicroErrorReporter error_reporter;
+  MicroBenchmarkSuite suite(&error_reporter);
+  InitializeKeywordRunner();
+  suite.Run("KeywordInvoke", []() { benchmark_runner->RunSingleIteration(); });
+  suite.Run(
+      "KeywordBatchedInvoke",
+      []() { batched_benchmark_runner->RunSingleIteration(); }, kBatchSize);
+  return suite.Finish(argc, argv);
+}
@@ -0,0 +1,71 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+
+#include "magic_wand_model_data.h"
+#include "ring_micro_features_data.h"
+#include "tensorflow/lite/micro/benchmarks/micro_benchmark.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+
+/*
+ * Magic Wand benchmark. Evaluates the runtime performance of the gesture
+ * model from examples/magic_wand on a recorded ring gesture.
+ */
+
+namespace {
+
+using MagicWandOpResolver = tflite::MicroMutableOpResolver<5>;
+using MagicWandBenchmarkRunner = MicroBenchmarkRunner<float>;
+
+// Create an area of memory to use for input, output, and intermediate arrays.
+// Align arena to 16 bytes to avoid alignment warnings on certain platforms.
+constexpr int kTensorArenaSize = 60 * 1024;
+alignas(16) uint8_t tensor_arena[kTensorArenaSize];
+
+uint8_t op_resolver_buffer[sizeof(MagicWandOpResolver)];
+uint8_t benchmark_runner_buffer[sizeof(MagicWandBenchmarkRunner)];
+MagicWandBenchmarkRunner* benchmark_runner = nullptr;
+
+// Initialize benchmark runner instance explicitly to avoid global init order
+// issues on Sparkfun. Use new since static variables within a method
+// are automatically surrounded by locking, which breaks bluepill and stm32f4.
+void CreateBenchmarkRunner() {
+  // We allocate the MagicWandOpResolver from a global buffer because the
+  // object's lifetime must exceed that of the MagicWandBenchmarkRunner object.
+  MagicWandOpResolver* op_resolver =
+      new (op_resolver_buffer) MagicWandOpResolver();
+  op_resolver->AddConv2D();
+  op_resolver->AddDepthwiseConv2D();
+  op_resolver->AddFullyConnected();
+  op_resolver->AddMaxPool2D();
+  op_resolver->AddSoftmax();
+
+  benchmark_runner = new (benchmark_runner_buffer) MagicWandBenchmarkRunner(
+      g_magic_wand_model_data, op_resolver, tensor_arena, kTensorArenaSize);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  tflite::MicroErrorReporter error_reporter;
+  MicroBenchmarkSuite suite(&error_reporter);
+  CreateBenchmarkRunner();
+  benchmark_runner->SetInput(g_ring_micro_f9643d42_nohash_4_data);
+  suite.Run("MagicWandInvoke",
+            []() { benchmark_runner->RunSingleIteration(); });
+  return suite.Finish(argc, argv);
+}
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "feature_provider.h"
 
+#include <cstring>
+
 #include "audio_provider.h"
 #include "micro_features/micro_features_generator.h"
 #include "micro_features/micro_model_settings.h"
@@ -75,17 +77,11 @@ TfLiteStatus FeatureProvider::PopulateFeatureData(
   // +-----------+   --        +-----------+
   // | data@80ms | --          |  <empty>  |
   // +-----------+             +-----------+
+  // The kept slices are contiguous, so they move up in a single memmove.
   if (slices_to_keep > 0) {
-    for (int dest_slice = 0; dest_slice < slices_to_keep; ++dest_slice) {
-      int8_t* dest_slice_data =
-          feature_data_ + (dest_slice * kFeatureSliceSize);
-      const int src_slice = dest_slice + slices_to_drop;
-      const int8_t* src_slice_data =
-          feature_data_ + (src_slice * kFeatureSliceSize);
-      for (int i = 0; i < kFeatureSliceSize; ++i) {
-        dest_slice_data[i] = src_slice_data[i];
-      }
-    }
+    std::memmove(feature_data_,
+                 feature_data_ + (slices_to_drop * kFeatureSliceSize),
+                 slices_to_keep * kFeatureSliceSize);
   }
   // Any slices that need to be filled in with feature data have their
   // appropriate audio data pulled, and features calculated for that slice.
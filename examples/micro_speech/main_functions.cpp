@@ -40,7 +40,9 @@ int32_t previous_time = 0;
 // Create an area of memory to use for input, output, and intermediate arrays.
 // The size of this will depend on the model you're using, and may need to be
 // determined by experimentation.
-constexpr int kTensorArenaSize = 10 * 1024;
+// The streaming depthwise convolution keeps its previous input and output rows
+// in the arena as well.
+constexpr int kTensorArenaSize = 20 * 1024;
 uint8_t tensor_arena[kTensorArenaSize];
 int8_t feature_buffer[kFeatureElementCount];
 int8_t* model_input_buffer = nullptr;
@@ -74,7 +76,10 @@ void setup() {
   // tflite::AllOpsResolver resolver;
   // NOLINTNEXTLINE(runtime-global-variables)
   static tflite::MicroMutableOpResolver<4> micro_op_resolver(error_reporter);
-  if (micro_op_resolver.AddDepthwiseConv2D() != kTfLiteOk) {
+  // The spectrogram only moves by a few slices between invocations, so use the
+  // depthwise convolution that reuses the output rows it computed last time.
+  if (micro_op_resolver.AddDepthwiseConv2D(
+          tflite::Register_DEPTHWISE_CONV_2D_STREAMING()) != kTfLiteOk) {
     return;
   }
   if (micro_op_resolver.AddFullyConnected() != kTfLiteOk) {
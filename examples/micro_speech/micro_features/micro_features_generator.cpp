@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "micro_features/micro_features_generator.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
@@ -27,12 +28,65 @@ limitations under the License.
 
 namespace {
 
-FrontendState g_micro_features_state;
-bool g_is_first_time = true;
+MicroFeaturesGenerator g_micro_features_generator;
+
+// Number of streams GenerateMicroFeaturesBatch() passes to the frontend at a
+// time, which bounds the per-call arrays it keeps on the stack.
+constexpr int kMaxBatchStreams = 16;
+
+// Returns where the frontend should start reading |input|. Every call after
+// the first one only needs the samples that follow the previous window.
+const int16_t* FrontendInput(MicroFeaturesGenerator* generator,
+                             const int16_t* input) {
+  if (generator->is_first_time) {
+    generator->is_first_time = false;
+    return input;
+  }
+  return input + 160;
+}
+
+void ConvertFrontendOutput(const FrontendOutput& frontend_output,
+                           int8_t* output) {
+  for (size_t i = 0; i < frontend_output.size; ++i) {
+    // These scaling values are derived from those used in input_data.py in the
+    // training pipeline.
+    // The feature pipeline outputs 16-bit signed integers in roughly a 0 to 670
+    // range. In training, these are then arbitrarily divided by 25.6 to get
+    // float values in the rough range of 0.0 to 26.0. This scaling is performed
+    // for historical reasons, to match up with the output of other feature
+    // generators.
+    // The process is then further complicated when we quantize the model. This
+    // means we have to scale the 0.0 to 26.0 real values to the -128 to 127
+    // signed integer numbers.
+    // All this means that to get matching values from our integer feature
+    // output into the tensor input, we have to perform:
+    // input = (((feature / 25.6) / 26.0) * 256) - 128
+    // To simplify this and perform it in 32-bit integer math, we rearrange to:
+    // input = (feature * 256) / (25.6 * 26.0) - 128
+    constexpr int32_t value_scale = 256;
+    constexpr int32_t value_div = static_cast<int32_t>((25.6f * 26.0f) + 0.5f);
+    int32_t value =
+        ((frontend_output.values[i] * value_scale) + (value_div / 2)) /
+        value_div;
+    value -= 128;
+    if (value < -128) {
+      value = -128;
+    }
+    if (value > 127) {
+      value = 127;
+    }
+    output[i] = value;
+  }
+}
 
 }  // namespace
 
 TfLiteStatus InitializeMicroFeatures(tflite::ErrorReporter* error_reporter) {
+  return InitializeMicroFeatures(error_reporter, &g_micro_features_generator);
+}
+
+TfLiteStatus InitializeMicroFeatures(tflite::ErrorReporter* error_reporter,
+                                     MicroFeaturesGenerator* generator) {
   FrontendConfig config;
   config.window.size_ms = kFeatureSliceDurationMs;
   config.window.step_size_ms = kFeatureSliceStrideMs;
@@ -50,67 +104,75 @@ TfLiteStatus InitializeMicroFeatures(tflite::ErrorReporter* error_reporter) {
   config.pcan_gain_control.gain_bits = 21;
   config.log_scale.enable_log = 1;
   config.log_scale.scale_shift = 6;
-  if (!FrontendPopulateState(&config, &g_micro_features_state,
+  if (!FrontendPopulateState(&config, &generator->frontend_state,
                              kAudioSampleFrequency)) {
     TF_LITE_REPORT_ERROR(error_reporter, "FrontendPopulateState() failed");
     return kTfLiteError;
   }
-  g_is_first_time = true;
+  generator->is_first_time = true;
   return kTfLiteOk;
 }
 
-// This is not exposed in any header, and is only used for testing, to ensure
-// that the state is correctly set up before generating results.
-void SetMicroFeaturesNoiseEstimates(const uint32_t* estimate_presets) {
-  for (int i = 0; i < g_micro_features_state.filterbank.num_channels; ++i) {
-    g_micro_features_state.noise_reduction.estimate[i] = estimate_presets[i];
+void FreeMicroFeatures(MicroFeaturesGenerator* generator) {
+  FrontendFreeStateContents(&generator->frontend_state);
+}
+
+// These are not exposed in any header, and are only used for testing, to
+// ensure that the state is correctly set up before generating results.
+void SetMicroFeaturesNoiseEstimates(MicroFeaturesGenerator* generator,
+                                    const uint32_t* estimate_presets) {
+  FrontendState& state = generator->frontend_state;
+  for (int i = 0; i < state.filterbank.num_channels; ++i) {
+    state.noise_reduction.estimate[i] = estimate_presets[i];
   }
 }
 
+void SetMicroFeaturesNoiseEstimates(const uint32_t* estimate_presets) {
+  SetMicroFeaturesNoiseEstimates(&g_micro_features_generator,
+                                 estimate_presets);
+}
+
 TfLiteStatus GenerateMicroFeatures(tflite::ErrorReporter* error_reporter,
                                    const int16_t* input, int input_size,
                                    int output_size, int8_t* output,
                                    size_t* num_samples_read) {
-  const int16_t* frontend_input;
-  if (g_is_first_time) {
-    frontend_input = input;
-    g_is_first_time = false;
-  } else {
-    frontend_input = input + 160;
-  }
+  return GenerateMicroFeatures(error_reporter, &g_micro_features_generator,
+                               input, input_size, output_size, output,
+                               num_samples_read);
+}
+
+TfLiteStatus GenerateMicroFeatures(tflite::ErrorReporter* error_reporter,
+                                   MicroFeaturesGenerator* generator,
+                                   const int16_t* input, int input_size,
+                                   int output_size, int8_t* output,
+                                   size_t* num_samples_read) {
   FrontendOutput frontend_output = FrontendProcessSamples(
-      &g_micro_features_state, frontend_input, input_size, num_samples_read);
+      &generator->frontend_state, FrontendInput(generator, input), input_size,
+      num_samples_read);
+  ConvertFrontendOutput(frontend_output, output);
+  return kTfLiteOk;
+}
 
-  for (size_t i = 0; i < frontend_output.size; ++i) {
-    // These scaling values are derived from those used in input_data.py in the
-    // training pipeline.
-    // The feature pipeline outputs 16-bit signed integers in roughly a 0 to 670
-    // range. In training, these are then arbitrarily divided by 25.6 to get
-    // float values in the rough range of 0.0 to 26.0. This scaling is performed
-    // for historical reasons, to match up with the output of other feature
-    // generators.
-    // The process is then further complicated when we quantize the model. This
-    // means we have to scale the 0.0 to 26.0 real values to the -128 to 127
-    // signed integer numbers.
-    // All this means that to get matching values from our integer feature
-    // output into the tensor input, we have to perform:
-    // input = (((feature / 25.6) / 26.0) * 256) - 128
-    // To simplify this and perform it in 32-bit integer math, we rearrange to:
-    // input = (feature * 256) / (25.6 * 26.0) - 128
-    constexpr int32_t value_scale = 256;
-    constexpr int32_t value_div = static_cast<int32_t>((25.6f * 26.0f) + 0.5f);
-    int32_t value =
-        ((frontend_output.values[i] * value_scale) + (value_div / 2)) /
-        value_div;
-    value -= 128;
-    if (value < -128) {
-      value = -128;
+TfLiteStatus GenerateMicroFeaturesBatch(
+    tflite::ErrorReporter* error_reporter,
+    MicroFeaturesGenerator* const* generators, int num_streams,
+    const int16_t* const* inputs, int input_size, int output_size,
+    int8_t* const* outputs, size_t* num_samples_read) {
+  FrontendState* states[kMaxBatchStreams];
+  const int16_t* frontend_inputs[kMaxBatchStreams];
+  FrontendOutput frontend_outputs[kMaxBatchStreams];
+  for (int begin = 0; begin < num_streams; begin += kMaxBatchStreams) {
+    const int count = std::min(kMaxBatchStreams, num_streams - begin);
+    for (int i = 0; i < count; ++i) {
+      states[i] = &generators[begin + i]->frontend_state;
+      frontend_inputs[i] =
+          FrontendInput(generators[begin + i], inputs[begin + i]);
     }
-    if (value > 127) {
-      value = 127;
+    FrontendProcessSamplesBatch(states, frontend_inputs, count, input_size,
+                                num_samples_read + begin, frontend_outputs);
+    for (int i = 0; i < count; ++i) {
+      ConvertFrontendOutput(frontend_outputs[i], outputs[begin + i]);
     }
-    output[i] = value;
   }
-
   return kTfLiteOk;
 }
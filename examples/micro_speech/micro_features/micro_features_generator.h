@@ -17,8 +17,17 @@ limitations under the License.
 #define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_MICRO_FEATURES_MICRO_FEATURES_GENERATOR_H_
 
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 
+// State of the feature generation pipeline for one audio stream. Streams do
+// not share any state, so one process can generate features for as many of
+// them as it has generators.
+struct MicroFeaturesGenerator {
+  FrontendState frontend_state;
+  bool is_first_time;
+};
+
 // Sets up any resources needed for the feature generation pipeline.
 TfLiteStatus InitializeMicroFeatures(tflite::ErrorReporter* error_reporter);
 
@@ -29,4 +38,29 @@ TfLiteStatus GenerateMicroFeatures(tflite::ErrorReporter* error_reporter,
                                    int output_size, int8_t* output,
                                    size_t* num_samples_read);
 
+// Same as above, for the stream of |generator|. The functions without a
+// generator use a single global one.
+TfLiteStatus InitializeMicroFeatures(tflite::ErrorReporter* error_reporter,
+                                     MicroFeaturesGenerator* generator);
+
+TfLiteStatus GenerateMicroFeatures(tflite::ErrorReporter* error_reporter,
+                                   MicroFeaturesGenerator* generator,
+                                   const int16_t* input, int input_size,
+                                   int output_size, int8_t* output,
+                                   size_t* num_samples_read);
+
+// Releases the buffers InitializeMicroFeatures() allocated for |generator|.
+void FreeMicroFeatures(MicroFeaturesGenerator* generator);
+
+// Generates the features of |num_streams| streams in one call, where stream i
+// uses generators[i], reads input_size samples from inputs[i] and writes
+// output_size features to outputs[i]. Produces the same results as calling
+// GenerateMicroFeatures() for each stream, but runs every frontend stage for
+// all streams before the next one.
+TfLiteStatus GenerateMicroFeaturesBatch(
+    tflite::ErrorReporter* error_reporter,
+    MicroFeaturesGenerator* const* generators, int num_streams,
+    const int16_t* const* inputs, int input_size, int output_size,
+    int8_t* const* outputs, size_t* num_samples_read);
+
 #endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_MICRO_FEATURES_MICRO_FEATURES_GENERATOR_H_
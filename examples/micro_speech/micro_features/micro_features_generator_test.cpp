@@ -23,8 +23,32 @@ limitations under the License.
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 #include "tensorflow/lite/micro/testing/micro_test.h"
 
-// This is a test-only API, not exposed in any public headers, so declare it.
+// These are test-only APIs, not exposed in any public headers, so declare them.
 void SetMicroFeaturesNoiseEstimates(const uint32_t* estimate_presets);
+void SetMicroFeaturesNoiseEstimates(MicroFeaturesGenerator* generator,
+                                    const uint32_t* estimate_presets);
+
+namespace {
+
+// Known snapshots of the noise estimates at the point that the golden feature
+// values were created.
+const uint32_t yes_estimate_presets[] = {
+    1062898, 2644477, 1257642, 1864718, 412722, 725703, 395721, 474082,
+    173046,  255856,  158966,  153736,  69181,  199100, 144493, 227740,
+    110573,  164330,  79666,   144650,  122947, 476799, 398553, 497493,
+    322152,  1140005, 566716,  690605,  308902, 347481, 109891, 170457,
+    73901,   100975,  42963,   72325,   34183,  20207,  6640,   9468,
+};
+
+const uint32_t no_estimate_presets[] = {
+    2563964, 1909393, 559801, 538670, 203643, 175959, 75088, 139491,
+    59691,   95307,   43865,  129263, 52517,  80058,  51330, 100731,
+    76674,   76262,   15497,  22598,  13778,  21460,  8946,  17806,
+    10023,   18810,   8002,   10842,  7578,   9983,   6267,  10759,
+    8946,    18488,   9691,   39785,  9939,   17835,  9671,  18512,
+};
+
+}  // namespace
 
 TF_LITE_MICRO_TESTS_BEGIN
 
@@ -39,13 +63,6 @@ TF_LITE_MICRO_TEST(TestMicroFeaturesGeneratorYes) {
   // exactly reproduce results in a test environment, so use a known snapshot
   // of the parameters at the point that the golden feature values were
   // created.
-  const uint32_t yes_estimate_presets[] = {
-      1062898, 2644477, 1257642, 1864718, 412722, 725703, 395721, 474082,
-      173046,  255856,  158966,  153736,  69181,  199100, 144493, 227740,
-      110573,  164330,  79666,   144650,  122947, 476799, 398553, 497493,
-      322152,  1140005, 566716,  690605,  308902, 347481, 109891, 170457,
-      73901,   100975,  42963,   72325,   34183,  20207,  6640,   9468,
-  };
   SetMicroFeaturesNoiseEstimates(yes_estimate_presets);
 
   int8_t yes_calculated_data[g_yes_feature_data_slice_size];
@@ -74,13 +91,6 @@ TF_LITE_MICRO_TEST(TestMicroFeaturesGeneratorNo) {
                           InitializeMicroFeatures(&micro_error_reporter));
   // As we did for the previous features, set known good noise state
   // parameters.
-  const uint32_t no_estimate_presets[] = {
-      2563964, 1909393, 559801, 538670, 203643, 175959, 75088, 139491,
-      59691,   95307,   43865,  129263, 52517,  80058,  51330, 100731,
-      76674,   76262,   15497,  22598,  13778,  21460,  8946,  17806,
-      10023,   18810,   8002,   10842,  7578,   9983,   6267,  10759,
-      8946,    18488,   9691,   39785,  9939,   17835,  9671,  18512,
-  };
   SetMicroFeaturesNoiseEstimates(no_estimate_presets);
 
   int8_t no_calculated_data[g_no_feature_data_slice_size];
@@ -101,4 +111,46 @@ TF_LITE_MICRO_TEST(TestMicroFeaturesGeneratorNo) {
   }
 }
 
+TF_LITE_MICRO_TEST(TestMicroFeaturesGeneratorBatch) {
+  tflite::MicroErrorReporter micro_error_reporter;
+
+  // Runs the yes and no streams side by side, each with its own generator,
+  // and expects both to produce the same features as on their own.
+  MicroFeaturesGenerator yes_generator;
+  MicroFeaturesGenerator no_generator;
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, InitializeMicroFeatures(&micro_error_reporter, &yes_generator));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, InitializeMicroFeatures(&micro_error_reporter, &no_generator));
+  SetMicroFeaturesNoiseEstimates(&yes_generator, yes_estimate_presets);
+  SetMicroFeaturesNoiseEstimates(&no_generator, no_estimate_presets);
+
+  TF_LITE_MICRO_EXPECT_EQ(g_yes_30ms_sample_data_size,
+                          g_no_30ms_sample_data_size);
+  TF_LITE_MICRO_EXPECT_EQ(g_yes_feature_data_slice_size,
+                          g_no_feature_data_slice_size);
+  int8_t yes_calculated_data[g_yes_feature_data_slice_size];
+  int8_t no_calculated_data[g_no_feature_data_slice_size];
+  MicroFeaturesGenerator* generators[] = {&yes_generator, &no_generator};
+  const int16_t* inputs[] = {g_yes_30ms_sample_data, g_no_30ms_sample_data};
+  int8_t* outputs[] = {yes_calculated_data, no_calculated_data};
+  size_t num_samples_read[2];
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk,
+      GenerateMicroFeaturesBatch(&micro_error_reporter, generators, 2, inputs,
+                                 g_yes_30ms_sample_data_size,
+                                 g_yes_feature_data_slice_size, outputs,
+                                 num_samples_read));
+  TF_LITE_MICRO_EXPECT_EQ(num_samples_read[0], num_samples_read[1]);
+
+  for (int i = 0; i < g_yes_feature_data_slice_size; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(g_yes_feature_data_slice[i],
+                            yes_calculated_data[i]);
+    TF_LITE_MICRO_EXPECT_EQ(g_no_feature_data_slice[i], no_calculated_data[i]);
+  }
+
+  FreeMicroFeatures(&yes_generator);
+  FreeMicroFeatures(&no_generator);
+}
+
 TF_LITE_MICRO_TESTS_END
@@ -13,11 +13,13 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include "micro_features/micro_model_settings.h"
 #include "micro_features/model.h"
 #include "micro_features/no_micro_features_data.h"
 #include "micro_features/yes_micro_features_data.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 #include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/kernels/depthwise_conv.h"
 #include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
 #include "tensorflow/lite/micro/testing/micro_test.h"
 #include "tensorflow/lite/schema/schema_generated.h"
@@ -142,4 +144,145 @@ TF_LITE_MICRO_TEST(TestInvoke) {
   TF_LITE_REPORT_ERROR(&micro_error_reporter, "Ran successfully\n");
 }
 
+TF_LITE_MICRO_TEST(TestStreamingInvokeMatchesFullInvoke) {
+  tflite::MicroErrorReporter micro_error_reporter;
+  const tflite::Model* model = ::tflite::GetModel(g_model);
+
+  tflite::MicroMutableOpResolver<4> full_op_resolver;
+  full_op_resolver.AddDepthwiseConv2D();
+  full_op_resolver.AddFullyConnected();
+  full_op_resolver.AddReshape();
+  full_op_resolver.AddSoftmax();
+
+  tflite::MicroMutableOpResolver<4> streaming_op_resolver;
+  streaming_op_resolver.AddDepthwiseConv2D(
+      tflite::Register_DEPTHWISE_CONV_2D_STREAMING());
+  streaming_op_resolver.AddFullyConnected();
+  streaming_op_resolver.AddReshape();
+  streaming_op_resolver.AddSoftmax();
+
+  const int tensor_arena_size = 20 * 1024;
+  uint8_t full_tensor_arena[tensor_arena_size];
+  uint8_t streaming_tensor_arena[tensor_arena_size];
+  tflite::MicroInterpreter full_interpreter(model, full_op_resolver,
+                                            full_tensor_arena,
+                                            tensor_arena_size,
+                                            &micro_error_reporter);
+  tflite::MicroInterpreter streaming_interpreter(
+      model, streaming_op_resolver, streaming_tensor_arena, tensor_arena_size,
+      &micro_error_reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, full_interpreter.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, streaming_interpreter.AllocateTensors());
+
+  // Slide a window over the "Yes" spectrogram followed by the "No" one, by
+  // varying numbers of slices, including not moving at all and jumping back
+  // to the start.
+  int8_t spectrogram[2 * kFeatureElementCount];
+  for (int i = 0; i < kFeatureElementCount; ++i) {
+    spectrogram[i] = g_yes_micro_f2e59fea_nohash_1_data[i];
+    spectrogram[kFeatureElementCount + i] =
+        g_no_micro_f9643d42_nohash_4_data[i];
+  }
+  const int shifts[] = {0, 1, 1, 0, 2, 1, 3, 1, 1, 5, 1, 2, 1, 1, -20, 1, 1};
+  int start_slice = 0;
+  for (int step = 0; step < static_cast<int>(sizeof(shifts) / sizeof(int));
+       ++step) {
+    start_slice += shifts[step];
+    const int8_t* window = spectrogram + start_slice * kFeatureSliceSize;
+    TfLiteTensor* full_input = full_interpreter.input(0);
+    TfLiteTensor* streaming_input = streaming_interpreter.input(0);
+    for (int i = 0; i < kFeatureElementCount; ++i) {
+      full_input->data.int8[i] = window[i];
+      streaming_input->data.int8[i] = window[i];
+    }
+
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, full_interpreter.Invoke());
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, streaming_interpreter.Invoke());
+
+    TfLiteTensor* full_output = full_interpreter.output(0);
+    TfLiteTensor* streaming_output = streaming_interpreter.output(0);
+    for (int i = 0; i < 4; ++i) {
+      TF_LITE_MICRO_EXPECT_EQ(full_output->data.int8[i],
+                              streaming_output->data.int8[i]);
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(TestStreamingSessionsKeepTheirOwnState) {
+  tflite::MicroErrorReporter micro_error_reporter;
+  const tflite::Model* model = ::tflite::GetModel(g_model);
+
+  tflite::MicroMutableOpResolver<4> full_op_resolver;
+  full_op_resolver.AddDepthwiseConv2D();
+  full_op_resolver.AddFullyConnected();
+  full_op_resolver.AddReshape();
+  full_op_resolver.AddSoftmax();
+
+  tflite::MicroMutableOpResolver<4> streaming_op_resolver;
+  streaming_op_resolver.AddDepthwiseConv2D(
+      tflite::Register_DEPTHWISE_CONV_2D_STREAMING());
+  streaming_op_resolver.AddFullyConnected();
+  streaming_op_resolver.AddReshape();
+  streaming_op_resolver.AddSoftmax();
+
+  // Two sessions of one compiled streaming model slide over different
+  // spectrograms in turn, and must each match their own full interpreter.
+  const int tensor_arena_size = 20 * 1024;
+  uint8_t compiled_tensor_arena[tensor_arena_size];
+  uint8_t full_tensor_arenas[2][tensor_arena_size];
+  uint8_t session_tensor_arenas[2][tensor_arena_size];
+  tflite::MicroInterpreter compiled(model, streaming_op_resolver,
+                                    compiled_tensor_arena, tensor_arena_size,
+                                    &micro_error_reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, compiled.AllocateTensors());
+  tflite::MicroInterpreter full0(model, full_op_resolver,
+                                 full_tensor_arenas[0], tensor_arena_size,
+                                 &micro_error_reporter);
+  tflite::MicroInterpreter full1(model, full_op_resolver,
+                                 full_tensor_arenas[1], tensor_arena_size,
+                                 &micro_error_reporter);
+  tflite::MicroInterpreter session0(compiled, session_tensor_arenas[0],
+                                    tensor_arena_size, &micro_error_reporter);
+  tflite::MicroInterpreter session1(compiled, session_tensor_arenas[1],
+                                    tensor_arena_size, &micro_error_reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, full0.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, full1.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, session0.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, session1.AllocateTensors());
+
+  const int8_t* spectrograms[] = {g_yes_micro_f2e59fea_nohash_1_data,
+                                  g_no_micro_f9643d42_nohash_4_data};
+  tflite::MicroInterpreter* interpreters[] = {&session0, &full0, &session1,
+                                              &full1};
+  const int shifts[] = {0, 1, 2, 1, 3, 1, 1};
+  int start_slice = 0;
+  for (int step = 0; step < static_cast<int>(sizeof(shifts) / sizeof(int));
+       ++step) {
+    start_slice += shifts[step];
+    for (int n = 0; n < 4; ++n) {
+      // Both sessions slide by the same number of slices, so each one only
+      // streams correctly if it keeps its own previous input.
+      const int8_t* spectrogram = spectrograms[n / 2];
+      TfLiteTensor* input = interpreters[n]->input(0);
+      for (int i = 0; i < kFeatureElementCount; ++i) {
+        const int slice = i / kFeatureSliceSize + start_slice;
+        input->data.int8[i] =
+            slice < kFeatureSliceCount
+                ? spectrogram[slice * kFeatureSliceSize +
+                              i % kFeatureSliceSize]
+                : 0;
+      }
+      TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreters[n]->Invoke());
+    }
+    for (int n = 0; n < 4; n += 2) {
+      TfLiteTensor* session_output = interpreters[n]->output(0);
+      TfLiteTensor* full_output = interpreters[n + 1]->output(0);
+      for (int i = 0; i < 4; ++i) {
+        TF_LITE_MICRO_EXPECT_EQ(full_output->data.int8[i],
+                                session_output->data.int8[i]);
+      }
+    }
+  }
+}
+
 TF_LITE_MICRO_TESTS_END
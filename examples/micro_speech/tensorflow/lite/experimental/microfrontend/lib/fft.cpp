@@ -16,31 +16,339 @@ limitations under the License.
 
 #include <string.h>
 
-#define FIXED_POINT 16
-#include "kiss_fft.h"
-#include "tools/kiss_fftr.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/x86_simd.h"
+
+namespace {
+
+// The factors kiss_fft's C_FIXDIV multiplies by to divide by 1, 2 and 4.
+constexpr int16_t kDivideBy1 = 32767;
+constexpr int16_t kDivideBy2 = 32767 / 2;
+constexpr int16_t kDivideBy4 = 32767 / 4;
+
+// Rounds away the 15 fractional bits of a product, keeping the low 16 bits.
+inline int16_t RoundQ15(int32_t product) {
+  return static_cast<int16_t>((product + (1 << 14)) >> 15);
+}
+
+inline complex_int16_t Divide(complex_int16_t x, int16_t factor) {
+  x.real = RoundQ15(x.real * factor);
+  x.imag = RoundQ15(x.imag * factor);
+  return x;
+}
+
+// Multiplies by a twiddle stored in the two forms FftStage describes.
+inline complex_int16_t Multiply(complex_int16_t x, complex_int16_t real_form,
+                                complex_int16_t imag_form) {
+  complex_int16_t result;
+  result.real = RoundQ15(x.real * real_form.real + x.imag * real_form.imag);
+  result.imag = RoundQ15(x.real * imag_form.real + x.imag * imag_form.imag);
+  return result;
+}
+
+inline complex_int16_t Add(complex_int16_t a, complex_int16_t b) {
+  complex_int16_t result;
+  result.real = static_cast<int16_t>(a.real + b.real);
+  result.imag = static_cast<int16_t>(a.imag + b.imag);
+  return result;
+}
+
+inline complex_int16_t Subtract(complex_int16_t a, complex_int16_t b) {
+  complex_int16_t result;
+  result.real = static_cast<int16_t>(a.real - b.real);
+  result.imag = static_cast<int16_t>(a.imag - b.imag);
+  return result;
+}
+
+inline int16_t ShiftInput(int16_t sample, int shift) {
+  return static_cast<int16_t>(static_cast<uint16_t>(sample) << shift);
+}
+
+// Scales the input and writes it to the work buffer in the order the first
+// stage reads it, with zeros past the end of the input. |begin| slots are
+// already done.
+void LoadInput(const FftPlan& plan, const int16_t* input, size_t input_size,
+               int shift, size_t begin, size_t complex_size) {
+  size_t i;
+  for (i = begin; i < complex_size; ++i) {
+    const size_t sample = 2 * plan.input_pairs[i];
+    plan.work[i].real = sample < input_size ? ShiftInput(input[sample], shift)
+                                            : 0;
+    plan.work[i].imag =
+        sample + 1 < input_size ? ShiftInput(input[sample + 1], shift) : 0;
+  }
+}
+
+// kiss_fft's kf_bfly4().
+void Radix4(const FftStage& stage, complex_int16_t* block) {
+  const int span = stage.span;
+  const complex_int16_t* twiddles = stage.twiddles;
+  int k;
+  for (k = 0; k < span; ++k) {
+    complex_int16_t f0 = Divide(block[k], kDivideBy4);
+    const complex_int16_t s0 =
+        Multiply(Divide(block[span + k], kDivideBy4), twiddles[k],
+                 twiddles[span + k]);
+    const complex_int16_t s1 =
+        Multiply(Divide(block[2 * span + k], kDivideBy4),
+                 twiddles[2 * span + k], twiddles[3 * span + k]);
+    const complex_int16_t s2 =
+        Multiply(Divide(block[3 * span + k], kDivideBy4),
+                 twiddles[4 * span + k], twiddles[5 * span + k]);
+    const complex_int16_t s5 = Subtract(f0, s1);
+    f0 = Add(f0, s1);
+    const complex_int16_t s3 = Add(s0, s2);
+    const complex_int16_t s4 = Subtract(s0, s2);
+    block[2 * span + k] = Subtract(f0, s3);
+    block[k] = Add(f0, s3);
+    block[span + k].real = static_cast<int16_t>(s5.real + s4.imag);
+    block[span + k].imag = static_cast<int16_t>(s5.imag - s4.real);
+    block[3 * span + k].real = static_cast<int16_t>(s5.real - s4.imag);
+    block[3 * span + k].imag = static_cast<int16_t>(s5.imag + s4.real);
+  }
+}
+
+// kiss_fft's kf_bfly2().
+void Radix2(const FftStage& stage, complex_int16_t* block) {
+  const int span = stage.span;
+  int k;
+  for (k = 0; k < span; ++k) {
+    const complex_int16_t f0 = Divide(block[k], kDivideBy2);
+    const complex_int16_t t =
+        Multiply(Divide(block[span + k], kDivideBy2), stage.twiddles[k],
+                 stage.twiddles[span + k]);
+    block[span + k] = Subtract(f0, t);
+    block[k] = Add(f0, t);
+  }
+}
+
+// The second half of kiss_fftr(), which turns the half-size complex FFT of
+// the interleaved samples into the real FFT, for bins |begin| to
+// complex_size / 2. |begin| is at least 1.
+void Split(const FftPlan& plan, size_t begin, size_t complex_size,
+           complex_int16_t* output) {
+  const complex_int16_t* work = plan.work;
+  const size_t half = complex_size / 2;
+  const complex_int16_t* twiddles = plan.split_twiddles;
+  size_t k;
+  for (k = begin; k <= half; ++k) {
+    const complex_int16_t fpk = Divide(work[k], kDivideBy2);
+    complex_int16_t fpnk = work[complex_size - k];
+    fpnk.imag = static_cast<int16_t>(-fpnk.imag);
+    fpnk = Divide(fpnk, kDivideBy2);
+    const complex_int16_t f1k = Add(fpk, fpnk);
+    const complex_int16_t tw =
+        Multiply(Subtract(fpk, fpnk), twiddles[k - 1], twiddles[half + k - 1]);
+    output[k].real = static_cast<int16_t>((f1k.real + tw.real) >> 1);
+    output[k].imag = static_cast<int16_t>((f1k.imag + tw.imag) >> 1);
+    output[complex_size - k].real =
+        static_cast<int16_t>((f1k.real - tw.real) >> 1);
+    output[complex_size - k].imag =
+        static_cast<int16_t>((tw.imag - f1k.imag) >> 1);
+  }
+}
+
+#ifdef FRONTEND_X86_SIMD
+
+// The vector versions work on four complex values at a time, as interleaved
+// 16-bit real and imaginary parts, and wrap and round exactly like the scalar
+// code above.
+
+FRONTEND_TARGET_AVX2 inline __m128i DivideAvx2(__m128i x, int16_t factor) {
+  // (x * factor + (1 << 14)) >> 15, like RoundQ15().
+  return _mm_mulhrs_epi16(x, _mm_set1_epi16(factor));
+}
+
+FRONTEND_TARGET_AVX2 inline __m128i MultiplyAvx2(__m128i x, __m128i real_form,
+                                                 __m128i imag_form) {
+  const __m128i round = _mm_set1_epi32(1 << 14);
+  const __m128i real =
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(x, real_form), round), 15);
+  const __m128i imag =
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(x, imag_form), round), 15);
+  // Keeps the low 16 bits of each.
+  return _mm_blend_epi16(real, _mm_slli_epi32(imag, 16), 0xAA);
+}
+
+// Swaps the real and imaginary parts.
+FRONTEND_TARGET_AVX2 inline __m128i SwapAvx2(__m128i x) {
+  return _mm_or_si128(_mm_slli_epi32(x, 16), _mm_srli_epi32(x, 16));
+}
+
+// (a + b) >> 1 and (a - b) >> 1 for each 16-bit lane without overflowing.
+FRONTEND_TARGET_AVX2 inline __m128i HalfSumAvx2(__m128i a, __m128i b) {
+  return _mm_add_epi16(_mm_and_si128(a, b),
+                       _mm_srai_epi16(_mm_xor_si128(a, b), 1));
+}
+
+FRONTEND_TARGET_AVX2 inline __m128i HalfDifferenceAvx2(__m128i a, __m128i b) {
+  // a - b is a + ~b + 1, and (a + c + 1) >> 1 is (a | c) - ((a ^ c) >> 1).
+  const __m128i not_b = _mm_xor_si128(b, _mm_set1_epi32(-1));
+  return _mm_sub_epi16(_mm_or_si128(a, not_b),
+                       _mm_srai_epi16(_mm_xor_si128(a, not_b), 1));
+}
+
+FRONTEND_TARGET_AVX2 inline __m128i ReverseAvx2(__m128i x) {
+  return _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// LoadInput() for the first complex_size / 8 * 8 slots, as long as the input
+// has an even number of samples. Returns how many slots that was.
+FRONTEND_TARGET_AVX2 size_t LoadInputAvx2(const FftPlan& plan,
+                                          const int16_t* input,
+                                          size_t input_size, int shift,
+                                          size_t complex_size) {
+  if (input_size % 2 != 0) {
+    return 0;
+  }
+  const __m256i num_pairs = _mm256_set1_epi32(static_cast<int>(input_size / 2));
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  size_t i;
+  for (i = 0; i + 8 <= complex_size; i += 8) {
+    const __m256i pairs = _mm256_cvtepu16_epi32(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(plan.input_pairs + i)));
+    const __m256i values = _mm256_mask_i32gather_epi32(
+        _mm256_setzero_si256(), reinterpret_cast<const int*>(input), pairs,
+        _mm256_cmpgt_epi32(num_pairs, pairs), 4);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(plan.work + i),
+                        _mm256_sll_epi16(values, count));
+  }
+  return i;
+}
+
+// Radix4() for all butterflies of a block, when the span is a multiple of 4.
+FRONTEND_TARGET_AVX2 void Radix4Avx2(const FftStage& stage,
+                                     complex_int16_t* block) {
+  const int span = stage.span;
+  const __m128i* twiddles = reinterpret_cast<const __m128i*>(stage.twiddles);
+  __m128i* f0_ptr = reinterpret_cast<__m128i*>(block);
+  __m128i* f1_ptr = reinterpret_cast<__m128i*>(block + span);
+  __m128i* f2_ptr = reinterpret_cast<__m128i*>(block + 2 * span);
+  __m128i* f3_ptr = reinterpret_cast<__m128i*>(block + 3 * span);
+  const int step = span / 4;
+  int k;
+  for (k = 0; k < step; ++k) {
+    __m128i f0 = DivideAvx2(_mm_loadu_si128(f0_ptr + k), kDivideBy4);
+    const __m128i s0 = MultiplyAvx2(
+        DivideAvx2(_mm_loadu_si128(f1_ptr + k), kDivideBy4),
+        _mm_loadu_si128(twiddles + k), _mm_loadu_si128(twiddles + step + k));
+    const __m128i s1 = MultiplyAvx2(
+        DivideAvx2(_mm_loadu_si128(f2_ptr + k), kDivideBy4),
+        _mm_loadu_si128(twiddles + 2 * step + k),
+        _mm_loadu_si128(twiddles + 3 * step + k));
+    const __m128i s2 = MultiplyAvx2(
+        DivideAvx2(_mm_loadu_si128(f3_ptr + k), kDivideBy4),
+        _mm_loadu_si128(twiddles + 4 * step + k),
+        _mm_loadu_si128(twiddles + 5 * step + k));
+    const __m128i s5 = _mm_sub_epi16(f0, s1);
+    f0 = _mm_add_epi16(f0, s1);
+    const __m128i s3 = _mm_add_epi16(s0, s2);
+    const __m128i s4 = SwapAvx2(_mm_sub_epi16(s0, s2));
+    const __m128i sum = _mm_add_epi16(s5, s4);
+    const __m128i difference = _mm_sub_epi16(s5, s4);
+    _mm_storeu_si128(f2_ptr + k, _mm_sub_epi16(f0, s3));
+    _mm_storeu_si128(f0_ptr + k, _mm_add_epi16(f0, s3));
+    _mm_storeu_si128(f1_ptr + k, _mm_blend_epi16(sum, difference, 0xAA));
+    _mm_storeu_si128(f3_ptr + k, _mm_blend_epi16(difference, sum, 0xAA));
+  }
+}
+
+// Split() for bins 1 to the last multiple of 4 before complex_size / 2.
+// Returns the first bin it did not do.
+FRONTEND_TARGET_AVX2 size_t SplitAvx2(const FftPlan& plan, size_t complex_size,
+                                      complex_int16_t* output) {
+  const complex_int16_t* work = plan.work;
+  const size_t half = complex_size / 2;
+  const complex_int16_t* twiddles = plan.split_twiddles;
+  const __m128i zero = _mm_setzero_si128();
+  size_t k;
+  for (k = 1; k + 3 <= half; k += 4) {
+    const __m128i fpk = DivideAvx2(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(work + k)),
+        kDivideBy2);
+    // Bins complex_size - k downwards, conjugated.
+    __m128i fpnk = ReverseAvx2(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(work + complex_size - k - 3)));
+    fpnk = DivideAvx2(
+        _mm_blend_epi16(fpnk, _mm_sub_epi16(zero, fpnk), 0xAA), kDivideBy2);
+    const __m128i f1k = _mm_add_epi16(fpk, fpnk);
+    const __m128i tw = MultiplyAvx2(
+        _mm_sub_epi16(fpk, fpnk),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(twiddles + k - 1)),
+        _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(twiddles + half + k - 1)));
+    // When the last group reaches complex_size / 2, both stores write that
+    // bin, and like in the scalar code the second one wins.
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + k),
+                     HalfSumAvx2(f1k, tw));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(output + complex_size - k - 3),
+        ReverseAvx2(_mm_blend_epi16(HalfDifferenceAvx2(f1k, tw),
+                                    HalfDifferenceAvx2(tw, f1k), 0xAA)));
+  }
+  return k;
+}
+
+#endif  // FRONTEND_X86_SIMD
+
+}  // namespace
 
 void FftCompute(struct FftState* state, const int16_t* input,
                 int input_scale_shift) {
+  const FftPlan& plan = *reinterpret_cast<const FftPlan*>(state->scratch);
   const size_t input_size = state->input_size;
-  const size_t fft_size = state->fft_size;
+  const size_t complex_size = state->fft_size / 2;
+  complex_int16_t* output = state->output;
+#ifdef FRONTEND_X86_SIMD
+  const bool use_avx2 = FrontendHasAvx2();
+#endif
 
-  int16_t* fft_input = state->input;
-  // First, scale the input by the given shift.
-  size_t i;
-  for (i = 0; i < input_size; ++i) {
-    fft_input[i] = static_cast<int16_t>(static_cast<uint16_t>(input[i])
-                                        << input_scale_shift);
+  // Scale the input and reorder it for the first stage.
+  size_t loaded = 0;
+#ifdef FRONTEND_X86_SIMD
+  if (use_avx2) {
+    loaded = LoadInputAvx2(plan, input, input_size, input_scale_shift,
+                           complex_size);
   }
-  // Zero out whatever else remains in the top part of the input.
-  for (; i < fft_size; ++i) {
-    fft_input[i] = 0;
+#endif
+  LoadInput(plan, input, input_size, input_scale_shift, loaded, complex_size);
+
+  // Apply the FFT of the interleaved samples.
+  int i;
+  for (i = 0; i < plan.num_stages; ++i) {
+    const FftStage& stage = plan.stages[i];
+    const size_t block_size = stage.radix * stage.span;
+    complex_int16_t* block = plan.work;
+    complex_int16_t* const end = plan.work + complex_size;
+    for (; block != end; block += block_size) {
+      if (stage.radix == 4) {
+#ifdef FRONTEND_X86_SIMD
+        if (use_avx2 && stage.span % 4 == 0) {
+          Radix4Avx2(stage, block);
+          continue;
+        }
+#endif
+        Radix4(stage, block);
+      } else if (stage.radix == 2) {
+        Radix2(stage, block);
+      } else {
+        block[0] = Divide(block[0], kDivideBy1);
+      }
+    }
   }
 
-  // Apply the FFT.
-  kiss_fftr(reinterpret_cast<kiss_fftr_cfg>(state->scratch),
-            state->input,
-            reinterpret_cast<kiss_fft_cpx*>(state->output));
+  // Split it into the FFT of the real input.
+  const complex_int16_t dc = Divide(plan.work[0], kDivideBy2);
+  output[0].real = static_cast<int16_t>(dc.real + dc.imag);
+  output[0].imag = 0;
+  output[complex_size].real = static_cast<int16_t>(dc.real - dc.imag);
+  output[complex_size].imag = 0;
+  size_t split = 1;
+#ifdef FRONTEND_X86_SIMD
+  if (use_avx2) {
+    split = SplitAvx2(plan, complex_size, output);
+  }
+#endif
+  Split(plan, split, complex_size, output);
 }
 
 void FftInit(struct FftState* state) {
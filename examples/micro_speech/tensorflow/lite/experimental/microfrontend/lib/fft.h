@@ -27,6 +27,35 @@ struct complex_int16_t {
   int16_t imag;
 };
 
+#define kFftMaxStages 16
+
+// One radix-2 or radix-4 pass over the complex work buffer, applied to
+// blocks of radix * span values. Each twiddle is stored twice, as
+// (real, -imag) and (imag, real), so that the real and imaginary parts of a
+// product are both a pair of multiply-adds.
+struct FftStage {
+  int radix;
+  int span;
+  // radix - 1 runs of span entries for each of the two forms.
+  const struct complex_int16_t* twiddles;
+};
+
+// The plan FftPopulateState() builds at the start of FftState::scratch. The
+// real FFT is computed as a complex FFT of half the size, with the same
+// factorization, twiddles and fixed-point rounding as kiss_fftr, so the
+// output matches it bit for bit.
+struct FftPlan {
+  int num_stages;
+  // In the order they are applied, the innermost first.
+  struct FftStage stages[kFftMaxStages];
+  // The input sample pair that goes in each slot of the work buffer.
+  const uint16_t* input_pairs;
+  // The twiddles that split the half-size FFT into the real FFT, stored
+  // like the stage twiddles.
+  const struct complex_int16_t* split_twiddles;
+  struct complex_int16_t* work;
+};
+
 struct FftState {
   int16_t* input;
   struct complex_int16_t* output;
@@ -36,6 +65,8 @@ struct FftState {
   size_t scratch_size;
 };
 
+// Shifts the input up by input_scale_shift, pads it with zeros to fft_size
+// and writes its fft_size / 2 + 1 lowest frequency bins to state->output.
 void FftCompute(struct FftState* state, const int16_t* input,
                 int input_scale_shift);
 
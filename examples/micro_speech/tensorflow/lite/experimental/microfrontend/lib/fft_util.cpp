@@ -14,11 +14,48 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/lite/experimental/microfrontend/lib/fft_util.h"
 
+#include <math.h>
 #include <stdio.h>
 
-#define FIXED_POINT 16
-#include "kiss_fft.h"
-#include "tools/kiss_fftr.h"
+namespace {
+
+// kiss_fft's fixed-point twiddle for the given phase.
+complex_int16_t Twiddle(double phase) {
+  complex_int16_t twiddle;
+  twiddle.real = static_cast<int16_t>(floor(.5 + 32767 * cos(phase)));
+  twiddle.imag = static_cast<int16_t>(floor(.5 + 32767 * sin(phase)));
+  return twiddle;
+}
+
+// Stores |twiddle| in the two forms FftStage describes, |span| entries apart.
+void StoreTwiddle(complex_int16_t twiddle, size_t span,
+                  complex_int16_t* output) {
+  output[0].real = twiddle.real;
+  output[0].imag = static_cast<int16_t>(-twiddle.imag);
+  output[span].real = twiddle.imag;
+  output[span].imag = twiddle.real;
+}
+
+// Fills in input_pairs the way kiss_fft's recursion reads its leaves, for the
+// factors from |stage| outwards.
+void FillInputPairs(const int* radixes, const int* spans, int stage,
+                    size_t output_index, size_t input_index, size_t stride,
+                    uint16_t* input_pairs) {
+  const int radix = radixes[stage];
+  const int span = spans[stage];
+  int i;
+  for (i = 0; i < radix; ++i) {
+    if (span == 1) {
+      input_pairs[output_index + i] =
+          static_cast<uint16_t>(input_index + i * stride);
+    } else {
+      FillInputPairs(radixes, spans, stage + 1, output_index + i * span,
+                     input_index + i * stride, stride * radix, input_pairs);
+    }
+  }
+}
+
+}  // namespace
 
 int FftPopulateState(struct FftState* state, size_t input_size) {
   state->input_size = input_size;
@@ -26,6 +63,12 @@ int FftPopulateState(struct FftState* state, size_t input_size) {
   while (state->fft_size < state->input_size) {
     state->fft_size <<= 1;
   }
+  // The real FFT is computed as a complex one of half the size.
+  const size_t complex_size = state->fft_size / 2;
+  if (complex_size == 0 || complex_size > 65536) {
+    fprintf(stderr, "Unsupported fft size %zu\n", state->fft_size);
+    return 0;
+  }
 
   state->input = reinterpret_cast<int16_t*>(
       malloc(state->fft_size * sizeof(*state->input)));
@@ -41,27 +84,79 @@ int FftPopulateState(struct FftState* state, size_t input_size) {
     return 0;
   }
 
-  // Ask kissfft how much memory it wants.
-  size_t scratch_size = 0;
-  kiss_fftr_cfg kfft_cfg = kiss_fftr_alloc(
-      state->fft_size, 0, nullptr, &scratch_size);
-  if (kfft_cfg != nullptr) {
-    fprintf(stderr, "Kiss memory sizing failed.\n");
-    return 0;
+  // Factors the size like kiss_fft does, outermost first: radix 4 while it
+  // divides, then radix 2. A size of 1 is a single radix 1 stage.
+  int radixes[kFftMaxStages];
+  int spans[kFftMaxStages];
+  int num_stages = 0;
+  size_t span = complex_size;
+  do {
+    const int radix = (span % 4 == 0) ? 4 : (span == 1) ? 1 : 2;
+    span /= radix;
+    radixes[num_stages] = radix;
+    spans[num_stages] = static_cast<int>(span);
+    ++num_stages;
+  } while (span > 1);
+
+  size_t num_twiddles = complex_size;  // For splitting the output.
+  int i;
+  for (i = 0; i < num_stages; ++i) {
+    num_twiddles += 2 * (radixes[i] - 1) * spans[i];
   }
+  const size_t scratch_size =
+      sizeof(FftPlan) + num_twiddles * sizeof(complex_int16_t) +
+      complex_size * sizeof(complex_int16_t) +
+      complex_size * sizeof(uint16_t);
   state->scratch = malloc(scratch_size);
   if (state->scratch == nullptr) {
     fprintf(stderr, "Failed to alloc fft scratch buffer\n");
     return 0;
   }
   state->scratch_size = scratch_size;
-  // Let kissfft configure the scratch space we just allocated
-  kfft_cfg = kiss_fftr_alloc(state->fft_size, 0,
-                                              state->scratch, &scratch_size);
-  if (kfft_cfg != state->scratch) {
-    fprintf(stderr, "Kiss memory preallocation strategy failed.\n");
-    return 0;
+
+  FftPlan* plan = reinterpret_cast<FftPlan*>(state->scratch);
+  complex_int16_t* twiddles = reinterpret_cast<complex_int16_t*>(plan + 1);
+  plan->work = twiddles + num_twiddles;
+  uint16_t* input_pairs = reinterpret_cast<uint16_t*>(
+      plan->work + complex_size);
+  plan->input_pairs = input_pairs;
+  plan->num_stages = num_stages;
+
+  const double pi =
+      3.141592653589793238462643383279502884197169399375105820974944;
+  // Stage i is the i-th factor from the inside, so it splits blocks of
+  // radix * span values, with twiddles |stride| apart in kiss_fft's table.
+  size_t stride = complex_size;
+  for (i = 0; i < num_stages; ++i) {
+    const int factor = num_stages - 1 - i;
+    FftStage* stage = &plan->stages[i];
+    stage->radix = radixes[factor];
+    stage->span = spans[factor];
+    stride /= stage->radix;
+    stage->twiddles = twiddles;
+    int q;
+    for (q = 1; q < stage->radix; ++q) {
+      int k;
+      for (k = 0; k < stage->span; ++k) {
+        const size_t index = q * k * stride;
+        StoreTwiddle(Twiddle(-2 * pi * index / complex_size), stage->span,
+                     twiddles + k);
+      }
+      twiddles += 2 * stage->span;
+    }
+  }
+
+  plan->split_twiddles = twiddles;
+  const size_t num_split_twiddles = complex_size / 2;
+  size_t k;
+  for (k = 0; k < num_split_twiddles; ++k) {
+    const double phase =
+        -3.14159265358979323846264338327 *
+        ((double)(k + 1) / complex_size + .5);
+    StoreTwiddle(Twiddle(phase), num_split_twiddles, twiddles + k);
   }
+
+  FillInputPairs(radixes, spans, 0, 0, 0, 1, input_pairs);
   return 1;
 }
 
@@ -17,15 +17,74 @@ limitations under the License.
 #include <string.h>
 
 #include "tensorflow/lite/experimental/microfrontend/lib/bits.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/x86_simd.h"
+
+#ifdef FRONTEND_X86_SIMD
+
+// Computes the energy of the first count / 8 * 8 bins and returns how many
+// that was. madd squares the interleaved real and imaginary parts and adds
+// each pair, which wraps in exactly the same way as the scalar code.
+static FRONTEND_TARGET_AVX2 int ConvertFftComplexToEnergyAvx2(
+    const struct complex_int16_t* fft_output, int32_t* energy, int count) {
+  int i;
+  for (i = 0; i <= count - 8; i += 8) {
+    const __m256i values =
+        _mm256_loadu_si256((const __m256i*)(fft_output + i));
+    _mm256_storeu_si256((__m256i*)(energy + i),
+                        _mm256_madd_epi16(values, values));
+  }
+  return i;
+}
+
+// Returns the sums of weights[j] * magnitudes[j] and unweights[j] *
+// magnitudes[j] over the first width / 4 * 4 bins of a channel in |sums|, and
+// how many bins that was. Magnitudes are sign extended to 64 bits like in the
+// scalar code, so the signed products are the same modulo 2^64.
+static FRONTEND_TARGET_AVX2 int AccumulateChannelAvx2(
+    const int32_t* magnitudes, const int16_t* weights,
+    const int16_t* unweights, int width, uint64_t* sums) {
+  __m256i weight_sum = _mm256_setzero_si256();
+  __m256i unweight_sum = _mm256_setzero_si256();
+  int j;
+  for (j = 0; j <= width - 4; j += 4) {
+    const __m256i magnitude = _mm256_cvtepi32_epi64(
+        _mm_loadu_si128((const __m128i*)(magnitudes + j)));
+    const __m256i weight =
+        _mm256_cvtepi16_epi64(_mm_loadl_epi64((const __m128i*)(weights + j)));
+    const __m256i unweight = _mm256_cvtepi16_epi64(
+        _mm_loadl_epi64((const __m128i*)(unweights + j)));
+    weight_sum =
+        _mm256_add_epi64(weight_sum, _mm256_mul_epi32(weight, magnitude));
+    unweight_sum =
+        _mm256_add_epi64(unweight_sum, _mm256_mul_epi32(unweight, magnitude));
+  }
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i*)lanes, weight_sum);
+  sums[0] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  _mm256_storeu_si256((__m256i*)lanes, unweight_sum);
+  sums[1] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  return j;
+}
+
+#endif  // FRONTEND_X86_SIMD
 
 void FilterbankConvertFftComplexToEnergy(struct FilterbankState* state,
                                          struct complex_int16_t* fft_output,
                                          int32_t* energy) {
   const int end_index = state->end_index;
-  int i;
+  int i = state->start_index;
   energy += state->start_index;
   fft_output += state->start_index;
-  for (i = state->start_index; i < end_index; ++i) {
+#ifdef FRONTEND_X86_SIMD
+  if (FrontendHasAvx2()) {
+    const int done = ConvertFftComplexToEnergyAvx2(fft_output, energy,
+                                                   end_index - i);
+    i += done;
+    energy += done;
+    fft_output += done;
+  }
+#endif
+  for (; i < end_index; ++i) {
     const int32_t real = fft_output->real;
     const int32_t imag = fft_output->imag;
     fft_output++;
@@ -45,14 +104,28 @@ void FilterbankAccumulateChannels(struct FilterbankState* state,
   const int16_t* channel_widths = state->channel_widths;
 
   int num_channels_plus_1 = state->num_channels + 1;
+#ifdef FRONTEND_X86_SIMD
+  const int use_avx2 = FrontendHasAvx2();
+#endif
   int i;
   for (i = 0; i < num_channels_plus_1; ++i) {
     const int32_t* magnitudes = energy + *channel_frequency_starts++;
     const int16_t* weights = state->weights + *channel_weight_starts;
     const int16_t* unweights = state->unweights + *channel_weight_starts++;
     const int width = *channel_widths++;
-    int j;
-    for (j = 0; j < width; ++j) {
+    int j = 0;
+#ifdef FRONTEND_X86_SIMD
+    if (use_avx2) {
+      uint64_t sums[2];
+      j = AccumulateChannelAvx2(magnitudes, weights, unweights, width, sums);
+      weight_accumulator += sums[0];
+      unweight_accumulator += sums[1];
+      magnitudes += j;
+      weights += j;
+      unweights += j;
+    }
+#endif
+    for (; j < width; ++j) {
       weight_accumulator += *weights++ * ((uint64_t)*magnitudes);
       unweight_accumulator += *unweights++ * ((uint64_t)*magnitudes);
       ++magnitudes;
@@ -116,14 +189,71 @@ static uint32_t Sqrt64(uint64_t num) {
   return res;
 }
 
+#ifdef FRONTEND_X86_SIMD
+
+// Computes the output of FilterbankSqrt() for the first count / 4 * 4
+// channels and returns how many that was. Values below 2^32 take the double
+// precision square root, which is exact for them: Sqrt32() rounds the integer
+// square root r up when num > r * r + r, unless r is 0xFFFF. Groups that have
+// larger values fall back to Sqrt64().
+static FRONTEND_TARGET_AVX2 int SqrtAvx2(const uint64_t* work,
+                                         uint32_t* output, int count,
+                                         int scale_down_shift) {
+  const __m256i high_words = _mm256_set1_epi64x((int64_t)0xFFFFFFFF00000000ULL);
+  const __m256d two_to_52 = _mm256_set1_pd(4503599627370496.0);
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i max_root = _mm256_set1_epi64x(0xFFFF);
+  const __m256i pack_low_words = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+  const __m128i shift = _mm_cvtsi32_si128(scale_down_shift);
+  int i;
+  for (i = 0; i <= count - 4; i += 4) {
+    // Loaded before anything is stored, since the output overlaps the start
+    // of the work buffer.
+    const __m256i num = _mm256_loadu_si256((const __m256i*)(work + i));
+    if (!_mm256_testz_si256(num, high_words)) {
+      int k;
+      for (k = 0; k < 4; ++k) {
+        output[i + k] = Sqrt64(work[i + k]) >> scale_down_shift;
+      }
+      continue;
+    }
+    // Converts to double by placing the value in the mantissa of 2^52.
+    const __m256d num_as_double = _mm256_sub_pd(
+        _mm256_castsi256_pd(
+            _mm256_or_si256(num, _mm256_castpd_si256(two_to_52))),
+        two_to_52);
+    const __m256i root = _mm256_cvtepu32_epi64(
+        _mm256_cvttpd_epi32(_mm256_sqrt_pd(num_as_double)));
+    const __m256i round_up = _mm256_andnot_si256(
+        _mm256_cmpeq_epi64(root, max_root),
+        _mm256_cmpgt_epi64(num, _mm256_mul_epu32(
+                                    root, _mm256_add_epi64(root, one))));
+    const __m256i result =
+        _mm256_srl_epi64(_mm256_sub_epi64(root, round_up), shift);
+    _mm_storeu_si128((__m128i*)(output + i),
+                     _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+                         result, pack_low_words)));
+  }
+  return i;
+}
+
+#endif  // FRONTEND_X86_SIMD
+
 uint32_t* FilterbankSqrt(struct FilterbankState* state, int scale_down_shift) {
   const int num_channels = state->num_channels;
   const uint64_t* work = state->work + 1;
   // Reuse the work buffer since we're fine clobbering it at this point to hold
   // the output.
   uint32_t* output = (uint32_t*)state->work;
-  int i;
-  for (i = 0; i < num_channels; ++i) {
+  int i = 0;
+#ifdef FRONTEND_X86_SIMD
+  if (FrontendHasAvx2()) {
+    i = SqrtAvx2(work, output, num_channels, scale_down_shift);
+    work += i;
+    output += i;
+  }
+#endif
+  for (; i < num_channels; ++i) {
     *output++ = Sqrt64(*work++) >> scale_down_shift;
   }
   return (uint32_t*)state->work;
@@ -16,26 +16,21 @@ limitations under the License.
 
 #include "tensorflow/lite/experimental/microfrontend/lib/bits.h"
 
-struct FrontendOutput FrontendProcessSamples(struct FrontendState* state,
-                                             const int16_t* samples,
-                                             size_t num_samples,
-                                             size_t* num_samples_read) {
-  struct FrontendOutput output;
-  output.values = NULL;
-  output.size = 0;
+// The stages that follow the window. They work in place on buffers owned by
+// |state|, so FrontendProcessSamplesBatch() can run each of them across all
+// streams before moving on to the next.
 
-  // Try to apply the window - if it fails, return and wait for more data.
-  if (!WindowProcessSamples(&state->window, samples, num_samples,
-                            num_samples_read)) {
-    return output;
-  }
+// Shift that scales the window's output so that the fixed point FFT can have
+// as much resolution as possible.
+static int FrontendInputShift(const struct FrontendState* state) {
+  return 15 - MostSignificantBit32(state->window.max_abs_output_value);
+}
 
-  // Apply the FFT to the window's output (and scale it so that the fixed point
-  // FFT can have as much resolution as possible).
-  int input_shift =
-      15 - MostSignificantBit32(state->window.max_abs_output_value);
-  FftCompute(&state->fft, state->window.output, input_shift);
+static void FrontendApplyFft(struct FrontendState* state) {
+  FftCompute(&state->fft, state->window.output, FrontendInputShift(state));
+}
 
+static uint32_t* FrontendApplyFilterbank(struct FrontendState* state) {
   // We can re-ruse the fft's output buffer to hold the energy.
   int32_t* energy = (int32_t*)state->fft.output;
 
@@ -43,27 +38,91 @@ struct FrontendOutput FrontendProcessSamples(struct FrontendState* state,
                                       energy);
 
   FilterbankAccumulateChannels(&state->filterbank, energy);
-  uint32_t* scaled_filterbank = FilterbankSqrt(&state->filterbank, input_shift);
+  return FilterbankSqrt(&state->filterbank, FrontendInputShift(state));
+}
 
+static void FrontendApplyGainControl(struct FrontendState* state,
+                                     uint32_t* scaled_filterbank) {
   // Apply noise reduction.
   NoiseReductionApply(&state->noise_reduction, scaled_filterbank);
 
   if (state->pcan_gain_control.enable_pcan) {
     PcanGainControlApply(&state->pcan_gain_control, scaled_filterbank);
   }
+}
 
+static struct FrontendOutput FrontendApplyLogScale(
+    struct FrontendState* state, uint32_t* scaled_filterbank) {
   // Apply the log and scale.
   int correction_bits =
       MostSignificantBit32(state->fft.fft_size) - 1 - (kFilterbankBits / 2);
-  uint16_t* logged_filterbank =
+  struct FrontendOutput output;
+  output.values =
       LogScaleApply(&state->log_scale, scaled_filterbank,
                     state->filterbank.num_channels, correction_bits);
-
   output.size = state->filterbank.num_channels;
-  output.values = logged_filterbank;
   return output;
 }
 
+struct FrontendOutput FrontendProcessSamples(struct FrontendState* state,
+                                             const int16_t* samples,
+                                             size_t num_samples,
+                                             size_t* num_samples_read) {
+  struct FrontendOutput output;
+  output.values = NULL;
+  output.size = 0;
+
+  // Try to apply the window - if it fails, return and wait for more data.
+  if (!WindowProcessSamples(&state->window, samples, num_samples,
+                            num_samples_read)) {
+    return output;
+  }
+
+  FrontendApplyFft(state);
+  uint32_t* scaled_filterbank = FrontendApplyFilterbank(state);
+  FrontendApplyGainControl(state, scaled_filterbank);
+  return FrontendApplyLogScale(state, scaled_filterbank);
+}
+
+void FrontendProcessSamplesBatch(struct FrontendState* const* states,
+                                 const int16_t* const* samples,
+                                 size_t num_streams, size_t num_samples,
+                                 size_t* num_samples_read,
+                                 struct FrontendOutput* outputs) {
+  size_t i;
+  // A stream that produced a window is marked with a non-zero size until its
+  // output is filled in by the last stage.
+  for (i = 0; i < num_streams; ++i) {
+    outputs[i].values = NULL;
+    outputs[i].size = WindowProcessSamples(&states[i]->window, samples[i],
+                                           num_samples, &num_samples_read[i]);
+  }
+  for (i = 0; i < num_streams; ++i) {
+    if (outputs[i].size) {
+      FrontendApplyFft(states[i]);
+    }
+  }
+  for (i = 0; i < num_streams; ++i) {
+    if (outputs[i].size) {
+      FrontendApplyFilterbank(states[i]);
+    }
+  }
+  // FilterbankSqrt() always writes to the start of the filterbank's work
+  // buffer, which the remaining stages update in place.
+  for (i = 0; i < num_streams; ++i) {
+    if (outputs[i].size) {
+      FrontendApplyGainControl(states[i],
+                               (uint32_t*)states[i]->filterbank.work);
+    }
+  }
+  for (i = 0; i < num_streams; ++i) {
+    if (outputs[i].size) {
+      outputs[i] = FrontendApplyLogScale(
+          states[i], (uint32_t*)states[i]->filterbank.work);
+    }
+  }
+}
+
 void FrontendReset(struct FrontendState* state) {
   WindowReset(&state->window);
   FftReset(&state->fft);
@@ -55,6 +55,19 @@ struct FrontendOutput FrontendProcessSamples(struct FrontendState* state,
                                              size_t num_samples,
                                              size_t* num_samples_read);
 
+// Same as calling FrontendProcessSamples() on each of the num_streams
+// independent streams, where stream i reads num_samples samples from
+// samples[i], and stores the number it consumed in num_samples_read[i] and its
+// output in outputs[i]. Every processing stage is run for all streams before
+// the next one starts, so each stage's code stays in cache while it runs for
+// every stream. As with FrontendProcessSamples(), the outputs are invalidated
+// by the next call for the same states.
+void FrontendProcessSamplesBatch(struct FrontendState* const* states,
+                                 const int16_t* const* samples,
+                                 size_t num_streams, size_t num_samples,
+                                 size_t* num_samples_read,
+                                 struct FrontendOutput* outputs);
+
 void FrontendReset(struct FrontendState* state);
 
 #ifdef __cplusplus
@@ -16,6 +16,7 @@ limitations under the License.
 
 #include "tensorflow/lite/experimental/microfrontend/lib/bits.h"
 #include "tensorflow/lite/experimental/microfrontend/lib/log_lut.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/x86_simd.h"
 
 #define kuint16max 0x0000FFFF
 
@@ -57,13 +58,97 @@ static uint32_t Log(const uint32_t x, const uint32_t scale_shift) {
   return loge_scaled;
 }
 
+#ifdef FRONTEND_X86_SIMD
+
+// Log() for each lane, for values above 1.
+static FRONTEND_TARGET_AVX2 __m256i LogAvx2(__m256i x, int scale_shift) {
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i scale_log2 = _mm256_set1_epi32(kLogScaleLog2);
+  const __m256i round = _mm256_set1_epi32(kLogScale / 2);
+  const __m256i integer = _mm256_sub_epi32(MostSignificantBit32Avx2(x), one);
+
+  // Log2FractionPart().
+  __m256i frac = _mm256_sub_epi32(x, _mm256_sllv_epi32(one, integer));
+  frac = _mm256_srlv_epi32(
+      _mm256_sllv_epi32(
+          frac, _mm256_max_epi32(_mm256_sub_epi32(scale_log2, integer), zero)),
+      _mm256_max_epi32(_mm256_sub_epi32(integer, scale_log2), zero));
+  const __m256i base_seg =
+      _mm256_srli_epi32(frac, kLogScaleLog2 - kLogSegmentsLog2);
+  const __m256i c01 =
+      _mm256_i32gather_epi32((const int*)kLogLut, base_seg, 2);
+  const __m256i c0 = _mm256_and_si256(c01, _mm256_set1_epi32(0xFFFF));
+  const __m256i c1 = _mm256_srli_epi32(c01, 16);
+  const __m256i seg_base =
+      _mm256_slli_epi32(base_seg, kLogScaleLog2 - kLogSegmentsLog2);
+  const __m256i rel_pos = _mm256_srai_epi32(
+      _mm256_mullo_epi32(_mm256_sub_epi32(c1, c0),
+                         _mm256_sub_epi32(frac, seg_base)),
+      kLogScaleLog2);
+  const __m256i fraction =
+      _mm256_add_epi32(_mm256_add_epi32(frac, c0), rel_pos);
+
+  const __m256i log2 =
+      _mm256_add_epi32(_mm256_slli_epi32(integer, kLogScaleLog2), fraction);
+  const __m256i loge = MulAddShiftRightAvx2(
+      log2, _mm256_set1_epi32(kLogCoeff), round, one, kLogScaleLog2);
+  return _mm256_srli_epi32(
+      _mm256_add_epi32(
+          _mm256_sll_epi32(loge, _mm_cvtsi32_si128(scale_shift)), round),
+      kLogScaleLog2);
+}
+
+// Scales the first signal_size / 8 * 8 values and returns how many that was.
+// Each block is loaded before it is stored, and the uint16_t output never
+// reaches past the uint32_t input that is still to be read.
+static FRONTEND_TARGET_AVX2 int LogScaleApplyAvx2(struct LogScaleState* state,
+                                                  const uint32_t* signal,
+                                                  uint16_t* output,
+                                                  int signal_size,
+                                                  int correction_bits) {
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i max_output = _mm256_set1_epi32(kuint16max);
+  const __m128i correction =
+      _mm_cvtsi32_si128(correction_bits < 0 ? -correction_bits
+                                            : correction_bits);
+  int i;
+  for (i = 0; i <= signal_size - 8; i += 8) {
+    __m256i value = _mm256_loadu_si256((const __m256i*)(signal + i));
+    if (state->enable_log) {
+      value = correction_bits < 0 ? _mm256_srl_epi32(value, correction)
+                                  : _mm256_sll_epi32(value, correction);
+      // Lanes that are 0 or 1 are computed on 2 and cleared afterwards.
+      const __m256i is_small = LessOrEqualU32Avx2(value, one);
+      value = _mm256_andnot_si256(
+          is_small, LogAvx2(_mm256_max_epu32(value, _mm256_set1_epi32(2)),
+                            state->scale_shift));
+    }
+    value = _mm256_packus_epi32(_mm256_min_epu32(value, max_output),
+                                _mm256_setzero_si256());
+    _mm_storeu_si128((__m128i*)(output + i),
+                     _mm256_castsi256_si128(
+                         _mm256_permute4x64_epi64(value, 0x08)));
+  }
+  return i;
+}
+
+#endif  // FRONTEND_X86_SIMD
+
 uint16_t* LogScaleApply(struct LogScaleState* state, uint32_t* signal,
                         int signal_size, int correction_bits) {
   const int scale_shift = state->scale_shift;
   uint16_t* output = (uint16_t*)signal;
   uint16_t* ret = output;
-  int i;
-  for (i = 0; i < signal_size; ++i) {
+  int i = 0;
+#ifdef FRONTEND_X86_SIMD
+  if (FrontendHasAvx2()) {
+    i = LogScaleApplyAvx2(state, signal, output, signal_size, correction_bits);
+    signal += i;
+    output += i;
+  }
+#endif
+  for (; i < signal_size; ++i) {
     uint32_t value = *signal++;
     if (state->enable_log) {
       if (correction_bits < 0) {
@@ -16,9 +16,58 @@ limitations under the License.
 
 #include <string.h>
 
-void NoiseReductionApply(struct NoiseReductionState* state, uint32_t* signal) {
+#include "tensorflow/lite/experimental/microfrontend/lib/x86_simd.h"
+
+#ifdef FRONTEND_X86_SIMD
+
+// Applies the noise reduction to the first num_channels / 8 * 8 channels and
+// returns how many that was. Since the vectors start on an even channel, the
+// smoothing factors simply alternate between the lanes.
+static FRONTEND_TARGET_AVX2 int NoiseReductionApplyAvx2(
+    struct NoiseReductionState* state, uint32_t* signal) {
+  const __m256i smoothing =
+      _mm256_setr_epi32(state->even_smoothing, state->odd_smoothing,
+                        state->even_smoothing, state->odd_smoothing,
+                        state->even_smoothing, state->odd_smoothing,
+                        state->even_smoothing, state->odd_smoothing);
+  const __m256i one_minus_smoothing =
+      _mm256_sub_epi32(_mm256_set1_epi32(1 << kNoiseReductionBits), smoothing);
+  const __m256i min_signal_remaining =
+      _mm256_set1_epi32(state->min_signal_remaining);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m128i smoothing_bits = _mm_cvtsi32_si128(state->smoothing_bits);
   int i;
-  for (i = 0; i < state->num_channels; ++i) {
+  for (i = 0; i <= state->num_channels - 8; i += 8) {
+    const __m256i value = _mm256_loadu_si256((const __m256i*)(signal + i));
+    const __m256i signal_scaled_up = _mm256_sll_epi32(value, smoothing_bits);
+    __m256i estimate = MulAddShiftRightAvx2(
+        signal_scaled_up, smoothing,
+        _mm256_loadu_si256((const __m256i*)(state->estimate + i)),
+        one_minus_smoothing, kNoiseReductionBits);
+    _mm256_storeu_si256((__m256i*)(state->estimate + i), estimate);
+
+    estimate = _mm256_min_epu32(estimate, signal_scaled_up);
+
+    const __m256i floor = MulAddShiftRightAvx2(
+        value, min_signal_remaining, zero, zero, kNoiseReductionBits);
+    const __m256i subtracted = _mm256_srl_epi32(
+        _mm256_sub_epi32(signal_scaled_up, estimate), smoothing_bits);
+    _mm256_storeu_si256((__m256i*)(signal + i),
+                        _mm256_max_epu32(subtracted, floor));
+  }
+  return i;
+}
+
+#endif  // FRONTEND_X86_SIMD
+
+void NoiseReductionApply(struct NoiseReductionState* state, uint32_t* signal) {
+  int i = 0;
+#ifdef FRONTEND_X86_SIMD
+  if (FrontendHasAvx2()) {
+    i = NoiseReductionApplyAvx2(state, signal);
+  }
+#endif
+  for (; i < state->num_channels; ++i) {
     const uint32_t smoothing =
         ((i & 1) == 0) ? state->even_smoothing : state->odd_smoothing;
     const uint32_t one_minus_smoothing = (1 << kNoiseReductionBits) - smoothing;
@@ -15,6 +15,7 @@ limitations under the License.
 #include "tensorflow/lite/experimental/microfrontend/lib/pcan_gain_control.h"
 
 #include "tensorflow/lite/experimental/microfrontend/lib/bits.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/x86_simd.h"
 
 int16_t WideDynamicFunction(const uint32_t x, const int16_t* lut) {
   if (x <= 2) {
@@ -44,10 +45,88 @@ uint32_t PcanShrink(const uint32_t x) {
   }
 }
 
+#ifdef FRONTEND_X86_SIMD
+
+// WideDynamicFunction() for each lane, with the three table entries of a lane
+// fetched by two overlapping 32-bit gathers from the int16 table.
+static FRONTEND_TARGET_AVX2 __m256i WideDynamicFunctionAvx2(
+    __m256i x, const int16_t* lut) {
+  const __m256i eleven = _mm256_set1_epi32(11);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i is_small = LessOrEqualU32Avx2(x, _mm256_set1_epi32(2));
+  const __m256i interval =
+      MostSignificantBit32Avx2(_mm256_max_epu32(x, _mm256_set1_epi32(3)));
+  // Small inputs index the table directly.
+  const __m256i index = _mm256_blendv_epi8(
+      _mm256_sub_epi32(_mm256_slli_epi32(interval, 2), _mm256_set1_epi32(6)),
+      x, is_small);
+  const __m256i lut01 = _mm256_i32gather_epi32((const int*)lut, index, 2);
+  const __m256i lut12 = _mm256_i32gather_epi32(
+      (const int*)lut, _mm256_add_epi32(index, _mm256_set1_epi32(1)), 2);
+  const __m256i lut0 = _mm256_srai_epi32(_mm256_slli_epi32(lut01, 16), 16);
+  const __m256i lut1 = _mm256_srai_epi32(lut01, 16);
+  const __m256i lut2 = _mm256_srai_epi32(lut12, 16);
+
+  const __m256i frac = _mm256_and_si256(
+      _mm256_srlv_epi32(
+          _mm256_sllv_epi32(x, _mm256_max_epi32(
+                                   _mm256_sub_epi32(eleven, interval), zero)),
+          _mm256_max_epi32(_mm256_sub_epi32(interval, eleven), zero)),
+      _mm256_set1_epi32(0x3FF));
+
+  __m256i result = _mm256_srai_epi32(_mm256_mullo_epi32(lut2, frac), 5);
+  result = _mm256_add_epi32(result, _mm256_slli_epi32(lut1, 5));
+  result = _mm256_mullo_epi32(result, frac);
+  result = _mm256_srai_epi32(
+      _mm256_add_epi32(result, _mm256_set1_epi32(1 << 14)), 15);
+  result = _mm256_add_epi32(result, lut0);
+  // Truncates to int16_t and sign extends back like the scalar return value.
+  result = _mm256_srai_epi32(_mm256_slli_epi32(result, 16), 16);
+  return _mm256_blendv_epi8(result, lut0, is_small);
+}
+
+// PcanShrink() for each lane.
+static FRONTEND_TARGET_AVX2 __m256i PcanShrinkAvx2(__m256i x) {
+  const __m256i is_small =
+      LessOrEqualU32Avx2(x, _mm256_set1_epi32((2 << kPcanSnrBits) - 1));
+  const __m256i small = _mm256_srli_epi32(_mm256_mullo_epi32(x, x),
+                                          2 + 2 * kPcanSnrBits -
+                                              kPcanOutputBits);
+  const __m256i large =
+      _mm256_sub_epi32(_mm256_srli_epi32(x, kPcanSnrBits - kPcanOutputBits),
+                       _mm256_set1_epi32(1 << kPcanOutputBits));
+  return _mm256_blendv_epi8(large, small, is_small);
+}
+
+// Applies the gain control to the first num_channels / 8 * 8 channels and
+// returns how many that was.
+static FRONTEND_TARGET_AVX2 int PcanGainControlApplyAvx2(
+    struct PcanGainControlState* state, uint32_t* signal) {
+  const __m256i zero = _mm256_setzero_si256();
+  int i;
+  for (i = 0; i <= state->num_channels - 8; i += 8) {
+    const __m256i gain = WideDynamicFunctionAvx2(
+        _mm256_loadu_si256((const __m256i*)(state->noise_estimate + i)),
+        state->gain_lut);
+    const __m256i snr = MulAddShiftRightAvx2(
+        _mm256_loadu_si256((const __m256i*)(signal + i)), gain, zero, zero,
+        state->snr_shift);
+    _mm256_storeu_si256((__m256i*)(signal + i), PcanShrinkAvx2(snr));
+  }
+  return i;
+}
+
+#endif  // FRONTEND_X86_SIMD
+
 void PcanGainControlApply(struct PcanGainControlState* state,
                           uint32_t* signal) {
-  int i;
-  for (i = 0; i < state->num_channels; ++i) {
+  int i = 0;
+#ifdef FRONTEND_X86_SIMD
+  if (FrontendHasAvx2()) {
+    i = PcanGainControlApplyAvx2(state, signal);
+  }
+#endif
+  for (; i < state->num_channels; ++i) {
     const uint32_t gain =
         WideDynamicFunction(state->noise_estimate[i], state->gain_lut);
     const uint32_t snr = ((uint64_t)signal[i] * gain) >> state->snr_shift;
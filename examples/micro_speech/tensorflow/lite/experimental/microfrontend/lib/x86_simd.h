@@ -0,0 +1,87 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_X86_SIMD_H_
+#define TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_X86_SIMD_H_
+
+// The frontend stages have AVX2 versions that are compiled with per-function
+// target attributes and selected at runtime, so the library can still be built
+// without any -m flags. Each one processes as many channels as fill whole
+// vectors and returns how many that was, and the caller's scalar loop finishes
+// the rest, which is also where other SIMD extensions would plug in. Define
+// TF_LITE_DISABLE_X86_SIMD to compile them out entirely.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(TF_LITE_DISABLE_X86_SIMD)
+#define FRONTEND_X86_SIMD
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#define FRONTEND_TARGET_AVX2 __attribute__((target("avx2")))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline int FrontendHasAvx2(void) {
+  return __builtin_cpu_supports("avx2");
+}
+
+// Returns the low 32 bits of ((uint64_t)a * b + (uint64_t)c * d) >> shift for
+// each unsigned 32-bit lane. The two products must not overflow when added.
+static inline FRONTEND_TARGET_AVX2 __m256i MulAddShiftRightAvx2(
+    __m256i a, __m256i b, __m256i c, __m256i d, int shift) {
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  // Even lanes are multiplied in place, odd lanes after moving them down.
+  const __m256i even = _mm256_srl_epi64(
+      _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_mul_epu32(c, d)), count);
+  const __m256i odd = _mm256_srl_epi64(
+      _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32),
+                                        _mm256_srli_epi64(b, 32)),
+                       _mm256_mul_epu32(_mm256_srli_epi64(c, 32),
+                                        _mm256_srli_epi64(d, 32))),
+      count);
+  return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+// MostSignificantBit32() for each unsigned 32-bit lane.
+static inline FRONTEND_TARGET_AVX2 __m256i MostSignificantBit32Avx2(
+    __m256i x) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i result = zero;
+  int shift;
+  for (shift = 16; shift > 0; shift >>= 1) {
+    const __m256i shifted = _mm256_srl_epi32(x, _mm_cvtsi32_si128(shift));
+    const __m256i has_bits = _mm256_cmpgt_epi32(shifted, zero);
+    x = _mm256_blendv_epi8(x, shifted, has_bits);
+    result = _mm256_add_epi32(
+        result, _mm256_and_si256(has_bits, _mm256_set1_epi32(shift)));
+  }
+  // x is now 1, or 0 if it was 0 to begin with.
+  return _mm256_add_epi32(result, x);
+}
+
+// Returns all ones in the lanes where the unsigned value of a is at most b.
+static inline FRONTEND_TARGET_AVX2 __m256i LessOrEqualU32Avx2(__m256i a,
+                                                              __m256i b) {
+  return _mm256_cmpeq_epi32(_mm256_min_epu32(a, b), a);
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // FRONTEND_X86_SIMD
+
+#endif  // TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_X86_SIMD_H_
@@ -0,0 +1,149 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "tensorflow/lite/experimental/microfrontend/lib/bits.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/fft.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/fft_util.h"
+#include "tensorflow/lite/micro/benchmarks/micro_benchmark.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "yes_1000ms_sample_data.h"
+
+#define FIXED_POINT 16
+#include "kiss_fft.h"
+#include "tools/kiss_fftr.h"
+
+/*
+ * Microfrontend FFT benchmark. Compares FftCompute() with the kiss_fftr path
+ * it replaced, on the 30 ms windows of a one second recording that the micro
+ * speech example computes features for. The two must agree bit for bit, and
+ * the benchmark fails if they do not.
+ */
+
+namespace {
+
+constexpr int kNumSamples = 16000;
+constexpr int kWindowSize = 480;
+constexpr int kWindowStep = 160;
+constexpr int kNumWindows = (kNumSamples - kWindowSize) / kWindowStep + 1;
+
+FftState fft_state;
+
+// kiss_fftr and the buffers FftCompute() used to fill for it.
+constexpr int kKissFftSize = 512;
+constexpr size_t kKissMemorySize = 4096;
+alignas(16) uint8_t kiss_memory[kKissMemorySize];
+kiss_fftr_cfg kiss_config = nullptr;
+int16_t kiss_input[kKissFftSize];
+kiss_fft_cpx kiss_output[kKissFftSize / 2 + 1];
+
+// Shifts up like the frontend does, to use the full 16 bits.
+int InputShift(const int16_t* window) {
+  int16_t max_abs = 0;
+  for (int i = 0; i < kWindowSize; ++i) {
+    const int16_t value = window[i] < 0 ? -window[i] : window[i];
+    max_abs = value > max_abs ? value : max_abs;
+  }
+  return 15 - MostSignificantBit32(max_abs);
+}
+
+void KissFftCompute(const int16_t* window, int shift) {
+  int i;
+  for (i = 0; i < kWindowSize; ++i) {
+    kiss_input[i] = static_cast<int16_t>(static_cast<uint16_t>(window[i])
+                                         << shift);
+  }
+  for (; i < kKissFftSize; ++i) {
+    kiss_input[i] = 0;
+  }
+  kiss_fftr(kiss_config, kiss_input, kiss_output);
+}
+
+const int16_t* Window(int index) {
+  return g_yes_1000ms_sample_data + index * kWindowStep;
+}
+
+// Returns the number of windows whose output differs, and the largest
+// difference of any bin in |max_error|.
+int CompareWithKiss(int* max_error) {
+  int num_mismatches = 0;
+  *max_error = 0;
+  for (int w = 0; w < kNumWindows; ++w) {
+    const int shift = InputShift(Window(w));
+    FftCompute(&fft_state, Window(w), shift);
+    KissFftCompute(Window(w), shift);
+    bool mismatch = false;
+    for (int k = 0; k <= kKissFftSize / 2; ++k) {
+      const int real_error =
+          std::abs(fft_state.output[k].real - kiss_output[k].r);
+      const int imag_error =
+          std::abs(fft_state.output[k].imag - kiss_output[k].i);
+      const int error = real_error > imag_error ? real_error : imag_error;
+      mismatch |= error != 0;
+      *max_error = error > *max_error ? error : *max_error;
+    }
+    num_mismatches += mismatch;
+  }
+  return num_mismatches;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  tflite::MicroErrorReporter error_reporter;
+  if (!FftPopulateState(&fft_state, kWindowSize) ||
+      fft_state.fft_size != kKissFftSize) {
+    TF_LITE_REPORT_ERROR(&error_reporter, "FftPopulateState() failed");
+    return 1;
+  }
+  size_t kiss_memory_size = kKissMemorySize;
+  kiss_config = kiss_fftr_alloc(kKissFftSize, 0, kiss_memory,
+                                &kiss_memory_size);
+  if (kiss_config == nullptr) {
+    TF_LITE_REPORT_ERROR(&error_reporter,
+                         "kiss_fftr needs %d bytes of memory",
+                         static_cast<int>(kiss_memory_size));
+    return 1;
+  }
+
+  int max_error = 0;
+  const int num_mismatches = CompareWithKiss(&max_error);
+  TF_LITE_REPORT_ERROR(&error_reporter,
+                       "%d of %d windows differ from kiss_fftr, by at most %d",
+                       num_mismatches, kNumWindows, max_error);
+
+  MicroBenchmarkSuite suite(&error_reporter);
+  suite.Run(
+      "FftCompute",
+      []() {
+        for (int w = 0; w < kNumWindows; ++w) {
+          FftCompute(&fft_state, Window(w), InputShift(Window(w)));
+        }
+      },
+      kNumWindows);
+  suite.Run(
+      "KissFftr",
+      []() {
+        for (int w = 0; w < kNumWindows; ++w) {
+          KissFftCompute(Window(w), InputShift(Window(w)));
+        }
+      },
+      kNumWindows);
+  const int result = suite.Finish(argc, argv);
+  FftFreeStateContents(&fft_state);
+  return num_mismatches != 0 ? 1 : result;
+}
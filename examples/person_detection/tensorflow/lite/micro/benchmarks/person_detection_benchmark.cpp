@@ -60,32 +60,17 @@ void CreateBenchmarkRunner() {
                                      tensor_arena, kTensorArenaSize);
 }
 
-void InitializeBenchmarkRunner() {
-  CreateBenchmarkRunner();
-  benchmark_runner->SetInput(reinterpret_cast<const int8_t*>(g_person_data));
-}
+}  // namespace
 
-void PersonDetectionTenIerationsWithPerson() {
+int main(int argc, char** argv) {
+  tflite::MicroErrorReporter error_reporter;
+  MicroBenchmarkSuite suite(&error_reporter);
+  CreateBenchmarkRunner();
   benchmark_runner->SetInput(reinterpret_cast<const int8_t*>(g_person_data));
-  for (int i = 0; i < 10; i++) {
-    benchmark_runner->RunSingleIteration();
-  }
-}
-
-void PersonDetectionTenIerationsWithoutPerson() {
+  suite.Run("PersonDetectionInvokeWithPerson",
+            []() { benchmark_runner->RunSingleIteration(); });
   benchmark_runner->SetInput(reinterpret_cast<const int8_t*>(g_no_person_data));
-  for (int i = 0; i < 10; i++) {
-    benchmark_runner->RunSingleIteration();
-  }
+  suite.Run("PersonDetectionInvokeWithoutPerson",
+            []() { benchmark_runner->RunSingleIteration(); });
+  return suite.Finish(argc, argv);
 }
-
-}  // namespace
-
-TF_LITE_MICRO_BENCHMARKS_BEGIN
-
-TF_LITE_MICRO_BENCHMARK(InitializeBenchmarkRunner());
-TF_LITE_MICRO_BENCHMARK(benchmark_runner->RunSingleIteration());
-TF_LITE_MICRO_BENCHMARK(PersonDetectionTenIerationsWithPerson());
-TF_LITE_MICRO_BENCHMARK(PersonDetectionTenIerationsWithoutPerson());
-
-TF_LITE_MICRO_BENCHMARKS_END
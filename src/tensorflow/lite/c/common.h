@@ -822,6 +822,17 @@ typedef struct TfLiteContext {
   // WARNING: This method may not be available on all platforms.
   TfLiteEvalTensor* (*GetEvalTensor)(const struct TfLiteContext* context,
                                      int tensor_idx);
+
+  // Allocate a zeroed buffer for state that a kernel keeps from one Eval to
+  // the next, such as a history of its inputs. The buffer is zeroed again
+  // whenever the variable tensors are reset, and every TFLM session of a
+  // prepared model gets its own copy. In Eval stage the kernel has to look it
+  // up with GetScratchBuffer(buffer_idx) instead of keeping the returned
+  // pointer in its op data. Returns nullptr on failure.
+  // This method is only available in Prepare stage.
+  // WARNING: This is an experimental interface that is subject to change.
+  void* (*AllocateStateBuffer)(struct TfLiteContext* ctx, size_t bytes,
+                               int* buffer_idx);
 } TfLiteContext;
 
 typedef struct TfLiteRegistration {
@@ -0,0 +1,53 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_CPU_CHECK_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_CPU_CHECK_H_
+
+// Host x86 SIMD kernels are compiled with per-function target attributes and
+// selected at runtime, so the library itself can still be built without any
+// -m flags. Define TF_LITE_DISABLE_X86_SIMD to compile them out entirely.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(TF_LITE_DISABLE_X86_SIMD)
+#define TFLITE_X86_SIMD
+#include <immintrin.h>
+
+#define TFLITE_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TFLITE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace tflite {
+
+#ifdef TFLITE_X86_SIMD
+
+inline bool TestCPUFeatureSse41() {
+  static const bool has_sse41 = __builtin_cpu_supports("sse4.1");
+  return has_sse41;
+}
+
+inline bool TestCPUFeatureAvx2() {
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+}
+
+#else
+
+inline bool TestCPUFeatureSse41() { return false; }
+inline bool TestCPUFeatureAvx2() { return false; }
+
+#endif  // TFLITE_X86_SIMD
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_CPU_CHECK_H_
@@ -0,0 +1,542 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_CONV_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_CONV_H_
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/cpu_check.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/packed_weights.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Returns true if a host SIMD implementation of ConvPerChannel is available on
+// the running CPU. When this returns false, callers should use the CMSIS-NN or
+// reference kernels instead.
+inline bool HasConvPerChannel() {
+  return TestCPUFeatureAvx2() || TestCPUFeatureSse41();
+}
+
+// Size in bytes of the scratch buffer ConvPerChannel needs: two int16 im2col
+// columns, one per output pixel of the pair being computed.
+inline int ConvPerChannelScratchSize(const RuntimeShape& filter_shape) {
+#ifdef TFLITE_X86_SIMD
+  return 2 * filter_shape.Dims(1) * filter_shape.Dims(2) *
+         filter_shape.Dims(3) * static_cast<int>(sizeof(int16_t));
+#else
+  return 0;
+#endif
+}
+
+// Size in bytes of the scratch buffer ConvPerChannelPacked needs: two int8
+// im2col columns padded to whole packed chunks.
+inline int ConvPerChannelPackedScratchSize(const RuntimeShape& filter_shape) {
+  return 2 * PackedDepth(filter_shape.Dims(1) * filter_shape.Dims(2) *
+                         filter_shape.Dims(3));
+}
+
+#ifdef TFLITE_X86_SIMD
+
+// Computes the dot products of one int16 im2col column with four consecutive
+// int8 filter rows of |depth| elements each. Products are widened to int32
+// with madd, so the result is exact as long as the reference kernel's int32
+// accumulator does not overflow either.
+TFLITE_TARGET_AVX2 inline void ColumnDot4Avx2(const int16_t* col,
+                                              const int8_t* filter, int depth,
+                                              int32_t* acc) {
+  const int8_t* f0 = filter;
+  const int8_t* f1 = f0 + depth;
+  const int8_t* f2 = f1 + depth;
+  const int8_t* f3 = f2 + depth;
+  __m256i acc0 = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+  __m256i acc2 = _mm256_setzero_si256();
+  __m256i acc3 = _mm256_setzero_si256();
+  int i = 0;
+  for (; i <= depth - 16; i += 16) {
+    const __m256i c =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(col + i));
+    const __m256i w0 = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(f0 + i)));
+    const __m256i w1 = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(f1 + i)));
+    const __m256i w2 = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(f2 + i)));
+    const __m256i w3 = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(f3 + i)));
+    acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(c, w0));
+    acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(c, w1));
+    acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(c, w2));
+    acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(c, w3));
+  }
+  const __m256i sum =
+      _mm256_hadd_epi32(_mm256_hadd_epi32(acc0, acc1),
+                        _mm256_hadd_epi32(acc2, acc3));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(acc),
+                   _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                 _mm256_extracti128_si256(sum, 1)));
+  for (; i < depth; ++i) {
+    acc[0] += col[i] * f0[i];
+    acc[1] += col[i] * f1[i];
+    acc[2] += col[i] * f2[i];
+    acc[3] += col[i] * f3[i];
+  }
+}
+
+TFLITE_TARGET_SSE41 inline void ColumnDot4Sse41(const int16_t* col,
+                                                const int8_t* filter,
+                                                int depth, int32_t* acc) {
+  const int8_t* f0 = filter;
+  const int8_t* f1 = f0 + depth;
+  const int8_t* f2 = f1 + depth;
+  const int8_t* f3 = f2 + depth;
+  __m128i acc0 = _mm_setzero_si128();
+  __m128i acc1 = _mm_setzero_si128();
+  __m128i acc2 = _mm_setzero_si128();
+  __m128i acc3 = _mm_setzero_si128();
+  int i = 0;
+  for (; i <= depth - 8; i += 8) {
+    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(col + i));
+    const __m128i w0 = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(f0 + i)));
+    const __m128i w1 = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(f1 + i)));
+    const __m128i w2 = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(f2 + i)));
+    const __m128i w3 = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(f3 + i)));
+    acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(c, w0));
+    acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(c, w1));
+    acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(c, w2));
+    acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(c, w3));
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(acc),
+                   _mm_hadd_epi32(_mm_hadd_epi32(acc0, acc1),
+                                  _mm_hadd_epi32(acc2, acc3)));
+  for (; i < depth; ++i) {
+    acc[0] += col[i] * f0[i];
+    acc[1] += col[i] * f1[i];
+    acc[2] += col[i] * f2[i];
+    acc[3] += col[i] * f3[i];
+  }
+}
+
+// Same as ColumnDot4Avx2 but for two columns at once, so every widened filter
+// vector is used twice. |acc| receives the four results of |col0| followed by
+// the four results of |col1|.
+TFLITE_TARGET_AVX2 inline void ColumnDot4x2Avx2(const int16_t* col0,
+                                                const int16_t* col1,
+                                                const int8_t* filter, int depth,
+                                                int32_t* acc) {
+  const int8_t* f0 = filter;
+  const int8_t* f1 = f0 + depth;
+  const int8_t* f2 = f1 + depth;
+  const int8_t* f3 = f2 + depth;
+  __m256i acc00 = _mm256_setzero_si256();
+  __m256i acc01 = _mm256_setzero_si256();
+  __m256i acc02 = _mm256_setzero_si256();
+  __m256i acc03 = _mm256_setzero_si256();
+  __m256i acc10 = _mm256_setzero_si256();
+  __m256i acc11 = _mm256_setzero_si256();
+  __m256i acc12 = _mm256_setzero_si256();
+  __m256i acc13 = _mm256_setzero_si256();
+  int i = 0;
+  for (; i <= depth - 16; i += 16) {
+    const __m256i c0 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(col0 + i));
+    const __m256i c1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(col1 + i));
+    const __m256i w0 = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(f0 + i)));
+    const __m256i w1 = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(f1 + i)));
+    const __m256i w2 = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(f2 + i)));
+    const __m256i w3 = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(f3 + i)));
+    acc00 = _mm256_add_epi32(acc00, _mm256_madd_epi16(c0, w0));
+    acc01 = _mm256_add_epi32(acc01, _mm256_madd_epi16(c0, w1));
+    acc02 = _mm256_add_epi32(acc02, _mm256_madd_epi16(c0, w2));
+    acc03 = _mm256_add_epi32(acc03, _mm256_madd_epi16(c0, w3));
+    acc10 = _mm256_add_epi32(acc10, _mm256_madd_epi16(c1, w0));
+    acc11 = _mm256_add_epi32(acc11, _mm256_madd_epi16(c1, w1));
+    acc12 = _mm256_add_epi32(acc12, _mm256_madd_epi16(c1, w2));
+    acc13 = _mm256_add_epi32(acc13, _mm256_madd_epi16(c1, w3));
+  }
+  const __m256i sum0 =
+      _mm256_hadd_epi32(_mm256_hadd_epi32(acc00, acc01),
+                        _mm256_hadd_epi32(acc02, acc03));
+  const __m256i sum1 =
+      _mm256_hadd_epi32(_mm256_hadd_epi32(acc10, acc11),
+                        _mm256_hadd_epi32(acc12, acc13));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(acc),
+                   _mm_add_epi32(_mm256_castsi256_si128(sum0),
+                                 _mm256_extracti128_si256(sum0, 1)));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 4),
+                   _mm_add_epi32(_mm256_castsi256_si128(sum1),
+                                 _mm256_extracti128_si256(sum1, 1)));
+  for (; i < depth; ++i) {
+    acc[0] += col0[i] * f0[i];
+    acc[1] += col0[i] * f1[i];
+    acc[2] += col0[i] * f2[i];
+    acc[3] += col0[i] * f3[i];
+    acc[4] += col1[i] * f0[i];
+    acc[5] += col1[i] * f1[i];
+    acc[6] += col1[i] * f2[i];
+    acc[7] += col1[i] * f3[i];
+  }
+}
+
+TFLITE_TARGET_SSE41 inline void ColumnDot4x2Sse41(const int16_t* col0,
+                                                  const int16_t* col1,
+                                                  const int8_t* filter,
+                                                  int depth, int32_t* acc) {
+  const int8_t* f0 = filter;
+  const int8_t* f1 = f0 + depth;
+  const int8_t* f2 = f1 + depth;
+  const int8_t* f3 = f2 + depth;
+  __m128i acc00 = _mm_setzero_si128();
+  __m128i acc01 = _mm_setzero_si128();
+  __m128i acc02 = _mm_setzero_si128();
+  __m128i acc03 = _mm_setzero_si128();
+  __m128i acc10 = _mm_setzero_si128();
+  __m128i acc11 = _mm_setzero_si128();
+  __m128i acc12 = _mm_setzero_si128();
+  __m128i acc13 = _mm_setzero_si128();
+  int i = 0;
+  for (; i <= depth - 8; i += 8) {
+    const __m128i c0 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(col0 + i));
+    const __m128i c1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(col1 + i));
+    const __m128i w0 = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(f0 + i)));
+    const __m128i w1 = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(f1 + i)));
+    const __m128i w2 = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(f2 + i)));
+    const __m128i w3 = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(f3 + i)));
+    acc00 = _mm_add_epi32(acc00, _mm_madd_epi16(c0, w0));
+    acc01 = _mm_add_epi32(acc01, _mm_madd_epi16(c0, w1));
+    acc02 = _mm_add_epi32(acc02, _mm_madd_epi16(c0, w2));
+    acc03 = _mm_add_epi32(acc03, _mm_madd_epi16(c0, w3));
+    acc10 = _mm_add_epi32(acc10, _mm_madd_epi16(c1, w0));
+    acc11 = _mm_add_epi32(acc11, _mm_madd_epi16(c1, w1));
+    acc12 = _mm_add_epi32(acc12, _mm_madd_epi16(c1, w2));
+    acc13 = _mm_add_epi32(acc13, _mm_madd_epi16(c1, w3));
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(acc),
+                   _mm_hadd_epi32(_mm_hadd_epi32(acc00, acc01),
+                                  _mm_hadd_epi32(acc02, acc03)));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 4),
+                   _mm_hadd_epi32(_mm_hadd_epi32(acc10, acc11),
+                                  _mm_hadd_epi32(acc12, acc13)));
+  for (; i < depth; ++i) {
+    acc[0] += col0[i] * f0[i];
+    acc[1] += col0[i] * f1[i];
+    acc[2] += col0[i] * f2[i];
+    acc[3] += col0[i] * f3[i];
+    acc[4] += col1[i] * f0[i];
+    acc[5] += col1[i] * f1[i];
+    acc[6] += col1[i] * f2[i];
+    acc[7] += col1[i] * f3[i];
+  }
+}
+
+#endif  // TFLITE_X86_SIMD
+
+#ifdef TFLITE_X86_SIMD
+
+// Expands the receptive field of output pixel (out_y, out_x) into an int16
+// column laid out like a filter row (filter_y, filter_x, in_channel), with
+// the input offset applied. Taps that fall into the padding are zero, which
+// matches the reference kernel skipping them.
+inline void FillConvColumn(const ConvParams& params,
+                           const RuntimeShape& input_shape,
+                           const int8_t* input_data, int batch,
+                           int filter_height, int filter_width, int out_y,
+                           int out_x, int16_t* col) {
+  const int32_t input_offset = params.input_offset;
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int input_depth = input_shape.Dims(3);
+  const int in_y_origin =
+      (out_y * params.stride_height) - params.padding_values.height;
+  const int in_x_origin =
+      (out_x * params.stride_width) - params.padding_values.width;
+  for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+    const int in_y = in_y_origin + params.dilation_height_factor * filter_y;
+    for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+      const int in_x = in_x_origin + params.dilation_width_factor * filter_x;
+      if ((in_x >= 0) && (in_x < input_width) && (in_y >= 0) &&
+          (in_y < input_height)) {
+        const int8_t* in =
+            input_data + Offset(input_shape, batch, in_y, in_x, 0);
+        for (int in_channel = 0; in_channel < input_depth; ++in_channel) {
+          col[in_channel] = static_cast<int16_t>(in[in_channel] + input_offset);
+        }
+      } else {
+        std::memset(col, 0, input_depth * sizeof(int16_t));
+      }
+      col += input_depth;
+    }
+  }
+}
+
+// Same as FillConvColumn but for ConvPerChannelPacked: the column holds the
+// raw int8 input values, since the input offset is folded into the bias. Taps
+// that fall into the padding hold the input zero point, which contributes
+// nothing once the offset is added back. The column is zero padded to
+// |packed_depth|.
+inline void FillPackedConvColumn(const ConvParams& params,
+                                 const RuntimeShape& input_shape,
+                                 const int8_t* input_data, int batch,
+                                 int filter_height, int filter_width,
+                                 int out_y, int out_x, int packed_depth,
+                                 int8_t* col) {
+  const int8_t input_zero_point = static_cast<int8_t>(-params.input_offset);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int input_depth = input_shape.Dims(3);
+  const int in_y_origin =
+      (out_y * params.stride_height) - params.padding_values.height;
+  const int in_x_origin =
+      (out_x * params.stride_width) - params.padding_values.width;
+  int8_t* col_end = col + packed_depth;
+  for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+    const int in_y = in_y_origin + params.dilation_height_factor * filter_y;
+    for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+      const int in_x = in_x_origin + params.dilation_width_factor * filter_x;
+      if ((in_x >= 0) && (in_x < input_width) && (in_y >= 0) &&
+          (in_y < input_height)) {
+        std::memcpy(col, input_data + Offset(input_shape, batch, in_y, in_x, 0),
+                    input_depth);
+      } else {
+        std::memset(col, input_zero_point, input_depth);
+      }
+      col += input_depth;
+    }
+  }
+  std::memset(col, 0, col_end - col);
+}
+
+inline int8_t RequantizeConvOutput(const ConvParams& params, int32_t acc,
+                                   const int32_t* bias_data,
+                                   const int32_t* output_multiplier,
+                                   const int32_t* output_shift, int channel) {
+  if (bias_data) {
+    acc += bias_data[channel];
+  }
+  acc = MultiplyByQuantizedMultiplier(acc, output_multiplier[channel],
+                                      output_shift[channel]);
+  acc += params.output_offset;
+  acc = std::max(acc, params.quantized_activation_min);
+  acc = std::min(acc, params.quantized_activation_max);
+  return static_cast<int8_t>(acc);
+}
+
+#endif  // TFLITE_X86_SIMD
+
+// Fixed-point per-channel-quantization convolution for x86 hosts. Produces the
+// same output as reference_integer_ops::ConvPerChannel. Output pixels are
+// processed in pairs: both receptive fields are expanded into |im2col_data|
+// once and then reused for every output channel, four channels at a time.
+// |im2col_data| must hold ConvPerChannelScratchSize() bytes. Must only be
+// called when HasConvPerChannel() returns true.
+inline void ConvPerChannel(
+    const ConvParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const int8_t* filter_data, const RuntimeShape& bias_shape,
+    const int32_t* bias_data, const RuntimeShape& output_shape,
+    int8_t* output_data, int16_t* im2col_data) {
+#ifdef TFLITE_X86_SIMD
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  if (bias_data) {
+    TFLITE_DCHECK_EQ(bias_shape.FlatSize(), output_depth);
+  }
+  TFLITE_DCHECK(im2col_data != nullptr);
+
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int output_pixels = output_height * output_width;
+  const int patch_depth = filter_height * filter_width * input_depth;
+
+  const bool use_avx2 = TestCPUFeatureAvx2();
+  void (*column_dot4)(const int16_t*, const int8_t*, int, int32_t*) =
+      use_avx2 ? ColumnDot4Avx2 : ColumnDot4Sse41;
+  void (*column_dot4x2)(const int16_t*, const int16_t*, const int8_t*, int,
+                        int32_t*) =
+      use_avx2 ? ColumnDot4x2Avx2 : ColumnDot4x2Sse41;
+
+  // Output pixels of all batches are walked as one sequence and a pair may
+  // straddle two batches, so a batched call does not pay for a single-column
+  // pass over the filter at the end of every batch with an odd pixel count.
+  const int total_pixels = batches * output_pixels;
+  int16_t* col0 = im2col_data;
+  int16_t* col1 = im2col_data + patch_depth;
+  for (int pixel = 0; pixel < total_pixels; pixel += 2) {
+    const bool has_pair = pixel + 1 < total_pixels;
+    const int batch0 = pixel / output_pixels;
+    const int pixel0 = pixel % output_pixels;
+    FillConvColumn(params, input_shape, input_data, batch0, filter_height,
+                   filter_width, pixel0 / output_width,
+                   pixel0 % output_width, col0);
+    if (has_pair) {
+      const int batch1 = (pixel + 1) / output_pixels;
+      const int pixel1 = (pixel + 1) % output_pixels;
+      FillConvColumn(params, input_shape, input_data, batch1, filter_height,
+                     filter_width, pixel1 / output_width,
+                     pixel1 % output_width, col1);
+    }
+    int8_t* out0 = output_data + pixel * output_depth;
+    int8_t* out1 = out0 + output_depth;
+
+    int32_t acc[8];
+    int out_channel = 0;
+    for (; out_channel <= output_depth - 4; out_channel += 4) {
+      const int8_t* filter = filter_data + out_channel * patch_depth;
+      if (has_pair) {
+        column_dot4x2(col0, col1, filter, patch_depth, acc);
+      } else {
+        column_dot4(col0, filter, patch_depth, acc);
+      }
+      for (int j = 0; j < 4; ++j) {
+        out0[out_channel + j] =
+            RequantizeConvOutput(params, acc[j], bias_data, output_multiplier,
+                                 output_shift, out_channel + j);
+        if (has_pair) {
+          out1[out_channel + j] = RequantizeConvOutput(
+              params, acc[4 + j], bias_data, output_multiplier, output_shift,
+              out_channel + j);
+        }
+      }
+    }
+    for (; out_channel < output_depth; ++out_channel) {
+      const int8_t* filter = filter_data + out_channel * patch_depth;
+      int32_t acc0 = 0;
+      for (int i = 0; i < patch_depth; ++i) {
+        acc0 += col0[i] * filter[i];
+      }
+      out0[out_channel] =
+          RequantizeConvOutput(params, acc0, bias_data, output_multiplier,
+                               output_shift, out_channel);
+      if (has_pair) {
+        int32_t acc1 = 0;
+        for (int i = 0; i < patch_depth; ++i) {
+          acc1 += col1[i] * filter[i];
+        }
+        out1[out_channel] =
+            RequantizeConvOutput(params, acc1, bias_data, output_multiplier,
+                                 output_shift, out_channel);
+      }
+    }
+  }
+#else
+  TFLITE_DCHECK(false);
+#endif  // TFLITE_X86_SIMD
+}
+
+// Same as ConvPerChannel, but on a filter prepared with PackWeights() as an
+// output_depth x (filter_height * filter_width * input_depth) matrix and a
+// bias prepared with FoldInputOffsetIntoBias(). The im2col columns are plain
+// copies of the input rows and every packed block is read front to back
+// without tail loops. |im2col_data| must hold
+// ConvPerChannelPackedScratchSize() bytes. Must only be called when
+// HasPackedWeights() returns true.
+inline void ConvPerChannelPacked(
+    const ConvParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const int8_t* packed_filter, const int32_t* folded_bias,
+    const RuntimeShape& output_shape, int8_t* output_data,
+    int8_t* im2col_data) {
+#ifdef TFLITE_X86_SIMD
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  TFLITE_DCHECK(im2col_data != nullptr);
+
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int output_pixels = output_height * output_width;
+  const int packed_depth =
+      PackedDepth(filter_height * filter_width * input_depth);
+  const int block_size = kPackedBlockRows * packed_depth;
+
+  const bool use_avx2 = TestCPUFeatureAvx2();
+  const PackedDotFn dot1 = GetPackedDot(use_avx2, 1);
+  const PackedDotFn dot2 = GetPackedDot(use_avx2, 2);
+
+  const int total_pixels = batches * output_pixels;
+  int8_t* cols[2] = {im2col_data, im2col_data + packed_depth};
+  for (int pixel = 0; pixel < total_pixels; pixel += 2) {
+    const int columns = std::min(2, total_pixels - pixel);
+    for (int c = 0; c < columns; ++c) {
+      const int batch = (pixel + c) / output_pixels;
+      const int batch_pixel = (pixel + c) % output_pixels;
+      FillPackedConvColumn(params, input_shape, input_data, batch,
+                           filter_height, filter_width,
+                           batch_pixel / output_width,
+                           batch_pixel % output_width, packed_depth, cols[c]);
+    }
+
+    int32_t acc[2 * kPackedBlockRows];
+    for (int out_channel = 0; out_channel < output_depth;
+         out_channel += kPackedBlockRows) {
+      const int8_t* block =
+          packed_filter + out_channel / kPackedBlockRows * block_size;
+      (columns == 2 ? dot2 : dot1)(block, cols, packed_depth, acc);
+      const int rows = std::min(kPackedBlockRows, output_depth - out_channel);
+      for (int c = 0; c < columns; ++c) {
+        int8_t* out = output_data + (pixel + c) * output_depth + out_channel;
+        for (int r = 0; r < rows; ++r) {
+          out[r] = RequantizeConvOutput(params, acc[c * kPackedBlockRows + r],
+                                        folded_bias, output_multiplier,
+                                        output_shift, out_channel + r);
+        }
+      }
+    }
+  }
+#else
+  TFLITE_DCHECK(false);
+#endif  // TFLITE_X86_SIMD
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_CONV_H_
@@ -0,0 +1,400 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_DEPTHWISE_CONV_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_DEPTHWISE_CONV_H_
+
+#include <algorithm>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/cpu_check.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Returns true if a host SIMD implementation of DepthwiseConvPerChannel is
+// available on the running CPU for |params|. Only a depth multiplier of 1 is
+// covered. When this returns false, callers should use the CMSIS-NN or
+// reference kernels instead.
+inline bool HasDepthwiseConvPerChannel(const DepthwiseParams& params) {
+  return params.depth_multiplier == 1 &&
+         (TestCPUFeatureAvx2() || TestCPUFeatureSse41());
+}
+
+#ifdef TFLITE_X86_SIMD
+
+// Number of channels every vector iteration computes. Channels are contiguous
+// in NHWC, so each filter tap is one 8 byte load of input and one of filter.
+constexpr int kDepthwiseChannelBlock = 8;
+
+// Everything needed to compute one output row of a depthwise convolution
+// with a depth multiplier of 1.
+struct DepthwiseConvRow {
+  const DepthwiseParams* params;
+  const int32_t* output_multiplier;
+  const int32_t* output_shift;
+  // Start of the batch the row belongs to.
+  const int8_t* input_data;
+  int input_height;
+  int input_width;
+  int depth;
+  const int8_t* filter_data;
+  int filter_height;
+  int filter_width;
+  const int32_t* bias_data;
+  int output_width;
+  int out_y;
+  int8_t* output_data;
+};
+
+// Computes output channel |channel| of pixel |out_x| the way the reference
+// kernel does. Used for the channels that do not fill a whole block.
+inline int8_t DepthwiseConvOutput(const DepthwiseConvRow& row, int out_x,
+                                  int channel) {
+  const DepthwiseParams& params = *row.params;
+  const int in_x_origin =
+      out_x * params.stride_width - params.padding_values.width;
+  const int in_y_origin =
+      row.out_y * params.stride_height - params.padding_values.height;
+  int32_t acc = 0;
+  for (int filter_y = 0; filter_y < row.filter_height; ++filter_y) {
+    const int in_y = in_y_origin + params.dilation_height_factor * filter_y;
+    if (in_y < 0 || in_y >= row.input_height) {
+      continue;
+    }
+    for (int filter_x = 0; filter_x < row.filter_width; ++filter_x) {
+      const int in_x = in_x_origin + params.dilation_width_factor * filter_x;
+      if (in_x < 0 || in_x >= row.input_width) {
+        continue;
+      }
+      const int32_t input_val =
+          row.input_data[(in_y * row.input_width + in_x) * row.depth + channel];
+      const int32_t filter_val =
+          row.filter_data[(filter_y * row.filter_width + filter_x) * row.depth +
+                          channel];
+      acc += filter_val * (input_val + params.input_offset);
+    }
+  }
+  if (row.bias_data) {
+    acc += row.bias_data[channel];
+  }
+  acc = MultiplyByQuantizedMultiplier(acc, row.output_multiplier[channel],
+                                      row.output_shift[channel]);
+  acc += params.output_offset;
+  acc = std::max(acc, params.quantized_activation_min);
+  acc = std::min(acc, params.quantized_activation_max);
+  return static_cast<int8_t>(acc);
+}
+
+// Returns filter * (input + input_offset) for eight channels as int16. The
+// operands are at most 255 and 128 in magnitude, so the product always fits.
+TFLITE_TARGET_SSE41 inline __m128i DepthwiseTap(const int8_t* input,
+                                                __m128i filter,
+                                                __m128i input_offset) {
+  const __m128i x = _mm_add_epi16(
+      _mm_cvtepi8_epi16(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(input))),
+      input_offset);
+  return _mm_mullo_epi16(filter, x);
+}
+
+TFLITE_TARGET_SSE41 inline __m128i LoadDepthwiseFilter(const int8_t* filter) {
+  return _mm_cvtepi8_epi16(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(filter)));
+}
+
+// Vector version of MultiplyByQuantizedMultiplier() with a per-lane multiplier
+// and shift. The multiplier is never negative, so the saturating case of
+// SaturatingRoundingDoublingHighMul() cannot occur, and its rounding is the
+// same as adding 2^30 to the 64-bit product and shifting right by 31.
+TFLITE_TARGET_AVX2 inline __m256i MultiplyByQuantizedMultiplierAvx2(
+    __m256i x, __m256i multiplier, __m256i shift) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i left_shift = _mm256_max_epi32(shift, zero);
+  const __m256i right_shift =
+      _mm256_max_epi32(_mm256_sub_epi32(zero, shift), zero);
+  x = _mm256_sllv_epi32(x, left_shift);
+
+  // Even lanes are multiplied in place, odd lanes after moving them down. The
+  // result is bits 31 to 62 of each 64-bit sum.
+  const __m256i nudge = _mm256_set1_epi64x(1 << 30);
+  const __m256i even =
+      _mm256_add_epi64(_mm256_mul_epi32(x, multiplier), nudge);
+  const __m256i odd = _mm256_add_epi64(
+      _mm256_mul_epi32(_mm256_srli_epi64(x, 32),
+                       _mm256_srli_epi64(multiplier, 32)),
+      nudge);
+  const __m256i high = _mm256_blend_epi32(_mm256_srli_epi64(even, 31),
+                                          _mm256_slli_epi64(odd, 1), 0xAA);
+
+  // RoundingDivideByPOT(), with the comparison masks standing in for -1.
+  const __m256i mask =
+      _mm256_sub_epi32(_mm256_sllv_epi32(one, right_shift), one);
+  const __m256i remainder = _mm256_and_si256(high, mask);
+  const __m256i threshold = _mm256_sub_epi32(_mm256_srli_epi32(mask, 1),
+                                             _mm256_cmpgt_epi32(zero, high));
+  return _mm256_sub_epi32(_mm256_srav_epi32(high, right_shift),
+                          _mm256_cmpgt_epi32(remainder, threshold));
+}
+
+// Computes one output row. kFilterHeight and kFilterWidth are the filter size
+// when it is known at compile time, in which case the taps are unrolled and
+// the filter of a channel block is kept in registers for the whole row, or 0
+// for any other size.
+template <int kFilterHeight, int kFilterWidth>
+TFLITE_TARGET_AVX2 void DepthwiseConvRowAvx2(const DepthwiseConvRow& row) {
+  const DepthwiseParams& params = *row.params;
+  const int filter_height =
+      kFilterHeight > 0 ? kFilterHeight : row.filter_height;
+  const int filter_width = kFilterWidth > 0 ? kFilterWidth : row.filter_width;
+  constexpr int kNumTaps =
+      kFilterHeight > 0 ? kFilterHeight * kFilterWidth : 1;
+  const int depth = row.depth;
+  const int in_y_origin =
+      row.out_y * params.stride_height - params.padding_values.height;
+  const __m128i input_offset =
+      _mm_set1_epi16(static_cast<int16_t>(params.input_offset));
+  const __m256i output_offset = _mm256_set1_epi32(params.output_offset);
+  const __m256i activation_min =
+      _mm256_set1_epi32(params.quantized_activation_min);
+  const __m256i activation_max =
+      _mm256_set1_epi32(params.quantized_activation_max);
+
+  int channel = 0;
+  for (; channel <= depth - kDepthwiseChannelBlock;
+       channel += kDepthwiseChannelBlock) {
+    __m128i filter[kNumTaps];
+    if (kFilterHeight > 0) {
+      for (int tap = 0; tap < kNumTaps; ++tap) {
+        filter[tap] =
+            LoadDepthwiseFilter(row.filter_data + tap * depth + channel);
+      }
+    }
+    const __m256i bias =
+        row.bias_data ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+                            row.bias_data + channel))
+                      : _mm256_setzero_si256();
+    const __m256i multiplier = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(row.output_multiplier + channel));
+    const __m256i shift = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(row.output_shift + channel));
+
+    for (int out_x = 0; out_x < row.output_width; ++out_x) {
+      const int in_x_origin =
+          out_x * params.stride_width - params.padding_values.width;
+      __m256i acc = bias;
+      for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+        const int in_y = in_y_origin + params.dilation_height_factor * filter_y;
+        if (in_y < 0 || in_y >= row.input_height) {
+          continue;
+        }
+        const int8_t* input_row =
+            row.input_data + in_y * row.input_width * depth + channel;
+        for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+          const int in_x =
+              in_x_origin + params.dilation_width_factor * filter_x;
+          if (in_x < 0 || in_x >= row.input_width) {
+            continue;
+          }
+          const int tap = filter_y * filter_width + filter_x;
+          const __m128i w = kFilterHeight > 0
+                                ? filter[tap]
+                                : LoadDepthwiseFilter(row.filter_data +
+                                                      tap * depth + channel);
+          acc = _mm256_add_epi32(
+              acc, _mm256_cvtepi16_epi32(DepthwiseTap(input_row + in_x * depth,
+                                                      w, input_offset)));
+        }
+      }
+      acc = MultiplyByQuantizedMultiplierAvx2(acc, multiplier, shift);
+      acc = _mm256_add_epi32(acc, output_offset);
+      acc = _mm256_max_epi32(acc, activation_min);
+      acc = _mm256_min_epi32(acc, activation_max);
+      const __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(acc),
+                                             _mm256_extracti128_si256(acc, 1));
+      _mm_storel_epi64(
+          reinterpret_cast<__m128i*>(row.output_data + out_x * depth + channel),
+          _mm_packs_epi16(packed, packed));
+    }
+  }
+  for (; channel < depth; ++channel) {
+    for (int out_x = 0; out_x < row.output_width; ++out_x) {
+      row.output_data[out_x * depth + channel] =
+          DepthwiseConvOutput(row, out_x, channel);
+    }
+  }
+}
+
+// Same as DepthwiseConvRowAvx2, but SSE4.1 has no per-lane shifts, so the
+// accumulators are requantized one channel at a time.
+template <int kFilterHeight, int kFilterWidth>
+TFLITE_TARGET_SSE41 void DepthwiseConvRowSse41(const DepthwiseConvRow& row) {
+  const DepthwiseParams& params = *row.params;
+  const int filter_height =
+      kFilterHeight > 0 ? kFilterHeight : row.filter_height;
+  const int filter_width = kFilterWidth > 0 ? kFilterWidth : row.filter_width;
+  constexpr int kNumTaps =
+      kFilterHeight > 0 ? kFilterHeight * kFilterWidth : 1;
+  const int depth = row.depth;
+  const int in_y_origin =
+      row.out_y * params.stride_height - params.padding_values.height;
+  const __m128i input_offset =
+      _mm_set1_epi16(static_cast<int16_t>(params.input_offset));
+
+  int channel = 0;
+  for (; channel <= depth - kDepthwiseChannelBlock;
+       channel += kDepthwiseChannelBlock) {
+    __m128i filter[kNumTaps];
+    if (kFilterHeight > 0) {
+      for (int tap = 0; tap < kNumTaps; ++tap) {
+        filter[tap] =
+            LoadDepthwiseFilter(row.filter_data + tap * depth + channel);
+      }
+    }
+
+    for (int out_x = 0; out_x < row.output_width; ++out_x) {
+      const int in_x_origin =
+          out_x * params.stride_width - params.padding_values.width;
+      __m128i acc_lo = _mm_setzero_si128();
+      __m128i acc_hi = _mm_setzero_si128();
+      for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+        const int in_y = in_y_origin + params.dilation_height_factor * filter_y;
+        if (in_y < 0 || in_y >= row.input_height) {
+          continue;
+        }
+        const int8_t* input_row =
+            row.input_data + in_y * row.input_width * depth + channel;
+        for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+          const int in_x =
+              in_x_origin + params.dilation_width_factor * filter_x;
+          if (in_x < 0 || in_x >= row.input_width) {
+            continue;
+          }
+          const int tap = filter_y * filter_width + filter_x;
+          const __m128i w = kFilterHeight > 0
+                                ? filter[tap]
+                                : LoadDepthwiseFilter(row.filter_data +
+                                                      tap * depth + channel);
+          const __m128i product =
+              DepthwiseTap(input_row + in_x * depth, w, input_offset);
+          acc_lo = _mm_add_epi32(acc_lo, _mm_cvtepi16_epi32(product));
+          acc_hi = _mm_add_epi32(
+              acc_hi, _mm_cvtepi16_epi32(_mm_unpackhi_epi64(product, product)));
+        }
+      }
+      int32_t acc[kDepthwiseChannelBlock];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(acc), acc_lo);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 4), acc_hi);
+      int8_t* output = row.output_data + out_x * depth + channel;
+      for (int i = 0; i < kDepthwiseChannelBlock; ++i) {
+        int32_t value = acc[i];
+        if (row.bias_data) {
+          value += row.bias_data[channel + i];
+        }
+        value = MultiplyByQuantizedMultiplier(
+            value, row.output_multiplier[channel + i],
+            row.output_shift[channel + i]);
+        value += params.output_offset;
+        value = std::max(value, params.quantized_activation_min);
+        value = std::min(value, params.quantized_activation_max);
+        output[i] = static_cast<int8_t>(value);
+      }
+    }
+  }
+  for (; channel < depth; ++channel) {
+    for (int out_x = 0; out_x < row.output_width; ++out_x) {
+      row.output_data[out_x * depth + channel] =
+          DepthwiseConvOutput(row, out_x, channel);
+    }
+  }
+}
+
+typedef void (*DepthwiseConvRowFn)(const DepthwiseConvRow&);
+
+// Returns the row kernel for a filter of |filter_height| x |filter_width|.
+inline DepthwiseConvRowFn GetDepthwiseConvRow(bool use_avx2, int filter_height,
+                                              int filter_width) {
+  if (filter_height == 3 && filter_width == 3) {
+    return use_avx2 ? DepthwiseConvRowAvx2<3, 3> : DepthwiseConvRowSse41<3, 3>;
+  }
+  return use_avx2 ? DepthwiseConvRowAvx2<0, 0> : DepthwiseConvRowSse41<0, 0>;
+}
+
+#endif  // TFLITE_X86_SIMD
+
+// Fixed-point per-channel-quantization depthwise convolution for x86 hosts,
+// for a depth multiplier of 1. Produces the same output as
+// reference_integer_ops::DepthwiseConvPerChannel. Channels are contiguous in
+// NHWC, so every filter tap is applied to eight channels at once; 3x3 filters
+// are unrolled and keep the filter in registers for a whole output row. Must
+// only be called when HasDepthwiseConvPerChannel() returns true.
+inline void DepthwiseConvPerChannel(
+    const DepthwiseParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const int8_t* filter_data, const RuntimeShape& bias_shape,
+    const int32_t* bias_data, const RuntimeShape& output_shape,
+    int8_t* output_data) {
+#ifdef TFLITE_X86_SIMD
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(params.depth_multiplier, 1);
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int depth = MatchingDim(input_shape, 3, output_shape, 3);
+  TFLITE_DCHECK_EQ(filter_shape.Dims(3), depth);
+  if (bias_data) {
+    TFLITE_DCHECK_EQ(bias_shape.FlatSize(), depth);
+  }
+
+  DepthwiseConvRow row;
+  row.params = &params;
+  row.output_multiplier = output_multiplier;
+  row.output_shift = output_shift;
+  row.input_height = input_shape.Dims(1);
+  row.input_width = input_shape.Dims(2);
+  row.depth = depth;
+  row.filter_data = filter_data;
+  row.filter_height = filter_shape.Dims(1);
+  row.filter_width = filter_shape.Dims(2);
+  row.bias_data = bias_data;
+  row.output_width = output_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const DepthwiseConvRowFn compute_row = GetDepthwiseConvRow(
+      TestCPUFeatureAvx2(), row.filter_height, row.filter_width);
+
+  for (int batch = 0; batch < batches; ++batch) {
+    row.input_data = input_data + batch * row.input_height * row.input_width *
+                                      depth;
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      row.out_y = out_y;
+      row.output_data =
+          output_data +
+          ((batch * output_height + out_y) * row.output_width) * depth;
+      compute_row(row);
+    }
+  }
+#else
+  TFLITE_DCHECK(false);
+#endif  // TFLITE_X86_SIMD
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_DEPTHWISE_CONV_H_
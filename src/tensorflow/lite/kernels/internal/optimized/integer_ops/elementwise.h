@@ -0,0 +1,394 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_ELEMENTWISE_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_ELEMENTWISE_H_
+
+#include <algorithm>
+#include <cstdint>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/cpu_check.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/add.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Returns true if host SIMD implementations of the int8 Add and Mul kernels
+// below are available on the running CPU. When this returns false, callers
+// should use the CMSIS-NN or reference kernels instead.
+inline bool HasElementwise() { return TestCPUFeatureAvx2(); }
+
+inline int8_t MulFunc(int8_t x, int8_t y, const ArithmeticParams& params) {
+  const int32_t input1_val = params.input1_offset + x;
+  const int32_t input2_val = params.input2_offset + y;
+  const int32_t unclamped_result =
+      params.output_offset +
+      MultiplyByQuantizedMultiplier(input1_val * input2_val,
+                                    params.output_multiplier,
+                                    params.output_shift);
+  const int32_t clamped_output =
+      std::min(params.quantized_activation_max,
+               std::max(params.quantized_activation_min, unclamped_result));
+  return static_cast<int8_t>(clamped_output);
+}
+
+#ifdef TFLITE_X86_SIMD
+
+// Every element needs up to three requantizations, each a 64-bit multiply per
+// lane, so these kernels are compute bound and use 256-bit vectors.
+
+// MultiplyByQuantizedMultiplier() of each int32 lane, for a positive
+// |multiplier| as produced by QuantizeMultiplier(). Such a multiplier cannot
+// saturate the doubling high multiply, whose rounding then comes down to
+// (x * multiplier + 2^30) >> 31.
+TFLITE_TARGET_AVX2 inline __m256i MultiplyByQuantizedMultiplierAvx2(
+    __m256i x, int32_t multiplier, int shift) {
+  const int left_shift = shift > 0 ? shift : 0;
+  const int right_shift = shift > 0 ? 0 : -shift;
+  x = _mm256_sll_epi32(x, _mm_cvtsi32_si128(left_shift));
+
+  const __m256i multiplier_vec = _mm256_set1_epi32(multiplier);
+  const __m256i nudge = _mm256_set1_epi64x(int64_t{1} << 30);
+  // Even lanes are multiplied in place, odd lanes after moving them down.
+  const __m256i even =
+      _mm256_add_epi64(_mm256_mul_epi32(x, multiplier_vec), nudge);
+  const __m256i odd = _mm256_add_epi64(
+      _mm256_mul_epi32(_mm256_srli_epi64(x, 32), multiplier_vec), nudge);
+  const __m256i high = _mm256_blend_epi32(_mm256_srli_epi64(even, 31),
+                                          _mm256_slli_epi64(odd, 1), 0xAA);
+  if (right_shift == 0) {
+    return high;
+  }
+
+  // RoundingDivideByPOT(): rounds half away from zero.
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i mask =
+      _mm256_set1_epi32(static_cast<int32_t>((int64_t{1} << right_shift) - 1));
+  const __m256i remainder = _mm256_and_si256(high, mask);
+  const __m256i threshold = _mm256_add_epi32(
+      _mm256_srai_epi32(mask, 1),
+      _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), high), one));
+  return _mm256_add_epi32(
+      _mm256_sra_epi32(high, _mm_cvtsi32_si128(right_shift)),
+      _mm256_and_si256(_mm256_cmpgt_epi32(remainder, threshold), one));
+}
+
+TFLITE_TARGET_AVX2 inline __m256i Load8x32(const int8_t* data) {
+  return _mm256_cvtepi8_epi32(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)));
+}
+
+// Adds the output offset, clamps to the activation range and stores 8 values.
+TFLITE_TARGET_AVX2 inline void StoreOutput8(__m256i values,
+                                            const ArithmeticParams& params,
+                                            int8_t* data) {
+  values = _mm256_add_epi32(values, _mm256_set1_epi32(params.output_offset));
+  values = _mm256_max_epi32(
+      values, _mm256_set1_epi32(params.quantized_activation_min));
+  values = _mm256_min_epi32(
+      values, _mm256_set1_epi32(params.quantized_activation_max));
+  const __m128i narrow16 = _mm_packs_epi32(_mm256_castsi256_si128(values),
+                                           _mm256_extracti128_si256(values, 1));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(data),
+                   _mm_packs_epi16(narrow16, narrow16));
+}
+
+// The input side of AddFunc(): offset, left shift and rescale.
+TFLITE_TARGET_AVX2 inline __m256i ScaleAddInputAvx2(__m256i values,
+                                                    int32_t offset,
+                                                    int left_shift,
+                                                    int32_t multiplier,
+                                                    int shift) {
+  values = _mm256_add_epi32(values, _mm256_set1_epi32(offset));
+  values = _mm256_sll_epi32(values, _mm_cvtsi32_si128(left_shift));
+  return MultiplyByQuantizedMultiplierAvx2(values, multiplier, shift);
+}
+
+// Vectorized part of AddElementwise(). Returns the number of values done.
+// Every block is loaded before it is stored, so |output_data| may be either
+// input.
+TFLITE_TARGET_AVX2 inline int AddElementwiseAvx2(int size,
+                                                 const ArithmeticParams& params,
+                                                 const int8_t* input1_data,
+                                                 const int8_t* input2_data,
+                                                 int8_t* output_data) {
+  int i = 0;
+  for (; i <= size - 8; i += 8) {
+    const __m256i input1 = ScaleAddInputAvx2(
+        Load8x32(input1_data + i), params.input1_offset, params.left_shift,
+        params.input1_multiplier, params.input1_shift);
+    const __m256i input2 = ScaleAddInputAvx2(
+        Load8x32(input2_data + i), params.input2_offset, params.left_shift,
+        params.input2_multiplier, params.input2_shift);
+    StoreOutput8(MultiplyByQuantizedMultiplierAvx2(
+                     _mm256_add_epi32(input1, input2),
+                     params.output_multiplier, params.output_shift),
+                 params, output_data + i);
+  }
+  return i;
+}
+
+// Vectorized part of AddScalarBroadcast(), with input 1 already scaled.
+TFLITE_TARGET_AVX2 inline int AddScalarBroadcastAvx2(
+    int size, const ArithmeticParams& params, int32_t scaled_input1,
+    const int8_t* input2_data, int8_t* output_data) {
+  const __m256i input1 = _mm256_set1_epi32(scaled_input1);
+  int i = 0;
+  for (; i <= size - 8; i += 8) {
+    const __m256i input2 = ScaleAddInputAvx2(
+        Load8x32(input2_data + i), params.input2_offset, params.left_shift,
+        params.input2_multiplier, params.input2_shift);
+    StoreOutput8(MultiplyByQuantizedMultiplierAvx2(
+                     _mm256_add_epi32(input1, input2),
+                     params.output_multiplier, params.output_shift),
+                 params, output_data + i);
+  }
+  return i;
+}
+
+// Vectorized part of MulElementwise(). The offset inputs fit in 9 bits, so
+// their product cannot overflow.
+TFLITE_TARGET_AVX2 inline int MulElementwiseAvx2(int size,
+                                                 const ArithmeticParams& params,
+                                                 const int8_t* input1_data,
+                                                 const int8_t* input2_data,
+                                                 int8_t* output_data) {
+  const __m256i input1_offset = _mm256_set1_epi32(params.input1_offset);
+  const __m256i input2_offset = _mm256_set1_epi32(params.input2_offset);
+  int i = 0;
+  for (; i <= size - 8; i += 8) {
+    const __m256i input1 =
+        _mm256_add_epi32(Load8x32(input1_data + i), input1_offset);
+    const __m256i input2 =
+        _mm256_add_epi32(Load8x32(input2_data + i), input2_offset);
+    StoreOutput8(MultiplyByQuantizedMultiplierAvx2(
+                     _mm256_mullo_epi32(input1, input2),
+                     params.output_multiplier, params.output_shift),
+                 params, output_data + i);
+  }
+  return i;
+}
+
+// Vectorized part of MulScalarBroadcast(), with the offset already added to
+// input 1.
+TFLITE_TARGET_AVX2 inline int MulScalarBroadcastAvx2(
+    int size, const ArithmeticParams& params, int32_t input1_val,
+    const int8_t* input2_data, int8_t* output_data) {
+  const __m256i input1 = _mm256_set1_epi32(input1_val);
+  const __m256i input2_offset = _mm256_set1_epi32(params.input2_offset);
+  int i = 0;
+  for (; i <= size - 8; i += 8) {
+    const __m256i input2 =
+        _mm256_add_epi32(Load8x32(input2_data + i), input2_offset);
+    StoreOutput8(MultiplyByQuantizedMultiplierAvx2(
+                     _mm256_mullo_epi32(input1, input2),
+                     params.output_multiplier, params.output_shift),
+                 params, output_data + i);
+  }
+  return i;
+}
+
+#endif  // TFLITE_X86_SIMD
+
+inline void AddElementwise(int size, const ArithmeticParams& params,
+                           const int8_t* input1_data, const int8_t* input2_data,
+                           int8_t* output_data) {
+  int i = 0;
+#ifdef TFLITE_X86_SIMD
+  i = AddElementwiseAvx2(size, params, input1_data, input2_data, output_data);
+#endif
+  for (; i < size; ++i) {
+    output_data[i] =
+        reference_integer_ops::AddFunc(input1_data[i], input2_data[i], params);
+  }
+}
+
+// Adds |input1| to each of the |size| values of |input2_data|.
+inline void AddScalarBroadcast(int size, const ArithmeticParams& params,
+                               int8_t input1, const int8_t* input2_data,
+                               int8_t* output_data) {
+  int i = 0;
+#ifdef TFLITE_X86_SIMD
+  const int32_t scaled_input1 = MultiplyByQuantizedMultiplierSmallerThanOneExp(
+      (params.input1_offset + input1) * (1 << params.left_shift),
+      params.input1_multiplier, params.input1_shift);
+  i = AddScalarBroadcastAvx2(size, params, scaled_input1, input2_data,
+                             output_data);
+#endif
+  for (; i < size; ++i) {
+    output_data[i] =
+        reference_integer_ops::AddFunc(input1, input2_data[i], params);
+  }
+}
+
+inline void MulElementwise(int size, const ArithmeticParams& params,
+                           const int8_t* input1_data, const int8_t* input2_data,
+                           int8_t* output_data) {
+  int i = 0;
+#ifdef TFLITE_X86_SIMD
+  i = MulElementwiseAvx2(size, params, input1_data, input2_data, output_data);
+#endif
+  for (; i < size; ++i) {
+    output_data[i] = MulFunc(input1_data[i], input2_data[i], params);
+  }
+}
+
+// Multiplies each of the |size| values of |input2_data| by |input1|.
+inline void MulScalarBroadcast(int size, const ArithmeticParams& params,
+                               int8_t input1, const int8_t* input2_data,
+                               int8_t* output_data) {
+  int i = 0;
+#ifdef TFLITE_X86_SIMD
+  i = MulScalarBroadcastAvx2(size, params, params.input1_offset + input1,
+                             input2_data, output_data);
+#endif
+  for (; i < size; ++i) {
+    output_data[i] = MulFunc(input1, input2_data[i], params);
+  }
+}
+
+typedef void (*ElementwiseFn)(int, const ArithmeticParams&, const int8_t*,
+                              const int8_t*, int8_t*);
+typedef void (*ScalarBroadcastFn)(int, const ArithmeticParams&, int8_t,
+                                  const int8_t*, int8_t*);
+
+// Walks the fivefold pattern that reference_ops::ProcessBroadcastShapes()
+// stored in |unswitched_params| and applies |elementwise| to every run of
+// values that both inputs have in common. When the innermost run is a single
+// value the pattern broadcasts one value of input 1 against a run of input 2
+// instead, which covers scalar and last-dimension broadcasts, and is what
+// |scalar_broadcast| does. The inputs and their parameters are swapped so that
+// input 1 is always the one that broadcasts, which requires the operation to
+// be commutative. Output values are written in order, each after the input
+// values it depends on were read, so |output_data| may alias an input that has
+// the output's shape.
+inline void BinaryBroadcastFiveFold(const ArithmeticParams& unswitched_params,
+                                    const int8_t* unswitched_input1_data,
+                                    const int8_t* unswitched_input2_data,
+                                    int8_t* output_data,
+                                    ElementwiseFn elementwise,
+                                    ScalarBroadcastFn scalar_broadcast) {
+  ArithmeticParams switched_params = unswitched_params;
+  switched_params.input1_offset = unswitched_params.input2_offset;
+  switched_params.input1_multiplier = unswitched_params.input2_multiplier;
+  switched_params.input1_shift = unswitched_params.input2_shift;
+  switched_params.input2_offset = unswitched_params.input1_offset;
+  switched_params.input2_multiplier = unswitched_params.input1_multiplier;
+  switched_params.input2_shift = unswitched_params.input1_shift;
+
+  const bool use_unswitched =
+      unswitched_params.broadcast_category ==
+      BroadcastableOpCategory::kFirstInputBroadcastsFast;
+  const ArithmeticParams& params =
+      use_unswitched ? unswitched_params : switched_params;
+  const int8_t* input1_data =
+      use_unswitched ? unswitched_input1_data : unswitched_input2_data;
+  const int8_t* input2_data =
+      use_unswitched ? unswitched_input2_data : unswitched_input1_data;
+
+  // Input 1 holds y0 * y1 * y2 * y4 values and input 2 y0 * y2 * y3 * y4.
+  // Input 2 restarts for every step of y1, input 1 is reused for every step
+  // of y3.
+  const int y0 = params.broadcast_shape[0];
+  const int y1 = params.broadcast_shape[1];
+  const int y2 = params.broadcast_shape[2];
+  const int y3 = params.broadcast_shape[3];
+  const int y4 = params.broadcast_shape[4];
+  int8_t* output_ptr = output_data;
+  const int8_t* input1_ptr = input1_data;
+  const int8_t* input2_reset = input2_data;
+  for (int i0 = 0; i0 < y0; ++i0) {
+    const int8_t* input2_ptr = input2_reset;
+    for (int i1 = 0; i1 < y1; ++i1) {
+      input2_ptr = input2_reset;
+      for (int i2 = 0; i2 < y2; ++i2) {
+        if (y4 > 1) {
+          for (int i3 = 0; i3 < y3; ++i3) {
+            elementwise(y4, params, input1_ptr, input2_ptr, output_ptr);
+            input2_ptr += y4;
+            output_ptr += y4;
+          }
+          input1_ptr += y4;
+        } else {
+          scalar_broadcast(y3, params, *input1_ptr, input2_ptr, output_ptr);
+          input2_ptr += y3;
+          output_ptr += y3;
+          input1_ptr += 1;
+        }
+      }
+    }
+    input2_reset = input2_ptr;
+  }
+}
+
+// Int8 Add for x86 hosts. Produces the same output as
+// reference_integer_ops::Add. Must only be called when HasElementwise()
+// returns true.
+inline void Add(const ArithmeticParams& params,
+                const RuntimeShape& input1_shape, const int8_t* input1_data,
+                const RuntimeShape& input2_shape, const int8_t* input2_data,
+                const RuntimeShape& output_shape, int8_t* output_data) {
+  reference_integer_ops::CheckArithmeticParams(params);
+  AddElementwise(MatchingElementsSize(input1_shape, input2_shape, output_shape),
+                 params, input1_data, input2_data, output_data);
+}
+
+// Int8 broadcast Add for x86 hosts, for shapes that
+// reference_ops::ProcessBroadcastShapes() put in one of the fivefold
+// categories. Produces the same output as
+// reference_integer_ops::BroadcastAdd4DSlow. Must only be called when
+// HasElementwise() returns true.
+inline void BroadcastAddFivefold(const ArithmeticParams& params,
+                                 const int8_t* input1_data,
+                                 const int8_t* input2_data,
+                                 int8_t* output_data) {
+  reference_integer_ops::CheckArithmeticParams(params);
+  BinaryBroadcastFiveFold(params, input1_data, input2_data, output_data,
+                          AddElementwise, AddScalarBroadcast);
+}
+
+// Int8 Mul for x86 hosts. Produces the same output as
+// reference_integer_ops::Mul. Must only be called when HasElementwise()
+// returns true.
+inline void Mul(const ArithmeticParams& params,
+                const RuntimeShape& input1_shape, const int8_t* input1_data,
+                const RuntimeShape& input2_shape, const int8_t* input2_data,
+                const RuntimeShape& output_shape, int8_t* output_data) {
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  MulElementwise(MatchingElementsSize(input1_shape, input2_shape, output_shape),
+                 params, input1_data, input2_data, output_data);
+}
+
+// Int8 broadcast Mul for x86 hosts, for shapes that
+// reference_ops::ProcessBroadcastShapes() put in one of the fivefold
+// categories. Produces the same output as
+// reference_integer_ops::BroadcastMul4DSlow. Must only be called when
+// HasElementwise() returns true.
+inline void BroadcastMulFivefold(const ArithmeticParams& params,
+                                 const int8_t* input1_data,
+                                 const int8_t* input2_data,
+                                 int8_t* output_data) {
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  BinaryBroadcastFiveFold(params, input1_data, input2_data, output_data,
+                          MulElementwise, MulScalarBroadcast);
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_ELEMENTWISE_H_
@@ -0,0 +1,251 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_FULLY_CONNECTED_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_FULLY_CONNECTED_H_
+
+#include <algorithm>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/cpu_check.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/packed_weights.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Returns true if a host SIMD implementation of FullyConnected is available on
+// the running CPU. When this returns false, callers should use the CMSIS-NN or
+// reference kernels instead.
+inline bool HasFullyConnected() {
+  return TestCPUFeatureAvx2() || TestCPUFeatureSse41();
+}
+
+#ifdef TFLITE_X86_SIMD
+
+// Number of batches that share one load of a filter row.
+constexpr int kFullyConnectedBatchBlock = 4;
+
+// Computes the dot products of one int8 filter row with kRows consecutive int8
+// input rows of |depth| elements each, with both offsets applied. Operands are
+// widened to int16 before the madd, so the result is exact as long as the
+// reference kernel's int32 accumulator does not overflow either.
+template <int kRows>
+TFLITE_TARGET_AVX2 inline void RowDotAvx2(const int8_t* filter,
+                                          const int8_t* input, int depth,
+                                          int32_t input_offset,
+                                          int32_t filter_offset,
+                                          int32_t* acc) {
+  const __m256i input_offset_vec =
+      _mm256_set1_epi16(static_cast<int16_t>(input_offset));
+  const __m256i filter_offset_vec =
+      _mm256_set1_epi16(static_cast<int16_t>(filter_offset));
+  __m256i sums[kRows];
+  for (int r = 0; r < kRows; ++r) {
+    sums[r] = _mm256_setzero_si256();
+  }
+  int i = 0;
+  for (; i <= depth - 16; i += 16) {
+    const __m256i w = _mm256_add_epi16(
+        _mm256_cvtepi8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(filter + i))),
+        filter_offset_vec);
+    for (int r = 0; r < kRows; ++r) {
+      const __m256i x = _mm256_add_epi16(
+          _mm256_cvtepi8_epi16(_mm_loadu_si128(
+              reinterpret_cast<const __m128i*>(input + r * depth + i))),
+          input_offset_vec);
+      sums[r] = _mm256_add_epi32(sums[r], _mm256_madd_epi16(w, x));
+    }
+  }
+  for (int r = 0; r < kRows; ++r) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sums[r]),
+                                _mm256_extracti128_si256(sums[r], 1));
+    sum = _mm_hadd_epi32(sum, sum);
+    sum = _mm_hadd_epi32(sum, sum);
+    int32_t result = _mm_cvtsi128_si32(sum);
+    const int8_t* x = input + r * depth;
+    for (int j = i; j < depth; ++j) {
+      result += (filter[j] + filter_offset) * (x[j] + input_offset);
+    }
+    acc[r] = result;
+  }
+}
+
+template <int kRows>
+TFLITE_TARGET_SSE41 inline void RowDotSse41(const int8_t* filter,
+                                            const int8_t* input, int depth,
+                                            int32_t input_offset,
+                                            int32_t filter_offset,
+                                            int32_t* acc) {
+  const __m128i input_offset_vec =
+      _mm_set1_epi16(static_cast<int16_t>(input_offset));
+  const __m128i filter_offset_vec =
+      _mm_set1_epi16(static_cast<int16_t>(filter_offset));
+  __m128i sums[kRows];
+  for (int r = 0; r < kRows; ++r) {
+    sums[r] = _mm_setzero_si128();
+  }
+  int i = 0;
+  for (; i <= depth - 8; i += 8) {
+    const __m128i w = _mm_add_epi16(
+        _mm_cvtepi8_epi16(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(filter + i))),
+        filter_offset_vec);
+    for (int r = 0; r < kRows; ++r) {
+      const __m128i x = _mm_add_epi16(
+          _mm_cvtepi8_epi16(_mm_loadl_epi64(
+              reinterpret_cast<const __m128i*>(input + r * depth + i))),
+          input_offset_vec);
+      sums[r] = _mm_add_epi32(sums[r], _mm_madd_epi16(w, x));
+    }
+  }
+  for (int r = 0; r < kRows; ++r) {
+    __m128i sum = _mm_hadd_epi32(sums[r], sums[r]);
+    sum = _mm_hadd_epi32(sum, sum);
+    int32_t result = _mm_cvtsi128_si32(sum);
+    const int8_t* x = input + r * depth;
+    for (int j = i; j < depth; ++j) {
+      result += (filter[j] + filter_offset) * (x[j] + input_offset);
+    }
+    acc[r] = result;
+  }
+}
+
+typedef void (*RowDotFn)(const int8_t*, const int8_t*, int, int32_t, int32_t,
+                         int32_t*);
+
+// Returns the row dot product kernel for |rows| in [1, 4] input rows.
+inline RowDotFn GetRowDot(bool use_avx2, int rows) {
+  switch (rows) {
+    case 1:
+      return use_avx2 ? RowDotAvx2<1> : RowDotSse41<1>;
+    case 2:
+      return use_avx2 ? RowDotAvx2<2> : RowDotSse41<2>;
+    case 3:
+      return use_avx2 ? RowDotAvx2<3> : RowDotSse41<3>;
+    default:
+      return use_avx2 ? RowDotAvx2<4> : RowDotSse41<4>;
+  }
+}
+
+#endif  // TFLITE_X86_SIMD
+
+// Int8 fully connected layer for x86 hosts. Produces the same output as
+// reference_integer_ops::FullyConnected. Filter rows are the outer loop and
+// every row is applied to all batches, kFullyConnectedBatchBlock at a time,
+// before moving on, so the weights are read from memory once per call rather
+// than once per batch. Must only be called when HasFullyConnected() returns
+// true.
+inline void FullyConnected(
+    const FullyConnectedParams& params, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const int8_t* filter_data, const RuntimeShape& bias_shape,
+    const int32_t* bias_data, const RuntimeShape& output_shape,
+    int8_t* output_data) {
+#ifdef TFLITE_X86_SIMD
+  TFLITE_DCHECK_GE(filter_shape.DimensionsCount(), 2);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 2);
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  const int filter_dim_count = filter_shape.DimensionsCount();
+  const int batches = output_shape.Dims(0);
+  const int output_depth = output_shape.Dims(1);
+  TFLITE_DCHECK_LE(output_depth, filter_shape.Dims(filter_dim_count - 2));
+  const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
+
+  const bool use_avx2 = TestCPUFeatureAvx2();
+  const RowDotFn block_dot = GetRowDot(use_avx2, kFullyConnectedBatchBlock);
+  const RowDotFn tail_dot =
+      GetRowDot(use_avx2, batches % kFullyConnectedBatchBlock);
+
+  int32_t acc[kFullyConnectedBatchBlock];
+  for (int out_c = 0; out_c < output_depth; ++out_c) {
+    const int8_t* filter = filter_data + out_c * accum_depth;
+    const int32_t bias = bias_data ? bias_data[out_c] : 0;
+    for (int batch = 0; batch < batches; batch += kFullyConnectedBatchBlock) {
+      const int rows = std::min(kFullyConnectedBatchBlock, batches - batch);
+      (rows == kFullyConnectedBatchBlock ? block_dot : tail_dot)(
+          filter, input_data + batch * accum_depth, accum_depth,
+          params.input_offset, params.weights_offset, acc);
+      for (int r = 0; r < rows; ++r) {
+        int32_t value = MultiplyByQuantizedMultiplier(
+            acc[r] + bias, params.output_multiplier, params.output_shift);
+        value += params.output_offset;
+        value = std::max(value, params.quantized_activation_min);
+        value = std::min(value, params.quantized_activation_max);
+        output_data[(batch + r) * output_depth + out_c] =
+            static_cast<int8_t>(value);
+      }
+    }
+  }
+#else
+  TFLITE_DCHECK(false);
+#endif  // TFLITE_X86_SIMD
+}
+
+// Int8 fully connected layer on weights prepared with PackWeights() and a bias
+// prepared with FoldInputOffsetIntoBias(). Produces the same output as
+// reference_integer_ops::FullyConnected for output units [row_start, row_end),
+// where |row_start| must be a multiple of kPackedBlockRows. Every block of the
+// packed filter is applied to two samples at a time. Must only be called when
+// HasPackedWeights() returns true.
+inline void FullyConnectedPacked(const FullyConnectedParams& params,
+                                 const int8_t* packed_filter,
+                                 const int32_t* folded_bias,
+                                 const int8_t* input_data, int batches,
+                                 int accum_depth, int output_depth,
+                                 int row_start, int row_end,
+                                 int8_t* output_data) {
+#ifdef TFLITE_X86_SIMD
+  TFLITE_DCHECK_EQ(row_start % kPackedBlockRows, 0);
+  TFLITE_DCHECK_EQ(params.weights_offset, 0);
+  const bool use_avx2 = TestCPUFeatureAvx2();
+  const PackedDotFn dot1 = GetPackedDot(use_avx2, 1);
+  const PackedDotFn dot2 = GetPackedDot(use_avx2, 2);
+  const int block_size = kPackedBlockRows * PackedDepth(accum_depth);
+
+  int32_t acc[2 * kPackedBlockRows];
+  for (int row = row_start; row < row_end; row += kPackedBlockRows) {
+    const int8_t* block = packed_filter + row / kPackedBlockRows * block_size;
+    const int rows = std::min(kPackedBlockRows, row_end - row);
+    for (int batch = 0; batch < batches; batch += 2) {
+      const int columns = std::min(2, batches - batch);
+      const int8_t* inputs[2] = {
+          input_data + batch * accum_depth,
+          input_data + (batch + columns - 1) * accum_depth};
+      (columns == 2 ? dot2 : dot1)(block, inputs, accum_depth, acc);
+      for (int c = 0; c < columns; ++c) {
+        int8_t* output = output_data + (batch + c) * output_depth + row;
+        for (int r = 0; r < rows; ++r) {
+          int32_t value = MultiplyByQuantizedMultiplier(
+              acc[c * kPackedBlockRows + r] + folded_bias[row + r],
+              params.output_multiplier, params.output_shift);
+          value += params.output_offset;
+          value = std::max(value, params.quantized_activation_min);
+          value = std::min(value, params.quantized_activation_max);
+          output[r] = static_cast<int8_t>(value);
+        }
+      }
+    }
+  }
+#else
+  TFLITE_DCHECK(false);
+#endif  // TFLITE_X86_SIMD
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_FULLY_CONNECTED_H_
@@ -0,0 +1,210 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_PACKED_WEIGHTS_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_PACKED_WEIGHTS_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include "tensorflow/lite/kernels/internal/optimized/cpu_check.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Int8 weight matrices of |rows| x |depth| (output channels x accumulation
+// depth) can be repacked once into blocks of kPackedBlockRows rows. Within a
+// block, the rows are interleaved in chunks of kPackedBlockDepth values, so a
+// dot product kernel reads the block front to back with one load per row and
+// chunk. Rows and depth are zero padded to whole blocks and chunks, which
+// removes the scalar tail loops from the kernels.
+constexpr int kPackedBlockRows = 4;
+constexpr int kPackedBlockDepth = 16;
+
+// Returns true if the kernels consuming packed weights can run on this CPU.
+// When this returns false, there is no point in packing.
+inline bool HasPackedWeights() {
+  return TestCPUFeatureAvx2() || TestCPUFeatureSse41();
+}
+
+// Depth of |depth| rounded up to whole chunks.
+inline int PackedDepth(int depth) {
+  return (depth + kPackedBlockDepth - 1) / kPackedBlockDepth *
+         kPackedBlockDepth;
+}
+
+// Size in bytes of the packed form of a |rows| x |depth| weight matrix.
+inline int PackedWeightsSize(int rows, int depth) {
+  const int packed_rows =
+      (rows + kPackedBlockRows - 1) / kPackedBlockRows * kPackedBlockRows;
+  return packed_rows * PackedDepth(depth);
+}
+
+// Writes the packed form of the row major |rows| x |depth| matrix |weights|
+// to |packed|, which must hold PackedWeightsSize(rows, depth) bytes.
+inline void PackWeights(const int8_t* weights, int rows, int depth,
+                        int8_t* packed) {
+  const int packed_depth = PackedDepth(depth);
+  for (int row_block = 0; row_block < rows; row_block += kPackedBlockRows) {
+    for (int chunk = 0; chunk < packed_depth; chunk += kPackedBlockDepth) {
+      for (int r = 0; r < kPackedBlockRows; ++r) {
+        const int row = row_block + r;
+        for (int i = 0; i < kPackedBlockDepth; ++i) {
+          const int col = chunk + i;
+          *packed++ =
+              (row < rows && col < depth) ? weights[row * depth + col] : 0;
+        }
+      }
+    }
+  }
+}
+
+// Folds the input offset into the bias, so that the kernels can take the dot
+// products of the weights with the raw input values:
+//   sum(w * (x + input_offset)) + bias
+//       == sum(w * x) + (bias + input_offset * sum(w)).
+// Only valid for weights with a zero point of 0. |bias| may be null.
+inline void FoldInputOffsetIntoBias(const int8_t* weights, int rows, int depth,
+                                    const int32_t* bias, int32_t input_offset,
+                                    int32_t* folded_bias) {
+  for (int row = 0; row < rows; ++row) {
+    int32_t sum = 0;
+    for (int i = 0; i < depth; ++i) {
+      sum += weights[row * depth + i];
+    }
+    folded_bias[row] = (bias ? bias[row] : 0) + input_offset * sum;
+  }
+}
+
+#ifdef TFLITE_X86_SIMD
+
+// Computes the dot products of one packed block with kColumns int8 columns of
+// |depth| values each. |acc| receives the kPackedBlockRows results of the
+// first column, followed by those of the next one. A partial last chunk is
+// copied out so that no column is read past its end.
+template <int kColumns>
+TFLITE_TARGET_AVX2 inline void PackedDotAvx2(const int8_t* block,
+                                             const int8_t* const* columns,
+                                             int depth, int32_t* acc) {
+  __m256i sums[kColumns][kPackedBlockRows];
+  for (int c = 0; c < kColumns; ++c) {
+    for (int r = 0; r < kPackedBlockRows; ++r) {
+      sums[c][r] = _mm256_setzero_si256();
+    }
+  }
+  int8_t tail[kColumns][kPackedBlockDepth];
+  const int8_t* x[kColumns];
+  const int full_depth = depth - depth % kPackedBlockDepth;
+  for (int i = 0; i < depth; i += kPackedBlockDepth) {
+    for (int c = 0; c < kColumns; ++c) {
+      if (i < full_depth) {
+        x[c] = columns[c] + i;
+      } else {
+        std::memset(tail[c], 0, kPackedBlockDepth);
+        std::memcpy(tail[c], columns[c] + i, depth - i);
+        x[c] = tail[c];
+      }
+    }
+    __m256i w[kPackedBlockRows];
+    for (int r = 0; r < kPackedBlockRows; ++r) {
+      w[r] = _mm256_cvtepi8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(block)));
+      block += kPackedBlockDepth;
+    }
+    for (int c = 0; c < kColumns; ++c) {
+      const __m256i v = _mm256_cvtepi8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(x[c])));
+      for (int r = 0; r < kPackedBlockRows; ++r) {
+        sums[c][r] = _mm256_add_epi32(sums[c][r], _mm256_madd_epi16(w[r], v));
+      }
+    }
+  }
+  for (int c = 0; c < kColumns; ++c) {
+    const __m256i sum =
+        _mm256_hadd_epi32(_mm256_hadd_epi32(sums[c][0], sums[c][1]),
+                          _mm256_hadd_epi32(sums[c][2], sums[c][3]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + c * kPackedBlockRows),
+                     _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                   _mm256_extracti128_si256(sum, 1)));
+  }
+}
+
+template <int kColumns>
+TFLITE_TARGET_SSE41 inline void PackedDotSse41(const int8_t* block,
+                                               const int8_t* const* columns,
+                                               int depth, int32_t* acc) {
+  __m128i sums[kColumns][kPackedBlockRows];
+  for (int c = 0; c < kColumns; ++c) {
+    for (int r = 0; r < kPackedBlockRows; ++r) {
+      sums[c][r] = _mm_setzero_si128();
+    }
+  }
+  int8_t tail[kColumns][kPackedBlockDepth];
+  const int8_t* x[kColumns];
+  const int full_depth = depth - depth % kPackedBlockDepth;
+  for (int i = 0; i < depth; i += kPackedBlockDepth) {
+    for (int c = 0; c < kColumns; ++c) {
+      if (i < full_depth) {
+        x[c] = columns[c] + i;
+      } else {
+        std::memset(tail[c], 0, kPackedBlockDepth);
+        std::memcpy(tail[c], columns[c] + i, depth - i);
+        x[c] = tail[c];
+      }
+    }
+    __m128i w_lo[kPackedBlockRows];
+    __m128i w_hi[kPackedBlockRows];
+    for (int r = 0; r < kPackedBlockRows; ++r) {
+      const __m128i w =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+      w_lo[r] = _mm_cvtepi8_epi16(w);
+      w_hi[r] = _mm_cvtepi8_epi16(_mm_srli_si128(w, 8));
+      block += kPackedBlockDepth;
+    }
+    for (int c = 0; c < kColumns; ++c) {
+      const __m128i v =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(x[c]));
+      const __m128i v_lo = _mm_cvtepi8_epi16(v);
+      const __m128i v_hi = _mm_cvtepi8_epi16(_mm_srli_si128(v, 8));
+      for (int r = 0; r < kPackedBlockRows; ++r) {
+        sums[c][r] = _mm_add_epi32(
+            sums[c][r], _mm_add_epi32(_mm_madd_epi16(w_lo[r], v_lo),
+                                      _mm_madd_epi16(w_hi[r], v_hi)));
+      }
+    }
+  }
+  for (int c = 0; c < kColumns; ++c) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + c * kPackedBlockRows),
+                     _mm_hadd_epi32(_mm_hadd_epi32(sums[c][0], sums[c][1]),
+                                    _mm_hadd_epi32(sums[c][2], sums[c][3])));
+  }
+}
+
+typedef void (*PackedDotFn)(const int8_t*, const int8_t* const*, int,
+                            int32_t*);
+
+// Returns the packed dot product kernel for one or two columns.
+inline PackedDotFn GetPackedDot(bool use_avx2, int columns) {
+  if (columns == 1) {
+    return use_avx2 ? PackedDotAvx2<1> : PackedDotSse41<1>;
+  }
+  return use_avx2 ? PackedDotAvx2<2> : PackedDotSse41<2>;
+}
+
+#endif  // TFLITE_X86_SIMD
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_PACKED_WEIGHTS_H_
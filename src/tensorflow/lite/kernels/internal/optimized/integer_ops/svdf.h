@@ -0,0 +1,188 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_SVDF_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_SVDF_H_
+
+#include <algorithm>
+#include <cstdint>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/cpu_check.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/fully_connected.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Quantization parameters of an int8 SVDF layer with int16 state.
+struct SvdfParams {
+  int32_t input_zero_point;
+  // Requantizes the feature dot products into the state.
+  int32_t feature_multiplier;
+  int feature_shift;
+  // Requantizes the time dot products, summed over the rank, into the output.
+  int32_t output_multiplier;
+  int output_shift;
+  int32_t output_zero_point;
+  int rank;
+};
+
+// Returns true if a host SIMD implementation of Svdf is available on the
+// running CPU. When this returns false, callers should use the CMSIS-NN or
+// reference kernels instead.
+inline bool HasSvdf() { return TestCPUFeatureAvx2() || TestCPUFeatureSse41(); }
+
+#ifdef TFLITE_X86_SIMD
+
+TFLITE_TARGET_AVX2 inline int32_t DotInt16Avx2(const int16_t* a,
+                                               const int16_t* b, int size) {
+  __m256i sum = _mm256_setzero_si256();
+  int i = 0;
+  for (; i <= size - 16; i += 16) {
+    sum = _mm256_add_epi32(
+        sum, _mm256_madd_epi16(
+                 _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                 _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i))));
+  }
+  __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                 _mm256_extracti128_si256(sum, 1));
+  if (i <= size - 8) {
+    sum128 = _mm_add_epi32(
+        sum128, _mm_madd_epi16(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+    i += 8;
+  }
+  sum128 = _mm_hadd_epi32(sum128, sum128);
+  sum128 = _mm_hadd_epi32(sum128, sum128);
+  int32_t result = _mm_cvtsi128_si32(sum128);
+  for (; i < size; ++i) {
+    result += a[i] * b[i];
+  }
+  return result;
+}
+
+TFLITE_TARGET_SSE41 inline int32_t DotInt16Sse41(const int16_t* a,
+                                                 const int16_t* b, int size) {
+  __m128i sum = _mm_setzero_si128();
+  int i = 0;
+  for (; i <= size - 8; i += 8) {
+    sum = _mm_add_epi32(
+        sum, _mm_madd_epi16(
+                 _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                 _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+  }
+  sum = _mm_hadd_epi32(sum, sum);
+  sum = _mm_hadd_epi32(sum, sum);
+  int32_t result = _mm_cvtsi128_si32(sum);
+  for (; i < size; ++i) {
+    result += a[i] * b[i];
+  }
+  return result;
+}
+
+typedef int32_t (*DotInt16Fn)(const int16_t*, const int16_t*, int);
+
+#endif  // TFLITE_X86_SIMD
+
+// Int8 SVDF step for x86 hosts. Produces the same output and state as the
+// reference kernel, where every row of |state| holds the last |memory_size|
+// feature activations of one filter and one batch, oldest first.
+//
+// Here the rows are rings instead: slot |head| of every row holds the oldest
+// value on entry and receives this step's activation, so the oldest value on
+// return is the one after it. Passing memory_size - 1 after shifting the rows
+// left by one gives the reference layout, and passing an index that advances
+// by one per call avoids the shift altogether.
+//
+// The feature and time dot products are fused: each new activation is
+// requantized into the state and immediately reduced against its time
+// weights, and the rank sums are requantized into the output as soon as a
+// unit is complete, so no scratch memory is needed. Every weights_feature row
+// is applied to kFullyConnectedBatchBlock batches per load. Must only be
+// called when HasSvdf() returns true.
+inline void Svdf(const SvdfParams& params, int batch_size, int input_size,
+                 int num_filters, int memory_size, const int8_t* input_data,
+                 const int8_t* weights_feature_data,
+                 const int16_t* weights_time_data, const int32_t* bias_data,
+                 int head, int16_t* state_data, int8_t* output_data) {
+#ifdef TFLITE_X86_SIMD
+  TFLITE_DCHECK_GE(head, 0);
+  TFLITE_DCHECK_LT(head, memory_size);
+  TFLITE_DCHECK_EQ(num_filters % params.rank, 0);
+  const int num_units = num_filters / params.rank;
+
+  const bool use_avx2 = TestCPUFeatureAvx2();
+  const RowDotFn block_dot = GetRowDot(use_avx2, kFullyConnectedBatchBlock);
+  const RowDotFn tail_dot =
+      GetRowDot(use_avx2, batch_size % kFullyConnectedBatchBlock);
+  const DotInt16Fn time_dot = use_avx2 ? DotInt16Avx2 : DotInt16Sse41;
+
+  // In logical order the row continues after |head| with the values that
+  // were already there and wraps around to end with the new one, so the time
+  // weights are split into two contiguous runs.
+  const int older_size = memory_size - 1 - head;
+
+  int32_t acc[kFullyConnectedBatchBlock];
+  int32_t unit_sum[kFullyConnectedBatchBlock];
+  for (int batch = 0; batch < batch_size; batch += kFullyConnectedBatchBlock) {
+    const int rows = std::min(kFullyConnectedBatchBlock, batch_size - batch);
+    for (int r = 0; r < rows; ++r) {
+      unit_sum[r] = 0;
+    }
+    for (int f = 0; f < num_filters; ++f) {
+      (rows == kFullyConnectedBatchBlock ? block_dot : tail_dot)(
+          weights_feature_data + f * input_size,
+          input_data + batch * input_size, input_size,
+          -params.input_zero_point, 0, acc);
+      const int16_t* weights_time = weights_time_data + f * memory_size;
+      for (int r = 0; r < rows; ++r) {
+        int16_t* state =
+            state_data + ((batch + r) * num_filters + f) * memory_size;
+        int32_t activation = MultiplyByQuantizedMultiplier(
+            acc[r], params.feature_multiplier, params.feature_shift);
+        activation = std::max<int32_t>(activation, INT16_MIN);
+        activation = std::min<int32_t>(activation, INT16_MAX);
+        state[head] = static_cast<int16_t>(activation);
+        if (older_size > 0) {
+          unit_sum[r] += time_dot(weights_time, state + head + 1, older_size);
+        }
+        unit_sum[r] += time_dot(weights_time + older_size, state, head + 1);
+      }
+      if (f % params.rank != params.rank - 1) {
+        continue;
+      }
+      const int unit = f / params.rank;
+      const int32_t bias = bias_data ? bias_data[unit] : 0;
+      for (int r = 0; r < rows; ++r) {
+        int32_t value = MultiplyByQuantizedMultiplier(
+            unit_sum[r] + bias, params.output_multiplier, params.output_shift);
+        value += params.output_zero_point;
+        value = std::max<int32_t>(value, INT8_MIN);
+        value = std::min<int32_t>(value, INT8_MAX);
+        output_data[(batch + r) * num_units + unit] =
+            static_cast<int8_t>(value);
+        unit_sum[r] = 0;
+      }
+    }
+  }
+#else
+  TFLITE_DCHECK(false);
+#endif  // TFLITE_X86_SIMD
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_SVDF_H_
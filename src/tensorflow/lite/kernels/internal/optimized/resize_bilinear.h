@@ -0,0 +1,324 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_RESIZE_BILINEAR_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_RESIZE_BILINEAR_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/cpu_check.h"
+#include "tensorflow/lite/kernels/internal/reference/resize_bilinear.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace optimized_ops {
+
+// Interpolation between two input rows (or columns) for one output row (or
+// column). Taps only depend on the shapes and the params, so kernels compute
+// them once in Prepare rather than for every pixel.
+struct ResizeBilinearTap {
+  int32_t lower;
+  int32_t upper;
+  // Weight of |upper|, the weight of |lower| being one minus it. Integer data
+  // uses |fixed_weight| in Q10, float data uses |float_weight|.
+  int32_t fixed_weight;
+  float float_weight;
+};
+
+// Fills |taps| with the interpolation of each of the |output_size| outputs
+// along one dimension, matching reference_ops::ResizeBilinearInteger when
+// |integer| is true and reference_ops::ResizeBilinear otherwise.
+inline void ComputeResizeBilinearTaps(const ResizeBilinearParams& params,
+                                      int32_t input_size, int32_t output_size,
+                                      bool integer, ResizeBilinearTap* taps) {
+  const int32_t scale_10 = reference_ops::ResizeBilinearScaleInteger(
+      params.align_corners, input_size, output_size);
+  const float scale = reference_ops::ResizeBilinearScale(
+      params.align_corners, input_size, output_size);
+  for (int32_t i = 0; i < output_size; ++i) {
+    ResizeBilinearTap& tap = taps[i];
+    tap.fixed_weight = 0;
+    tap.float_weight = 0.0f;
+    if (integer) {
+      int32_t scaled;
+      reference_ops::ComputeInterpolationValuesInteger(
+          i, scale_10, params.half_pixel_centers, input_size, &scaled,
+          &tap.lower, &tap.upper);
+      tap.fixed_weight = scaled - (1 << 10) * tap.lower;
+    } else {
+      float scaled;
+      reference_ops::ComputeInterpolationValues(
+          i, scale, params.half_pixel_centers, input_size, &scaled, &tap.lower,
+          &tap.upper);
+      tap.float_weight = scaled - tap.lower;
+    }
+    // Half pixel centers can put the first output before the first input.
+    // Both weights then apply to the same input, so give it all to |lower|.
+    if (tap.lower == tap.upper) {
+      tap.fixed_weight = 0;
+      tap.float_weight = 0.0f;
+    }
+  }
+}
+
+#ifdef TFLITE_X86_SIMD
+
+// Each pass below streams through its rows once with plain loads and stores,
+// so 128-bit vectors are enough to keep up with memory.
+
+// Loads 8 values widened to int16.
+TFLITE_TARGET_SSE41 inline __m128i Load8x16(const int8_t* data) {
+  return _mm_cvtepi8_epi16(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)));
+}
+
+TFLITE_TARGET_SSE41 inline __m128i Load8x16(const uint8_t* data) {
+  return _mm_cvtepu8_epi16(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)));
+}
+
+// Stores 4 int32 values, which must be in range, narrowed to 8 bits.
+TFLITE_TARGET_SSE41 inline void Store4x8(__m128i values, int8_t* data) {
+  const __m128i narrow = _mm_packs_epi16(_mm_packs_epi32(values, values),
+                                         _mm_setzero_si128());
+  const int32_t packed = _mm_cvtsi128_si32(narrow);
+  std::memcpy(data, &packed, sizeof(packed));
+}
+
+TFLITE_TARGET_SSE41 inline void Store4x8(__m128i values, uint8_t* data) {
+  const __m128i narrow = _mm_packus_epi16(_mm_packs_epi32(values, values),
+                                          _mm_setzero_si128());
+  const int32_t packed = _mm_cvtsi128_si32(narrow);
+  std::memcpy(data, &packed, sizeof(packed));
+}
+
+// Vectorized part of BlendRows() for integer data. Returns the number of
+// values done.
+template <typename T>
+TFLITE_TARGET_SSE41 inline int BlendRowsSse41(const T* row0, const T* row1,
+                                              int size, int32_t weight,
+                                              int32_t* output) {
+  // Interleaving the two rows lets one madd apply both weights.
+  const __m128i weights =
+      _mm_unpacklo_epi16(_mm_set1_epi16((1 << 10) - weight),
+                         _mm_set1_epi16(static_cast<int16_t>(weight)));
+  int i = 0;
+  for (; i <= size - 8; i += 8) {
+    const __m128i a = Load8x16(row0 + i);
+    const __m128i b = Load8x16(row1 + i);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i),
+                     _mm_madd_epi16(_mm_unpacklo_epi16(a, b), weights));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 4),
+                     _mm_madd_epi16(_mm_unpackhi_epi16(a, b), weights));
+  }
+  return i;
+}
+
+TFLITE_TARGET_SSE41 inline int BlendRowsSse41(const float* row0,
+                                              const float* row1, int size,
+                                              float weight, float* output) {
+  const __m128 weight0 = _mm_set1_ps(1.0f - weight);
+  const __m128 weight1 = _mm_set1_ps(weight);
+  int i = 0;
+  for (; i <= size - 4; i += 4) {
+    _mm_storeu_ps(output + i,
+                  _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(row0 + i), weight0),
+                             _mm_mul_ps(_mm_loadu_ps(row1 + i), weight1)));
+  }
+  return i;
+}
+
+// Vectorized part of BlendColumns() for integer data. Returns the number of
+// channels done.
+template <typename T>
+TFLITE_TARGET_SSE41 inline int BlendColumnsSse41(const int32_t* column0,
+                                                 const int32_t* column1,
+                                                 int depth, int32_t weight,
+                                                 T* output) {
+  const __m128i weight0 = _mm_set1_epi32((1 << 10) - weight);
+  const __m128i weight1 = _mm_set1_epi32(weight);
+  const __m128i round = _mm_set1_epi32(1 << 19);
+  int c = 0;
+  for (; c <= depth - 4; c += 4) {
+    const __m128i sum = _mm_add_epi32(
+        _mm_mullo_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(column0 + c)),
+            weight0),
+        _mm_mullo_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(column1 + c)),
+            weight1));
+    // Rounds half away from zero like the reference, on the magnitude.
+    const __m128i magnitude =
+        _mm_srli_epi32(_mm_add_epi32(_mm_abs_epi32(sum), round), 20);
+    Store4x8(_mm_sign_epi32(magnitude, sum), output + c);
+  }
+  return c;
+}
+
+TFLITE_TARGET_SSE41 inline int BlendColumnsSse41(const float* column0,
+                                                 const float* column1,
+                                                 int depth, float weight,
+                                                 float* output) {
+  const __m128 weight0 = _mm_set1_ps(1.0f - weight);
+  const __m128 weight1 = _mm_set1_ps(weight);
+  int c = 0;
+  for (; c <= depth - 4; c += 4) {
+    _mm_storeu_ps(output + c,
+                  _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(column0 + c), weight0),
+                             _mm_mul_ps(_mm_loadu_ps(column1 + c), weight1)));
+  }
+  return c;
+}
+
+#endif  // TFLITE_X86_SIMD
+
+// Interpolates two input rows of |size| integer values into Q10 values.
+template <typename T>
+inline void BlendRows(const T* row0, const T* row1, int size, int32_t weight,
+                      bool use_simd, int32_t* output) {
+  int i = 0;
+#ifdef TFLITE_X86_SIMD
+  if (use_simd) {
+    i = BlendRowsSse41(row0, row1, size, weight, output);
+  }
+#endif
+  for (; i < size; ++i) {
+    output[i] = row0[i] * ((1 << 10) - weight) + row1[i] * weight;
+  }
+}
+
+inline void BlendRows(const float* row0, const float* row1, int size,
+                      float weight, bool use_simd, float* output) {
+  int i = 0;
+#ifdef TFLITE_X86_SIMD
+  if (use_simd) {
+    i = BlendRowsSse41(row0, row1, size, weight, output);
+  }
+#endif
+  for (; i < size; ++i) {
+    output[i] = row0[i] * (1.0f - weight) + row1[i] * weight;
+  }
+}
+
+// Interpolates two pixels of |depth| Q10 values from BlendRows() into one
+// output pixel.
+template <typename T>
+inline void BlendColumns(const int32_t* column0, const int32_t* column1,
+                         int depth, int32_t weight, bool use_simd, T* output) {
+  int c = 0;
+#ifdef TFLITE_X86_SIMD
+  if (use_simd) {
+    c = BlendColumnsSse41(column0, column1, depth, weight, output);
+  }
+#endif
+  for (; c < depth; ++c) {
+    const int32_t sum =
+        column0[c] * ((1 << 10) - weight) + column1[c] * weight;
+    const int32_t round = sum > 0 ? (1 << 19) : -(1 << 19);
+    output[c] = static_cast<T>((sum + round) / (1 << 20));
+  }
+}
+
+inline void BlendColumns(const float* column0, const float* column1, int depth,
+                         float weight, bool use_simd, float* output) {
+  int c = 0;
+#ifdef TFLITE_X86_SIMD
+  if (use_simd) {
+    c = BlendColumnsSse41(column0, column1, depth, weight, output);
+  }
+#endif
+  for (; c < depth; ++c) {
+    output[c] = column0[c] * (1.0f - weight) + column1[c] * weight;
+  }
+}
+
+// Bilinear resize with taps from ComputeResizeBilinearTaps(), one per output
+// row and one per output column. Rows are interpolated first, over the whole
+// contiguous input row, into |row_buffer| of input width * depth values, and
+// output pixels are then interpolated from it. Both passes are unit stride,
+// so no per-pixel index or weight math is left in the inner loops. Produces
+// the same output as reference_ops::ResizeBilinearInteger.
+template <typename T>
+inline void ResizeBilinearInteger(const ResizeBilinearTap* row_taps,
+                                  const ResizeBilinearTap* column_taps,
+                                  const RuntimeShape& input_shape,
+                                  const T* input_data,
+                                  const RuntimeShape& output_shape,
+                                  T* output_data, int32_t* row_buffer) {
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int depth = MatchingDim(input_shape, 3, output_shape, 3);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int row_size = input_width * depth;
+  const bool use_simd = TestCPUFeatureSse41();
+
+  for (int b = 0; b < batches; ++b) {
+    const T* input = input_data + b * input_height * row_size;
+    for (int y = 0; y < output_height; ++y) {
+      const ResizeBilinearTap& row = row_taps[y];
+      BlendRows(input + row.lower * row_size, input + row.upper * row_size,
+                row_size, row.fixed_weight, use_simd, row_buffer);
+      for (int x = 0; x < output_width; ++x) {
+        const ResizeBilinearTap& column = column_taps[x];
+        BlendColumns(row_buffer + column.lower * depth,
+                     row_buffer + column.upper * depth, depth,
+                     column.fixed_weight, use_simd, output_data);
+        output_data += depth;
+      }
+    }
+  }
+}
+
+// Float version of ResizeBilinearInteger(). Matches reference_ops::
+// ResizeBilinear up to float rounding.
+inline void ResizeBilinear(const ResizeBilinearTap* row_taps,
+                           const ResizeBilinearTap* column_taps,
+                           const RuntimeShape& input_shape,
+                           const float* input_data,
+                           const RuntimeShape& output_shape,
+                           float* output_data, float* row_buffer) {
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int depth = MatchingDim(input_shape, 3, output_shape, 3);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int row_size = input_width * depth;
+  const bool use_simd = TestCPUFeatureSse41();
+
+  for (int b = 0; b < batches; ++b) {
+    const float* input = input_data + b * input_height * row_size;
+    for (int y = 0; y < output_height; ++y) {
+      const ResizeBilinearTap& row = row_taps[y];
+      BlendRows(input + row.lower * row_size, input + row.upper * row_size,
+                row_size, row.float_weight, use_simd, row_buffer);
+      for (int x = 0; x < output_width; ++x) {
+        const ResizeBilinearTap& column = column_taps[x];
+        BlendColumns(row_buffer + column.lower * depth,
+                     row_buffer + column.upper * depth, depth,
+                     column.float_weight, use_simd, output_data);
+        output_data += depth;
+      }
+    }
+  }
+}
+
+}  // namespace optimized_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_RESIZE_BILINEAR_H_
@@ -0,0 +1,333 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/benchmarks/micro_benchmark.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__)
+#include <cstdio>
+#endif
+
+#include "tensorflow/lite/micro/output_buffer.h"
+
+namespace {
+
+using tflite::internal::OutputBuffer;
+
+// The default clock needs samples of at least this many timer ticks to keep
+// the rounding error of each sample around one percent.
+constexpr uint64_t kMinSampleTicks = 100;
+
+constexpr uint64_t kNanosPerSecond = 1000000000ull;
+
+// Returns element |percentile| of |sorted| by the nearest rank method.
+uint64_t Percentile(const uint64_t* sorted, int count, int percentile) {
+  const int rank = (percentile * count + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void AppendResultJson(const MicroBenchmarkResult& result, OutputBuffer* out) {
+  out->Append("{\"name\":\"");
+  out->Append(result.name);
+  out->Append("\",\"samples\":");
+  out->AppendSigned(result.samples);
+  out->Append(",\"calls_per_sample\":");
+  out->AppendSigned(result.calls_per_sample);
+  out->Append(",\"min_ns\":");
+  out->AppendUnsigned(result.min_ns);
+  out->Append(",\"median_ns\":");
+  out->AppendUnsigned(result.median_ns);
+  out->Append(",\"p90_ns\":");
+  out->AppendUnsigned(result.p90_ns);
+  out->Append(",\"p99_ns\":");
+  out->AppendUnsigned(result.p99_ns);
+  out->Append(",\"max_ns\":");
+  out->AppendUnsigned(result.max_ns);
+  out->Append(",\"mean_ns\":");
+  out->AppendUnsigned(result.mean_ns);
+  out->Append(",\"ops_per_second\":");
+  out->AppendThousandths(
+      static_cast<uint64_t>(result.ops_per_second * 1000.0f + 0.5f));
+  out->Append("}");
+}
+
+// Returns the value of the unsigned integer field |key| of the JSON object
+// for benchmark |name|, or false if there is no such benchmark or field.
+bool FindBenchmarkField(const char* json, const char* name, const char* key,
+                        uint64_t* value) {
+  static const char kNameKey[] = "\"name\":\"";
+  const size_t name_length = strlen(name);
+  const size_t key_length = strlen(key);
+  for (const char* object = strstr(json, kNameKey); object != nullptr;
+       object = strstr(object + 1, kNameKey)) {
+    const char* object_name = object + sizeof(kNameKey) - 1;
+    if (strncmp(object_name, name, name_length) != 0 ||
+        object_name[name_length] != '"') {
+      continue;
+    }
+    // Benchmark objects are flat, so the object ends at the next brace.
+    const char* end = strchr(object_name, '}');
+    for (const char* field = object_name;
+         (field = strchr(field, '"')) != nullptr && field < end; ++field) {
+      if (strncmp(field + 1, key, key_length) != 0 ||
+          strncmp(field + 1 + key_length, "\":", 2) != 0) {
+        continue;
+      }
+      const char* digits = field + key_length + 3;
+      if (*digits < '0' || *digits > '9') {
+        return false;
+      }
+      *value = 0;
+      for (; *digits >= '0' && *digits <= '9'; ++digits) {
+        *value = *value * 10 + (*digits - '0');
+      }
+      return true;
+    }
+    return false;
+  }
+  return false;
+}
+
+// Returns the value of command line option |name|, as in --name=value.
+const char* FindOption(int argc, char** argv, const char* name) {
+  const size_t name_length = strlen(name);
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--", 2) == 0 &&
+        strncmp(arg + 2, name, name_length) == 0 &&
+        arg[2 + name_length] == '=') {
+      return arg + 3 + name_length;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+constexpr int MicroBenchmarkSuite::kMaxBenchmarks;
+constexpr int MicroBenchmarkSuite::kMaxSamples;
+constexpr int64_t MicroBenchmarkSuite::kMaxCallsPerSample;
+
+MicroBenchmarkSuite::MicroBenchmarkSuite(tflite::ErrorReporter* reporter,
+                                         const MicroBenchmarkOptions& options)
+    : reporter_(reporter),
+      options_(options),
+      min_sample_ns_(std::max(options.min_sample_ns,
+                              tflite::TicksToNanos(kMinSampleTicks))) {}
+
+size_t MicroBenchmarkSuite::ExportJson(char* buffer,
+                                       size_t buffer_size) const {
+  OutputBuffer out(buffer, buffer_size);
+  out.Append("{\"benchmarks\":[");
+  for (int i = 0; i < num_results_; ++i) {
+    out.Append(i == 0 ? "\n" : ",\n");
+    AppendResultJson(results_[i], &out);
+  }
+  out.Append("\n]}\n");
+  return out.Finish();
+}
+
+int MicroBenchmarkSuite::CompareWithBaseline(const char* baseline_json,
+                                             int tolerance_percent) const {
+  int regressions = 0;
+  for (int i = 0; i < num_results_; ++i) {
+    const MicroBenchmarkResult& result = results_[i];
+    uint64_t baseline_ns = 0;
+    if (!FindBenchmarkField(baseline_json, result.name, "median_ns",
+                            &baseline_ns) ||
+        baseline_ns == 0) {
+      TF_LITE_REPORT_ERROR(reporter_, "%s: not in baseline", result.name);
+      continue;
+    }
+    // Change in tenths of a percent, to print with one decimal.
+    const int64_t change = (static_cast<int64_t>(result.median_ns) -
+                            static_cast<int64_t>(baseline_ns)) *
+                           1000 / static_cast<int64_t>(baseline_ns);
+    const bool regressed = change > tolerance_percent * 10;
+    regressions += regressed ? 1 : 0;
+#ifndef TF_LITE_STRIP_ERROR_STRINGS
+    char line[160];
+    OutputBuffer out(line, sizeof(line));
+    out.Append(result.name);
+    out.Append(": median ");
+    out.AppendMicros(result.median_ns);
+    out.Append(" us, baseline ");
+    out.AppendMicros(baseline_ns);
+    out.Append(" us, ");
+    out.Append(change < 0 ? "-" : "+");
+    const int64_t magnitude = change < 0 ? -change : change;
+    out.AppendSigned(magnitude / 10);
+    out.Append(".");
+    out.AppendSigned(magnitude % 10);
+    out.Append(regressed ? "% REGRESSION" : "%");
+    out.Finish();
+    TF_LITE_REPORT_ERROR(reporter_, "%s", line);
+#endif
+  }
+  return regressions;
+}
+
+int MicroBenchmarkSuite::Finish(int argc, char** argv) {
+  int tolerance_percent = options_.tolerance_percent;
+  const char* tolerance = FindOption(argc, argv, "tolerance");
+  if (tolerance != nullptr) {
+    tolerance_percent = atoi(tolerance);
+  }
+#if defined(__linux__)
+  int status = 0;
+  const size_t json_length = ExportJson(nullptr, 0) + 1;
+  char* json = static_cast<char*>(malloc(json_length));
+  ExportJson(json, json_length);
+  const char* json_path = FindOption(argc, argv, "json");
+  if (json_path == nullptr) {
+    fputs(json, stdout);
+  } else {
+    FILE* file = fopen(json_path, "w");
+    if (file == nullptr || fputs(json, file) < 0) {
+      TF_LITE_REPORT_ERROR(reporter_, "Could not write %s", json_path);
+      status = 1;
+    }
+    if (file != nullptr) {
+      fclose(file);
+    }
+  }
+  free(json);
+
+  const char* baseline_path = FindOption(argc, argv, "baseline");
+  if (baseline_path != nullptr) {
+    FILE* file = fopen(baseline_path, "r");
+    if (file == nullptr) {
+      TF_LITE_REPORT_ERROR(reporter_, "Could not read %s", baseline_path);
+      return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    const long baseline_length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* baseline = static_cast<char*>(malloc(baseline_length + 1));
+    const size_t read = fread(baseline, 1, baseline_length, file);
+    baseline[read] = '\0';
+    fclose(file);
+    if (CompareWithBaseline(baseline, tolerance_percent) > 0) {
+      status = 1;
+    }
+    free(baseline);
+  }
+  return status;
+#else
+  // Without a file system the JSON goes through the reporter, one benchmark
+  // per line to stay within its line length.
+  for (int i = 0; i < num_results_; ++i) {
+    char line[256];
+    OutputBuffer out(line, sizeof(line));
+    AppendResultJson(results_[i], &out);
+    out.Finish();
+    TF_LITE_REPORT_ERROR(reporter_, "%s", line);
+  }
+  (void)tolerance_percent;
+  return 0;
+#endif
+}
+
+uint64_t MicroBenchmarkSuite::GetTimeNanos() {
+  return tflite::TicksToNanos(tflite::GetCurrentTimeTicks64());
+}
+
+bool MicroBenchmarkSuite::CanRun(const char* name) {
+  if (tflite::ticks64_per_second() == 0) {
+    TF_LITE_REPORT_ERROR(reporter_, "no timer implementation found");
+    return false;
+  }
+  if (num_results_ == kMaxBenchmarks) {
+    TF_LITE_REPORT_ERROR(reporter_, "%s: more than %d benchmarks", name,
+                         kMaxBenchmarks);
+    return false;
+  }
+  return true;
+}
+
+int64_t MicroBenchmarkSuite::NextCallsPerSample(int64_t calls,
+                                                uint64_t sample_ns) const {
+  // Aim a little past the minimum from the measured rate, but grow by at most
+  // ten times per step since short samples are dominated by timer resolution.
+  int64_t next = calls * 10;
+  if (sample_ns > 0) {
+    const uint64_t target_ns = min_sample_ns_ + min_sample_ns_ / 5;
+    const uint64_t estimate = calls * target_ns / sample_ns + 1;
+    if (estimate < static_cast<uint64_t>(next)) {
+      next = static_cast<int64_t>(estimate);
+    }
+  }
+  return std::min(std::max(next, calls + 1), kMaxCallsPerSample);
+}
+
+const MicroBenchmarkResult* MicroBenchmarkSuite::AddResult(
+    const char* name, int num_samples, int calls_per_sample,
+    int items_per_call) {
+  std::sort(samples_, samples_ + num_samples);
+  uint64_t total_ns = 0;
+  for (int i = 0; i < num_samples; ++i) {
+    total_ns += samples_[i];
+  }
+  const uint64_t calls = static_cast<uint64_t>(calls_per_sample);
+  const int middle = num_samples / 2;
+  const uint64_t median_sample_ns =
+      num_samples % 2 == 1 ? samples_[middle]
+                           : (samples_[middle - 1] + samples_[middle]) / 2;
+
+  MicroBenchmarkResult& result = results_[num_results_++];
+  result.name = name;
+  result.samples = num_samples;
+  result.calls_per_sample = calls_per_sample;
+  result.min_ns = samples_[0] / calls;
+  result.median_ns = median_sample_ns / calls;
+  result.p90_ns = Percentile(samples_, num_samples, 90) / calls;
+  result.p99_ns = Percentile(samples_, num_samples, 99) / calls;
+  result.max_ns = samples_[num_samples - 1] / calls;
+  result.mean_ns = total_ns / (calls * num_samples);
+  result.ops_per_second =
+      median_sample_ns > 0
+          ? static_cast<float>(items_per_call) * calls * kNanosPerSecond /
+                median_sample_ns
+          : 0.0f;
+
+#ifndef TF_LITE_STRIP_ERROR_STRINGS
+  char line[200];
+  OutputBuffer out(line, sizeof(line));
+  out.Append(name);
+  out.Append(": median ");
+  out.AppendMicros(result.median_ns);
+  out.Append(" p90 ");
+  out.AppendMicros(result.p90_ns);
+  out.Append(" p99 ");
+  out.AppendMicros(result.p99_ns);
+  out.Append(" min ");
+  out.AppendMicros(result.min_ns);
+  out.Append(" max ");
+  out.AppendMicros(result.max_ns);
+  out.Append(" us, ");
+  out.AppendThousandths(
+      static_cast<uint64_t>(result.ops_per_second * 1000.0f + 0.5f));
+  out.Append(" ops/s (");
+  out.AppendSigned(num_samples);
+  out.Append(" samples of ");
+  out.AppendSigned(calls_per_sample);
+  out.Append(" calls)");
+  out.Finish();
+  TF_LITE_REPORT_ERROR(reporter_, "%s", line);
+#endif
+  return &result;
+}
@@ -16,62 +16,178 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_MICRO_BENCHMARKS_MICRO_BENCHMARK_H_
 #define TENSORFLOW_LITE_MICRO_BENCHMARKS_MICRO_BENCHMARK_H_
 
-#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
 
+#include "tensorflow/lite/micro/compatibility.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 #include "tensorflow/lite/micro/micro_interpreter.h"
 #include "tensorflow/lite/micro/micro_op_resolver.h"
 #include "tensorflow/lite/micro/micro_time.h"
 
-namespace micro_benchmark {
-extern tflite::ErrorReporter* reporter;
-}  // namespace micro_benchmark
-
-#define TF_LITE_MICRO_BENCHMARKS_BEGIN           \
-  namespace micro_benchmark {                    \
-  tflite::ErrorReporter* reporter;               \
-  }                                              \
-                                                 \
-  int main(int argc, char** argv) {              \
-    tflite::MicroErrorReporter error_reporter;   \
-    micro_benchmark::reporter = &error_reporter; \
-    int32_t start_ticks;                         \
-    int32_t duration_ticks;                      \
-    int32_t duration_ms;
-
-#define TF_LITE_MICRO_BENCHMARKS_END \
-  return 0;                          \
+// Controls how long MicroBenchmarkSuite::Run() measures a benchmark.
+struct MicroBenchmarkOptions {
+  // Untimed calls before measuring, to warm up caches and lazily initialized
+  // state.
+  int warmup_calls = 2;
+  // Each sample times a batch of calls that is grown until it lasts at least
+  // this long, so that timer resolution does not dominate fast benchmarks. The
+  // suite raises it to 100 ticks of the platform timer if that is longer.
+  uint64_t min_sample_ns = 1000000;
+  // Samples are taken until there are at least min_samples of them and they
+  // add up to min_time_ns, or until there are
+  // MicroBenchmarkSuite::kMaxSamples.
+  int min_samples = 10;
+  uint64_t min_time_ns = 1000000000;
+  // A benchmark regresses when its median latency exceeds the baseline by
+  // more than this.
+  int tolerance_percent = 10;
+};
+
+// Latency distribution of one benchmark. All times are per call.
+struct MicroBenchmarkResult {
+  const char* name;
+  int samples;
+  int calls_per_sample;
+  uint64_t min_ns;
+  uint64_t median_ns;
+  uint64_t p90_ns;
+  uint64_t p99_ns;
+  uint64_t max_ns;
+  uint64_t mean_ns;
+  // Items processed per second at the median latency, for example inferences
+  // per second when every call runs a batch of inferences.
+  float ops_per_second;
+};
+
+// Runs benchmarks with warmup and adaptive iteration counts, reports the
+// median, p90 and p99 latency and throughput of each, writes them as JSON and
+// compares them with the JSON of an earlier run to catch regressions.
+//
+// Usage example:
+// int main(int argc, char** argv) {
+//   tflite::MicroErrorReporter reporter;
+//   MicroBenchmarkSuite suite(&reporter);
+//   suite.Run("Invoke", []() { runner->RunSingleIteration(); });
+//   return suite.Finish(argc, argv);
+// }
+//
+// and on Linux, to fail when a benchmark got more than 5% slower:
+// benchmark --json=new.json --baseline=old.json --tolerance=5
+class MicroBenchmarkSuite {
+ public:
+  static constexpr int kMaxBenchmarks = 48;
+  static constexpr int kMaxSamples = 100;
+
+  explicit MicroBenchmarkSuite(
+      tflite::ErrorReporter* reporter,
+      const MicroBenchmarkOptions& options = MicroBenchmarkOptions());
+  virtual ~MicroBenchmarkSuite() = default;
+
+  // Measures |func| and reports the result under |name|, which must outlive
+  // the suite. Every call of |func| processes |items_per_call| items. Returns
+  // null if there is no timer or the suite is full.
+  template <typename Func>
+  const MicroBenchmarkResult* Run(const char* name, Func func,
+                                  int items_per_call = 1) {
+    if (!CanRun(name)) {
+      return nullptr;
+    }
+    for (int i = 0; i < options_.warmup_calls; ++i) {
+      func();
+    }
+    int64_t calls_per_sample = 1;
+    uint64_t sample_ns = TimeCalls(func, calls_per_sample);
+    while (sample_ns < min_sample_ns_ && calls_per_sample < kMaxCallsPerSample) {
+      calls_per_sample = NextCallsPerSample(calls_per_sample, sample_ns);
+      sample_ns = TimeCalls(func, calls_per_sample);
+    }
+    int num_samples = 0;
+    uint64_t total_ns = 0;
+    while (num_samples < kMaxSamples &&
+           (num_samples < options_.min_samples ||
+            total_ns < options_.min_time_ns)) {
+      sample_ns = TimeCalls(func, calls_per_sample);
+      samples_[num_samples++] = sample_ns;
+      total_ns += sample_ns;
+    }
+    return AddResult(name, num_samples, static_cast<int>(calls_per_sample),
+                     items_per_call);
+  }
+
+  int num_results() const { return num_results_; }
+  const MicroBenchmarkResult& result(int index) const {
+    return results_[index];
   }
 
-#define TF_LITE_MICRO_BENCHMARK(func)                                   \
-  if (tflite::ticks_per_second() == 0) {                                \
-    TF_LITE_REPORT_ERROR(micro_benchmark::reporter,                     \
-                         "no timer implementation found");              \
-    return 0;                                                           \
-  }                                                                     \
-  start_ticks = tflite::GetCurrentTimeTicks();                          \
-  func;                                                                 \
-  duration_ticks = tflite::GetCurrentTimeTicks() - start_ticks;         \
-  if (duration_ticks > INT_MAX / 1000) {                                \
-    duration_ms = duration_ticks / (tflite::ticks_per_second() / 1000); \
-  } else {                                                              \
-    duration_ms = (duration_ticks * 1000) / tflite::ticks_per_second(); \
-  }                                                                     \
-  micro_benchmark::reporter->Report("%s took %d ticks (%d ms)", #func,  \
-                                    duration_ticks, duration_ms);
+  // Writes the results as {"benchmarks":[...]} with one benchmark per line.
+  // Like snprintf, the output is truncated to fit buffer_size including the
+  // terminating NUL, and the return value is the length of the complete
+  // output.
+  size_t ExportJson(char* buffer, size_t buffer_size) const;
+
+  // Compares the median of every result with that of the benchmark of the
+  // same name in |baseline_json|, as written by ExportJson(), and reports the
+  // change. Returns the number of benchmarks that regressed by more than
+  // |tolerance_percent|.
+  int CompareWithBaseline(const char* baseline_json,
+                          int tolerance_percent) const;
+
+  // Prints the JSON, or on Linux writes it to the file given by --json=path,
+  // and compares the results with the file given by --baseline=path using
+  // --tolerance=percent or the tolerance of the options. Returns the exit
+  // code for main(): 1 on a regression or an I/O error, 0 otherwise.
+  int Finish(int argc, char** argv);
+
+ protected:
+  // Monotonic time in nanoseconds. Virtual so that tests can inject a clock.
+  virtual uint64_t GetTimeNanos();
+
+ private:
+  static constexpr int64_t kMaxCallsPerSample = 1 << 30;
+
+  template <typename Func>
+  uint64_t TimeCalls(Func& func, int64_t calls) {
+    const uint64_t start_ns = GetTimeNanos();
+    for (int64_t i = 0; i < calls; ++i) {
+      func();
+    }
+    return GetTimeNanos() - start_ns;
+  }
+
+  bool CanRun(const char* name);
+  int64_t NextCallsPerSample(int64_t calls, uint64_t sample_ns) const;
+  const MicroBenchmarkResult* AddResult(const char* name, int num_samples,
+                                        int calls_per_sample,
+                                        int items_per_call);
+
+  tflite::ErrorReporter* reporter_;
+  MicroBenchmarkOptions options_;
+  uint64_t min_sample_ns_;
+  uint64_t samples_[kMaxSamples];
+  MicroBenchmarkResult results_[kMaxBenchmarks];
+  int num_results_ = 0;
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
 
 template <typename inputT>
 class MicroBenchmarkRunner {
  public:
   // The lifetimes of model, op_resolver and tensor_arena must exceed that of
-  // the created MicroBenchmarkRunner object.
+  // the created MicroBenchmarkRunner object. Every iteration runs batch_size
+  // independent inputs through the model.
   MicroBenchmarkRunner(const uint8_t* model,
                        const tflite::MicroOpResolver* op_resolver,
-                       uint8_t* tensor_arena, int tensor_arena_size)
+                       uint8_t* tensor_arena, int tensor_arena_size,
+                       int batch_size = 1)
       : model_(tflite::GetModel(model)),
         reporter_(&micro_reporter_),
         interpreter_(model_, *op_resolver, tensor_arena, tensor_arena_size,
-                     reporter_) {
+                     reporter_),
+        batch_size_(batch_size) {
+    interpreter_.SetBatchSize(batch_size);
     interpreter_.AllocateTensors();
   }
 
@@ -108,11 +224,23 @@ class MicroBenchmarkRunner {
     }
   }
 
+  // Copies one sample into slot |batch| of a batched input tensor.
+  void SetInput(const inputT* custom_input, int batch) {
+    TfLiteTensor* input = interpreter_.input(0);
+    int sample_length = input->bytes / sizeof(inputT) / batch_size_;
+    inputT* input_buffer =
+        tflite::GetTensorData<inputT>(input) + batch * sample_length;
+    for (int i = 0; i < sample_length; i++) {
+      input_buffer[i] = custom_input[i];
+    }
+  }
+
  private:
   const tflite::Model* model_;
   tflite::MicroErrorReporter micro_reporter_;
   tflite::ErrorReporter* reporter_;
   tflite::MicroInterpreter interpreter_;
+  const int batch_size_;
 };
 
 #endif  // TENSORFLOW_LITE_MICRO_BENCHMARKS_MICRO_BENCHMARK_H_
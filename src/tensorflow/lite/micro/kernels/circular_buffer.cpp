@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#define FLATBUFFERS_LOCALE_INDEPENDENT 0
+#include "flatbuffers/flexbuffers.h"
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/compatibility.h"
@@ -37,6 +39,20 @@ limitations under the License.
  * After shifting:
  * Output: [<input 2>, <input 3>, <input ...>, <input N+1>]
  *
+ * The ring variant (Register_CIRCULAR_BUFFER_RING) produces the same output
+ * without shifting. It keeps the history in a ring of 2 * N slots and writes
+ * each input twice, at the rotating head and N slots after it, so
+ * that the N slots following the head are always the history in order. The
+ * output tensor is then pointed at that window, which costs O(depth) per
+ * invocation instead of O(N * depth). The output always points into the ring,
+ * so the memory planner does not allocate a buffer for it, and the ring takes
+ * N * depth bytes more than the planned output would. Every session has its
+ * own ring, and interpreter->output() follows the window as it moves.
+ *
+ * The stride in time comes from the "cycles_max" entry of the custom options
+ * flexbuffer map. Models converted without it fall back to a heuristic that
+ * only recognizes the two streaming models TFLM originally supported.
+ *
  * We make some assumptions in this custom operator:
  * - Input shape must be [1, 1, 1, depth]
  * - Output shape must be [1, num_slots, 1, depth]
@@ -58,21 +74,49 @@ constexpr int kOutputTensor = 0;
 constexpr int kTfLiteAbort = -9;
 
 // These fields control the stride period of a strided streaming model. This op
-// returns kTfLiteAbort until cycles_until_run-- is zero.  At this time,
-// cycles_until_run is reset to cycles_max.
+// returns kTfLiteAbort until it has been invoked cycles_max times since it last
+// ran.
 struct OpData {
-  int cycles_until_run;
   int cycles_max;
+  // Index of the State buffer, which every session of a model has its own
+  // copy of.
+  int state_index;
+  // Whether the State is followed by the history of the ring variant.
+  bool use_ring;
+};
+
+// Per-stream state, kept in a state buffer rather than in OpData. For the ring
+// variant it is followed by the history, 2 * num_slots slots where the next
+// input goes to slot |head| and |head| + num_slots.
+struct State {
+  // Starts at zero, and the op runs when it reaches cycles_max.
+  int cycles_since_run;
+  int head;
 };
 
 }  // namespace
 
 void* Init(TfLiteContext* context, const char* buffer, size_t length) {
   TFLITE_DCHECK(context->AllocatePersistentBuffer != nullptr);
-  return context->AllocatePersistentBuffer(context, sizeof(OpData));
+  OpData* op_data = static_cast<OpData*>(
+      context->AllocatePersistentBuffer(context, sizeof(OpData)));
+  if (op_data == nullptr) {
+    return nullptr;
+  }
+  op_data->cycles_max = 0;
+  op_data->use_ring = false;
+  if (buffer != nullptr && length > 0) {
+    const uint8_t* buffer_t = reinterpret_cast<const uint8_t*>(buffer);
+    const flexbuffers::Map& m = flexbuffers::GetRoot(buffer_t, length).AsMap();
+    if (!m["cycles_max"].IsNull()) {
+      op_data->cycles_max = m["cycles_max"].AsInt32();
+    }
+  }
+  return op_data;
 }
 
-TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+TfLiteStatus PrepareImpl(TfLiteContext* context, TfLiteNode* node,
+                         bool use_ring) {
   const TfLiteTensor* input = GetInput(context, node, kInputTensor);
   TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
 
@@ -91,32 +135,61 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   // The circular buffer custom operator currently only supports int8.
   TF_LITE_ENSURE_TYPES_EQ(context, input->type, kTfLiteInt8);
 
-  // The last circular buffer layer simply accumulates outputs, and does not run
-  // periodically.
-  // TODO(b/150001379): Move this special case logic to the tflite flatbuffer.
-  static int cb_prepare_count = 0;
-  cb_prepare_count++;
-  // These checks specifically work for the only two streaming models supported
-  // on TFLM. They use the shape of the output tensor along with the layer
-  // number to determine if the circular buffer period should be 1 or 2.
-
-  // These models are outlined int the following documents:
-  // https://docs.google.com/document/d/1lc_G2ZFhjiKFo02UHjBaljye1xsL0EkfybkaVELEE3Q/edit?usp=sharing
-  // https://docs.google.com/document/d/1pGc42PuWyrk-Jy1-9qeqtggvsmHr1ifz8Lmqfpr2rKA/edit?usp=sharing
-  if (output->dims->data[1] == 5 || output->dims->data[1] == 13 ||
-      (cb_prepare_count == 5 && output->dims->data[2] == 2 &&
-       output->dims->data[3] == 96)) {
-    op_data->cycles_max = 1;
-    cb_prepare_count = 0;
-  } else {
-    op_data->cycles_max = 2;
+  if (op_data->cycles_max <= 0) {
+    // The last circular buffer layer simply accumulates outputs, and does not
+    // run periodically.
+    static int cb_prepare_count = 0;
+    cb_prepare_count++;
+    // These checks specifically work for the only two streaming models
+    // supported on TFLM before the period was stored in the custom options.
+    // They use the shape of the output tensor along with the layer number to
+    // determine if the circular buffer period should be 1 or 2.
+
+    // These models are outlined int the following documents:
+    // https://docs.google.com/document/d/1lc_G2ZFhjiKFo02UHjBaljye1xsL0EkfybkaVELEE3Q/edit?usp=sharing
+    // https://docs.google.com/document/d/1pGc42PuWyrk-Jy1-9qeqtggvsmHr1ifz8Lmqfpr2rKA/edit?usp=sharing
+    if (output->dims->data[1] == 5 || output->dims->data[1] == 13 ||
+        (cb_prepare_count == 5 && output->dims->data[2] == 2 &&
+         output->dims->data[3] == 96)) {
+      op_data->cycles_max = 1;
+      cb_prepare_count = 0;
+    } else {
+      op_data->cycles_max = 2;
+    }
+  }
+  size_t state_bytes = sizeof(State);
+  if (use_ring) {
+    const int num_slots = output->dims->data[1];
+    const int depth = output->dims->data[2] * output->dims->data[3];
+    state_bytes += 2 * num_slots * depth;
+  }
+  op_data->use_ring = use_ring;
+  TFLITE_DCHECK(context->AllocateStateBuffer != nullptr);
+  void* state = context->AllocateStateBuffer(context, state_bytes,
+                                             &op_data->state_index);
+  TF_LITE_ENSURE(context, state != nullptr);
+
+  if (use_ring) {
+    // A tensor that already has data is not planned. Eval moves the output
+    // along the ring, and sessions point it into their own copy.
+    TfLiteEvalTensor* output_eval =
+        context->GetEvalTensor(context, node->outputs->data[kOutputTensor]);
+    TF_LITE_ENSURE(context, output_eval != nullptr);
+    output_eval->data.int8 =
+        reinterpret_cast<int8_t*>(static_cast<State*>(state) + 1);
   }
-  op_data->cycles_until_run = op_data->cycles_max;
-  node->user_data = op_data;
 
   return kTfLiteOk;
 }
 
+TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  return PrepareImpl(context, node, /*use_ring=*/false);
+}
+
+TfLiteStatus PrepareRing(TfLiteContext* context, TfLiteNode* node) {
+  return PrepareImpl(context, node, /*use_ring=*/true);
+}
+
 // Shifts buffer over by the output depth, and write new input to end of buffer.
 // num_slots is the number of samples stored in the output buffer.
 // depth is the size of each sample.
@@ -125,6 +198,19 @@ void EvalInt8(const int8_t* input, int num_slots, int depth, int8_t* output) {
   memcpy(&output[(num_slots - 1) * depth], input, depth);
 }
 
+// Writes the new input into the ring and returns the start of the num_slots
+// slots that now hold the history, oldest first.
+int8_t* EvalRingInt8(const int8_t* input, int num_slots, int depth,
+                     State* state) {
+  int8_t* ring = reinterpret_cast<int8_t*>(state + 1);
+  int8_t* slot = &ring[state->head * depth];
+  memcpy(slot, input, depth);
+  memcpy(&slot[num_slots * depth], input, depth);
+  int8_t* history = &slot[depth];
+  state->head = state->head + 1 == num_slots ? 0 : state->head + 1;
+  return history;
+}
+
 TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   const TfLiteEvalTensor* input =
       tflite::micro::GetEvalInput(context, node, kInputTensor);
@@ -132,12 +218,17 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
       tflite::micro::GetEvalOutput(context, node, kOutputTensor);
 
   TFLITE_DCHECK(node->user_data != nullptr);
-  OpData* data = reinterpret_cast<OpData*>(node->user_data);
+  const OpData* data = reinterpret_cast<const OpData*>(node->user_data);
+  State* state = static_cast<State*>(
+      context->GetScratchBuffer(context, data->state_index));
 
   int num_slots = output->dims->data[1];
   int depth = output->dims->data[2] * output->dims->data[3];
 
-  if (input->type == kTfLiteInt8) {
+  if (input->type == kTfLiteInt8 && data->use_ring) {
+    output->data.int8 = EvalRingInt8(
+        tflite::micro::GetTensorData<int8_t>(input), num_slots, depth, state);
+  } else if (input->type == kTfLiteInt8) {
     EvalInt8(tflite::micro::GetTensorData<int8_t>(input), num_slots, depth,
              tflite::micro::GetTensorData<int8_t>(output));
   } else {
@@ -146,14 +237,14 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
     return kTfLiteError;
   }
 
-  if (--data->cycles_until_run != 0) {
+  if (++state->cycles_since_run != data->cycles_max) {
     // Signal the interpreter to end current run if the delay before op invoke
     // has not been reached.
     // TODO(b/149795762): Add kTfLiteAbort to TfLiteStatus enum.
     return static_cast<TfLiteStatus>(kTfLiteAbort);
   }
 
-  data->cycles_until_run = data->cycles_max;
+  state->cycles_since_run = 0;
 
   return kTfLiteOk;
 }
@@ -172,6 +263,18 @@ TfLiteRegistration* Register_CIRCULAR_BUFFER() {
   return &r;
 }
 
+TfLiteRegistration* Register_CIRCULAR_BUFFER_RING() {
+  static TfLiteRegistration r = {/*init=*/circular_buffer::Init,
+                                 /*free=*/nullptr,
+                                 /*prepare=*/circular_buffer::PrepareRing,
+                                 /*invoke=*/circular_buffer::Eval,
+                                 /*profiling_string=*/nullptr,
+                                 /*builtin_code=*/0,
+                                 /*custom_name=*/nullptr,
+                                 /*version=*/0};
+  return &r;
+}
+
 }  // namespace micro
 }  // namespace ops
 }  // namespace tflite
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "CMSIS/NN/Include/arm_nnfunctions.h"
 #include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/elementwise.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/add.h"
 #include "tensorflow/lite/kernels/internal/reference/process_broadcast_shapes.h"
@@ -149,7 +150,18 @@ TfLiteStatus EvalAddQuantized(TfLiteContext* context, TfLiteNode* node,
                tflite::micro::GetTensorShape(output),            \
                tflite::micro::GetTensorData<dtype>(output));
     if (output->type == kTfLiteInt8) {
-      if (need_broadcast) {
+      if (optimized_integer_ops::HasElementwise() &&
+          op_params.broadcast_category !=
+              BroadcastableOpCategory::kGenericBroadcast) {
+        if (need_broadcast) {
+          optimized_integer_ops::BroadcastAddFivefold(
+              op_params, tflite::micro::GetTensorData<int8_t>(input1),
+              tflite::micro::GetTensorData<int8_t>(input2),
+              tflite::micro::GetTensorData<int8_t>(output));
+        } else {
+          TF_LITE_ADD(optimized_integer_ops, Add, int8_t);
+        }
+      } else if (need_broadcast) {
         TF_LITE_ADD(reference_integer_ops, BroadcastAdd4DSlow, int8_t);
       } else {
         arm_elementwise_add_s8(
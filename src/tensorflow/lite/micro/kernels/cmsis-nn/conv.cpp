@@ -20,12 +20,16 @@ limitations under the License.
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/conv.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/packed_weights.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/conv.h"
 #include "tensorflow/lite/micro/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/micro_thread_pool.h"
 
 namespace tflite {
 namespace {
@@ -63,6 +67,16 @@ struct OpData {
 
   // Index to buffer for optimizations if applicable.
   int buffer_idx;
+
+  // Number of threads the scratch buffer was sized for. Each thread uses its
+  // own scratch_stride bytes of the buffer.
+  int num_threads;
+  int scratch_stride;
+
+  // Filter repacked by PackWeights() and bias with the input offset folded
+  // in, or null when the filter is used as stored in the model.
+  int8_t* packed_filter;
+  int32_t* folded_bias;
 };
 
 inline PaddingType RuntimePaddingType(TfLitePadding padding) {
@@ -119,7 +133,38 @@ void* Init(TfLiteContext* context, const char* buffer, size_t length) {
   return context->AllocatePersistentBuffer(context, sizeof(OpData));
 }
 
-TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+// Repacks the constant int8 filter of the node into persistent arena memory so
+// that Eval can use ConvPerChannelPacked. Leaves data->packed_filter null if
+// the filter or bias can change at runtime or no host SIMD kernel is
+// available.
+TfLiteStatus PackFilter(TfLiteContext* context, TfLiteNode* node,
+                        OpData* data) {
+  const TfLiteTensor* filter = GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
+  if (!optimized_integer_ops::HasPackedWeights() ||
+      !IsConstantTensor(filter) ||
+      (bias != nullptr && !IsConstantTensor(bias))) {
+    return kTfLiteOk;
+  }
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  const int rows = filter_shape.Dims(0);
+  const int depth = filter_shape.FlatSize() / rows;
+  data->packed_filter = static_cast<int8_t*>(context->AllocatePersistentBuffer(
+      context, optimized_integer_ops::PackedWeightsSize(rows, depth)));
+  data->folded_bias = static_cast<int32_t*>(
+      context->AllocatePersistentBuffer(context, rows * sizeof(int32_t)));
+  TF_LITE_ENSURE(context, data->packed_filter != nullptr &&
+                              data->folded_bias != nullptr);
+  optimized_integer_ops::PackWeights(GetTensorData<int8_t>(filter), rows,
+                                     depth, data->packed_filter);
+  optimized_integer_ops::FoldInputOffsetIntoBias(
+      GetTensorData<int8_t>(filter), rows, depth, GetTensorData<int32_t>(bias),
+      -data->input_zero_point, data->folded_bias);
+  return kTfLiteOk;
+}
+
+TfLiteStatus PrepareImpl(TfLiteContext* context, TfLiteNode* node,
+                         bool pack_weights) {
   TFLITE_DCHECK(node->user_data != nullptr);
   TFLITE_DCHECK(node->builtin_data != nullptr);
 
@@ -176,6 +221,12 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   data->filter_zero_point = filter->params.zero_point;
   data->output_zero_point = output->params.zero_point;
 
+  data->packed_filter = nullptr;
+  data->folded_bias = nullptr;
+  if (pack_weights && input->type == kTfLiteInt8) {
+    TF_LITE_ENSURE_STATUS(PackFilter(context, node, data));
+  }
+
   if (input->type == kTfLiteInt8) {
     // Initialize cmsis-nn convolution parameters
     cmsis_nn_conv_params conv_params;
@@ -192,8 +243,34 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
 
     buf_size = arm_convolve_wrapper_s8_get_buffer_size(
         &conv_params, &input_dims, &filter_dims, &output_dims);
+
+    // The host SIMD kernel is selected at Eval time based on the running CPU,
+    // so the buffer has to fit whichever implementation ends up being used.
+    if (optimized_integer_ops::HasConvPerChannel()) {
+      buf_size = std::max(buf_size,
+                          optimized_integer_ops::ConvPerChannelScratchSize(
+                              GetTensorShape(filter)));
+    }
+    if (data->packed_filter != nullptr) {
+      buf_size = std::max(
+          buf_size, optimized_integer_ops::ConvPerChannelPackedScratchSize(
+                        GetTensorShape(filter)));
+    }
+
+    // Row bands computed by worker threads can end up in a different
+    // arm_convolve_wrapper_s8 kernel than the whole tensor would, so size
+    // their scratch for the generic one as well.
+    data->num_threads = std::max(1, context->recommended_num_threads);
+    if (data->num_threads > 1) {
+      buf_size = std::max(
+          buf_size, arm_convolve_s8_get_buffer_size(&input_dims, &filter_dims));
+    }
+  } else {
+    data->num_threads = 1;
   }
 
+  data->scratch_stride = (buf_size + 15) & ~15;
+  buf_size = data->scratch_stride * data->num_threads;
   if (buf_size > 0) {
     TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
         context, buf_size, &data->buffer_idx));
@@ -203,6 +280,30 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   return kTfLiteOk;
 }
 
+TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  return PrepareImpl(context, node, /*pack_weights=*/false);
+}
+
+TfLiteStatus PreparePacked(TfLiteContext* context, TfLiteNode* node) {
+  return PrepareImpl(context, node, /*pack_weights=*/true);
+}
+
+ConvParams ConvParamsQuantized(const TfLiteConvParams& params,
+                               const OpData& data) {
+  ConvParams op_params;
+  op_params.input_offset = -data.input_zero_point;
+  op_params.output_offset = data.output_zero_point;
+  op_params.stride_height = params.stride_height;
+  op_params.stride_width = params.stride_width;
+  op_params.dilation_height_factor = params.dilation_height_factor;
+  op_params.dilation_width_factor = params.dilation_width_factor;
+  op_params.padding_values.height = data.padding.height;
+  op_params.padding_values.width = data.padding.width;
+  op_params.quantized_activation_min = data.output_activation_min;
+  op_params.quantized_activation_max = data.output_activation_max;
+  return op_params;
+}
+
 TfLiteStatus EvalQuantized(TfLiteContext* context, TfLiteNode* node,
                            TfLiteConvParams* params, const OpData& data,
                            const TfLiteEvalTensor* input,
@@ -243,14 +344,47 @@ TfLiteStatus EvalQuantized(TfLiteContext* context, TfLiteNode* node,
   return kTfLiteOk;
 }
 
-TfLiteStatus EvalQuantizedPerChannel(
-    TfLiteContext* context, TfLiteNode* node, TfLiteConvParams* params,
-    const OpData& data, const TfLiteEvalTensor* input,
-    const TfLiteEvalTensor* filter, const TfLiteEvalTensor* bias,
-    TfLiteEvalTensor* output, TfLiteEvalTensor* im2col) {
+// Runs the int8 per-channel convolution of |input_shape| into |output_shape|
+// using |scratch| as the kernel's temporary buffer. |pad_height| overrides the
+// op's padding so that callers can pass in a band of rows.
+void ConvPerChannelInt8(const TfLiteConvParams& params, const OpData& data,
+                        int pad_height, const RuntimeShape& input_shape,
+                        const int8_t* input_data,
+                        const RuntimeShape& filter_shape,
+                        const int8_t* filter_data,
+                        const RuntimeShape& bias_shape,
+                        const int32_t* bias_data,
+                        const RuntimeShape& output_shape, int8_t* output_data,
+                        void* scratch) {
+  ConvParams op_params = ConvParamsQuantized(params, data);
+  op_params.padding_values.height = pad_height;
+
+  if (data.packed_filter != nullptr) {
+    TFLITE_DCHECK(scratch != nullptr);
+    optimized_integer_ops::ConvPerChannelPacked(
+        op_params, data.per_channel_output_multiplier,
+        data.per_channel_output_shift, input_shape, input_data, filter_shape,
+        data.packed_filter, data.folded_bias, output_shape, output_data,
+        static_cast<int8_t*>(scratch));
+    return;
+  }
+
+  // Without ARM_MATH_DSP or ARM_MATH_MVEI, arm_convolve_wrapper_s8 is plain
+  // scalar C. On x86 hosts use the SIMD kernel instead, which also covers the
+  // dilated case.
+  if (optimized_integer_ops::HasConvPerChannel()) {
+    TFLITE_DCHECK(scratch != nullptr);
+    optimized_integer_ops::ConvPerChannel(
+        op_params, data.per_channel_output_multiplier,
+        data.per_channel_output_shift, input_shape, input_data, filter_shape,
+        filter_data, bias_shape, bias_data, output_shape, output_data,
+        static_cast<int16_t*>(scratch));
+    return;
+  }
+
   cmsis_nn_conv_params conv_params;
-  conv_params.dilation.h = params->dilation_height_factor;
-  conv_params.dilation.w = params->dilation_width_factor;
+  conv_params.dilation.h = params.dilation_height_factor;
+  conv_params.dilation.w = params.dilation_width_factor;
   // TODO(#43557) Remove checks for dilation and call to reference
   // implementation when dilation is supported in the optimized implementation
   // by CMSIS-NN.
@@ -258,9 +392,9 @@ TfLiteStatus EvalQuantizedPerChannel(
     // Initialize cmsis-nn convolution parameters
     conv_params.input_offset = -data.input_zero_point;
     conv_params.output_offset = data.output_zero_point;
-    conv_params.stride.h = params->stride_height;
-    conv_params.stride.w = params->stride_width;
-    conv_params.padding.h = data.padding.height;
+    conv_params.stride.h = params.stride_height;
+    conv_params.stride.w = params.stride_width;
+    conv_params.padding.h = pad_height;
     conv_params.padding.w = data.padding.width;
     conv_params.activation.min = data.output_activation_min;
     conv_params.activation.max = data.output_activation_max;
@@ -271,11 +405,6 @@ TfLiteStatus EvalQuantizedPerChannel(
         const_cast<int32_t*>(data.per_channel_output_multiplier);
     quant_params.shift = const_cast<int32_t*>(data.per_channel_output_shift);
 
-    RuntimeShape filter_shape = tflite::micro::GetTensorShape(filter);
-    RuntimeShape input_shape = tflite::micro::GetTensorShape(input);
-    RuntimeShape output_shape = tflite::micro::GetTensorShape(output);
-    RuntimeShape bias_shape = tflite::micro::GetTensorShape(bias);
-
     // Consistency check.
     TFLITE_DCHECK_LE(conv_params.activation.min, conv_params.activation.max);
     TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
@@ -284,7 +413,7 @@ TfLiteStatus EvalQuantizedPerChannel(
     const int batch_size = MatchingDim(input_shape, 0, output_shape, 0);
     const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
     const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
-    if (tflite::micro::GetTensorData<int8_t>(bias)) {
+    if (bias_data) {
       TFLITE_DCHECK_EQ(bias_shape.FlatSize(), output_depth);
     }
 
@@ -318,52 +447,133 @@ TfLiteStatus EvalQuantizedPerChannel(
     output_dims.c = output_depth;
 
     // Initialize cmsis-nn context
+    // Note: ctx.size is currently not used in cmsis-nn.
+    // The buffer should be allocated in the Prepare function through
+    // arm_convolve_wrapper_s8_get_buffer_size
     cmsis_nn_context ctx;
-    ctx.buf = nullptr;
+    ctx.buf = scratch;
     ctx.size = 0;
 
-    if (data.buffer_idx > -1) {
-      ctx.buf = context->GetScratchBuffer(context, data.buffer_idx);
-      // Note: ctx.size is currently not used in cmsis-nn.
-      // The buffer should be allocated in the Prepare function through
-      // arm_convolve_wrapper_s8_get_buffer_size
-    }
-
     // arm_convolve_wrapper_s8 dispatches the optimized kernel accordingly with
     // the parameters passed
     TFLITE_DCHECK_EQ(
-        arm_convolve_wrapper_s8(
-            &ctx, &conv_params, &quant_params, &input_dims,
-            tflite::micro::GetTensorData<int8_t>(input), &filter_dims,
-            tflite::micro::GetTensorData<int8_t>(filter), &bias_dims,
-            tflite::micro::GetTensorData<int32_t>(bias), &output_dims,
-            tflite::micro::GetTensorData<int8_t>(output)),
+        arm_convolve_wrapper_s8(&ctx, &conv_params, &quant_params, &input_dims,
+                                input_data, &filter_dims, filter_data,
+                                &bias_dims, bias_data, &output_dims,
+                                output_data),
         ARM_MATH_SUCCESS);
   } else {
     // TODO(b/154032858): Investigate removing extra copies.
-    ConvParams op_params;
-    op_params.input_offset = -data.input_zero_point;
-    op_params.output_offset = data.output_zero_point;
-    op_params.stride_height = params->stride_height;
-    op_params.stride_width = params->stride_width;
-    op_params.dilation_height_factor = params->dilation_height_factor;
-    op_params.dilation_width_factor = params->dilation_width_factor;
-    op_params.padding_values.height = data.padding.height;
-    op_params.padding_values.width = data.padding.width;
-    op_params.quantized_activation_min = data.output_activation_min;
-    op_params.quantized_activation_max = data.output_activation_max;
-
     reference_integer_ops::ConvPerChannel(
         op_params, data.per_channel_output_multiplier,
-        data.per_channel_output_shift, tflite::micro::GetTensorShape(input),
-        tflite::micro::GetTensorData<int8_t>(input),
-        tflite::micro::GetTensorShape(filter),
-        tflite::micro::GetTensorData<int8_t>(filter),
-        tflite::micro::GetTensorShape(bias),
-        tflite::micro::GetTensorData<int32_t>(bias),
-        tflite::micro::GetTensorShape(output),
-        tflite::micro::GetTensorData<int8_t>(output));
+        data.per_channel_output_shift, input_shape, input_data, filter_shape,
+        filter_data, bias_shape, bias_data, output_shape, output_data);
+  }
+}
+
+// Work shared by the tasks of a multi-threaded int8 convolution. Each task
+// computes a contiguous range of the batches * output_height output rows.
+struct ConvPerChannelTask {
+  const TfLiteConvParams& params;
+  const OpData& data;
+  const RuntimeShape& input_shape;
+  const int8_t* input_data;
+  const RuntimeShape& filter_shape;
+  const int8_t* filter_data;
+  const RuntimeShape& bias_shape;
+  const int32_t* bias_data;
+  const RuntimeShape& output_shape;
+  int8_t* output_data;
+  uint8_t* scratch;
+  int num_tasks;
+};
+
+void RunConvPerChannelTask(void* arg, int task_index) {
+  const ConvPerChannelTask& task = *static_cast<ConvPerChannelTask*>(arg);
+  const TfLiteConvParams& params = task.params;
+  const OpData& data = task.data;
+  const int input_height = task.input_shape.Dims(1);
+  const int input_row_size = task.input_shape.Dims(2) * task.input_shape.Dims(3);
+  const int output_height = task.output_shape.Dims(1);
+  const int output_row_size =
+      task.output_shape.Dims(2) * task.output_shape.Dims(3);
+  void* scratch = task.scratch != nullptr
+                      ? task.scratch + task_index * data.scratch_stride
+                      : nullptr;
+
+  int row, row_end;
+  GetTaskRange(task.output_shape.Dims(0) * output_height, task.num_tasks,
+               task_index, &row, &row_end);
+  while (row < row_end) {
+    const int batch = row / output_height;
+    const int out_y = row % output_height;
+    const int out_y_end = std::min(output_height, out_y + row_end - row);
+    const micro::ConvRowBand band = micro::GetConvRowBand(
+        input_height, task.filter_shape.Dims(1), params.stride_height,
+        params.dilation_height_factor, data.padding.height, out_y, out_y_end);
+
+    const int32_t band_input_dims[4] = {1, band.rows, task.input_shape.Dims(2),
+                                        task.input_shape.Dims(3)};
+    const int32_t band_output_dims[4] = {1, out_y_end - out_y,
+                                         task.output_shape.Dims(2),
+                                         task.output_shape.Dims(3)};
+    ConvPerChannelInt8(
+        params, data, band.pad_height, RuntimeShape(4, band_input_dims),
+        task.input_data +
+            (batch * input_height + band.row_start) * input_row_size,
+        task.filter_shape, task.filter_data, task.bias_shape, task.bias_data,
+        RuntimeShape(4, band_output_dims),
+        task.output_data + (batch * output_height + out_y) * output_row_size,
+        scratch);
+    row += out_y_end - out_y;
+  }
+}
+
+TfLiteStatus EvalQuantizedPerChannel(
+    TfLiteContext* context, TfLiteNode* node, TfLiteConvParams* params,
+    const OpData& data, const TfLiteEvalTensor* input,
+    const TfLiteEvalTensor* filter, const TfLiteEvalTensor* bias,
+    TfLiteEvalTensor* output, TfLiteEvalTensor* im2col) {
+  uint8_t* scratch =
+      data.buffer_idx > -1 ? static_cast<uint8_t*>(context->GetScratchBuffer(
+                                 context, data.buffer_idx))
+                           : nullptr;
+
+  const RuntimeShape input_shape = tflite::micro::GetTensorShape(input);
+  const RuntimeShape filter_shape = tflite::micro::GetTensorShape(filter);
+  const RuntimeShape bias_shape = tflite::micro::GetTensorShape(bias);
+  const RuntimeShape output_shape = tflite::micro::GetTensorShape(output);
+
+  MicroThreadPool* thread_pool = GetMicroThreadPool(context);
+  const int output_rows = output_shape.Dims(0) * output_shape.Dims(1);
+  const int64_t macs_per_row =
+      static_cast<int64_t>(output_shape.Dims(2)) * filter_shape.FlatSize();
+  const int num_tasks = GetNumTasks(thread_pool, data.num_threads,
+                                    output_rows, macs_per_row);
+  if (num_tasks == 1) {
+    ConvPerChannelInt8(*params, data, data.padding.height, input_shape,
+                       tflite::micro::GetTensorData<int8_t>(input),
+                       filter_shape,
+                       tflite::micro::GetTensorData<int8_t>(filter),
+                       bias_shape, tflite::micro::GetTensorData<int32_t>(bias),
+                       output_shape,
+                       tflite::micro::GetTensorData<int8_t>(output), scratch);
+    return kTfLiteOk;
   }
+
+  ConvPerChannelTask task = {*params,
+                             data,
+                             input_shape,
+                             tflite::micro::GetTensorData<int8_t>(input),
+                             filter_shape,
+                             tflite::micro::GetTensorData<int8_t>(filter),
+                             bias_shape,
+                             tflite::micro::GetTensorData<int32_t>(bias),
+                             output_shape,
+                             tflite::micro::GetTensorData<int8_t>(output),
+                             scratch,
+                             num_tasks};
+  thread_pool->Run(num_tasks, RunConvPerChannelTask, &task);
   return kTfLiteOk;
 }
 
@@ -459,4 +669,15 @@ TfLiteRegistration Register_CONV_2D() {
           /*version=*/0};
 }
 
+TfLiteRegistration Register_CONV_2D_PACKED() {
+  return {/*init=*/Init,
+          /*free=*/nullptr,
+          /*prepare=*/PreparePacked,
+          /*invoke=*/Eval,
+          /*profiling_string=*/nullptr,
+          /*builtin_code=*/0,
+          /*custom_name=*/nullptr,
+          /*version=*/0};
+}
+
 }  // namespace tflite
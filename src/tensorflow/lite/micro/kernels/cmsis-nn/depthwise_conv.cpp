@@ -15,17 +15,22 @@ limitations under the License.
 
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
 
+#include <cstring>
+
 #include "CMSIS/NN/Include/arm_nnfunctions.h"
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/depthwise_conv.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/depthwiseconv_float.h"
 #include "tensorflow/lite/kernels/internal/reference/depthwiseconv_uint8.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/depthwise_conv.h"
 #include "tensorflow/lite/micro/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/micro_thread_pool.h"
 
 namespace tflite {
 namespace {
@@ -62,6 +67,29 @@ struct OpData {
   int32_t output_activation_max;
   // Index to buffer for optimizations if applicable.
   int buffer_idx;
+
+  // Number of threads the scratch buffer was sized for. Each thread uses its
+  // own scratch_stride bytes of the buffer.
+  int num_threads;
+  int scratch_stride;
+
+  // Streaming variant only, see EvalStreamingPerChannel(). Index of the state
+  // buffer that holds a StreamingState followed by the input of the previous
+  // invocation, the cached output rows and their valid flags, or -1 when
+  // streaming is not used. There is one cached output row for each input row
+  // the filter can start at without reading padding.
+  int streaming_state_idx;
+  int cached_row_count;
+  int cached_rows_offset;
+  int cached_row_valid_offset;
+};
+
+// Start of the state buffer of the streaming variant. Slot
+// (cached_row_head + q) % cached_row_count holds the output row for input row
+// q, if it is valid. All zeros is the state before the first invocation.
+struct StreamingState {
+  int cached_row_head;
+  int has_previous_input;
 };
 
 TfLiteStatus CalculateOpData(TfLiteContext* context, TfLiteNode* node,
@@ -160,6 +188,9 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   data->input_zero_point = input->params.zero_point;
   data->filter_zero_point = filter->params.zero_point;
   data->output_zero_point = output->params.zero_point;
+  data->num_threads = 1;
+  data->scratch_stride = 0;
+  data->streaming_state_idx = -1;
 
   if (input->type == kTfLiteInt8) {
     RuntimeShape input_shape = GetTensorShape(input);
@@ -169,12 +200,11 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
     TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
     TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
 
-    const int batch_size = MatchingDim(input_shape, 0, output_shape, 0);
     const int output_depth = MatchingDim(output_shape, 3, filter_shape, 3);
-    TFLITE_DCHECK_EQ(batch_size, 1); /* Only batch = 1 is supported */
 
+    // Eval runs the CMSIS-NN kernels one batch at a time.
     cmsis_nn_dims input_dims;
-    input_dims.n = batch_size;
+    input_dims.n = 1;
     input_dims.h = height;
     input_dims.w = width;
     input_dims.c = input_shape.Dims(3);
@@ -186,7 +216,7 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
     filter_dims.c = output_depth;
 
     cmsis_nn_dims output_dims;
-    output_dims.n = batch_size;
+    output_dims.n = 1;
     output_dims.h = output_shape.Dims(1);
     output_dims.w = output_shape.Dims(2);
     output_dims.c = output_depth;
@@ -198,9 +228,12 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
     const int32_t buf_size = arm_depthwise_conv_wrapper_s8_get_buffer_size(
         &dw_conv_params, &input_dims, &filter_dims, &output_dims);
 
+    data->num_threads = std::max(1, context->recommended_num_threads);
+    data->scratch_stride = (buf_size + 15) & ~15;
     if (buf_size > 0) {
       TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
-          context, buf_size, &data->buffer_idx));
+          context, data->scratch_stride * data->num_threads,
+          &data->buffer_idx));
     } else {
       data->buffer_idx = -1;
     }
@@ -208,6 +241,50 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   return kTfLiteOk;
 }
 
+TfLiteStatus PrepareStreaming(TfLiteContext* context, TfLiteNode* node) {
+  TF_LITE_ENSURE_STATUS(Prepare(context, node));
+
+  OpData* data = static_cast<OpData*>(node->user_data);
+  auto* params =
+      reinterpret_cast<TfLiteDepthwiseConvParams*>(node->builtin_data);
+
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+
+  // Cached rows can only be reused if nothing but the input changes between
+  // invocations. Anything else runs like the regular kernel.
+  if (input->type != kTfLiteInt8 || SizeOfDimension(input, 0) != 1 ||
+      !IsConstantTensor(filter) ||
+      (bias != nullptr && !IsConstantTensor(bias))) {
+    return kTfLiteOk;
+  }
+  const int input_height = SizeOfDimension(input, 1);
+  const int filter_extent =
+      (SizeOfDimension(filter, 1) - 1) * params->dilation_height_factor + 1;
+  const int cached_row_count = input_height - filter_extent + 1;
+  if (cached_row_count <= 0) {
+    return kTfLiteOk;
+  }
+  const int input_row_size =
+      SizeOfDimension(input, 2) * SizeOfDimension(input, 3);
+  const int output_row_size =
+      SizeOfDimension(output, 2) * SizeOfDimension(output, 3);
+
+  data->cached_row_count = cached_row_count;
+  data->cached_rows_offset =
+      sizeof(StreamingState) + input_height * input_row_size;
+  data->cached_row_valid_offset =
+      data->cached_rows_offset + cached_row_count * output_row_size;
+  TFLITE_DCHECK(context->AllocateStateBuffer != nullptr);
+  TF_LITE_ENSURE(context,
+                 context->AllocateStateBuffer(
+                     context, data->cached_row_valid_offset + cached_row_count,
+                     &data->streaming_state_idx) != nullptr);
+  return kTfLiteOk;
+}
+
 void EvalFloat(TfLiteContext* context, TfLiteNode* node,
                TfLiteDepthwiseConvParams* params, const OpData* data,
                const TfLiteEvalTensor* input, const TfLiteEvalTensor* filter,
@@ -240,37 +317,61 @@ void EvalFloat(TfLiteContext* context, TfLiteNode* node,
       tflite::micro::GetTensorData<float>(output));
 }
 
-void EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
-                             TfLiteDepthwiseConvParams* params, OpData* data,
-                             const TfLiteEvalTensor* input,
-                             const TfLiteEvalTensor* filter,
-                             const TfLiteEvalTensor* bias,
-                             TfLiteEvalTensor* output) {
+// Runs the int8 per-channel depthwise convolution of |input_shape| into
+// |output_shape| using |scratch| as the kernel's temporary buffer.
+// |pad_height| overrides the op's padding so that callers can pass in a band
+// of rows.
+void DepthwiseConvPerChannelInt8(
+    const TfLiteDepthwiseConvParams& params, const OpData& data,
+    int pad_height, const RuntimeShape& input_shape, const int8_t* input_data,
+    const RuntimeShape& filter_shape, const int8_t* filter_data,
+    const RuntimeShape& bias_shape, const int32_t* bias_data,
+    const RuntimeShape& output_shape, int8_t* output_data, void* scratch) {
+  DepthwiseParams op_params;
+  op_params.padding_type = PaddingType::kSame;
+  op_params.padding_values.width = data.padding.width;
+  op_params.padding_values.height = pad_height;
+  op_params.stride_width = params.stride_width;
+  op_params.stride_height = params.stride_height;
+  op_params.dilation_width_factor = params.dilation_width_factor;
+  op_params.dilation_height_factor = params.dilation_height_factor;
+  op_params.depth_multiplier = params.depth_multiplier;
+  op_params.input_offset = -data.input_zero_point;
+  op_params.weights_offset = 0;
+  op_params.output_offset = data.output_zero_point;
+  op_params.quantized_activation_min = data.output_activation_min;
+  op_params.quantized_activation_max = data.output_activation_max;
+
+  // Without ARM_MATH_DSP or ARM_MATH_MVEI, arm_depthwise_conv_wrapper_s8 is
+  // plain scalar C. On x86 hosts use the SIMD kernel instead, which also
+  // covers the dilated case.
+  if (optimized_integer_ops::HasDepthwiseConvPerChannel(op_params)) {
+    optimized_integer_ops::DepthwiseConvPerChannel(
+        op_params, data.per_channel_output_multiplier,
+        data.per_channel_output_shift, input_shape, input_data, filter_shape,
+        filter_data, bias_shape, bias_data, output_shape, output_data);
+    return;
+  }
+
   cmsis_nn_dw_conv_params dw_conv_params;
-  dw_conv_params.dilation.h = params->dilation_height_factor;
-  dw_conv_params.dilation.w = params->dilation_width_factor;
+  dw_conv_params.dilation.h = params.dilation_height_factor;
+  dw_conv_params.dilation.w = params.dilation_width_factor;
   // Call to reference implementation can be removed when dilation is supported
   // in the optimized implementations.
   if (1 == dw_conv_params.dilation.h && 1 == dw_conv_params.dilation.w) {
-    dw_conv_params.input_offset = -data->input_zero_point;
-    dw_conv_params.output_offset = data->output_zero_point;
-    dw_conv_params.stride.h = params->stride_height;
-    dw_conv_params.stride.w = params->stride_width;
-    dw_conv_params.padding.h = data->padding.height;
-    dw_conv_params.padding.w = data->padding.width;
-    // TODO(b/130439627): Use calculated value for clamping.
-    dw_conv_params.activation.min = std::numeric_limits<int8_t>::min();
-    dw_conv_params.activation.max = std::numeric_limits<int8_t>::max();
-    dw_conv_params.ch_mult = params->depth_multiplier;
+    dw_conv_params.input_offset = -data.input_zero_point;
+    dw_conv_params.output_offset = data.output_zero_point;
+    dw_conv_params.stride.h = params.stride_height;
+    dw_conv_params.stride.w = params.stride_width;
+    dw_conv_params.padding.h = pad_height;
+    dw_conv_params.padding.w = data.padding.width;
+    dw_conv_params.activation.min = data.output_activation_min;
+    dw_conv_params.activation.max = data.output_activation_max;
+    dw_conv_params.ch_mult = params.depth_multiplier;
 
     cmsis_nn_per_channel_quant_params quant_params;
-    quant_params.multiplier = data->per_channel_output_multiplier;
-    quant_params.shift = data->per_channel_output_shift;
-
-    RuntimeShape filter_shape = tflite::micro::GetTensorShape(filter);
-    RuntimeShape input_shape = tflite::micro::GetTensorShape(input);
-    RuntimeShape output_shape = tflite::micro::GetTensorShape(output);
-    RuntimeShape bias_shape = tflite::micro::GetTensorShape(bias);
+    quant_params.multiplier = data.per_channel_output_multiplier;
+    quant_params.shift = data.per_channel_output_shift;
 
     TFLITE_DCHECK_LE(dw_conv_params.activation.min,
                      dw_conv_params.activation.max);
@@ -278,12 +379,14 @@ void EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
     const int batch_size = MatchingDim(input_shape, 0, output_shape, 0);
     const int output_depth = MatchingDim(filter_shape, 3, output_shape, 3);
 
-    if (tflite::micro::GetTensorData<int8_t>(bias)) {
+    if (bias_data) {
       TFLITE_DCHECK_EQ(bias_shape.FlatSize(), output_depth);
     }
 
+    // The CMSIS-NN depthwise kernels ignore input_dims.n and handle a single
+    // batch per call.
     cmsis_nn_dims input_dims;
-    input_dims.n = batch_size;
+    input_dims.n = 1;
     input_dims.h = input_shape.Dims(1);
     input_dims.w = input_shape.Dims(2);
     input_dims.c = input_shape.Dims(3);
@@ -301,56 +404,238 @@ void EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
     bias_dims.c = output_depth;
 
     cmsis_nn_dims output_dims;
-    output_dims.n = batch_size;
+    output_dims.n = 1;
     output_dims.h = output_shape.Dims(1);
     output_dims.w = output_shape.Dims(2);
     output_dims.c = output_depth;
 
     cmsis_nn_context ctx;
-    ctx.buf = nullptr;
+    ctx.buf = scratch;
     /* 'size' is unused */
     ctx.size = 0;
 
-    if (data->buffer_idx > -1) {
-      ctx.buf = context->GetScratchBuffer(context, data->buffer_idx);
+    const int input_batch_size = input_shape.FlatSize() / batch_size;
+    const int output_batch_size = output_shape.FlatSize() / batch_size;
+    for (int batch = 0; batch < batch_size; ++batch) {
+      TFLITE_DCHECK_EQ(
+          arm_depthwise_conv_wrapper_s8(
+              &ctx, &dw_conv_params, &quant_params, &input_dims,
+              input_data + batch * input_batch_size, &filter_dims, filter_data,
+              &bias_dims, bias_data, &output_dims,
+              output_data + batch * output_batch_size),
+          ARM_MATH_SUCCESS);
     }
+  } else {
+    reference_integer_ops::DepthwiseConvPerChannel(
+        op_params, data.per_channel_output_multiplier,
+        data.per_channel_output_shift, input_shape, input_data, filter_shape,
+        filter_data, bias_shape, bias_data, output_shape, output_data);
+  }
+}
+
+// Work shared by the tasks of a multi-threaded int8 depthwise convolution.
+// Each task computes a contiguous range of the batches * output_height output
+// rows.
+struct DepthwiseConvPerChannelTask {
+  const TfLiteDepthwiseConvParams& params;
+  const OpData& data;
+  const RuntimeShape& input_shape;
+  const int8_t* input_data;
+  const RuntimeShape& filter_shape;
+  const int8_t* filter_data;
+  const RuntimeShape& bias_shape;
+  const int32_t* bias_data;
+  const RuntimeShape& output_shape;
+  int8_t* output_data;
+  uint8_t* scratch;
+  int num_tasks;
+};
+
+void RunDepthwiseConvPerChannelTask(void* arg, int task_index) {
+  const DepthwiseConvPerChannelTask& task =
+      *static_cast<DepthwiseConvPerChannelTask*>(arg);
+  const TfLiteDepthwiseConvParams& params = task.params;
+  const OpData& data = task.data;
+  const int input_height = task.input_shape.Dims(1);
+  const int input_row_size = task.input_shape.Dims(2) * task.input_shape.Dims(3);
+  const int output_height = task.output_shape.Dims(1);
+  const int output_row_size =
+      task.output_shape.Dims(2) * task.output_shape.Dims(3);
+  void* scratch = task.scratch != nullptr
+                      ? task.scratch + task_index * data.scratch_stride
+                      : nullptr;
+
+  int row, row_end;
+  GetTaskRange(task.output_shape.Dims(0) * output_height, task.num_tasks,
+               task_index, &row, &row_end);
+  while (row < row_end) {
+    const int batch = row / output_height;
+    const int out_y = row % output_height;
+    const int out_y_end = std::min(output_height, out_y + row_end - row);
+    const micro::ConvRowBand band = micro::GetConvRowBand(
+        input_height, task.filter_shape.Dims(1), params.stride_height,
+        params.dilation_height_factor, data.padding.height, out_y, out_y_end);
+
+    const int32_t band_input_dims[4] = {1, band.rows, task.input_shape.Dims(2),
+                                        task.input_shape.Dims(3)};
+    const int32_t band_output_dims[4] = {1, out_y_end - out_y,
+                                         task.output_shape.Dims(2),
+                                         task.output_shape.Dims(3)};
+    DepthwiseConvPerChannelInt8(
+        params, data, band.pad_height, RuntimeShape(4, band_input_dims),
+        task.input_data +
+            (batch * input_height + band.row_start) * input_row_size,
+        task.filter_shape, task.filter_data, task.bias_shape, task.bias_data,
+        RuntimeShape(4, band_output_dims),
+        task.output_data + (batch * output_height + out_y) * output_row_size,
+        scratch);
+    row += out_y_end - out_y;
+  }
+}
+
+void EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
+                             TfLiteDepthwiseConvParams* params, OpData* data,
+                             const TfLiteEvalTensor* input,
+                             const TfLiteEvalTensor* filter,
+                             const TfLiteEvalTensor* bias,
+                             TfLiteEvalTensor* output) {
+  uint8_t* scratch =
+      data->buffer_idx > -1 ? static_cast<uint8_t*>(context->GetScratchBuffer(
+                                  context, data->buffer_idx))
+                            : nullptr;
+
+  const RuntimeShape input_shape = tflite::micro::GetTensorShape(input);
+  const RuntimeShape filter_shape = tflite::micro::GetTensorShape(filter);
+  const RuntimeShape bias_shape = tflite::micro::GetTensorShape(bias);
+  const RuntimeShape output_shape = tflite::micro::GetTensorShape(output);
+
+  MicroThreadPool* thread_pool = GetMicroThreadPool(context);
+  const int output_rows = output_shape.Dims(0) * output_shape.Dims(1);
+  const int64_t macs_per_row = static_cast<int64_t>(output_shape.Dims(2)) *
+                               output_shape.Dims(3) * filter_shape.Dims(1) *
+                               filter_shape.Dims(2);
+  const int num_tasks = GetNumTasks(thread_pool, data->num_threads,
+                                    output_rows, macs_per_row);
+  if (num_tasks == 1) {
+    DepthwiseConvPerChannelInt8(
+        *params, *data, data->padding.height, input_shape,
+        tflite::micro::GetTensorData<int8_t>(input), filter_shape,
+        tflite::micro::GetTensorData<int8_t>(filter), bias_shape,
+        tflite::micro::GetTensorData<int32_t>(bias), output_shape,
+        tflite::micro::GetTensorData<int8_t>(output), scratch);
+    return;
+  }
+
+  DepthwiseConvPerChannelTask task = {
+      *params,
+      *data,
+      input_shape,
+      tflite::micro::GetTensorData<int8_t>(input),
+      filter_shape,
+      tflite::micro::GetTensorData<int8_t>(filter),
+      bias_shape,
+      tflite::micro::GetTensorData<int32_t>(bias),
+      output_shape,
+      tflite::micro::GetTensorData<int8_t>(output),
+      scratch,
+      num_tasks};
+  thread_pool->Run(num_tasks, RunDepthwiseConvPerChannelTask, &task);
+}
 
-    TFLITE_DCHECK_EQ(
-        arm_depthwise_conv_wrapper_s8(
-            &ctx, &dw_conv_params, &quant_params, &input_dims,
-            tflite::micro::GetTensorData<int8_t>(input), &filter_dims,
-            tflite::micro::GetTensorData<int8_t>(filter), &bias_dims,
-            tflite::micro::GetTensorData<int32_t>(bias), &output_dims,
-            tflite::micro::GetTensorData<int8_t>(output)),
-        ARM_MATH_SUCCESS);
+// Streaming version of EvalQuantizedPerChannel(). The input is compared with
+// the previous one to find the smallest shift along the height axis that
+// explains it, and output rows whose filter window only covers input rows that
+// were already seen are copied from the cache instead of being recomputed.
+// Rows that touch padding are always recomputed, since the padding moves with
+// the window.
+void EvalStreamingPerChannel(TfLiteContext* context,
+                             TfLiteDepthwiseConvParams* params,
+                             const OpData* data,
+                             const TfLiteEvalTensor* input,
+                             const TfLiteEvalTensor* filter,
+                             const TfLiteEvalTensor* bias,
+                             TfLiteEvalTensor* output) {
+  void* scratch = data->buffer_idx > -1
+                      ? context->GetScratchBuffer(context, data->buffer_idx)
+                      : nullptr;
+  uint8_t* state_buffer = static_cast<uint8_t*>(
+      context->GetScratchBuffer(context, data->streaming_state_idx));
+  StreamingState* state = reinterpret_cast<StreamingState*>(state_buffer);
+  int8_t* previous_input = reinterpret_cast<int8_t*>(state + 1);
+  int8_t* cached_rows =
+      reinterpret_cast<int8_t*>(state_buffer + data->cached_rows_offset);
+  uint8_t* cached_row_valid = state_buffer + data->cached_row_valid_offset;
+
+  const RuntimeShape input_shape = tflite::micro::GetTensorShape(input);
+  const RuntimeShape filter_shape = tflite::micro::GetTensorShape(filter);
+  const RuntimeShape bias_shape = tflite::micro::GetTensorShape(bias);
+  const RuntimeShape output_shape = tflite::micro::GetTensorShape(output);
+  const int8_t* input_data = tflite::micro::GetTensorData<int8_t>(input);
+  int8_t* output_data = tflite::micro::GetTensorData<int8_t>(output);
+
+  const int input_height = input_shape.Dims(1);
+  const int input_row_size = input_shape.Dims(2) * input_shape.Dims(3);
+  const int output_height = output_shape.Dims(1);
+  const int output_row_size = output_shape.Dims(2) * output_shape.Dims(3);
+  const int filter_extent =
+      (filter_shape.Dims(1) - 1) * params->dilation_height_factor + 1;
+  const int cached_row_count = data->cached_row_count;
+
+  int shift = input_height;
+  if (state->has_previous_input) {
+    for (int s = 0; s < cached_row_count; ++s) {
+      if (std::memcmp(input_data, previous_input + s * input_row_size,
+                      (input_height - s) * input_row_size) == 0) {
+        shift = s;
+        break;
+      }
+    }
+  }
+  if (shift >= cached_row_count) {
+    std::memset(cached_row_valid, 0, cached_row_count);
+    state->cached_row_head = 0;
   } else {
-    DepthwiseParams op_params;
-    op_params.padding_type = PaddingType::kSame;
-    op_params.padding_values.width = data->padding.width;
-    op_params.padding_values.height = data->padding.height;
-    op_params.stride_width = params->stride_width;
-    op_params.stride_height = params->stride_height;
-    op_params.dilation_width_factor = params->dilation_width_factor;
-    op_params.dilation_height_factor = params->dilation_height_factor;
-    op_params.depth_multiplier = params->depth_multiplier;
-    op_params.input_offset = -data->input_zero_point;
-    op_params.weights_offset = 0;
-    op_params.output_offset = data->output_zero_point;
-    // TODO(b/130439627): Use calculated value for clamping.
-    op_params.quantized_activation_min = std::numeric_limits<int8_t>::min();
-    op_params.quantized_activation_max = std::numeric_limits<int8_t>::max();
+    state->cached_row_head =
+        (state->cached_row_head + shift) % cached_row_count;
+    for (int row = cached_row_count - shift; row < cached_row_count; ++row) {
+      cached_row_valid[(state->cached_row_head + row) % cached_row_count] = 0;
+    }
+  }
 
-    reference_integer_ops::DepthwiseConvPerChannel(
-        op_params, data->per_channel_output_multiplier,
-        data->per_channel_output_shift, tflite::micro::GetTensorShape(input),
-        tflite::micro::GetTensorData<int8_t>(input),
-        tflite::micro::GetTensorShape(filter),
-        tflite::micro::GetTensorData<int8_t>(filter),
-        tflite::micro::GetTensorShape(bias),
+  for (int out_y = 0; out_y < output_height; ++out_y) {
+    const micro::ConvRowBand band = micro::GetConvRowBand(
+        input_height, filter_shape.Dims(1), params->stride_height,
+        params->dilation_height_factor, data->padding.height, out_y, out_y + 1);
+    int8_t* output_row = output_data + out_y * output_row_size;
+    int slot = -1;
+    if (band.pad_height == 0 && band.rows == filter_extent) {
+      slot = (state->cached_row_head + band.row_start) % cached_row_count;
+      if (cached_row_valid[slot]) {
+        std::memcpy(output_row, cached_rows + slot * output_row_size,
+                    output_row_size);
+        continue;
+      }
+    }
+
+    const int32_t band_input_dims[4] = {1, band.rows, input_shape.Dims(2),
+                                        input_shape.Dims(3)};
+    const int32_t band_output_dims[4] = {1, 1, output_shape.Dims(2),
+                                         output_shape.Dims(3)};
+    DepthwiseConvPerChannelInt8(
+        *params, *data, band.pad_height, RuntimeShape(4, band_input_dims),
+        input_data + band.row_start * input_row_size, filter_shape,
+        tflite::micro::GetTensorData<int8_t>(filter), bias_shape,
         tflite::micro::GetTensorData<int32_t>(bias),
-        tflite::micro::GetTensorShape(output),
-        tflite::micro::GetTensorData<int8_t>(output));
+        RuntimeShape(4, band_output_dims), output_row, scratch);
+    if (slot >= 0) {
+      std::memcpy(cached_rows + slot * output_row_size, output_row,
+                  output_row_size);
+      cached_row_valid[slot] = 1;
+    }
   }
+
+  std::memcpy(previous_input, input_data, input_height * input_row_size);
+  state->has_previous_input = 1;
 }
 
 void EvalQuantized(TfLiteContext* context, TfLiteNode* node,
@@ -459,6 +744,32 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   return kTfLiteOk;
 }
 
+TfLiteStatus EvalStreaming(TfLiteContext* context, TfLiteNode* node) {
+  TFLITE_DCHECK(node->user_data != nullptr);
+  TFLITE_DCHECK(node->builtin_data != nullptr);
+
+  const OpData& data = *(static_cast<const OpData*>(node->user_data));
+  if (data.streaming_state_idx < 0) {
+    return Eval(context, node);
+  }
+
+  auto* params =
+      reinterpret_cast<TfLiteDepthwiseConvParams*>(node->builtin_data);
+  TfLiteEvalTensor* output =
+      tflite::micro::GetEvalOutput(context, node, kOutputTensor);
+  const TfLiteEvalTensor* input =
+      tflite::micro::GetEvalInput(context, node, kInputTensor);
+  const TfLiteEvalTensor* filter =
+      tflite::micro::GetEvalInput(context, node, kFilterTensor);
+  const TfLiteEvalTensor* bias =
+      (NumInputs(node) == 3)
+          ? tflite::micro::GetEvalInput(context, node, kBiasTensor)
+          : nullptr;
+
+  EvalStreamingPerChannel(context, params, &data, input, filter, bias, output);
+  return kTfLiteOk;
+}
+
 }  // namespace
 
 TfLiteRegistration Register_DEPTHWISE_CONV_2D() {
@@ -472,4 +783,15 @@ TfLiteRegistration Register_DEPTHWISE_CONV_2D() {
           /*version=*/0};
 }
 
+TfLiteRegistration Register_DEPTHWISE_CONV_2D_STREAMING() {
+  return {/*init=*/Init,
+          /*free=*/nullptr,
+          /*prepare=*/PrepareStreaming,
+          /*invoke=*/EvalStreaming,
+          /*profiling_string=*/nullptr,
+          /*builtin_code=*/0,
+          /*custom_name=*/nullptr,
+          /*version=*/0};
+}
+
 }  // namespace tflite
@@ -16,15 +16,19 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/reference/fully_connected.h"
 
 #include "CMSIS/NN/Include/arm_nnfunctions.h"
+#include "CMSIS/NN/Include/arm_nnsupportfunctions.h"
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/packed_weights.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/micro/kernels/fully_connected.h"
 #include "tensorflow/lite/micro/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/micro_thread_pool.h"
 
 namespace tflite {
 namespace {
@@ -47,6 +51,14 @@ struct OpData {
   int32_t input_zero_point;
   int32_t filter_zero_point;
   int32_t output_zero_point;
+
+  // Maximum number of threads the output units are split across.
+  int num_threads;
+
+  // Weights repacked by PackWeights() and bias with the input offset folded
+  // in, or null when the weights are used as stored in the model.
+  int8_t* packed_filter;
+  int32_t* folded_bias;
 };
 
 constexpr int kInputTensor = 0;
@@ -90,7 +102,38 @@ void* Init(TfLiteContext* context, const char* buffer, size_t length) {
   return context->AllocatePersistentBuffer(context, sizeof(OpData));
 }
 
-TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+// Repacks the constant int8 weights of the node into persistent arena memory
+// so that Eval can use FullyConnectedPacked. Leaves data->packed_filter null
+// if the weights or bias can change at runtime, the weights are not
+// symmetrically quantized or no host SIMD kernel is available.
+TfLiteStatus PackFilter(TfLiteContext* context, const TfLiteTensor* filter,
+                        const TfLiteTensor* bias, const TfLiteTensor* output,
+                        OpData* data) {
+  if (!optimized_integer_ops::HasPackedWeights() ||
+      !IsConstantTensor(filter) ||
+      (bias != nullptr && !IsConstantTensor(bias)) ||
+      data->filter_zero_point != 0) {
+    return kTfLiteOk;
+  }
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  const int rows = output->dims->data[output->dims->size - 1];
+  const int depth = filter_shape.Dims(filter_shape.DimensionsCount() - 1);
+  data->packed_filter = static_cast<int8_t*>(context->AllocatePersistentBuffer(
+      context, optimized_integer_ops::PackedWeightsSize(rows, depth)));
+  data->folded_bias = static_cast<int32_t*>(
+      context->AllocatePersistentBuffer(context, rows * sizeof(int32_t)));
+  TF_LITE_ENSURE(context, data->packed_filter != nullptr &&
+                              data->folded_bias != nullptr);
+  optimized_integer_ops::PackWeights(GetTensorData<int8_t>(filter), rows,
+                                     depth, data->packed_filter);
+  optimized_integer_ops::FoldInputOffsetIntoBias(
+      GetTensorData<int8_t>(filter), rows, depth, GetTensorData<int32_t>(bias),
+      -data->input_zero_point, data->folded_bias);
+  return kTfLiteOk;
+}
+
+TfLiteStatus PrepareImpl(TfLiteContext* context, TfLiteNode* node,
+                         bool pack_weights) {
   TFLITE_DCHECK(node->user_data != nullptr);
   TFLITE_DCHECK(node->builtin_data != nullptr);
 
@@ -108,6 +151,13 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE_STATUS(CalculateOpData(context, params->activation,
                                         input->type, input, filter, bias,
                                         output, data));
+  data->num_threads = std::max(1, context->recommended_num_threads);
+
+  data->packed_filter = nullptr;
+  data->folded_bias = nullptr;
+  if (pack_weights && input->type == kTfLiteInt8) {
+    TF_LITE_ENSURE_STATUS(PackFilter(context, filter, bias, output, data));
+  }
 
   if (input->type == kTfLiteInt8 && nullptr != GetTensorData<int32_t>(bias)) {
     RuntimeShape filter_shape = GetTensorShape(filter);
@@ -134,12 +184,126 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   return kTfLiteOk;
 }
 
+TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  return PrepareImpl(context, node, /*pack_weights=*/false);
+}
+
+TfLiteStatus PreparePacked(TfLiteContext* context, TfLiteNode* node) {
+  return PrepareImpl(context, node, /*pack_weights=*/true);
+}
+
+// Work shared by the tasks of a multi-threaded int8 fully connected op. Each
+// task computes a contiguous range of output units for every batch.
+struct FullyConnectedInt8Task {
+  const OpData& data;
+  const int8_t* input_data;
+  const int8_t* filter_data;
+  const int32_t* bias_data;
+  int8_t* output_data;
+  int batches;
+  int accum_depth;
+  int output_depth;
+  int num_tasks;
+};
+
+void RunFullyConnectedInt8Task(void* arg, int task_index) {
+  const FullyConnectedInt8Task& task =
+      *static_cast<FullyConnectedInt8Task*>(arg);
+  int start, end;
+  GetTaskRange(task.output_depth, task.num_tasks, task_index, &start, &end);
+  for (int b = 0; b < task.batches; ++b) {
+    arm_nn_vec_mat_mult_t_s8(
+        task.input_data + b * task.accum_depth,
+        task.filter_data + start * task.accum_depth, task.bias_data + start,
+        task.output_data + b * task.output_depth + start,
+        -task.data.input_zero_point, -task.data.filter_zero_point,
+        task.data.output_zero_point, task.data.output_multiplier,
+        -task.data.output_shift, task.accum_depth, end - start,
+        task.data.output_activation_min, task.data.output_activation_max);
+  }
+}
+
+tflite::FullyConnectedParams FullyConnectedParamsInt8(const OpData& data) {
+  tflite::FullyConnectedParams op_params;
+  op_params.input_offset = -data.input_zero_point;
+  op_params.weights_offset = -data.filter_zero_point;
+  op_params.output_offset = data.output_zero_point;
+  op_params.output_multiplier = data.output_multiplier;
+  // TODO(b/138810107): Figure out whether output shift should be inverted
+  op_params.output_shift = -data.output_shift;
+  op_params.quantized_activation_min = data.output_activation_min;
+  op_params.quantized_activation_max = data.output_activation_max;
+  return op_params;
+}
+
+// Work shared by the tasks of an int8 fully connected op on packed weights.
+// Each task computes a contiguous range of packed row blocks.
+struct FullyConnectedPackedTask {
+  tflite::FullyConnectedParams params;
+  const OpData& data;
+  const int8_t* input_data;
+  int8_t* output_data;
+  int batches;
+  int accum_depth;
+  int output_depth;
+  int num_tasks;
+};
+
+void RunFullyConnectedPackedTask(void* arg, int task_index) {
+  const FullyConnectedPackedTask& task =
+      *static_cast<FullyConnectedPackedTask*>(arg);
+  constexpr int kBlockRows = optimized_integer_ops::kPackedBlockRows;
+  const int num_blocks = (task.output_depth + kBlockRows - 1) / kBlockRows;
+  int start, end;
+  GetTaskRange(num_blocks, task.num_tasks, task_index, &start, &end);
+  optimized_integer_ops::FullyConnectedPacked(
+      task.params, task.data.packed_filter, task.data.folded_bias,
+      task.input_data, task.batches, task.accum_depth, task.output_depth,
+      start * kBlockRows, std::min(end * kBlockRows, task.output_depth),
+      task.output_data);
+}
+
+TfLiteStatus EvalPackedInt8(TfLiteContext* context, const OpData& data,
+                            const TfLiteEvalTensor* input,
+                            const TfLiteEvalTensor* filter,
+                            TfLiteEvalTensor* output) {
+  const RuntimeShape output_shape = tflite::micro::GetTensorShape(output);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 2);
+  const RuntimeShape filter_shape = tflite::micro::GetTensorShape(filter);
+  constexpr int kBlockRows = optimized_integer_ops::kPackedBlockRows;
+  FullyConnectedPackedTask task = {
+      FullyConnectedParamsInt8(data),
+      data,
+      tflite::micro::GetTensorData<int8_t>(input),
+      tflite::micro::GetTensorData<int8_t>(output),
+      output_shape.Dims(0),
+      filter_shape.Dims(filter_shape.DimensionsCount() - 1),
+      output_shape.Dims(1),
+      1};
+
+  MicroThreadPool* thread_pool = GetMicroThreadPool(context);
+  task.num_tasks = GetNumTasks(
+      thread_pool, data.num_threads,
+      (task.output_depth + kBlockRows - 1) / kBlockRows,
+      static_cast<int64_t>(kBlockRows) * task.batches * task.accum_depth);
+  if (task.num_tasks > 1) {
+    thread_pool->Run(task.num_tasks, RunFullyConnectedPackedTask, &task);
+  } else {
+    RunFullyConnectedPackedTask(&task, 0);
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
                                const OpData& data,
                                const TfLiteEvalTensor* input,
                                const TfLiteEvalTensor* filter,
                                const TfLiteEvalTensor* bias,
                                TfLiteEvalTensor* output) {
+  if (data.packed_filter != nullptr) {
+    return EvalPackedInt8(context, data, input, filter, output);
+  }
+
   // The 'if' condition can be removed when null handling of bias is added to
   // arm_fully_connected_s8
   if (nullptr != tflite::micro::GetTensorData<int32_t>(bias)) {
@@ -152,6 +316,37 @@ TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
     const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
     const RuntimeShape input_shape = tflite::micro::GetTensorShape(input);
 
+    MicroThreadPool* thread_pool = GetMicroThreadPool(context);
+    const int num_tasks = GetNumTasks(thread_pool, data.num_threads,
+                                      output_depth, batches * accum_depth);
+    if (num_tasks > 1) {
+      FullyConnectedInt8Task task = {
+          data,
+          tflite::micro::GetTensorData<int8_t>(input),
+          tflite::micro::GetTensorData<int8_t>(filter),
+          tflite::micro::GetTensorData<int32_t>(bias),
+          tflite::micro::GetTensorData<int8_t>(output),
+          batches,
+          accum_depth,
+          output_depth,
+          num_tasks};
+      thread_pool->Run(num_tasks, RunFullyConnectedInt8Task, &task);
+      return kTfLiteOk;
+    }
+
+    // With more than one sample, walk every filter row once for the whole
+    // batch instead of once per sample as arm_fully_connected_s8 does.
+    if (batches > 1 && optimized_integer_ops::HasFullyConnected()) {
+      optimized_integer_ops::FullyConnected(
+          FullyConnectedParamsInt8(data), input_shape,
+          tflite::micro::GetTensorData<int8_t>(input), filter_shape,
+          tflite::micro::GetTensorData<int8_t>(filter),
+          tflite::micro::GetTensorShape(bias),
+          tflite::micro::GetTensorData<int32_t>(bias), output_shape,
+          tflite::micro::GetTensorData<int8_t>(output));
+      return kTfLiteOk;
+    }
+
     cmsis_nn_fc_params fc_params;
     fc_params.input_offset = -data.input_zero_point;
     fc_params.output_offset = data.output_zero_point;
@@ -206,18 +401,8 @@ TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
             tflite::micro::GetTensorData<int8_t>(output)),
         ARM_MATH_SUCCESS);
   } else {
-    tflite::FullyConnectedParams op_params;
-    op_params.input_offset = -data.input_zero_point;
-    op_params.weights_offset = -data.filter_zero_point;
-    op_params.output_offset = data.output_zero_point;
-    op_params.output_multiplier = data.output_multiplier;
-    // TODO(b/138810107): Figure out whether output shift should be inverted
-    op_params.output_shift = -data.output_shift;
-    op_params.quantized_activation_min = data.output_activation_min;
-    op_params.quantized_activation_max = data.output_activation_max;
-
     reference_integer_ops::FullyConnected(
-        op_params, tflite::micro::GetTensorShape(input),
+        FullyConnectedParamsInt8(data), tflite::micro::GetTensorShape(input),
         tflite::micro::GetTensorData<int8_t>(input),
         tflite::micro::GetTensorShape(filter),
         tflite::micro::GetTensorData<int8_t>(filter),
@@ -389,4 +574,16 @@ TfLiteRegistration Register_FULLY_CONNECTED_INT8() {
   return fully_connected_registration;
 }
 
+TfLiteRegistration Register_FULLY_CONNECTED_PACKED() {
+  fully_connected_registration.init = Init;
+  fully_connected_registration.free = nullptr;
+  fully_connected_registration.prepare = PreparePacked;
+  fully_connected_registration.invoke = Eval;
+  fully_connected_registration.profiling_string = nullptr;
+  fully_connected_registration.builtin_code = 0;
+  fully_connected_registration.custom_name = nullptr;
+  fully_connected_registration.version = 0;
+  return fully_connected_registration;
+}
+
 }  // namespace tflite
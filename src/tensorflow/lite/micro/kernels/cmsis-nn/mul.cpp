@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/reference/mul.h"
 
 #include "CMSIS/NN/Include/arm_nnfunctions.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/elementwise.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/mul.h"
 #include "tensorflow/lite/kernels/internal/reference/process_broadcast_shapes.h"
@@ -125,7 +126,18 @@ void EvalQuantized(TfLiteContext* context, TfLiteNode* node,
                tflite::micro::GetTensorData<dtype>(output));
 
     if (output->type == kTfLiteInt8) {
-      if (need_broadcast) {
+      if (optimized_integer_ops::HasElementwise() &&
+          op_params.broadcast_category !=
+              BroadcastableOpCategory::kGenericBroadcast) {
+        if (need_broadcast) {
+          optimized_integer_ops::BroadcastMulFivefold(
+              op_params, tflite::micro::GetTensorData<int8_t>(input1),
+              tflite::micro::GetTensorData<int8_t>(input2),
+              tflite::micro::GetTensorData<int8_t>(output));
+        } else {
+          TF_LITE_MUL(optimized_integer_ops, Mul, int8_t);
+        }
+      } else if (need_broadcast) {
         TF_LITE_MUL(reference_integer_ops, BroadcastMul4DSlow, int8_t);
       } else {
         arm_elementwise_mul_s8(
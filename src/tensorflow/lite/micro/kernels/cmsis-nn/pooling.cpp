@@ -156,12 +156,20 @@ void AverageEvalQuantized(TfLiteContext* context, const TfLiteNode* node,
       ctx.buf = context->GetScratchBuffer(context, data.buffer_idx);
     }
 
-    TFLITE_DCHECK_EQ(
-        arm_avgpool_s8(&ctx, &pool_params, &input_dims,
-                       tflite::micro::GetTensorData<int8_t>(input),
-                       &filter_dims, &output_dims,
-                       tflite::micro::GetTensorData<int8_t>(output)),
-        ARM_MATH_SUCCESS);
+    // arm_avgpool_s8 handles a single batch per call.
+    const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+    const int input_batch_size = input_shape.FlatSize() / batches;
+    const int output_batch_size = output_shape.FlatSize() / batches;
+    for (int batch = 0; batch < batches; ++batch) {
+      TFLITE_DCHECK_EQ(
+          arm_avgpool_s8(&ctx, &pool_params, &input_dims,
+                         tflite::micro::GetTensorData<int8_t>(input) +
+                             batch * input_batch_size,
+                         &filter_dims, &output_dims,
+                         tflite::micro::GetTensorData<int8_t>(output) +
+                             batch * output_batch_size),
+          ARM_MATH_SUCCESS);
+    }
   }
 }
 
@@ -246,12 +254,20 @@ TfLiteStatus MaxEvalInt8(TfLiteContext* context, const TfLiteNode* node,
     ctx.buf = context->GetScratchBuffer(context, data.buffer_idx);
   }
 
-  TFLITE_DCHECK_EQ(
-      arm_max_pool_s8(&ctx, &pool_params, &input_dims,
-                      tflite::micro::GetTensorData<int8_t>(input), &filter_dims,
-                      &output_dims,
-                      tflite::micro::GetTensorData<int8_t>(output)),
-      ARM_MATH_SUCCESS);
+  // arm_max_pool_s8 handles a single batch per call.
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_batch_size = input_shape.FlatSize() / batches;
+  const int output_batch_size = output_shape.FlatSize() / batches;
+  for (int batch = 0; batch < batches; ++batch) {
+    TFLITE_DCHECK_EQ(
+        arm_max_pool_s8(&ctx, &pool_params, &input_dims,
+                        tflite::micro::GetTensorData<int8_t>(input) +
+                            batch * input_batch_size,
+                        &filter_dims, &output_dims,
+                        tflite::micro::GetTensorData<int8_t>(output) +
+                            batch * output_batch_size),
+        ARM_MATH_SUCCESS);
+  }
 
   return kTfLiteOk;
 }
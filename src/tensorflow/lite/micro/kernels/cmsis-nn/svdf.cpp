@@ -13,14 +13,18 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 
 #include "CMSIS/NN/Include/arm_nn_types.h"
 #include "CMSIS/NN/Include/arm_nnfunctions.h"
+#include "CMSIS/NN/Include/arm_nnsupportfunctions.h"
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/svdf.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
@@ -45,6 +49,11 @@ struct OpData {
   // Cached tensor zero point values for quantized operations.
   int input_zero_point;
   int output_zero_point;
+
+  // State buffer holding the slot of every int8 activation_state row that
+  // holds the oldest value and receives the next one. Only used by the ring
+  // variant, which advances the slot on every Invoke().
+  int state_head_index;
 };
 
 // Input tensors.
@@ -67,6 +76,13 @@ constexpr int kOutputTensor = 0;
  * 2.) Output dimensions - the TFLite version determines output size and runtime
  * and resizes the output tensor. Micro runtime does not support tensor
  * resizing.
+ *
+ * The ring variant (Register_SVDF_RING) produces the same output, but instead
+ * of shifting every int8 activation_state row left by one on each invocation
+ * it writes the new activation over the oldest one and advances a head index.
+ * The activation_state tensor then only holds the history in rotated order,
+ * and the head lives in a kernel state buffer, so every interpreter session
+ * keeps its own. ResetVariableTensors() zeroes both the state and the head.
  */
 static inline void ApplyTimeWeightsBiasAndActivation(
     int batch_size, int memory_size, int num_filters, int num_units, int rank,
@@ -203,6 +219,125 @@ inline void EvalFloatSVDF(
       bias_ptr, params->activation, state_ptr, scratch_ptr, output_ptr);
 }
 
+// Same computation as arm_svdf_s8, but with the batch loops inside the loops
+// over weights_feature and weights_time rows, so that every weight row is read
+// once per Invoke() rather than once per sample. The activation_state rows are
+// rings as in optimized_integer_ops::Svdf(): slot |head| holds the oldest value
+// and receives the new one, and memory_size - 1 after a left shift by one
+// gives the layout arm_svdf_s8 uses.
+void EvalIntegerSVDFBatched(const OpData& data, int rank, int batch_size,
+                            int input_size, int num_filters, int memory_size,
+                            const int8_t* input_ptr,
+                            const int8_t* weights_feature_ptr,
+                            const int16_t* weights_time_ptr,
+                            const int32_t* bias_ptr, int head,
+                            int16_t* state_ptr, int32_t* scratch_ptr,
+                            int8_t* output_ptr) {
+  const int num_units = num_filters / rank;
+
+  // Compute conv1d(inputs, weights_feature) into the head column of the
+  // activation_state.
+  for (int f = 0; f < num_filters; ++f) {
+    const int8_t* weights_row = weights_feature_ptr + f * input_size;
+    for (int b = 0; b < batch_size; ++b) {
+      const int8_t* input_row = input_ptr + b * input_size;
+      int32_t dot_prod = 0;
+      for (int c = 0; c < input_size; ++c) {
+        dot_prod += weights_row[c] * (input_row[c] - data.input_zero_point);
+      }
+      dot_prod = arm_nn_requantize(dot_prod, data.effective_scale_1_a,
+                                   data.effective_scale_1_b);
+      dot_prod = std::min<int32_t>(std::max<int32_t>(dot_prod, INT16_MIN),
+                                   INT16_MAX);
+      state_ptr[(b * num_filters + f) * memory_size + head] =
+          static_cast<int16_t>(dot_prod);
+    }
+  }
+
+  // Compute matmul(activation_state, weights_time), starting after the head
+  // column, which now holds the newest value.
+  for (int f = 0; f < num_filters; ++f) {
+    const int16_t* weights_row = weights_time_ptr + f * memory_size;
+    for (int b = 0; b < batch_size; ++b) {
+      const int16_t* state_row =
+          state_ptr + (b * num_filters + f) * memory_size;
+      int32_t sum = 0;
+      int slot = head;
+      for (int j = 0; j < memory_size; ++j) {
+        slot = slot + 1 == memory_size ? 0 : slot + 1;
+        sum += weights_row[j] * state_row[slot];
+      }
+      scratch_ptr[b * num_filters + f] = sum;
+    }
+  }
+
+  // Reduction sum, bias and requantization.
+  for (int b = 0; b < batch_size; ++b) {
+    const int32_t* scratch_batch = scratch_ptr + b * num_filters;
+    for (int i = 0; i < num_units; ++i) {
+      int32_t sum = bias_ptr != nullptr ? bias_ptr[i] : 0;
+      for (int j = 0; j < rank; ++j) {
+        sum += *scratch_batch++;
+      }
+      int32_t output = arm_nn_requantize(sum, data.effective_scale_2_a,
+                                         data.effective_scale_2_b) +
+                       data.output_zero_point;
+      output = std::min<int32_t>(std::max<int32_t>(output, INT8_MIN), INT8_MAX);
+      output_ptr[b * num_units + i] = static_cast<int8_t>(output);
+    }
+  }
+}
+
+// Runs one step on activation_state rows that are rings starting at |head|,
+// with the host SIMD kernel when there is one.
+void EvalIntegerSVDFRing(TfLiteContext* context,
+                         const TfLiteEvalTensor* input_tensor,
+                         const TfLiteEvalTensor* weights_feature_tensor,
+                         const TfLiteEvalTensor* weights_time_tensor,
+                         const TfLiteEvalTensor* bias_tensor,
+                         const TfLiteSVDFParams* params, int head,
+                         TfLiteEvalTensor* activation_state_tensor,
+                         TfLiteEvalTensor* output_tensor, const OpData& data) {
+  const int batch_size = input_tensor->dims->data[0];
+  const int input_size = input_tensor->dims->data[1];
+  const int num_filters = weights_feature_tensor->dims->data[0];
+  const int memory_size = weights_time_tensor->dims->data[1];
+  const int8_t* input = tflite::micro::GetTensorData<int8_t>(input_tensor);
+  const int8_t* weights_feature =
+      tflite::micro::GetTensorData<int8_t>(weights_feature_tensor);
+  const int16_t* weights_time =
+      tflite::micro::GetTensorData<int16_t>(weights_time_tensor);
+  const int32_t* bias =
+      bias_tensor != nullptr
+          ? tflite::micro::GetTensorData<int32_t>(bias_tensor)
+          : nullptr;
+  int16_t* state =
+      tflite::micro::GetTensorData<int16_t>(activation_state_tensor);
+  int8_t* output = tflite::micro::GetTensorData<int8_t>(output_tensor);
+
+  if (optimized_integer_ops::HasSvdf()) {
+    optimized_integer_ops::SvdfParams op_params;
+    op_params.input_zero_point = data.input_zero_point;
+    op_params.feature_multiplier = data.effective_scale_1_a;
+    op_params.feature_shift = data.effective_scale_1_b;
+    op_params.output_multiplier = data.effective_scale_2_a;
+    op_params.output_shift = data.effective_scale_2_b;
+    op_params.output_zero_point = data.output_zero_point;
+    op_params.rank = params->rank;
+    optimized_integer_ops::Svdf(op_params, batch_size, input_size, num_filters,
+                                memory_size, input, weights_feature,
+                                weights_time, bias, head, state, output);
+    return;
+  }
+
+  TFLITE_DCHECK(context->GetScratchBuffer != nullptr);
+  int32_t* scratch = static_cast<int32_t*>(
+      context->GetScratchBuffer(context, data.scratch_tensor_index));
+  EvalIntegerSVDFBatched(data, params->rank, batch_size, input_size,
+                         num_filters, memory_size, input, weights_feature,
+                         weights_time, bias, head, state, scratch, output);
+}
+
 void EvalIntegerSVDF(TfLiteContext* context, TfLiteNode* node,
                      const TfLiteEvalTensor* input_tensor,
                      const TfLiteEvalTensor* weights_feature_tensor,
@@ -211,6 +346,22 @@ void EvalIntegerSVDF(TfLiteContext* context, TfLiteNode* node,
                      const TfLiteSVDFParams* params,
                      TfLiteEvalTensor* activation_state_tensor,
                      TfLiteEvalTensor* output_tensor, const OpData& data) {
+  // Batches and the host kernel work on rings, so shift the state the way
+  // arm_svdf_s8 does and hand them the last column.
+  if (input_tensor->dims->data[0] > 1 || optimized_integer_ops::HasSvdf()) {
+    const int memory_size = weights_time_tensor->dims->data[1];
+    int16_t* state_ptr =
+        tflite::micro::GetTensorData<int16_t>(activation_state_tensor);
+    const int state_size =
+        input_tensor->dims->data[0] * activation_state_tensor->dims->data[1];
+    memmove(state_ptr, state_ptr + 1, (state_size - 1) * sizeof(int16_t));
+    EvalIntegerSVDFRing(context, input_tensor, weights_feature_tensor,
+                        weights_time_tensor, bias_tensor, params,
+                        memory_size - 1, activation_state_tensor,
+                        output_tensor, data);
+    return;
+  }
+
   cmsis_nn_dims input_dims;
   input_dims.n = input_tensor->dims->data[0];
   input_dims.h = input_tensor->dims->data[1];
@@ -384,6 +535,15 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
 
     data->input_zero_point = input->params.zero_point;
     data->output_zero_point = output->params.zero_point;
+    data->state_head_index = -1;
+
+    // The host kernel reduces every activation as soon as it is computed and
+    // needs no scratch memory.
+    if (optimized_integer_ops::HasSvdf()) {
+      data->scratch_tensor_index = -1;
+      data->scratch_output_tensor_index = -1;
+      return kTfLiteOk;
+    }
 
     TFLITE_DCHECK(context->RequestScratchBufferInArena != nullptr);
 
@@ -460,6 +620,60 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   return kTfLiteOk;
 }
 
+TfLiteStatus PrepareRing(TfLiteContext* context, TfLiteNode* node) {
+  TF_LITE_ENSURE_OK(context, Prepare(context, node));
+
+  const TfLiteTensor* weights_feature =
+      GetInput(context, node, kWeightsFeatureTensor);
+  if (weights_feature->type != kTfLiteInt8) {
+    return kTfLiteOk;
+  }
+  TFLITE_DCHECK(node->user_data != nullptr);
+  OpData* data = static_cast<OpData*>(node->user_data);
+  TFLITE_DCHECK(context->AllocateStateBuffer != nullptr);
+  void* head = context->AllocateStateBuffer(context, sizeof(int),
+                                            &data->state_head_index);
+  TF_LITE_ENSURE(context, head != nullptr);
+  return kTfLiteOk;
+}
+
+// Same as Eval(), except that int8 activation_state rows are rings whose head
+// is kept in a state buffer and advanced on every call instead of shifting
+// them.
+TfLiteStatus EvalRing(TfLiteContext* context, TfLiteNode* node) {
+  TFLITE_DCHECK(node->user_data != nullptr);
+  const OpData& data = *(static_cast<const OpData*>(node->user_data));
+
+  const TfLiteEvalTensor* weights_feature =
+      tflite::micro::GetEvalInput(context, node, kWeightsFeatureTensor);
+  if (weights_feature->type != kTfLiteInt8) {
+    return Eval(context, node);
+  }
+
+  auto* params = reinterpret_cast<TfLiteSVDFParams*>(node->builtin_data);
+  const TfLiteEvalTensor* input =
+      tflite::micro::GetEvalInput(context, node, kInputTensor);
+  const TfLiteEvalTensor* weights_time =
+      tflite::micro::GetEvalInput(context, node, kWeightsTimeTensor);
+  const TfLiteEvalTensor* bias =
+      (NumInputs(node) == 5)
+          ? tflite::micro::GetEvalInput(context, node, kBiasTensor)
+          : nullptr;
+  TfLiteEvalTensor* activation_state = tflite::micro::GetMutableEvalInput(
+      context, node, kInputActivationStateTensor);
+  TfLiteEvalTensor* output =
+      tflite::micro::GetEvalOutput(context, node, kOutputTensor);
+
+  int* state_head = static_cast<int*>(
+      context->GetScratchBuffer(context, data.state_head_index));
+  TFLITE_DCHECK(state_head != nullptr);
+  EvalIntegerSVDFRing(context, input, weights_feature, weights_time, bias,
+                      params, *state_head, activation_state, output, data);
+  const int memory_size = weights_time->dims->data[1];
+  *state_head = *state_head + 1 == memory_size ? 0 : *state_head + 1;
+  return kTfLiteOk;
+}
+
 }  // namespace
 
 TfLiteRegistration Register_SVDF() {
@@ -473,4 +687,15 @@ TfLiteRegistration Register_SVDF() {
           /*version=*/0};
 }
 
+TfLiteRegistration Register_SVDF_RING() {
+  return {/*init=*/Init,
+          /*free=*/nullptr,
+          /*prepare=*/PrepareRing,
+          /*invoke=*/EvalRing,
+          /*profiling_string=*/nullptr,
+          /*builtin_code=*/0,
+          /*custom_name=*/nullptr,
+          /*version=*/0};
+}
+
 }  // namespace tflite
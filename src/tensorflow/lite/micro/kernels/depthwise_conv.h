@@ -0,0 +1,53 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_DEPTHWISE_CONV_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_DEPTHWISE_CONV_H_
+
+#include "tensorflow/lite/c/common.h"
+
+namespace tflite {
+
+// This is the most generic TfLiteRegistration. The actual supported types may
+// still be target dependent. The only requirement is that every implementation
+// (reference or optimized) must define this function.
+TfLiteRegistration Register_DEPTHWISE_CONV_2D();
+
+#if defined(CMSIS_NN) || defined(ARDUINO)
+
+// Returns a TfLiteRegistration struct for the cmsis-nn kernel variant meant
+// for models that run over a sliding window along the height (time) axis, such
+// as a spectrogram that is shifted by a few rows between invocations. For int8
+// inputs it keeps the previous input and the output rows it computed in a
+// kernel state buffer, works out how far the window moved, and only computes
+// the output rows that read new input rows. The results are identical to
+// Register_DEPTHWISE_CONV_2D(). Every interpreter session gets its own state,
+// which is cleared by ResetVariableTensors(). Trades arena space for speed, so
+// it has to be selected explicitly.
+TfLiteRegistration Register_DEPTHWISE_CONV_2D_STREAMING();
+
+#else
+// Note that while this block gets used for both reference and optimized kernels
+// that do not have any specialized implementations, the only goal here is to
+// define fallback implementation that allow reference kernels to still be used
+// from applications that call a more specific kernel variant.
+
+inline TfLiteRegistration Register_DEPTHWISE_CONV_2D_STREAMING() {
+  return Register_DEPTHWISE_CONV_2D();
+}
+
+#endif
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_DEPTHWISE_CONV_H_
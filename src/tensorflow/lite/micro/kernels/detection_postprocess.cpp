@@ -12,6 +12,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <limits>
 #include <numeric>
 
 #define FLATBUFFERS_LOCALE_INDEPENDENT 0
@@ -19,11 +21,13 @@ limitations under the License.
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/cpu_check.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/kernels/op_macros.h"
 #include "tensorflow/lite/micro/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/micro_thread_pool.h"
 #include "tensorflow/lite/micro/micro_utils.h"
 
 #define DEBUG0(fmt...) (void(0))
@@ -56,6 +60,13 @@ constexpr int kBatchSize = 1;
 
 constexpr int kNumDetectionsPerClass = 100;
 
+// ymin, xmin, ymax, xmax and area of each decoded box.
+constexpr int kNumDecodedBoxArrays = 5;
+
+// Rough number of multiply-accumulates one IoU comparison is worth, to weigh
+// NMS work against the thread pool's minimum task size.
+constexpr int kNmsComparisonCost = 16;
+
 // Object Detection model produces axis-aligned boxes in two formats:
 // BoxCorner represents the lower left corner (xmin, ymin) and
 // the upper right corner (xmax, ymax).
@@ -88,28 +99,59 @@ static_assert(sizeof(BoxCornerEncoding) == sizeof(float) * kNumCoordBox,
 static_assert(sizeof(CenterSizeEncoding) == sizeof(float) * kNumCoordBox,
               "Size of CenterSizeEncoding is 4 float values");
 
+// Decoded boxes are kept as a structure of arrays, so that the IoU of one box
+// against a block of others can be computed with SIMD. The area of each box is
+// computed once, when the boxes are decoded.
+struct DecodedBoxes {
+  float* ymin;
+  float* xmin;
+  float* ymax;
+  float* xmax;
+  float* area;
+};
+
+// Working memory of one non-max suppression task. The selected arrays hold up
+// to selected_capacity boxes of a single NMS pass. The kept arrays hold the
+// best detections across the classes a task has processed so far, plus room
+// for the results of one more pass.
+struct NmsWorkspace {
+  float* class_scores;
+  int* candidates;
+  int* selected;
+  DecodedBoxes selected_boxes;
+  int* num_kept;
+  int* kept_indices;
+  float* kept_scores;
+  int* sort_indices;
+  float* sort_values;
+};
+
 struct OpData {
   int max_detections;
   int max_classes_per_detection;  // Fast Non-Max-Suppression
   int detections_per_class;       // Regular Non-Max-Suppression
   float non_max_suppression_score_threshold;
   float intersection_over_union_threshold;
+  // non_max_suppression_score_threshold in the units of the class
+  // predictions, that is a quantized score for quantized class predictions.
+  float score_threshold;
   int num_classes;
   bool use_regular_non_max_suppression;
   CenterSizeEncoding scale_values;
 
   // Scratch buffers indexes
-  int active_candidate_idx;
   int decoded_boxes_idx;
-  int scores_idx;
+  int candidate_anchors_idx;
   int score_buffer_idx;
-  int keep_scores_idx;
-  int scores_after_regular_non_max_suppression_idx;
-  int sorted_values_idx;
-  int keep_indices_idx;
-  int sorted_indices_idx;
   int buffer_idx;
-  int selected_idx;
+
+  // One NmsWorkspace of nms_workspace_stride bytes per thread. Regular NMS
+  // splits the classes across the threads.
+  int nms_workspace_idx;
+  int nms_workspace_stride;
+  int nms_selected_capacity;
+  int nms_kept_capacity;
+  int num_threads;
 
   // Cached tensor scale and zero point values for quantized operations
   TfLiteQuantizationParams input_box_encodings;
@@ -172,6 +214,88 @@ void Free(TfLiteContext* context, void* buffer)
 }
 
 
+// Lays out an NmsWorkspace at |base| and returns its size in bytes, rounded up
+// so that the workspaces of several tasks can be placed back to back. With
+// |base| == nullptr it only computes the size.
+int LayoutNmsWorkspace(const OpData& op_data, int num_boxes, uint8_t* base,
+                       NmsWorkspace* workspace) {
+  int offset = 0;
+  auto take = [&](int count, int element_size) -> void* {
+    void* result = base != nullptr ? base + offset : nullptr;
+    offset += (count * element_size + 15) & ~15;
+    return result;
+  };
+  const int selected = op_data.nms_selected_capacity;
+  const int kept = op_data.nms_kept_capacity;
+  NmsWorkspace layout;
+  layout.class_scores = static_cast<float*>(take(num_boxes, sizeof(float)));
+  layout.candidates = static_cast<int*>(take(num_boxes, sizeof(int)));
+  layout.selected = static_cast<int*>(take(selected, sizeof(int)));
+  layout.selected_boxes.ymin =
+      static_cast<float*>(take(selected, sizeof(float)));
+  layout.selected_boxes.xmin =
+      static_cast<float*>(take(selected, sizeof(float)));
+  layout.selected_boxes.ymax =
+      static_cast<float*>(take(selected, sizeof(float)));
+  layout.selected_boxes.xmax =
+      static_cast<float*>(take(selected, sizeof(float)));
+  layout.selected_boxes.area =
+      static_cast<float*>(take(selected, sizeof(float)));
+  layout.num_kept = static_cast<int*>(take(1, sizeof(int)));
+  layout.kept_indices = static_cast<int*>(take(kept, sizeof(int)));
+  layout.kept_scores = static_cast<float*>(take(kept, sizeof(float)));
+  layout.sort_indices = static_cast<int*>(take(kept, sizeof(int)));
+  layout.sort_values = static_cast<float*>(take(kept, sizeof(float)));
+  if (workspace != nullptr) {
+    *workspace = layout;
+  }
+  return offset;
+}
+
+class Dequantizer {
+ public:
+  Dequantizer(int zero_point, float scale)
+      : zero_point_(zero_point), scale_(scale) {}
+  float operator()(int x) const {
+    return (static_cast<float>(x) - zero_point_) * scale_;
+  }
+
+ private:
+  int zero_point_;
+  float scale_;
+};
+
+// Class scores are compared in the type of the class predictions, so that
+// quantized scores are never dequantized in bulk. Returns the smallest
+// quantized score that passes nms_score_threshold once dequantized, or one
+// more than the largest score if none does. Dequantization is monotonic, so
+// this selects exactly the scores the float comparison would select, and it
+// keeps their order.
+template <typename T>
+float QuantizeScoreThreshold(const OpData& op_data) {
+  const Dequantizer dequantize(op_data.input_class_predictions.zero_point,
+                               op_data.input_class_predictions.scale);
+  int score = std::numeric_limits<T>::min();
+  while (score <= std::numeric_limits<T>::max() &&
+         dequantize(score) < op_data.non_max_suppression_score_threshold) {
+    ++score;
+  }
+  return static_cast<float>(score);
+}
+
+// Converts a score as compared by NMS back to the float score it stands for.
+template <typename T>
+float DequantizeScore(const OpData& op_data, float score) {
+  const Dequantizer dequantize(op_data.input_class_predictions.zero_point,
+                               op_data.input_class_predictions.scale);
+  return dequantize(static_cast<int>(score));
+}
+
+template <>
+float DequantizeScore<float>(const OpData& op_data, float score) {
+  return score;
+}
+
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   auto* op_data = static_cast<OpData*>(node->user_data);
 
@@ -190,6 +314,7 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE_EQ(context, NumOutputs(node), 4);
   const int num_boxes = input_box_encodings->dims->data[1];
   const int num_classes = op_data->num_classes;
+  TF_LITE_ENSURE(context, num_classes > 0);
 
   //DEBUG0("[PREPARE] num_boxes=%d, num_classes=%d\n", num_boxes, num_classes);
   op_data->input_box_encodings.scale = input_box_encodings->params.scale;
@@ -199,58 +324,62 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   op_data->input_anchors.scale = input_anchors->params.scale;
   op_data->input_anchors.zero_point = input_anchors->params.zero_point;
 
-  // Scratch tensors
-  //DEBUG0("[PREPARE] kNumCoordBox=%d\n", kNumCoordBox);
-  context->RequestScratchBufferInArena(context, num_boxes,
-                                       &op_data->active_candidate_idx);
-  context->RequestScratchBufferInArena(context,
-                                       num_boxes * kNumCoordBox * sizeof(float),
-                                       &op_data->decoded_boxes_idx);
-#if 0
-  DEBUG0("[PREPARE] prediction dim->data[0]=%d, dim->data[1]=%d, dim->data[2]=%d, requeseted size = %ld\n",
-	  input_class_predictions->dims->data[0],
-      input_class_predictions->dims->data[1],
-      input_class_predictions->dims->data[2],
-      input_class_predictions->dims->data[1] * input_class_predictions->dims->data[2]*sizeof(float));
-#endif
-
-  context->RequestScratchBufferInArena(
-      context,
-      input_class_predictions->dims->data[1] *
-          input_class_predictions->dims->data[2] * sizeof(float),
-      &op_data->scores_idx);
-
-  // Additional buffers
-  context->RequestScratchBufferInArena(context, num_boxes * sizeof(float),
-                                       &op_data->score_buffer_idx);
-  context->RequestScratchBufferInArena(context, num_boxes * sizeof(float),
-                                       &op_data->keep_scores_idx);
-
-  context->RequestScratchBufferInArena(
-      context, op_data->max_detections * num_boxes * sizeof(float),
-      &op_data->scores_after_regular_non_max_suppression_idx);
-
-#if 0
-  DEBUG0("[PREPARE] op_data->max_detections = %d\n", op_data->max_detections);
-  DEBUG0("[PREPARE] num_boxes = %d\n", num_boxes);
-  DEBUG0("[PREPARE] allocate detection box size=%ld\n", op_data->max_detections * num_boxes * sizeof(float));
-#endif
+  switch (input_class_predictions->type) {
+    case kTfLiteFloat32:
+      op_data->score_threshold = op_data->non_max_suppression_score_threshold;
+      break;
+    case kTfLiteUInt8:
+      TF_LITE_ENSURE(context, op_data->input_class_predictions.scale > 0.0f);
+      op_data->score_threshold = QuantizeScoreThreshold<uint8_t>(*op_data);
+      break;
+    case kTfLiteInt8:
+      TF_LITE_ENSURE(context, op_data->input_class_predictions.scale > 0.0f);
+      op_data->score_threshold = QuantizeScoreThreshold<int8_t>(*op_data);
+      break;
+    default:
+      TF_LITE_KERNEL_LOG(context, "Type %s (%d) not supported.",
+                         TfLiteTypeGetName(input_class_predictions->type),
+                         input_class_predictions->type);
+      return kTfLiteError;
+  }
 
+  // Scratch tensors. The candidate anchors are the ones with a class score
+  // above the threshold, the only ones NMS visits.
   context->RequestScratchBufferInArena(
-      context, op_data->max_detections * num_boxes * sizeof(float),
-      &op_data->sorted_values_idx);
-
+      context, num_boxes * kNumDecodedBoxArrays * sizeof(float),
+      &op_data->decoded_boxes_idx);
   context->RequestScratchBufferInArena(context, num_boxes * sizeof(int),
-                                       &op_data->keep_indices_idx);
-  context->RequestScratchBufferInArena(
-      context, op_data->max_detections * num_boxes * sizeof(int),
-      &op_data->sorted_indices_idx);
-  int buffer_size = std::max(num_classes, op_data->max_detections);
-  context->RequestScratchBufferInArena(
-      context, buffer_size * num_boxes * sizeof(int), &op_data->buffer_idx);
-  buffer_size = std::min(num_boxes, op_data->max_detections);
-  context->RequestScratchBufferInArena(
-      context, buffer_size * num_boxes * sizeof(int), &op_data->selected_idx);
+                                       &op_data->candidate_anchors_idx);
+
+  // Additional buffers for fast NMS: the max score and the indices of the
+  // top classes of each anchor, plus room to sort the classes of one anchor.
+  if (!op_data->use_regular_non_max_suppression) {
+    TF_LITE_ENSURE(context, op_data->max_classes_per_detection > 0);
+    const int num_categories_per_anchor =
+        std::min(op_data->max_classes_per_detection, num_classes);
+    context->RequestScratchBufferInArena(context, num_boxes * sizeof(float),
+                                         &op_data->score_buffer_idx);
+    context->RequestScratchBufferInArena(
+        context, (num_boxes * num_categories_per_anchor + num_classes) *
+                     sizeof(int),
+        &op_data->buffer_idx);
+  }
+
+  // Regular NMS runs one pass with up to detections_per_class results per
+  // class, fast NMS a single pass with up to max_detections results.
+  op_data->nms_selected_capacity =
+      std::max(op_data->max_detections, op_data->detections_per_class);
+  op_data->nms_kept_capacity =
+      op_data->max_detections + op_data->nms_selected_capacity;
+  op_data->num_threads =
+      op_data->use_regular_non_max_suppression
+          ? std::max(1, std::min(num_classes, context->recommended_num_threads))
+          : 1;
+  op_data->nms_workspace_stride =
+      LayoutNmsWorkspace(*op_data, num_boxes, nullptr, nullptr);
+  TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+      context, op_data->nms_workspace_stride * op_data->num_threads,
+      &op_data->nms_workspace_idx));
 
   // Outputs: detection_boxes, detection_scores, detection_classes, num_detections
   TF_LITE_ENSURE_EQ(context, NumOutputs(node), 4);
@@ -258,26 +387,13 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   return kTfLiteOk;
 }
 
-class Dequantizer {
- public:
-  Dequantizer(int zero_point, float scale)
-      : zero_point_(zero_point), scale_(scale) {}
-  float operator()(uint8_t x) {
-    return (static_cast<float>(x) - zero_point_) * scale_;
-  }
-
- private:
-  int zero_point_;
-  float scale_;
-};
-
+template <typename T>
 void DequantizeBoxEncodings(const TfLiteEvalTensor* input_box_encodings,
                             int idx, float quant_zero_point, float quant_scale,
                             int length_box_encoding,
                             CenterSizeEncoding* box_centersize) {
-  const uint8_t* boxes =
-      tflite::micro::GetTensorData<uint8_t>(input_box_encodings) +
-      length_box_encoding * idx;
+  const T* boxes = tflite::micro::GetTensorData<T>(input_box_encodings) +
+                   length_box_encoding * idx;
   Dequantizer dequantize(quant_zero_point, quant_scale);
   // See definition of the KeyPointBoxCoder at
   // https://github.com/tensorflow/models/blob/master/research/object_detection/box_coders/keypoint_box_coder.py
@@ -302,6 +418,59 @@ T ReInterpretTensor(TfLiteEvalTensor* tensor) {
   return reinterpret_cast<T>(tensor_base);
 }
 
+DecodedBoxes GetDecodedBoxes(TfLiteContext* context, const OpData* op_data,
+                             int num_boxes) {
+  float* decoded_boxes = reinterpret_cast<float*>(
+      context->GetScratchBuffer(context, op_data->decoded_boxes_idx));
+  DecodedBoxes boxes;
+  boxes.ymin = decoded_boxes;
+  boxes.xmin = decoded_boxes + num_boxes;
+  boxes.ymax = decoded_boxes + 2 * num_boxes;
+  boxes.xmax = decoded_boxes + 3 * num_boxes;
+  boxes.area = decoded_boxes + 4 * num_boxes;
+  return boxes;
+}
+
+BoxCornerEncoding GetBoxCornerEncoding(const DecodedBoxes& boxes, int index) {
+  return {boxes.ymin[index], boxes.xmin[index], boxes.ymax[index],
+          boxes.xmax[index]};
+}
+
+// Reads the center-size encoding |idx| of |tensor|, which holds
+// |length_box_encoding| values per box, as floats.
+TfLiteStatus GetCenterSizeEncoding(const TfLiteEvalTensor* tensor,
+                                   const TfLiteQuantizationParams& params,
+                                   int length_box_encoding, int idx,
+                                   CenterSizeEncoding* box_centersize) {
+  switch (tensor->type) {
+      // Quantized
+    case kTfLiteUInt8:
+      DequantizeBoxEncodings<uint8_t>(
+          tensor, idx, static_cast<float>(params.zero_point),
+          static_cast<float>(params.scale), length_box_encoding,
+          box_centersize);
+      break;
+    case kTfLiteInt8:
+      DequantizeBoxEncodings<int8_t>(
+          tensor, idx, static_cast<float>(params.zero_point),
+          static_cast<float>(params.scale), length_box_encoding,
+          box_centersize);
+      break;
+      // Float
+    case kTfLiteFloat32: {
+      // Please see DequantizeBoxEncodings function for the support detail.
+      const float* boxes = tflite::micro::GetTensorData<float>(tensor) +
+                           length_box_encoding * idx;
+      *box_centersize = *reinterpret_cast<const CenterSizeEncoding*>(boxes);
+      break;
+    }
+    default:
+      // Unsupported type.
+      return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus DecodeCenterSizeBoxes(TfLiteContext* context, TfLiteNode* node,
                                    OpData* op_data) {
   // Parse input tensor boxencodings
@@ -318,204 +487,281 @@ TfLiteStatus DecodeCenterSizeBoxes(TfLiteContext* context, TfLiteNode* node,
   CenterSizeEncoding box_centersize;
   CenterSizeEncoding scale_values = op_data->scale_values;
   CenterSizeEncoding anchor;
+  const DecodedBoxes boxes = GetDecodedBoxes(context, op_data, num_boxes);
 
   for (int idx = 0; idx < num_boxes; ++idx) {
-    switch (input_box_encodings->type) {
-        // Quantized
-      case kTfLiteUInt8:
-		//DEBUG0("type: kTfLiteUInt8\n");
-        DequantizeBoxEncodings(
-            input_box_encodings, idx,
-            static_cast<float>(op_data->input_box_encodings.zero_point),
-            static_cast<float>(op_data->input_box_encodings.scale),
-            input_box_encodings->dims->data[2], &box_centersize);
-        DequantizeBoxEncodings(
-            input_anchors, idx,
-            static_cast<float>(op_data->input_anchors.zero_point),
-            static_cast<float>(op_data->input_anchors.scale), kNumCoordBox,
-            &anchor);
-        break;
-        // Float
-      case kTfLiteFloat32: {
-		//DEBUG0("type: kTfLiteFloat32\n");
-        // Please see DequantizeBoxEncodings function for the support detail.
-        const int box_encoding_idx = idx * input_box_encodings->dims->data[2];
-		//DEBUG0("box_encoding_idx=%d\n", box_encoding_idx);
-        const float* boxes = &(tflite::micro::GetTensorData<float>(
-            input_box_encodings)[box_encoding_idx]);
-		//DEBUG0("b0(%f), b1(%f), b2(%f), b3(%f)\n", boxes[0], boxes[1], boxes[2], boxes[3]);
-        box_centersize = *reinterpret_cast<const CenterSizeEncoding*>(boxes);
-        anchor =
-            ReInterpretTensor<const CenterSizeEncoding*>(input_anchors)[idx];
-        break;
-      }
-      default:
-        // Unsupported type.
-        return kTfLiteError;
-    }
+    TF_LITE_ENSURE_STATUS(GetCenterSizeEncoding(
+        input_box_encodings, op_data->input_box_encodings,
+        input_box_encodings->dims->data[2], idx, &box_centersize));
+    TF_LITE_ENSURE_STATUS(GetCenterSizeEncoding(input_anchors,
+                                                op_data->input_anchors,
+                                                kNumCoordBox, idx, &anchor));
 
     float ycenter = box_centersize.y / scale_values.y * anchor.h + anchor.y;
     float xcenter = box_centersize.x / scale_values.x * anchor.w + anchor.x;
     float half_h = 0.5f * static_cast<float>(std::exp(box_centersize.h / scale_values.h)) * anchor.h;
     float half_w = 0.5f * static_cast<float>(std::exp(box_centersize.w / scale_values.w)) * anchor.w;
 
-	//DEBUG0("idx(%d) center=(%f, %f), w=%f, h=%f\n", idx, xcenter, ycenter, half_w * 2.0, half_h * 2.0);
-    float* decoded_boxes = reinterpret_cast<float*>(
-        context->GetScratchBuffer(context, op_data->decoded_boxes_idx));
-    auto& box = reinterpret_cast<BoxCornerEncoding*>(decoded_boxes)[idx];
-    box.ymin = ycenter - half_h;
-    box.xmin = xcenter - half_w;
-    box.ymax = ycenter + half_h;
-    box.xmax = xcenter + half_w;
-	//DEBUG0("box.xmin(%f), box.ymin(%f), box.xmax(%f), box.ymax(%f)\n", box.xmin, box.ymin, box.xmax, box.ymax);
+    boxes.ymin[idx] = ycenter - half_h;
+    boxes.xmin[idx] = xcenter - half_w;
+    boxes.ymax[idx] = ycenter + half_h;
+    boxes.xmax[idx] = xcenter + half_w;
+    boxes.area[idx] = (boxes.ymax[idx] - boxes.ymin[idx]) *
+                      (boxes.xmax[idx] - boxes.xmin[idx]);
   }
   return kTfLiteOk;
 }
 
-void DecreasingPartialArgSort(const float* values, int num_values,
+// Sorts the first |num_to_sort| of |indices| by decreasing value. Equal values
+// keep the order of their indices, so the result does not depend on the sort
+// implementation.
+template <typename T>
+void DecreasingPartialArgSort(const T* values, int num_values,
                               int num_to_sort, int* indices) {
   std::iota(indices, indices + num_values, 0);
-  std::partial_sort(
-      indices, indices + num_to_sort, indices + num_values,
-      [&values](const int i, const int j) { return values[i] > values[j]; });
+  std::partial_sort(indices, indices + num_to_sort, indices + num_values,
+                    [&values](const int i, const int j) {
+                      return values[i] > values[j] ||
+                             (values[i] == values[j] && i < j);
+                    });
 }
 
-int SelectDetectionsAboveScoreThreshold(const float* values, int size,
-                                        const float threshold,
-                                        float* keep_values, int* keep_indices) {
-  int counter = 0;
-  for (int i = 0; i < size; i++) {
-    if (values[i] >= threshold) {
-      keep_values[counter++] = values[i];
-      keep_indices[i] = i;
-    }
-  }
-  return counter;
-}
-
-bool ValidateBoxes(const float* decoded_boxes, const int num_boxes) {
-  DEBUG0("%s (%d) %s\n", __FUNCTION__, __LINE__, __FILE__);
-  DEBUG0("num_boxes=%d\n", num_boxes);
-  for (int i = 0; i < num_boxes; ++i) {
+bool ValidateBoxes(const DecodedBoxes& boxes, const int num_boxes) {
+  for (int idx = 0; idx < num_boxes; ++idx) {
     // ymax>=ymin, xmax>=xmin
-    auto& box = reinterpret_cast<const BoxCornerEncoding*>(decoded_boxes)[i];
-    if (box.ymin >= box.ymax || box.xmin >= box.xmax) {
+    if (boxes.ymin[idx] >= boxes.ymax[idx] ||
+        boxes.xmin[idx] >= boxes.xmax[idx]) {
       return false;
     }
   }
   return true;
 }
 
-float ComputeIntersectionOverUnion(const float* decoded_boxes, const int i,
-                                   const int j) {
-  auto& box_i = reinterpret_cast<const BoxCornerEncoding*>(decoded_boxes)[i];
-  auto& box_j = reinterpret_cast<const BoxCornerEncoding*>(decoded_boxes)[j];
-  const float area_i = (box_i.ymax - box_i.ymin) * (box_i.xmax - box_i.xmin);
-  const float area_j = (box_j.ymax - box_j.ymin) * (box_j.xmax - box_j.xmin);
-  if (area_i <= 0 || area_j <= 0) return 0.0;
-  const float intersection_ymin = std::max<float>(box_i.ymin, box_j.ymin);
-  const float intersection_xmin = std::max<float>(box_i.xmin, box_j.xmin);
-  const float intersection_ymax = std::min<float>(box_i.ymax, box_j.ymax);
-  const float intersection_xmax = std::min<float>(box_i.xmax, box_j.xmax);
+// Returns true if the IoU of box |index| of |boxes| and box |k| of |selected|
+// is above |iou_threshold|. Boxes without area do not overlap anything.
+inline bool IsSuppressedBy(const DecodedBoxes& boxes, int index,
+                           const DecodedBoxes& selected, int k,
+                           float iou_threshold) {
+  if (selected.area[k] <= 0 || boxes.area[index] <= 0) return false;
+  const float intersection_ymin =
+      std::max<float>(selected.ymin[k], boxes.ymin[index]);
+  const float intersection_xmin =
+      std::max<float>(selected.xmin[k], boxes.xmin[index]);
+  const float intersection_ymax =
+      std::min<float>(selected.ymax[k], boxes.ymax[index]);
+  const float intersection_xmax =
+      std::min<float>(selected.xmax[k], boxes.xmax[index]);
   const float intersection_area =
-      std::max<float>(intersection_ymax - intersection_ymin, 0.0) *
-      std::max<float>(intersection_xmax - intersection_xmin, 0.0);
-  return intersection_area / (area_i + area_j - intersection_area);
+      std::max<float>(intersection_ymax - intersection_ymin, 0.0f) *
+      std::max<float>(intersection_xmax - intersection_xmin, 0.0f);
+  return intersection_area / (selected.area[k] + boxes.area[index] -
+                              intersection_area) >
+         iou_threshold;
 }
 
-// NonMaxSuppressionSingleClass() prunes out the box locations with high overlap
-// before selecting the highest scoring boxes (max_detections in number)
-// It assumes all boxes are good in beginning and sorts based on the scores.
-// If lower-scoring box has too much overlap with a higher-scoring box,
-// we get rid of the lower-scoring box.
-// Complexity is O(N^2) pairwise comparison between boxes
-TfLiteStatus NonMaxSuppressionSingleClassHelper(
-    TfLiteContext* context, TfLiteNode* node, OpData* op_data,
-    const float* scores, int* selected, int* selected_size,
-    int max_detections) {
-
-  DEBUG0("%s (%d) %s\n", __FUNCTION__, __LINE__, __FILE__);
-  const TfLiteEvalTensor* input_box_encodings =
-      tflite::micro::GetEvalInput(context, node, kInputTensorBoxEncodings);
-  const int num_boxes = input_box_encodings->dims->data[1];
-  const float non_max_suppression_score_threshold =
-      op_data->non_max_suppression_score_threshold;
-  const float intersection_over_union_threshold =
-      op_data->intersection_over_union_threshold;
-  // Maximum detections should be positive.
-  TF_LITE_ENSURE(context, (max_detections >= 0));
-  // intersection_over_union_threshold should be positive
-  // and should be less than 1.
-  TF_LITE_ENSURE(context, (intersection_over_union_threshold > 0.0f) &&
-                              (intersection_over_union_threshold <= 1.0f));
-  // Validate boxes
-  float* decoded_boxes = reinterpret_cast<float*>(
-      context->GetScratchBuffer(context, op_data->decoded_boxes_idx));
+#ifdef TFLITE_X86_SIMD
+// Same as IsSuppressedBy() for |count| selected boxes starting at |k|, four
+// at a time. Returns the number of boxes checked, which stops at the first
+// block that suppresses the box.
+TFLITE_TARGET_SSE41 int CheckSuppressedSse41(const DecodedBoxes& boxes,
+                                             int index,
+                                             const DecodedBoxes& selected,
+                                             int count, float iou_threshold,
+                                             bool* suppressed) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 threshold = _mm_set1_ps(iou_threshold);
+  const __m128 ymin = _mm_set1_ps(boxes.ymin[index]);
+  const __m128 xmin = _mm_set1_ps(boxes.xmin[index]);
+  const __m128 ymax = _mm_set1_ps(boxes.ymax[index]);
+  const __m128 xmax = _mm_set1_ps(boxes.xmax[index]);
+  const __m128 area = _mm_set1_ps(boxes.area[index]);
+  int k = 0;
+  for (; k + 4 <= count; k += 4) {
+    const __m128 selected_area = _mm_loadu_ps(selected.area + k);
+    const __m128 height = _mm_max_ps(
+        _mm_sub_ps(_mm_min_ps(_mm_loadu_ps(selected.ymax + k), ymax),
+                   _mm_max_ps(_mm_loadu_ps(selected.ymin + k), ymin)),
+        zero);
+    const __m128 width = _mm_max_ps(
+        _mm_sub_ps(_mm_min_ps(_mm_loadu_ps(selected.xmax + k), xmax),
+                   _mm_max_ps(_mm_loadu_ps(selected.xmin + k), xmin)),
+        zero);
+    const __m128 intersection_area = _mm_mul_ps(height, width);
+    const __m128 iou = _mm_div_ps(
+        intersection_area,
+        _mm_sub_ps(_mm_add_ps(selected_area, area), intersection_area));
+    const __m128 mask = _mm_and_ps(_mm_cmpgt_ps(iou, threshold),
+                                   _mm_cmpgt_ps(selected_area, zero));
+    if (_mm_movemask_ps(mask) != 0) {
+      *suppressed = true;
+      return k + 4;
+    }
+  }
+  *suppressed = false;
+  return k;
+}
+#endif
 
-  TF_LITE_ENSURE(context, ValidateBoxes(decoded_boxes, num_boxes));
+// Returns true if box |index| overlaps one of the first |count| boxes of
+// |selected| by more than |iou_threshold|.
+bool IsSuppressed(const DecodedBoxes& boxes, int index,
+                  const DecodedBoxes& selected, int count,
+                  float iou_threshold) {
+  if (boxes.area[index] <= 0) return false;
+  int k = 0;
+#ifdef TFLITE_X86_SIMD
+  if (TestCPUFeatureSse41()) {
+    bool suppressed;
+    k = CheckSuppressedSse41(boxes, index, selected, count, iou_threshold,
+                             &suppressed);
+    if (suppressed) return true;
+  }
+#endif
+  for (; k < count; ++k) {
+    if (IsSuppressedBy(boxes, index, selected, k, iou_threshold)) return true;
+  }
+  return false;
+}
 
-  // threshold scores
-  int* keep_indices = reinterpret_cast<int*>(
-      context->GetScratchBuffer(context, op_data->keep_indices_idx));
-  float* keep_scores = reinterpret_cast<float*>(
-      context->GetScratchBuffer(context, op_data->keep_scores_idx));
-  int num_scores_kept = SelectDetectionsAboveScoreThreshold(
-      scores, num_boxes, non_max_suppression_score_threshold, keep_scores,
-      keep_indices);
-  int* sorted_indices = reinterpret_cast<int*>(
-      context->GetScratchBuffer(context, op_data->sorted_indices_idx));
+// NonMaxSuppressionSingleClass() prunes out the box locations with high overlap
+// before selecting the highest scoring boxes (max_detections in number).
+// Of the |num_anchors| anchors listed in |anchors|, the ones with a score of at
+// least score_threshold are visited in order of decreasing score,
+// and a box is selected unless it overlaps a box that was selected before it.
+// This gives the same result as suppressing all the lower-scoring boxes that
+// overlap each selected box, but only compares against the selected boxes and
+// stops as soon as max_detections are found, so the complexity is
+// O(N * max_detections) box comparisons plus O(N log N) for the ordering.
+// Writes the selected box indices to workspace.selected and returns how many
+// there are.
+int NonMaxSuppressionSingleClass(const DecodedBoxes& boxes,
+                                 const int* anchors, int num_anchors,
+                                 const float* scores, float score_threshold,
+                                 float iou_threshold, int max_detections,
+                                 const NmsWorkspace& workspace) {
+  int* candidates = workspace.candidates;
+  int num_candidates = 0;
+  for (int i = 0; i < num_anchors; ++i) {
+    if (scores[anchors[i]] >= score_threshold) {
+      candidates[num_candidates++] = anchors[i];
+    }
+  }
+  // A heap only orders the candidates that are actually visited.
+  auto lower_score = [scores](const int i, const int j) {
+    return scores[i] < scores[j] || (scores[i] == scores[j] && i > j);
+  };
+  std::make_heap(candidates, candidates + num_candidates, lower_score);
 
-  DecreasingPartialArgSort(keep_scores, num_scores_kept, num_scores_kept,
-                           sorted_indices);
+  const DecodedBoxes& selected_boxes = workspace.selected_boxes;
+  int selected_size = 0;
+  while (selected_size < max_detections && num_candidates > 0) {
+    std::pop_heap(candidates, candidates + num_candidates, lower_score);
+    const int index = candidates[--num_candidates];
+    if (IsSuppressed(boxes, index, selected_boxes, selected_size,
+                     iou_threshold)) {
+      continue;
+    }
+    selected_boxes.ymin[selected_size] = boxes.ymin[index];
+    selected_boxes.xmin[selected_size] = boxes.xmin[index];
+    selected_boxes.ymax[selected_size] = boxes.ymax[index];
+    selected_boxes.xmax[selected_size] = boxes.xmax[index];
+    selected_boxes.area[selected_size] = boxes.area[index];
+    workspace.selected[selected_size++] = index;
+  }
+  return selected_size;
+}
 
-  const int num_boxes_kept = num_scores_kept;
-  const int output_size = std::min(num_boxes_kept, max_detections);
-  *selected_size = 0;
+// Reorders the |count| kept detections of |workspace| by decreasing score and
+// keeps the first |max_count| of them.
+void KeepTopScores(const NmsWorkspace& workspace, int count, int max_count) {
+  const int num_to_sort = std::min(count, max_count);
+  DecreasingPartialArgSort(workspace.kept_scores, count, num_to_sort,
+                           workspace.sort_indices);
+  for (int row = 0; row < num_to_sort; row++) {
+    workspace.sort_values[row] =
+        workspace.kept_scores[workspace.sort_indices[row]];
+    workspace.sort_indices[row] =
+        workspace.kept_indices[workspace.sort_indices[row]];
+  }
+  for (int row = 0; row < num_to_sort; row++) {
+    workspace.kept_indices[row] = workspace.sort_indices[row];
+    workspace.kept_scores[row] = workspace.sort_values[row];
+  }
+  *workspace.num_kept = num_to_sort;
+}
 
-  int num_active_candidate = num_boxes_kept;
-  uint8_t* active_box_candidate = reinterpret_cast<uint8_t*>(
-      context->GetScratchBuffer(context, op_data->active_candidate_idx));
+// The classes handled by each task of a regular NMS. Every task keeps the best
+// max_detections detections of its classes in its own workspace.
+template <typename T>
+struct RegularNmsTask {
+  const OpData& op_data;
+  const DecodedBoxes& boxes;
+  int num_boxes;
+  const int* anchors;
+  int num_anchors;
+  const T* scores;
+  int num_classes_with_background;
+  int label_offset;
+  uint8_t* workspaces;
+  int num_tasks;
+};
 
-  for (int row = 0; row < num_boxes_kept; row++) {
-    active_box_candidate[row] = 1;
-  }
-  for (int i = 0; i < num_boxes_kept; ++i) {
-    if (num_active_candidate == 0 || *selected_size >= output_size) break;
-    if (active_box_candidate[i] == 1) {
-      selected[(*selected_size)++] = keep_indices[sorted_indices[i]];
-      active_box_candidate[i] = 0;
-      num_active_candidate--;
-    } else {
-      continue;
+template <typename T>
+void RunRegularNmsTask(void* arg, int task_index) {
+  const RegularNmsTask<T>& task = *static_cast<RegularNmsTask<T>*>(arg);
+  const OpData& op_data = task.op_data;
+  NmsWorkspace workspace;
+  LayoutNmsWorkspace(
+      op_data, task.num_boxes,
+      task.workspaces + task_index * op_data.nms_workspace_stride, &workspace);
+  *workspace.num_kept = 0;
+
+  int col, col_end;
+  GetTaskRange(op_data.num_classes, task.num_tasks, task_index, &col,
+               &col_end);
+  for (; col < col_end; col++) {
+    for (int i = 0; i < task.num_anchors; i++) {
+      // Get scores of boxes corresponding to the candidate anchors for single
+      // class
+      const int row = task.anchors[i];
+      workspace.class_scores[row] = static_cast<float>(
+          task.scores[row * task.num_classes_with_background + col +
+                      task.label_offset]);
     }
-    for (int j = i + 1; j < num_boxes_kept; ++j) {
-      if (active_box_candidate[j] == 1) {
-        float intersection_over_union = ComputeIntersectionOverUnion(
-            decoded_boxes, keep_indices[sorted_indices[i]],
-            keep_indices[sorted_indices[j]]);
-
-        if (intersection_over_union > intersection_over_union_threshold) {
-          active_box_candidate[j] = 0;
-          num_active_candidate--;
-        }
-      }
+    // Perform non-maximal suppression on single class
+    const int selected_size = NonMaxSuppressionSingleClass(
+        task.boxes, task.anchors, task.num_anchors, workspace.class_scores,
+        op_data.score_threshold,
+        op_data.intersection_over_union_threshold,
+        op_data.detections_per_class, workspace);
+    // Add selected indices from non-max suppression of boxes in this class
+    int output_index = *workspace.num_kept;
+    for (int i = 0; i < selected_size; i++) {
+      const int selected_index = workspace.selected[i];
+      workspace.kept_indices[output_index] =
+          (selected_index * task.num_classes_with_background + col +
+           task.label_offset);
+      workspace.kept_scores[output_index] =
+          workspace.class_scores[selected_index];
+      output_index++;
     }
+    // Keep the top scores among the selected indices
+    KeepTopScores(workspace, output_index, op_data.max_detections);
   }
-
-  return kTfLiteOk;
 }
 
 // This function implements a regular version of Non Maximal Suppression (NMS)
 // for multiple classes where
 // 1) we do NMS separately for each class across all anchors and
 // 2) keep only the highest anchor scores across all classes
-// 3) The worst runtime of the regular NMS is O(K*N^2)
-// where N is the number of anchors and K the number of
-// classes.
-TfLiteStatus NonMaxSuppressionMultiClassRegularHelper(TfLiteContext* context,
-                                                      TfLiteNode* node,
-                                                      OpData* op_data,
-                                                      const float* scores) {
+// 3) The worst runtime of the regular NMS is O(K*N*D)
+// where N is the number of anchors, K the number of classes and D the
+// detections per class. The classes are independent, so they are split
+// across the threads of the thread pool, if there is one.
+template <typename T>
+TfLiteStatus NonMaxSuppressionMultiClassRegularHelper(
+    TfLiteContext* context, TfLiteNode* node, OpData* op_data, const T* scores,
+    const int* anchors, int num_anchors) {
   const TfLiteEvalTensor* input_box_encodings =
       tflite::micro::GetEvalInput(context, node, kInputTensorBoxEncodings);
   const TfLiteEvalTensor* input_class_predictions =
@@ -538,64 +784,52 @@ TfLiteStatus NonMaxSuppressionMultiClassRegularHelper(TfLiteContext* context,
   int label_offset = num_classes_with_background - num_classes;
   TF_LITE_ENSURE(context, num_detections_per_class > 0);
 
-  // For each class, perform non-max suppression.
-  float* class_scores = reinterpret_cast<float*>(
-      context->GetScratchBuffer(context, op_data->score_buffer_idx));
-  int* box_indices_after_regular_non_max_suppression = reinterpret_cast<int*>(
-      context->GetScratchBuffer(context, op_data->buffer_idx));
-  float* scores_after_regular_non_max_suppression =
-      reinterpret_cast<float*>(context->GetScratchBuffer(
-          context, op_data->scores_after_regular_non_max_suppression_idx));
-
-  int size_of_sorted_indices = 0;
-  int* sorted_indices = reinterpret_cast<int*>(
-      context->GetScratchBuffer(context, op_data->sorted_indices_idx));
-  float* sorted_values = reinterpret_cast<float*>(
-      context->GetScratchBuffer(context, op_data->sorted_values_idx));
-
-  for (int col = 0; col < num_classes; col++) {
-    for (int row = 0; row < num_boxes; row++) {
-      // Get scores of boxes corresponding to all anchors for single class
-      class_scores[row] =
-          *(scores + row * num_classes_with_background + col + label_offset);
-    }
-    // Perform non-maximal suppression on single class
-    int selected_size = 0;
-    int* selected = reinterpret_cast<int*>(
-        context->GetScratchBuffer(context, op_data->selected_idx));
-    TF_LITE_ENSURE_STATUS(NonMaxSuppressionSingleClassHelper(
-        context, node, op_data, class_scores, selected, &selected_size,
-        num_detections_per_class));
-    // Add selected indices from non-max suppression of boxes in this class
-    int output_index = size_of_sorted_indices;
-    for (int i = 0; i < selected_size; i++) {
-      int selected_index = selected[i];
+  const DecodedBoxes boxes = GetDecodedBoxes(context, op_data, num_boxes);
+  uint8_t* workspaces = static_cast<uint8_t*>(
+      context->GetScratchBuffer(context, op_data->nms_workspace_idx));
+
+  MicroThreadPool* thread_pool = GetMicroThreadPool(context);
+  const int num_tasks = GetNumTasks(
+      thread_pool, op_data->num_threads, num_classes,
+      static_cast<int64_t>(num_anchors) * num_detections_per_class *
+          kNmsComparisonCost);
+  RegularNmsTask<T> task = {*op_data,
+                            boxes,
+                            num_boxes,
+                            anchors,
+                            num_anchors,
+                            scores,
+                            num_classes_with_background,
+                            label_offset,
+                            workspaces,
+                            num_tasks};
+  if (num_tasks == 1) {
+    RunRegularNmsTask<T>(&task, 0);
+  } else {
+    thread_pool->Run(num_tasks, RunRegularNmsTask<T>, &task);
+  }
 
-      box_indices_after_regular_non_max_suppression[output_index] =
-          (selected_index * num_classes_with_background + col + label_offset);
-      scores_after_regular_non_max_suppression[output_index] =
-          class_scores[selected_index];
-      output_index++;
-    }
-    // Sort the max scores among the selected indices
-    // Get the indices for top scores
-    int num_indices_to_sort = std::min(output_index, max_detections);
-    DecreasingPartialArgSort(scores_after_regular_non_max_suppression,
-                             output_index, num_indices_to_sort, sorted_indices);
-
-    // Copy values to temporary vectors
-    for (int row = 0; row < num_indices_to_sort; row++) {
-      int temp = sorted_indices[row];
-      sorted_indices[row] = box_indices_after_regular_non_max_suppression[temp];
-      sorted_values[row] = scores_after_regular_non_max_suppression[temp];
+  // Merge the detections kept by the other tasks into the first one. The
+  // tasks cover increasing class ranges, so equal scores end up in the same
+  // order as with a single task.
+  NmsWorkspace merged;
+  LayoutNmsWorkspace(*op_data, num_boxes, workspaces, &merged);
+  for (int i = 1; i < num_tasks; ++i) {
+    NmsWorkspace other;
+    LayoutNmsWorkspace(*op_data, num_boxes,
+                       workspaces + i * op_data->nms_workspace_stride, &other);
+    int count = *merged.num_kept;
+    for (int row = 0; row < *other.num_kept; ++row) {
+      merged.kept_indices[count] = other.kept_indices[row];
+      merged.kept_scores[count] = other.kept_scores[row];
+      count++;
     }
-    // Copy scores and indices from temporary vectors
-    for (int row = 0; row < num_indices_to_sort; row++) {
-      box_indices_after_regular_non_max_suppression[row] = sorted_indices[row];
-      scores_after_regular_non_max_suppression[row] = sorted_values[row];
-    }
-    size_of_sorted_indices = num_indices_to_sort;
+    KeepTopScores(merged, count, max_detections);
   }
+  const int size_of_sorted_indices = *merged.num_kept;
+  const int* box_indices_after_regular_non_max_suppression =
+      merged.kept_indices;
+  const float* scores_after_regular_non_max_suppression = merged.kept_scores;
 
   // Allocate output tensors
   for (int output_box_index = 0; output_box_index < max_detections;
@@ -607,13 +841,11 @@ TfLiteStatus NonMaxSuppressionMultiClassRegularHelper(TfLiteContext* context,
       const int class_index =
           box_indices_after_regular_non_max_suppression[output_box_index] -
           anchor_index * num_classes_with_background - label_offset;
-      const float selected_score =
-          scores_after_regular_non_max_suppression[output_box_index];
+      const float selected_score = DequantizeScore<T>(
+          *op_data, scores_after_regular_non_max_suppression[output_box_index]);
       // detection_boxes
-      float* decoded_boxes = reinterpret_cast<float*>(
-          context->GetScratchBuffer(context, op_data->decoded_boxes_idx));
       ReInterpretTensor<BoxCornerEncoding*>(detection_boxes)[output_box_index] =
-          reinterpret_cast<BoxCornerEncoding*>(decoded_boxes)[anchor_index];
+          GetBoxCornerEncoding(boxes, anchor_index);
       // detection_classes
       tflite::micro::GetTensorData<float>(detection_classes)[output_box_index] =
           class_index;
@@ -644,10 +876,10 @@ TfLiteStatus NonMaxSuppressionMultiClassRegularHelper(TfLiteContext* context,
 // 3) Compared to standard NMS, the worst runtime of this version is O(N^2)
 // instead of O(KN^2) where N is the number of anchors and K the number of
 // classes.
-TfLiteStatus NonMaxSuppressionMultiClassFastHelper(TfLiteContext* context,
-                                                   TfLiteNode* node,
-                                                   OpData* op_data,
-                                                   const float* scores) {
+template <typename T>
+TfLiteStatus NonMaxSuppressionMultiClassFastHelper(
+    TfLiteContext* context, TfLiteNode* node, OpData* op_data, const T* scores,
+    const int* anchors, int num_anchors) {
   const TfLiteEvalTensor* input_box_encodings =
       tflite::micro::GetEvalInput(context, node, kInputTensorBoxEncodings);
   const TfLiteEvalTensor* input_class_predictions =
@@ -677,33 +909,39 @@ TfLiteStatus NonMaxSuppressionMultiClassFastHelper(TfLiteContext* context,
 
   // The row index offset is 1 if background class is included and 0 otherwise.
   int label_offset = num_classes_with_background - num_classes;
-  TF_LITE_ENSURE(context, (max_categories_per_anchor > 0));
   const int num_categories_per_anchor =
       std::min(max_categories_per_anchor, num_classes);
   float* max_scores = reinterpret_cast<float*>(
       context->GetScratchBuffer(context, op_data->score_buffer_idx));
   int* sorted_class_indices = reinterpret_cast<int*>(
       context->GetScratchBuffer(context, op_data->buffer_idx));
+  int* class_order =
+      sorted_class_indices + num_boxes * num_categories_per_anchor;
 
   DEBUG0("[EVAL] max_scores = %p\n", max_scores);
-  for (int row = 0; row < num_boxes; row++) {
-    const float* box_scores =
+  for (int i = 0; i < num_anchors; i++) {
+    const int row = anchors[i];
+    const T* box_scores =
         scores + row * num_classes_with_background + label_offset;
-    int* class_indices = sorted_class_indices + row * num_classes;
     DecreasingPartialArgSort(box_scores, num_classes, num_categories_per_anchor,
-                             class_indices);
-    max_scores[row] = box_scores[class_indices[0]];
-	//DEBUG0("max_scores[%d] = %f\n", row, max_scores[row]);
+                             class_order);
+    std::copy(class_order, class_order + num_categories_per_anchor,
+              sorted_class_indices + row * num_categories_per_anchor);
+    max_scores[row] = static_cast<float>(box_scores[class_order[0]]);
   }
 
   // Perform non-maximal suppression on max scores
-  int selected_size = 0;
-  int* selected = reinterpret_cast<int*>(
-      context->GetScratchBuffer(context, op_data->selected_idx));
-
-  TF_LITE_ENSURE_STATUS(NonMaxSuppressionSingleClassHelper(
-      context, node, op_data, max_scores, selected, &selected_size,
-      op_data->max_detections));
+  const DecodedBoxes boxes = GetDecodedBoxes(context, op_data, num_boxes);
+  NmsWorkspace workspace;
+  LayoutNmsWorkspace(*op_data, num_boxes,
+                     static_cast<uint8_t*>(context->GetScratchBuffer(
+                         context, op_data->nms_workspace_idx)),
+                     &workspace);
+  const int selected_size = NonMaxSuppressionSingleClass(
+      boxes, anchors, num_anchors, max_scores, op_data->score_threshold,
+      op_data->intersection_over_union_threshold, op_data->max_detections,
+      workspace);
+  const int* selected = workspace.selected;
 
   // Allocate output tensors
   int output_box_index = 0;
@@ -713,21 +951,18 @@ TfLiteStatus NonMaxSuppressionMultiClassFastHelper(TfLiteContext* context,
   	DEBUG0("i(%d) of selected_size=%d\n", i, selected_size);
     int selected_index = selected[i];
 
-    const float* box_scores =
+    const T* box_scores =
         scores + selected_index * num_classes_with_background + label_offset;
     const int* class_indices =
-        sorted_class_indices + selected_index * num_classes;
+        sorted_class_indices + selected_index * num_categories_per_anchor;
 
     for (int col = 0; col < num_categories_per_anchor; ++col) {
       int box_offset = num_categories_per_anchor * output_box_index + col;
 	  DEBUG0("col=%d, box_offset=%d\n", col, box_offset);
 
       // detection_boxes
-      float* decoded_boxes = reinterpret_cast<float*>(
-          context->GetScratchBuffer(context, op_data->decoded_boxes_idx));
-
       ReInterpretTensor<BoxCornerEncoding*>(detection_boxes)[box_offset] =
-          reinterpret_cast<BoxCornerEncoding*>(decoded_boxes)[selected_index];
+          GetBoxCornerEncoding(boxes, selected_index);
 
 	  float *_class = tflite::micro::GetTensorData<float>(detection_classes);
 	  float *_score = tflite::micro::GetTensorData<float>(detection_scores);
@@ -743,7 +978,7 @@ TfLiteStatus NonMaxSuppressionMultiClassFastHelper(TfLiteContext* context,
 
       // detection_scores
       tflite::micro::GetTensorData<float>(detection_scores)[box_offset] =
-          box_scores[class_indices[col]];
+          DequantizeScore<T>(*op_data, box_scores[class_indices[col]]);
 
 #if 0
 	  BoxCornerEncoding b = ReInterpretTensor<BoxCornerEncoding*>(detection_boxes)[box_offset];
@@ -782,22 +1017,25 @@ TfLiteStatus NonMaxSuppressionMultiClassFastHelper(TfLiteContext* context,
   return kTfLiteOk;
 }
 
-void DequantizeClassPredictions(const TfLiteEvalTensor* input_class_predictions,
-                                const int num_boxes,
-                                const int num_classes_with_background,
-                                float* scores, OpData* op_data) {
-  float quant_zero_point =
-      static_cast<float>(op_data->input_class_predictions.zero_point);
-  float quant_scale =
-      static_cast<float>(op_data->input_class_predictions.scale);
-  Dequantizer dequantize(quant_zero_point, quant_scale);
-  const uint8_t* scores_quant =
-      tflite::micro::GetTensorData<uint8_t>(input_class_predictions);
-  for (int idx = 0; idx < num_boxes * num_classes_with_background; ++idx) {
-    scores[idx] = dequantize(scores_quant[idx]);
+// Collects the anchors with at least one class score of score_threshold or
+// more. No other anchor can be selected by either NMS.
+template <typename T>
+int SelectCandidateAnchors(const T* scores, int num_boxes, int num_classes,
+                           int num_classes_with_background, int label_offset,
+                           float score_threshold, int* anchors) {
+  int num_anchors = 0;
+  for (int row = 0; row < num_boxes; row++) {
+    const T* box_scores =
+        scores + row * num_classes_with_background + label_offset;
+    const T max_score = *std::max_element(box_scores, box_scores + num_classes);
+    if (static_cast<float>(max_score) >= score_threshold) {
+      anchors[num_anchors++] = row;
+    }
   }
+  return num_anchors;
 }
 
+template <typename T>
 TfLiteStatus NonMaxSuppressionMultiClass(TfLiteContext* context,
                                          TfLiteNode* node, OpData* op_data) {
   // Get the input tensors
@@ -817,32 +1055,35 @@ TfLiteStatus NonMaxSuppressionMultiClass(TfLiteContext* context,
   TF_LITE_ENSURE(context, (num_classes_with_background - num_classes <= 1));
   TF_LITE_ENSURE(context, (num_classes_with_background >= num_classes));
 
-  const float* scores;
-  switch (input_class_predictions->type) {
-    case kTfLiteUInt8: {
-      float* temporary_scores = reinterpret_cast<float*>(
-          context->GetScratchBuffer(context, op_data->scores_idx));
-      DequantizeClassPredictions(input_class_predictions, num_boxes,
-                                 num_classes_with_background, temporary_scores,
-                                 op_data);
-      scores = temporary_scores;
-    } break;
-    case kTfLiteFloat32:
-      scores = tflite::micro::GetTensorData<float>(input_class_predictions);
-      break;
-    default:
-      // Unsupported type.
-      return kTfLiteError;
-  }
+  // Maximum detections should be positive.
+  TF_LITE_ENSURE(context, (op_data->max_detections >= 0));
+  // intersection_over_union_threshold should be positive
+  // and should be less than 1.
+  TF_LITE_ENSURE(context,
+                 (op_data->intersection_over_union_threshold > 0.0f) &&
+                     (op_data->intersection_over_union_threshold <= 1.0f));
+
+  // Every box is decoded and validated, so that an invalid box fails the op
+  // whatever its scores are. Then the scores are thresholded in the type of
+  // the class predictions, and NMS only visits the anchors that pass.
+  TF_LITE_ENSURE_STATUS(DecodeCenterSizeBoxes(context, node, op_data));
+  TF_LITE_ENSURE(context, ValidateBoxes(GetDecodedBoxes(context, op_data,
+                                                        num_boxes),
+                                        num_boxes));
+  const T* scores = tflite::micro::GetTensorData<T>(input_class_predictions);
+  int* anchors = reinterpret_cast<int*>(
+      context->GetScratchBuffer(context, op_data->candidate_anchors_idx));
+  const int num_anchors = SelectCandidateAnchors(
+      scores, num_boxes, num_classes, num_classes_with_background,
+      num_classes_with_background - num_classes, op_data->score_threshold,
+      anchors);
 
   if (op_data->use_regular_non_max_suppression) {
-	//DEBUG0("op_data->user_regular_non_max_suppression\n");
     TF_LITE_ENSURE_STATUS(NonMaxSuppressionMultiClassRegularHelper(
-        context, node, op_data, scores));
+        context, node, op_data, scores, anchors, num_anchors));
   } else {
-	//DEBUG0("NOT op_data->user_regular_non_max_suppression\n");
-    TF_LITE_ENSURE_STATUS(
-        NonMaxSuppressionMultiClassFastHelper(context, node, op_data, scores));
+    TF_LITE_ENSURE_STATUS(NonMaxSuppressionMultiClassFastHelper(
+        context, node, op_data, scores, anchors, num_anchors));
   }
 
   return kTfLiteOk;
@@ -863,24 +1104,24 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE(context, (kBatchSize == 1));
   auto* op_data = static_cast<OpData*>(node->user_data);
 
-  // These two functions correspond to two blocks in the Object Detection model.
-  // In future, we would like to break the custom op in two blocks, which is
-  // currently not feasible because we would like to input quantized inputs
-  // and do all calculations in float. Mixed quantized/float calculations are
-  // currently not supported in TFLite.
-
-  // This fills in temporary decoded_boxes
-  // by transforming input_box_encodings and input_anchors from
-  // CenterSizeEncodings to BoxCornerEncoding
-  TF_LITE_ENSURE_STATUS(DecodeCenterSizeBoxes(context, node, op_data));
-
-  // This fills in the output tensors
-  // by choosing effective set of decoded boxes
-  // based on Non Maximal Suppression, i.e. selecting
-  // highest scoring non-overlapping boxes.
-  TF_LITE_ENSURE_STATUS(NonMaxSuppressionMultiClass(context, node, op_data));
-
-  return kTfLiteOk;
+  // This fills in the output tensors by choosing effective set of decoded
+  // boxes based on Non Maximal Suppression, i.e. selecting highest scoring
+  // non-overlapping boxes. The class scores stay in the type of the class
+  // predictions, and only the boxes of the anchors that pass the score
+  // threshold are transformed from CenterSizeEncoding to BoxCornerEncoding.
+  const TfLiteEvalTensor* input_class_predictions =
+      tflite::micro::GetEvalInput(context, node, kInputTensorClassPredictions);
+  switch (input_class_predictions->type) {
+    case kTfLiteFloat32:
+      return NonMaxSuppressionMultiClass<float>(context, node, op_data);
+    case kTfLiteUInt8:
+      return NonMaxSuppressionMultiClass<uint8_t>(context, node, op_data);
+    case kTfLiteInt8:
+      return NonMaxSuppressionMultiClass<int8_t>(context, node, op_data);
+    default:
+      // Unsupported type.
+      return kTfLiteError;
+  }
 }
 
 }  // namespace
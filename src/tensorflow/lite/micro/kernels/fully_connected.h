@@ -34,6 +34,12 @@ TfLiteRegistration Register_FULLY_CONNECTED();
 // supports int8.
 TfLiteRegistration Register_FULLY_CONNECTED_INT8();
 
+// Returns a TfLiteRegistration struct for the cmsis-nn kernel variant that
+// repacks constant int8 weights into persistent arena memory during Prepare,
+// for the host SIMD kernels to consume. Trades arena space for speed, so it
+// has to be selected explicitly.
+TfLiteRegistration Register_FULLY_CONNECTED_PACKED();
+
 #else
 // Note that while this block gets used for both reference and optimized kernels
 // that do not have any specialized implementations, the only goal here is to
@@ -44,6 +50,10 @@ inline TfLiteRegistration Register_FULLY_CONNECTED_INT8() {
   return Register_FULLY_CONNECTED();
 }
 
+inline TfLiteRegistration Register_FULLY_CONNECTED_PACKED() {
+  return Register_FULLY_CONNECTED();
+}
+
 #endif
 }  // namespace tflite
 
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/lite/micro/kernels/kernel_runner.h"
 
+#include <cstring>
+
 namespace tflite {
 namespace micro {
 
@@ -44,7 +46,9 @@ KernelRunner::KernelRunner(const TfLiteRegistration& registration,
   context_.GetEvalTensor = GetEvalTensor;
   context_.AllocatePersistentBuffer = AllocatePersistentBuffer;
   context_.RequestScratchBufferInArena = RequestScratchBufferInArena;
+  context_.AllocateStateBuffer = AllocateStateBuffer;
   context_.GetScratchBuffer = GetScratchBuffer;
+  context_.GetExternalContext = GetExternalContext;
 
   // Prepare TfLiteNode:
   node_.inputs = inputs;
@@ -69,7 +73,17 @@ TfLiteStatus KernelRunner::Invoke() {
                          "TfLiteRegistration missing invoke function pointer!");
     return kTfLiteError;
   }
-  return registration_.invoke(&context_, &node_);
+  const TfLiteStatus status = registration_.invoke(&context_, &node_);
+  // Like MicroInterpreter, release the eval tensors the kernel looked up so
+  // that a runner can be invoked any number of times.
+  allocator_->ResetTempAllocations();
+  return status;
+}
+
+void KernelRunner::SetThreadPool(MicroThreadPool* thread_pool) {
+  thread_pool_ = thread_pool;
+  context_.recommended_num_threads =
+      thread_pool != nullptr ? thread_pool->num_threads() : 1;
 }
 
 TfLiteTensor* KernelRunner::GetTensor(const struct TfLiteContext* context,
@@ -138,6 +152,17 @@ TfLiteStatus KernelRunner::RequestScratchBufferInArena(TfLiteContext* context,
   return kTfLiteOk;
 }
 
+void* KernelRunner::AllocateStateBuffer(TfLiteContext* context, size_t bytes,
+                                        int* buffer_index) {
+  // Scratch buffers already keep their contents, they only need zeroing.
+  if (RequestScratchBufferInArena(context, bytes, buffer_index) != kTfLiteOk) {
+    return nullptr;
+  }
+  void* buffer = GetScratchBuffer(context, *buffer_index);
+  memset(buffer, 0, bytes);
+  return buffer;
+}
+
 void* KernelRunner::GetScratchBuffer(TfLiteContext* context, int buffer_index) {
   TFLITE_DCHECK(context != nullptr);
   KernelRunner* runner = reinterpret_cast<KernelRunner*>(context->impl_);
@@ -162,5 +187,17 @@ void KernelRunner::ReportOpError(struct TfLiteContext* context,
   va_end(args);
 }
 
+TfLiteExternalContext* KernelRunner::GetExternalContext(
+    struct TfLiteContext* context, TfLiteExternalContextType type) {
+  TFLITE_DCHECK(context != nullptr);
+  KernelRunner* runner = reinterpret_cast<KernelRunner*>(context->impl_);
+  TFLITE_DCHECK(runner != nullptr);
+
+  if (type != kTfLiteCpuBackendContext) {
+    return nullptr;
+  }
+  return runner->thread_pool_;
+}
+
 }  // namespace micro
 }  // namespace tflite
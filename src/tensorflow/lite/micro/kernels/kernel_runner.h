@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/compatibility.h"
+#include "tensorflow/lite/micro/micro_thread_pool.h"
 #include "tensorflow/lite/micro/simple_memory_allocator.h"
 
 namespace tflite {
@@ -47,6 +48,10 @@ class KernelRunner {
   // passed into the constructor of this class.
   TfLiteStatus Invoke();
 
+  // Makes |thread_pool| available to the kernel. Must be called before
+  // InitAndPrepare() so that the kernel can size its buffers for it.
+  void SetThreadPool(MicroThreadPool* thread_pool);
+
  protected:
   static TfLiteTensor* GetTensor(const struct TfLiteContext* context,
                                  int tensor_index);
@@ -56,9 +61,13 @@ class KernelRunner {
   static TfLiteStatus RequestScratchBufferInArena(TfLiteContext* context,
                                                   size_t bytes,
                                                   int* buffer_index);
+  static void* AllocateStateBuffer(TfLiteContext* context, size_t bytes,
+                                   int* buffer_index);
   static void* GetScratchBuffer(TfLiteContext* context, int buffer_index);
   static void ReportOpError(struct TfLiteContext* context, const char* format,
                             ...);
+  static TfLiteExternalContext* GetExternalContext(
+      struct TfLiteContext* context, TfLiteExternalContextType type);
 
  private:
   static constexpr int kNumScratchBuffers_ = 12;
@@ -76,6 +85,8 @@ class KernelRunner {
 
   int scratch_buffer_count_ = 0;
   uint8_t* scratch_buffers_[kNumScratchBuffers_];
+
+  MicroThreadPool* thread_pool_ = nullptr;
 };
 
 }  // namespace micro
@@ -37,5 +37,21 @@ const RuntimeShape GetTensorShape(const TfLiteEvalTensor* tensor) {
   return RuntimeShape(dims_size, dims_data);
 }
 
+ConvRowBand GetConvRowBand(int input_height, int filter_height,
+                           int stride_height, int dilation_height,
+                           int pad_height, int output_row_start,
+                           int output_row_end) {
+  TFLITE_DCHECK_LT(output_row_start, output_row_end);
+  const int first_row = output_row_start * stride_height - pad_height;
+  const int last_row = (output_row_end - 1) * stride_height - pad_height +
+                       (filter_height - 1) * dilation_height;
+  ConvRowBand band;
+  band.row_start = first_row < 0 ? 0 : first_row;
+  band.pad_height = band.row_start - first_row;
+  const int row_end = last_row + 1 < input_height ? last_row + 1 : input_height;
+  band.rows = row_end > band.row_start ? row_end - band.row_start : 0;
+  return band;
+}
+
 }  // namespace micro
 }  // namespace tflite
@@ -69,6 +69,23 @@ const RuntimeShape GetTensorShape(const TfLiteEvalTensor* tensor);
 bool HaveSameShapes(const TfLiteEvalTensor* input1,
                     const TfLiteEvalTensor* input2);
 
+// The input rows that a convolution reads to produce a band of output rows,
+// expressed so that the band can be computed as a standalone convolution:
+// rows [row_start, row_start + rows) of the input, with |pad_height| rows of
+// implicit zero padding above them.
+struct ConvRowBand {
+  int row_start;
+  int rows;
+  int pad_height;
+};
+
+// Returns the band of input rows needed for output rows
+// [output_row_start, output_row_end) of a (depthwise) convolution.
+ConvRowBand GetConvRowBand(int input_height, int filter_height,
+                           int stride_height, int dilation_height,
+                           int pad_height, int output_row_start,
+                           int output_row_end);
+
 }  // namespace micro
 }  // namespace tflite
 
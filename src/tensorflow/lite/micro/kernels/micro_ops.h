@@ -37,6 +37,10 @@ TfLiteRegistration Register_QUANTIZE();
 TfLiteRegistration Register_SHAPE();
 TfLiteRegistration Register_SOFTMAX();
 TfLiteRegistration Register_SVDF();
+// Variant that keeps int8 activation_state rows as rings instead of shifting
+// them on every invocation. The ring head lives in the op data, so it must not
+// be used by sessions that share a compiled model. See svdf.cpp.
+TfLiteRegistration Register_SVDF_RING();
 
 namespace ops {
 namespace micro {
@@ -49,6 +53,9 @@ TfLiteRegistration Register_AVERAGE_POOL_2D();
 TfLiteRegistration Register_CEIL();
 // TODO(b/160234179): Change custom OPs to also return by value.
 TfLiteRegistration* Register_CIRCULAR_BUFFER();
+// Variant that keeps its history in a ring state buffer instead of shifting
+// the output tensor on every invocation. See circular_buffer.cpp.
+TfLiteRegistration* Register_CIRCULAR_BUFFER_RING();
 TfLiteRegistration Register_CONCATENATION();
 TfLiteRegistration Register_COS();
 TfLiteRegistration Register_DEQUANTIZE();
@@ -13,7 +13,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
-#include "tensorflow/lite/kernels/internal/reference/resize_nearest_neighbor.h"
+#include "tensorflow/lite/kernels/internal/optimized/resize_bilinear.h"
 
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
@@ -31,7 +31,26 @@ constexpr int kInputTensor = 0;
 constexpr int kSizeTensor = 1;
 constexpr int kOutputTensor = 0;
 
+struct OpData {
+  // Interpolation of each output row and column, computed in Prepare.
+  optimized_ops::ResizeBilinearTap* row_taps;
+  optimized_ops::ResizeBilinearTap* column_taps;
+  // Index of the scratch buffer holding one interpolated input row.
+  int row_buffer_index;
+};
+
+void* Init(TfLiteContext* context, const char* buffer, size_t length) {
+  TFLITE_DCHECK(context->AllocatePersistentBuffer != nullptr);
+  return context->AllocatePersistentBuffer(context, sizeof(OpData));
+}
+
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  TFLITE_DCHECK(node->user_data != nullptr);
+  TFLITE_DCHECK(node->builtin_data != nullptr);
+  OpData* data = static_cast<OpData*>(node->user_data);
+  const auto* params =
+      static_cast<const TfLiteResizeBilinearParams*>(node->builtin_data);
+
   TF_LITE_ENSURE_EQ(context, NumInputs(node), 2);
   TF_LITE_ENSURE_EQ(context, NumOutputs(node), 1);
 
@@ -45,56 +64,86 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE_EQ(context, NumDimensions(size), 1);
   TF_LITE_ENSURE_EQ(context, size->type, kTfLiteInt32);
   TF_LITE_ENSURE_EQ(context, size->dims->data[0], 2);
+  TF_LITE_ENSURE(context,
+                 !params->half_pixel_centers || !params->align_corners);
 
   output->type = input->type;
+  if (input->type != kTfLiteFloat32 && input->type != kTfLiteUInt8 &&
+      input->type != kTfLiteInt8) {
+    TF_LITE_KERNEL_LOG(context,
+                       "Output type is %d, requires float, uint8_t or int8_t.",
+                       output->type);
+    return kTfLiteError;
+  }
 
   if (!IsConstantTensor(size)) {
     TF_LITE_KERNEL_LOG(context, "Dynamic tensors are unsupported in tfmicro.");
     return kTfLiteError;
   }
-  return kTfLiteOk;
+  const int32_t output_height = GetTensorData<int32_t>(size)[0];
+  const int32_t output_width = GetTensorData<int32_t>(size)[1];
+  TF_LITE_ENSURE_EQ(context, NumDimensions(output), 4);
+  TF_LITE_ENSURE_EQ(context, output->dims->data[1], output_height);
+  TF_LITE_ENSURE_EQ(context, output->dims->data[2], output_width);
+
+  // The size is constant, so the interpolation indices and weights are too.
+  tflite::ResizeBilinearParams op_params;
+  op_params.align_corners = params->align_corners;
+  op_params.half_pixel_centers = params->half_pixel_centers;
+  const bool integer = input->type != kTfLiteFloat32;
+  data->row_taps = static_cast<optimized_ops::ResizeBilinearTap*>(
+      context->AllocatePersistentBuffer(
+          context, output_height * sizeof(optimized_ops::ResizeBilinearTap)));
+  data->column_taps = static_cast<optimized_ops::ResizeBilinearTap*>(
+      context->AllocatePersistentBuffer(
+          context, output_width * sizeof(optimized_ops::ResizeBilinearTap)));
+  TF_LITE_ENSURE(context,
+                 data->row_taps != nullptr && data->column_taps != nullptr);
+  optimized_ops::ComputeResizeBilinearTaps(op_params, input->dims->data[1],
+                                           output_height, integer,
+                                           data->row_taps);
+  optimized_ops::ComputeResizeBilinearTaps(op_params, input->dims->data[2],
+                                           output_width, integer,
+                                           data->column_taps);
+
+  // Int32 for integer types and float otherwise, both 4 bytes wide.
+  const int row_size = input->dims->data[2] * input->dims->data[3];
+  return context->RequestScratchBufferInArena(
+      context, row_size * sizeof(int32_t), &data->row_buffer_index);
 }
 
 TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
-  auto* params =
-      reinterpret_cast<TfLiteResizeNearestNeighborParams*>(node->builtin_data);
+  TFLITE_DCHECK(node->user_data != nullptr);
+  const OpData& data = *static_cast<const OpData*>(node->user_data);
 
   const TfLiteEvalTensor* input =
       tflite::micro::GetEvalInput(context, node, kInputTensor);
-  const TfLiteEvalTensor* size =
-      tflite::micro::GetEvalInput(context, node, kSizeTensor);
   TfLiteEvalTensor* output =
       tflite::micro::GetEvalOutput(context, node, kOutputTensor);
-
-  // FIXME: implement the resize bilinear
-  tflite::ResizeNearestNeighborParams op_params;
-  op_params.align_corners = params->align_corners;
-  op_params.half_pixel_centers = false;
+  void* row_buffer = context->GetScratchBuffer(context, data.row_buffer_index);
+  TFLITE_DCHECK(row_buffer != nullptr);
 
   if (output->type == kTfLiteFloat32) {
-    reference_ops::ResizeNearestNeighbor(
-        op_params, tflite::micro::GetTensorShape(input),
-        tflite::micro::GetTensorData<int32_t>(input),
-        tflite::micro::GetTensorShape(size),
-        tflite::micro::GetTensorData<int32_t>(size),
+    optimized_ops::ResizeBilinear(
+        data.row_taps, data.column_taps, tflite::micro::GetTensorShape(input),
+        tflite::micro::GetTensorData<float>(input),
         tflite::micro::GetTensorShape(output),
-        tflite::micro::GetTensorData<int32_t>(output));
+        tflite::micro::GetTensorData<float>(output),
+        static_cast<float*>(row_buffer));
   } else if (output->type == kTfLiteUInt8) {
-    reference_ops::ResizeNearestNeighbor(
-        op_params, tflite::micro::GetTensorShape(input),
+    optimized_ops::ResizeBilinearInteger(
+        data.row_taps, data.column_taps, tflite::micro::GetTensorShape(input),
         tflite::micro::GetTensorData<uint8_t>(input),
-        tflite::micro::GetTensorShape(size),
-        tflite::micro::GetTensorData<int32_t>(size),
         tflite::micro::GetTensorShape(output),
-        tflite::micro::GetTensorData<uint8_t>(output));
+        tflite::micro::GetTensorData<uint8_t>(output),
+        static_cast<int32_t*>(row_buffer));
   } else if (output->type == kTfLiteInt8) {
-    reference_ops::ResizeNearestNeighbor(
-        op_params, tflite::micro::GetTensorShape(input),
+    optimized_ops::ResizeBilinearInteger(
+        data.row_taps, data.column_taps, tflite::micro::GetTensorShape(input),
         tflite::micro::GetTensorData<int8_t>(input),
-        tflite::micro::GetTensorShape(size),
-        tflite::micro::GetTensorData<int32_t>(size),
         tflite::micro::GetTensorShape(output),
-        tflite::micro::GetTensorData<int8_t>(output));
+        tflite::micro::GetTensorData<int8_t>(output),
+        static_cast<int32_t*>(row_buffer));
   } else {
     TF_LITE_KERNEL_LOG(context,
                        "Output type is %d, requires float, uint8_t or int8_t.",
@@ -107,7 +156,7 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
 }  // namespace resize_bilinear
 
 TfLiteRegistration Register_RESIZE_BILINEAR() {
-  return {/*init=*/nullptr,
+  return {/*init=*/resize_bilinear::Init,
           /*free=*/nullptr,
           /*prepare=*/resize_bilinear::Prepare,
           /*invoke=*/resize_bilinear::Eval,
@@ -13,27 +13,52 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
-// Raspberry Pi Pico-specific implementation of timing functions.
+// Linux implementation of timing functions. GetCurrentTimeTicks() counts
+// milliseconds since its first call, so the 32 bit count only wraps after
+// about 24 days, and GetCurrentTimeTicks64() counts nanoseconds. Both read the
+// raw monotonic clock, which NTP does not slew.
 
 #include "tensorflow/lite/micro/micro_time.h"
-#include "tensorflow/lite/micro/debug_log.h"
-#include <sys/time.h>
+
+#include <time.h>
+
+#include <atomic>
 
 namespace tflite {
+namespace {
+constexpr int32_t kTicksPerSecond = 1000;
+constexpr uint64_t kTicks64PerSecond = 1000000000;
+constexpr uint64_t kTicks64PerTick = kTicks64PerSecond / kTicksPerSecond;
+constexpr uint64_t kNoStartTicks = ~uint64_t{0};
+
+// The millisecond count GetCurrentTimeTicks() starts from. Profilers and
+// tracers call it from thread pool workers, and function-local statics are not
+// thread safe in this build (-fno-threadsafe-statics), so the first caller
+// sets it with a compare-exchange instead.
+std::atomic<uint64_t> start_ticks{kNoStartTicks};
+}  // namespace
 
-int32_t ticks_per_second() { return 1000; }
+int32_t ticks_per_second() { return kTicksPerSecond; }
 
-static struct timeval start_tv;
 int32_t GetCurrentTimeTicks() {
-	static int started = 0;
-	if ( started == 0 ) {
-		gettimeofday(&start_tv, 0);
-		started = 1;
-	}
-	struct timeval tv;
-	gettimeofday(&tv, 0);
-	return (int32_t)((tv.tv_sec * 1000 + tv.tv_usec / 1000) -
-			(start_tv.tv_sec * 1000 + start_tv.tv_usec / 1000));
+  const uint64_t now = GetCurrentTimeTicks64() / kTicks64PerTick;
+  uint64_t start = start_ticks.load(std::memory_order_relaxed);
+  if (start == kNoStartTicks &&
+      start_ticks.compare_exchange_strong(start, now,
+                                          std::memory_order_relaxed)) {
+    start = now;
+  }
+  // A caller that read the clock just before another one set the start may be
+  // a tick behind it.
+  return now > start ? static_cast<int32_t>(now - start) : 0;
+}
+
+uint64_t ticks64_per_second() { return kTicks64PerSecond; }
+
+uint64_t GetCurrentTimeTicks64() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * kTicks64PerSecond + ts.tv_nsec;
 }
 
 }  // namespace tflite
@@ -0,0 +1,119 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/linux/pthread_thread_pool.h"
+
+namespace tflite {
+
+PthreadThreadPool::PthreadThreadPool(int num_threads) {
+  if (num_threads < 1) {
+    num_threads = 1;
+  } else if (num_threads > kMaxThreads) {
+    num_threads = kMaxThreads;
+  }
+  pthread_mutex_init(&mutex_, nullptr);
+  pthread_cond_init(&work_available_, nullptr);
+  pthread_cond_init(&work_done_, nullptr);
+
+  // Slot 0 is the thread calling Run(). If a worker fails to start, the pool
+  // simply runs with the threads it has.
+  num_threads_ = 1;
+  for (int i = 1; i < num_threads; ++i) {
+    if (pthread_create(&workers_[i], nullptr, WorkerMain, this) != 0) {
+      break;
+    }
+    ++num_threads_;
+  }
+}
+
+PthreadThreadPool::~PthreadThreadPool() {
+  pthread_mutex_lock(&mutex_);
+  shutdown_ = true;
+  pthread_cond_broadcast(&work_available_);
+  pthread_mutex_unlock(&mutex_);
+  for (int i = 1; i < num_threads_; ++i) {
+    pthread_join(workers_[i], nullptr);
+  }
+  pthread_cond_destroy(&work_done_);
+  pthread_cond_destroy(&work_available_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+void PthreadThreadPool::Run(int num_tasks,
+                            void (*task)(void* arg, int task_index),
+                            void* arg) {
+  if (num_tasks <= 0) {
+    return;
+  }
+  if (num_tasks == 1 || num_threads_ == 1) {
+    for (int i = 0; i < num_tasks; ++i) {
+      task(arg, i);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&mutex_);
+  task_ = task;
+  arg_ = arg;
+  num_tasks_ = num_tasks;
+  next_task_ = 0;
+  pending_tasks_ = num_tasks;
+  ++generation_;
+  pthread_cond_broadcast(&work_available_);
+
+  RunTasksLocked();
+  while (pending_tasks_ > 0) {
+    pthread_cond_wait(&work_done_, &mutex_);
+  }
+  task_ = nullptr;
+  arg_ = nullptr;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void PthreadThreadPool::RunTasksLocked() {
+  while (next_task_ < num_tasks_) {
+    const int index = next_task_++;
+    void (*task)(void*, int) = task_;
+    void* arg = arg_;
+    pthread_mutex_unlock(&mutex_);
+    task(arg, index);
+    pthread_mutex_lock(&mutex_);
+    if (--pending_tasks_ == 0) {
+      pthread_cond_signal(&work_done_);
+    }
+  }
+}
+
+void* PthreadThreadPool::WorkerMain(void* pool) {
+  PthreadThreadPool* self = static_cast<PthreadThreadPool*>(pool);
+  pthread_mutex_lock(&self->mutex_);
+  // Workers that start late still see any Run() issued since construction;
+  // RunTasksLocked() is a no-op if its tasks have already been claimed.
+  unsigned seen_generation = 0;
+  while (true) {
+    while (!self->shutdown_ && self->generation_ == seen_generation) {
+      pthread_cond_wait(&self->work_available_, &self->mutex_);
+    }
+    if (self->shutdown_) {
+      break;
+    }
+    seen_generation = self->generation_;
+    self->RunTasksLocked();
+  }
+  pthread_mutex_unlock(&self->mutex_);
+  return nullptr;
+}
+
+}  // namespace tflite
@@ -0,0 +1,69 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_LINUX_PTHREAD_THREAD_POOL_H_
+#define TENSORFLOW_LITE_MICRO_LINUX_PTHREAD_THREAD_POOL_H_
+
+#include <pthread.h>
+
+#include "tensorflow/lite/micro/compatibility.h"
+#include "tensorflow/lite/micro/micro_thread_pool.h"
+
+namespace tflite {
+
+// MicroThreadPool backed by a fixed set of POSIX threads that are started in
+// the constructor and joined in the destructor. No memory is allocated after
+// construction.
+class PthreadThreadPool : public MicroThreadPool {
+ public:
+  static constexpr int kMaxThreads = 32;
+
+  // Starts num_threads - 1 workers; the thread calling Run() is the last one.
+  // num_threads is clamped to [1, kMaxThreads].
+  explicit PthreadThreadPool(int num_threads);
+  ~PthreadThreadPool() override;
+
+  int num_threads() const override { return num_threads_; }
+
+  void Run(int num_tasks, void (*task)(void* arg, int task_index),
+           void* arg) override;
+
+ private:
+  static void* WorkerMain(void* pool);
+
+  // Executes tasks of the current Run() until none are left to claim. Must be
+  // called with mutex_ held; the lock is released while a task runs.
+  void RunTasksLocked();
+
+  pthread_mutex_t mutex_;
+  pthread_cond_t work_available_;
+  pthread_cond_t work_done_;
+  pthread_t workers_[kMaxThreads];
+  int num_threads_;
+
+  // State of the current Run(), guarded by mutex_.
+  void (*task_)(void*, int) = nullptr;
+  void* arg_ = nullptr;
+  int num_tasks_ = 0;
+  int next_task_ = 0;
+  int pending_tasks_ = 0;
+  unsigned generation_ = 0;
+  bool shutdown_ = false;
+
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_LINUX_PTHREAD_THREAD_POOL_H_
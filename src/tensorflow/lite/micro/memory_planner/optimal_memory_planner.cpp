@@ -0,0 +1,324 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/memory_planner/optimal_memory_planner.h"
+
+#include <limits>
+
+namespace tflite {
+
+OptimalMemoryPlanner::OptimalMemoryPlanner(unsigned char* scratch_buffer,
+                                           int scratch_buffer_size,
+                                           int max_search_steps)
+    : buffer_count_(0),
+      max_search_steps_(max_search_steps),
+      search_steps_(0),
+      search_completed_(false),
+      best_size_(0),
+      greedy_size_(0),
+      lower_bound_size_(0),
+      need_to_calculate_offsets_(true) {
+  // Allocate the arrays we need within the scratch buffer arena.
+  max_buffer_count_ = scratch_buffer_size / per_buffer_size();
+
+  unsigned char* next_free = scratch_buffer;
+  requirements_ = reinterpret_cast<BufferRequirements*>(next_free);
+  next_free += sizeof(BufferRequirements) * max_buffer_count_;
+
+  buffer_ids_sorted_ = reinterpret_cast<int*>(next_free);
+  next_free += sizeof(int) * max_buffer_count_;
+
+  buffer_offsets_ = reinterpret_cast<int*>(next_free);
+  next_free += sizeof(int) * max_buffer_count_;
+
+  best_buffer_offsets_ = reinterpret_cast<int*>(next_free);
+  next_free += sizeof(int) * max_buffer_count_;
+
+  peak_before_ = reinterpret_cast<int*>(next_free);
+}
+
+OptimalMemoryPlanner::~OptimalMemoryPlanner() {
+  // We don't own the scratch buffer, so don't deallocate anything.
+}
+
+TfLiteStatus OptimalMemoryPlanner::AddBuffer(
+    tflite::ErrorReporter* error_reporter, int size, int first_time_used,
+    int last_time_used) {
+  if (buffer_count_ >= max_buffer_count_) {
+    TF_LITE_REPORT_ERROR(error_reporter, "Too many buffers (max is %d)",
+                         max_buffer_count_);
+    return kTfLiteError;
+  }
+  BufferRequirements* current = &requirements_[buffer_count_];
+  current->size = size;
+  current->first_time_used = first_time_used;
+  current->last_time_used = last_time_used;
+  current->offline_offset = kOnlinePlannedBuffer;
+  ++buffer_count_;
+  need_to_calculate_offsets_ = true;
+  return kTfLiteOk;
+}
+
+TfLiteStatus OptimalMemoryPlanner::AddBuffer(
+    tflite::ErrorReporter* error_reporter, int size, int first_time_used,
+    int last_time_used, int offline_offset) {
+  BufferRequirements* current = &requirements_[buffer_count_];
+  if (AddBuffer(error_reporter, size, first_time_used, last_time_used) !=
+      kTfLiteOk) {
+    return kTfLiteError;
+  }
+  current->offline_offset = offline_offset;
+  return kTfLiteOk;
+}
+
+int OptimalMemoryPlanner::NextFreeOffset(int depth, int offset,
+                                         int limit) const {
+  const BufferRequirements& wanted = requirements_[buffer_ids_sorted_[depth]];
+  // Candidate offsets are zero and the ends of the buffers placed before that
+  // are live at the same time. Any other offset can be lowered to one of those
+  // without creating an overlap.
+  int candidate = offset < 0 ? 0 : -1;
+  if (candidate < 0) {
+    for (int i = 0; i < depth; ++i) {
+      const BufferRequirements& placed = requirements_[buffer_ids_sorted_[i]];
+      if (placed.first_time_used > wanted.last_time_used ||
+          wanted.first_time_used > placed.last_time_used) {
+        continue;
+      }
+      const int end = buffer_offsets_[buffer_ids_sorted_[i]] + placed.size;
+      if (end > offset && (candidate < 0 || end < candidate)) {
+        candidate = end;
+      }
+    }
+  }
+  while (candidate >= 0 && candidate + wanted.size < limit) {
+    // Every candidate below the end of an overlapping buffer overlaps it too,
+    // so skip straight past the highest one.
+    int overlap_end = -1;
+    for (int i = 0; i < depth; ++i) {
+      const BufferRequirements& placed = requirements_[buffer_ids_sorted_[i]];
+      if (placed.first_time_used > wanted.last_time_used ||
+          wanted.first_time_used > placed.last_time_used) {
+        continue;
+      }
+      const int start = buffer_offsets_[buffer_ids_sorted_[i]];
+      const int end = start + placed.size;
+      if (candidate < end && candidate + wanted.size > start &&
+          end > overlap_end) {
+        overlap_end = end;
+      }
+    }
+    if (overlap_end < 0) {
+      return candidate;
+    }
+    candidate = overlap_end;
+  }
+  return -1;
+}
+
+void OptimalMemoryPlanner::CalculateOffsetsIfNeeded() {
+  if (!need_to_calculate_offsets_ || (buffer_count_ == 0)) {
+    return;
+  }
+  need_to_calculate_offsets_ = false;
+
+  // Use the placement order of GreedyMemoryPlanner, so that the first layout
+  // the search completes is the greedy one.
+  int idx_from_tail = buffer_count_;
+  int idx_from_head = 0;
+  for (int i = 0; i < buffer_count_; ++i) {
+    if (requirements_[i].offline_offset == kOnlinePlannedBuffer) {
+      idx_from_tail--;
+      buffer_ids_sorted_[idx_from_tail] = i;
+      buffer_offsets_[i] = -1;
+    } else {
+      buffer_ids_sorted_[idx_from_head] = i;
+      buffer_offsets_[i] = requirements_[i].offline_offset;
+      idx_from_head++;
+    }
+  }
+  const int offline_count = idx_from_head;
+  for (int i = offline_count + 1; i < buffer_count_; ++i) {
+    const int id = buffer_ids_sorted_[i];
+    int j = i;
+    for (; j > offline_count &&
+           requirements_[buffer_ids_sorted_[j - 1]].size <
+               requirements_[id].size;
+         --j) {
+      buffer_ids_sorted_[j] = buffer_ids_sorted_[j - 1];
+    }
+    buffer_ids_sorted_[j] = id;
+  }
+
+  // The live bytes only grow when a buffer is first used, so their maximum is
+  // reached at one of those times.
+  int offline_peak = 0;
+  lower_bound_size_ = 0;
+  for (int i = 0; i < buffer_count_; ++i) {
+    const BufferRequirements& current = requirements_[i];
+    if (current.offline_offset != kOnlinePlannedBuffer &&
+        current.offline_offset + current.size > offline_peak) {
+      offline_peak = current.offline_offset + current.size;
+    }
+    int live_size = 0;
+    for (int j = 0; j < buffer_count_; ++j) {
+      if (requirements_[j].first_time_used <= current.first_time_used &&
+          requirements_[j].last_time_used >= current.first_time_used) {
+        live_size += requirements_[j].size;
+      }
+    }
+    if (live_size > lower_bound_size_) {
+      lower_bound_size_ = live_size;
+    }
+  }
+  if (offline_peak > lower_bound_size_) {
+    lower_bound_size_ = offline_peak;
+  }
+
+  search_steps_ = 0;
+  search_completed_ = false;
+  best_size_ = std::numeric_limits<int>::max();
+  greedy_size_ = -1;
+  if (offline_count == buffer_count_) {
+    best_size_ = offline_peak;
+    greedy_size_ = offline_peak;
+  }
+  for (int i = 0; i < offline_count; ++i) {
+    best_buffer_offsets_[buffer_ids_sorted_[i]] =
+        buffer_offsets_[buffer_ids_sorted_[i]];
+  }
+
+  int depth = offline_count;
+  peak_before_[depth] = offline_peak;
+  while (true) {
+    if (depth < offline_count || best_size_ <= lower_bound_size_) {
+      search_completed_ = true;
+      break;
+    }
+    if (greedy_size_ >= 0 && search_steps_ >= max_search_steps_) {
+      break;
+    }
+    const int buffer_id = buffer_ids_sorted_[depth];
+    const int size = requirements_[buffer_id].size;
+    // Larger offsets can only raise the high-water mark, so the branch is
+    // done once the next free offset is no longer better than the best layout.
+    const int offset =
+        NextFreeOffset(depth, buffer_offsets_[buffer_id], best_size_);
+    if (offset < 0) {
+      buffer_offsets_[buffer_id] = -1;
+      --depth;
+      continue;
+    }
+    ++search_steps_;
+    buffer_offsets_[buffer_id] = offset;
+    const int peak = offset + size > peak_before_[depth] ? offset + size
+                                                         : peak_before_[depth];
+    if (depth + 1 == buffer_count_) {
+      best_size_ = peak;
+      if (greedy_size_ < 0) {
+        greedy_size_ = peak;
+      }
+      for (int i = offline_count; i < buffer_count_; ++i) {
+        best_buffer_offsets_[buffer_ids_sorted_[i]] =
+            buffer_offsets_[buffer_ids_sorted_[i]];
+      }
+      continue;
+    }
+    ++depth;
+    peak_before_[depth] = peak;
+  }
+}
+
+size_t OptimalMemoryPlanner::GetMaximumMemorySize() {
+  CalculateOffsetsIfNeeded();
+  if (buffer_count_ == 0) {
+    return 0;
+  }
+  return best_size_;
+}
+
+size_t OptimalMemoryPlanner::GetGreedyMemorySize() {
+  CalculateOffsetsIfNeeded();
+  if (buffer_count_ == 0) {
+    return 0;
+  }
+  return greedy_size_;
+}
+
+size_t OptimalMemoryPlanner::GetLowerBoundMemorySize() {
+  CalculateOffsetsIfNeeded();
+  if (buffer_count_ == 0) {
+    return 0;
+  }
+  return lower_bound_size_;
+}
+
+bool OptimalMemoryPlanner::IsPlanOptimal() {
+  CalculateOffsetsIfNeeded();
+  return buffer_count_ == 0 || search_completed_;
+}
+
+int OptimalMemoryPlanner::GetSearchSteps() {
+  CalculateOffsetsIfNeeded();
+  return search_steps_;
+}
+
+int OptimalMemoryPlanner::GetBufferCount() { return buffer_count_; }
+
+TfLiteStatus OptimalMemoryPlanner::GetOffsetForBuffer(
+    tflite::ErrorReporter* error_reporter, int buffer_index, int* offset) {
+  CalculateOffsetsIfNeeded();
+  if ((buffer_index < 0) || (buffer_index >= buffer_count_)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "buffer index %d is outside range 0 to %d",
+                         buffer_index, buffer_count_);
+    return kTfLiteError;
+  }
+  *offset = best_buffer_offsets_[buffer_index];
+  return kTfLiteOk;
+}
+
+bool OptimalMemoryPlanner::DoAnyBuffersOverlap(ErrorReporter* error_reporter) {
+  CalculateOffsetsIfNeeded();
+  bool were_overlaps_found = false;
+  for (int i = 0; i < buffer_count_; ++i) {
+    const BufferRequirements& a = requirements_[i];
+    const int a_start_offset = best_buffer_offsets_[i];
+    const int a_end_offset = a_start_offset + a.size;
+    for (int j = i + 1; j < buffer_count_; ++j) {
+      const BufferRequirements& b = requirements_[j];
+      const int b_start_offset = best_buffer_offsets_[j];
+      const int b_end_offset = b_start_offset + b.size;
+      if ((a.first_time_used > b.last_time_used) ||
+          (b.first_time_used > a.last_time_used)) {
+        // Buffers don't overlap in time.
+        continue;
+      }
+      if ((a_start_offset >= b_end_offset) ||
+          (b_start_offset >= a_end_offset)) {
+        // No overlap in memory.
+        continue;
+      }
+      were_overlaps_found = true;
+      TF_LITE_REPORT_ERROR(
+          error_reporter, "Overlap: %d (%d=>%d, %d->%d) vs %d (%d=>%d, %d->%d)",
+          i, a.first_time_used, a.last_time_used, a_start_offset, a_end_offset,
+          j, b.first_time_used, b.last_time_used, b_start_offset, b_end_offset);
+    }
+  }
+  return were_overlaps_found;
+}
+
+}  // namespace tflite
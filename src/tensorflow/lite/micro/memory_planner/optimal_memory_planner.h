@@ -0,0 +1,155 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_MEMORY_PLANNER_OPTIMAL_MEMORY_PLANNER_H_
+#define TENSORFLOW_LITE_MICRO_MEMORY_PLANNER_OPTIMAL_MEMORY_PLANNER_H_
+
+#include "tensorflow/lite/micro/compatibility.h"
+#include "tensorflow/lite/micro/memory_planner/greedy_memory_planner.h"
+#include "tensorflow/lite/micro/memory_planner/memory_planner.h"
+
+namespace tflite {
+
+// A memory planner that searches for the smallest arena with a depth first
+// branch and bound over buffer offsets. Buffers are placed in the same order as
+// GreedyMemoryPlanner (offline planned buffers first, then by descending size),
+// and each one is tried at every offset where it starts at zero or right after
+// a buffer that is live at the same time. The first complete layout found is
+// exactly the greedy one, and the search only ever keeps layouts that are
+// strictly smaller, so the result is never worse than GreedyMemoryPlanner.
+//
+// A branch is cut as soon as its high-water mark reaches the best layout found
+// so far, and the search stops early when a layout reaches the lower bound,
+// which is the largest number of bytes live at any one time. Because the
+// search is exponential in the worst case, it is limited to a number of
+// placement steps rather than to wall clock time, so that plans stay
+// deterministic across runs and targets. If the search completes within the
+// budget, the plan is optimal.
+class OptimalMemoryPlanner : public MemoryPlanner {
+ public:
+  static constexpr int kDefaultMaxSearchSteps = 100000;
+
+  // Like GreedyMemoryPlanner, all working memory comes from |scratch_buffer|,
+  // which has to outlive the planner and holds per_buffer_size() bytes for
+  // each buffer to plan. At most |max_search_steps| placements are tried.
+  OptimalMemoryPlanner(unsigned char* scratch_buffer, int scratch_buffer_size,
+                       int max_search_steps = kDefaultMaxSearchSteps);
+  ~OptimalMemoryPlanner() override;
+
+  // Record details of a buffer we want to place.
+  TfLiteStatus AddBuffer(ErrorReporter* error_reporter, int size,
+                         int first_time_used, int last_time_used) override;
+
+  // Record details of an offline planned buffer offset we want to place.
+  // offline_offset is the buffer offset from the start of the arena.
+  TfLiteStatus AddBuffer(ErrorReporter* error_reporter, int size,
+                         int first_time_used, int last_time_used,
+                         int offline_offset);
+
+  // Returns the high-water mark of the best layout found.
+  size_t GetMaximumMemorySize() override;
+
+  // How many buffers have been recorded.
+  int GetBufferCount() override;
+
+  // Where a given buffer should be placed in the memory arena.
+  TfLiteStatus GetOffsetForBuffer(ErrorReporter* error_reporter,
+                                  int buffer_index, int* offset) override;
+
+  // Returns the high-water mark GreedyMemoryPlanner reaches for the same
+  // buffers.
+  size_t GetGreedyMemorySize();
+
+  // Returns the largest number of bytes that are live at the same time, which
+  // no layout can go below.
+  size_t GetLowerBoundMemorySize();
+
+  // Returns true if the search proved that no smaller layout exists, either
+  // because it completed within its budget or because the layout reaches the
+  // lower bound.
+  bool IsPlanOptimal();
+
+  // Number of placements the search tried.
+  int GetSearchSteps();
+
+  // Debug method to check whether any buffer allocations are overlapping. This
+  // is an O(N^2) complexity operation, so only use for testing.
+  bool DoAnyBuffersOverlap(ErrorReporter* error_reporter);
+
+  // Number of bytes required in order to plan a buffer.
+  static size_t per_buffer_size() {
+    const int per_buffer_size =
+        sizeof(BufferRequirements) +  // requirements_
+        sizeof(int) +                 // buffer_ids_sorted_
+        sizeof(int) +                 // buffer_offsets_
+        sizeof(int) +                 // best_buffer_offsets_
+        sizeof(int);                  // peak_before_;
+    return per_buffer_size;
+  }
+
+ private:
+  // Returns the lowest offset above |offset| at which the buffer at |depth| of
+  // the placement order does not overlap any buffer placed before it, or -1 if
+  // |offset| already reaches |limit|.
+  int NextFreeOffset(int depth, int offset, int limit) const;
+
+  // If there isn't an up to date plan, calculate a new one.
+  void CalculateOffsetsIfNeeded();
+
+  // How many buffers we can plan for, based on the arena size we're given in
+  // the constructor.
+  int max_buffer_count_;
+
+  // The number of buffers added so far.
+  int buffer_count_;
+
+  int max_search_steps_;
+  int search_steps_;
+  bool search_completed_;
+
+  struct BufferRequirements {
+    int size;
+    int offline_offset;
+    int first_time_used;
+    int last_time_used;
+  };
+
+  BufferRequirements* requirements_;
+
+  // Placement order: offline planned buffers, then online planned buffers by
+  // descending size.
+  int* buffer_ids_sorted_;
+
+  // Offsets of the layout being searched and of the best one found, indexed by
+  // buffer id.
+  int* buffer_offsets_;
+  int* best_buffer_offsets_;
+
+  // High-water mark of the buffers placed before each depth of the search.
+  int* peak_before_;
+
+  int best_size_;
+  int greedy_size_;
+  int lower_bound_size_;
+
+  // Whether buffers have been added since the last plan was calculated.
+  bool need_to_calculate_offsets_;
+
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MEMORY_PLANNER_OPTIMAL_MEMORY_PLANNER_H_
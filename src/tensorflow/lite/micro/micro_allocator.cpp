@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 #include "flatbuffers/flatbuffers.h"  // from @flatbuffers
 #include "tensorflow/lite/c/common.h"
@@ -29,6 +30,7 @@ limitations under the License.
 #include "tensorflow/lite/micro/memory_helpers.h"
 #include "tensorflow/lite/micro/memory_planner/greedy_memory_planner.h"
 #include "tensorflow/lite/micro/memory_planner/memory_planner.h"
+#include "tensorflow/lite/micro/memory_planner/optimal_memory_planner.h"
 #include "tensorflow/lite/micro/micro_op_resolver.h"
 #include "tensorflow/lite/micro/simple_memory_allocator.h"
 #include "tensorflow/lite/schema/schema_generated.h"
@@ -167,14 +169,19 @@ class AllocationInfoBuilder {
   TfLiteStatus GetOfflinePlannedOffsets(
       const Model* model, const int32_t** offline_planner_offsets);
 
-  // Add allocaiton information for the tensors.
+  // Add allocaiton information for the tensors. Tensors with an entry in
+  // tensor_aliases (if not null) are merged into the tensor it names; entries
+  // that can not be honored are reset to -1.
   TfLiteStatus AddTensors(const SubGraph* subgraph,
                           const int32_t* offline_offsets,
-                          TfLiteEvalTensor* eval_tensors);
+                          TfLiteEvalTensor* eval_tensors,
+                          int32_t* tensor_aliases);
 
   // Add allocation information for the scratch buffers.
+  // State buffers are already allocated and are not planned.
   TfLiteStatus AddScratchBuffers(
       internal::ScratchBufferRequest* scratch_buffer_requests,
+      const internal::StateBuffer* state_buffers,
       ScratchBufferHandle* scratch_buffer_handles);
 
   // Returns a pointer to the built AllocationInfo array.
@@ -189,7 +196,8 @@ class AllocationInfoBuilder {
 
 TfLiteStatus AllocationInfoBuilder::AddTensors(const SubGraph* subgraph,
                                                const int32_t* offline_offsets,
-                                               TfLiteEvalTensor* eval_tensors) {
+                                               TfLiteEvalTensor* eval_tensors,
+                                               int32_t* tensor_aliases) {
   TFLITE_DCHECK(eval_tensors != nullptr);
 
   // Set up allocation info for all tensors.
@@ -243,6 +251,33 @@ TfLiteStatus AllocationInfoBuilder::AddTensors(const SubGraph* subgraph,
     }
   }
 
+  // Aliased tensors are planned as part of the buffer they share.
+  for (size_t i = 0; tensor_aliases != nullptr && i < tensor_count_; ++i) {
+    if (tensor_aliases[i] < 0) {
+      continue;
+    }
+    AllocationInfo* current = &info_[i];
+    AllocationInfo* target = &info_[tensor_aliases[i]];
+    if (!current->needs_allocating || !target->needs_allocating ||
+        current->offline_offset != kOnlinePlannedBuffer ||
+        target->offline_offset != kOnlinePlannedBuffer) {
+      tensor_aliases[i] = -1;
+      continue;
+    }
+    if (current->first_created != -1 &&
+        (target->first_created == -1 ||
+         current->first_created < target->first_created)) {
+      target->first_created = current->first_created;
+    }
+    if (current->last_used > target->last_used) {
+      target->last_used = current->last_used;
+    }
+    if (current->bytes > target->bytes) {
+      target->bytes = current->bytes;
+    }
+    current->needs_allocating = false;
+  }
+
   // Sanity check for valid tensor lifetime.
 #if 0
   for (size_t i = 0; i < tensor_count_; ++i) {
@@ -317,6 +352,7 @@ TfLiteStatus AllocationInfoBuilder::GetOfflinePlannedOffsets(
 
 TfLiteStatus AllocationInfoBuilder::AddScratchBuffers(
     internal::ScratchBufferRequest* scratch_buffer_requests,
+    const internal::StateBuffer* state_buffers,
     ScratchBufferHandle* scratch_buffer_handles) {
   // Set up allocation info for buffers.
   for (size_t i = tensor_count_; i < tensor_count_ + buffer_count_; ++i) {
@@ -332,6 +368,16 @@ TfLiteStatus AllocationInfoBuilder::AddScratchBuffers(
     current->last_used = current_request->node_idx;
     current->offline_offset = kOnlinePlannedBuffer;
     current->needs_allocating = true;
+    current_handle->state_bytes = 0;
+  }
+  for (const internal::StateBuffer* state = state_buffers; state != nullptr;
+       state = state->next) {
+    const size_t i = tensor_count_ + state->buffer_idx;
+    ScratchBufferHandle* current_handle =
+        &(scratch_buffer_handles[state->buffer_idx]);
+    info_[i].needs_allocating = false;
+    current_handle->data = state->data;
+    current_handle->state_bytes = info_[i].bytes;
   }
   return kTfLiteOk;
 }
@@ -350,8 +396,10 @@ static void DumpAllocationInfo(const char *title, int i, const AllocationInfo *i
 #endif
 
 
-TfLiteStatus CreatePlan(ErrorReporter* error_reporter,
-                        GreedyMemoryPlanner* planner,
+// Works with any planner that has GreedyMemoryPlanner's AddBuffer() overload
+// for offline planned buffers.
+template <typename Planner>
+TfLiteStatus CreatePlan(ErrorReporter* error_reporter, Planner* planner,
                         const AllocationInfo* allocation_info,
                         size_t allocation_info_size) {
   // Add the tensors to our allocation plan.
@@ -393,6 +441,51 @@ TfLiteStatus CommitPlan(ErrorReporter* error_reporter, MemoryPlanner* planner,
   }
   return kTfLiteOk;
 }
+
+// Returns true if |op| treats the leading dimension of its non-constant
+// tensors as independent samples, so that its outputs are batched whenever one
+// of its inputs is.
+bool PropagatesBatch(BuiltinOperator op) {
+  switch (op) {
+    case BuiltinOperator_ABS:
+    case BuiltinOperator_ADD:
+    case BuiltinOperator_AVERAGE_POOL_2D:
+    case BuiltinOperator_CEIL:
+    case BuiltinOperator_CONCATENATION:
+    case BuiltinOperator_CONV_2D:
+    case BuiltinOperator_COS:
+    case BuiltinOperator_DEPTHWISE_CONV_2D:
+    case BuiltinOperator_DEQUANTIZE:
+    case BuiltinOperator_FLOOR:
+    case BuiltinOperator_FULLY_CONNECTED:
+    case BuiltinOperator_HARD_SWISH:
+    case BuiltinOperator_L2_NORMALIZATION:
+    case BuiltinOperator_LOG:
+    case BuiltinOperator_LOGISTIC:
+    case BuiltinOperator_MAX_POOL_2D:
+    case BuiltinOperator_MAXIMUM:
+    case BuiltinOperator_MINIMUM:
+    case BuiltinOperator_MUL:
+    case BuiltinOperator_NEG:
+    case BuiltinOperator_PRELU:
+    case BuiltinOperator_QUANTIZE:
+    case BuiltinOperator_RELU:
+    case BuiltinOperator_RELU6:
+    case BuiltinOperator_RESHAPE:
+    case BuiltinOperator_ROUND:
+    case BuiltinOperator_RSQRT:
+    case BuiltinOperator_SIN:
+    case BuiltinOperator_SOFTMAX:
+    case BuiltinOperator_SQRT:
+    case BuiltinOperator_SQUARE:
+    case BuiltinOperator_SUB:
+    case BuiltinOperator_SVDF:
+    case BuiltinOperator_TANH:
+      return true;
+    default:
+      return false;
+  }
+}
 }  // namespace
 
 namespace internal {
@@ -641,6 +734,39 @@ MicroAllocator* MicroAllocator::Create(SimpleMemoryAllocator* memory_allocator,
   return allocator;
 }
 
+TfLiteStatus MicroAllocator::SetBatchSize(int batch_size) {
+  if (model_is_allocating_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "MicroAllocator: Batch size can not be changed while "
+                         "a model is allocating");
+    return kTfLiteError;
+  }
+  if (batch_size < 1) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "MicroAllocator: Invalid batch size %d", batch_size);
+    return kTfLiteError;
+  }
+  batch_size_ = batch_size;
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroAllocator::SetMemoryPlannerSearchSteps(int max_search_steps) {
+  if (model_is_allocating_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "MicroAllocator: The memory planner can not be "
+                         "changed while a model is allocating");
+    return kTfLiteError;
+  }
+  if (max_search_steps < 0) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "MicroAllocator: Invalid number of search steps %d",
+                         max_search_steps);
+    return kTfLiteError;
+  }
+  memory_planner_search_steps_ = max_search_steps;
+  return kTfLiteOk;
+}
+
 TfLiteStatus MicroAllocator::StartModelAllocation(
     const Model* model, const MicroOpResolver& op_resolver,
     NodeAndRegistration** node_and_registrations,
@@ -686,10 +812,163 @@ TfLiteStatus MicroAllocator::FinishModelAllocation(
                                                *scratch_buffer_handles));
 
   TF_LITE_ENSURE_STATUS(AllocateVariables(subgraph, eval_tensors));
+  tensor_aliases_ = nullptr;
   model_is_allocating_ = false;
   return kTfLiteOk;
 }
 
+TfLiteStatus MicroAllocator::AllocateSession(
+    const MicroAllocator& compiled_allocator, const Model* model,
+    const TfLiteEvalTensor* compiled_eval_tensors,
+    const ScratchBufferHandle* compiled_scratch_buffer_handles,
+    TfLiteEvalTensor** eval_tensors,
+    ScratchBufferHandle** scratch_buffer_handles) {
+  TFLITE_DCHECK(eval_tensors != nullptr);
+  TFLITE_DCHECK(scratch_buffer_handles != nullptr);
+  if (model_is_allocating_ || compiled_allocator.model_is_allocating_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "MicroAllocator: Sessions can only be allocated "
+                         "between model allocations");
+    return kTfLiteError;
+  }
+  const SubGraph* subgraph = GetSubGraphFromModel(model);
+  TFLITE_DCHECK(subgraph != nullptr);
+
+  // Scratch buffers of the compiled memory plan are at the same offset in this
+  // allocator's head, while state buffers get a copy in the tail.
+  scratch_buffer_request_count_ =
+      compiled_allocator.scratch_buffer_request_count_;
+  TF_LITE_ENSURE_STATUS(AllocateScratchBufferHandles(
+      scratch_buffer_handles, scratch_buffer_request_count_));
+  for (size_t i = 0; i < scratch_buffer_request_count_; ++i) {
+    const ScratchBufferHandle& compiled = compiled_scratch_buffer_handles[i];
+    ScratchBufferHandle& handle = (*scratch_buffer_handles)[i];
+    handle = compiled;
+    if (compiled.state_bytes > 0) {
+      handle.data = static_cast<uint8_t*>(memory_allocator_->AllocateFromTail(
+          compiled.state_bytes, kBufferAlignment));
+      if (handle.data == nullptr) {
+        TF_LITE_REPORT_ERROR(error_reporter_,
+                             "Failed to allocate memory for a state buffer, "
+                             "%d bytes required",
+                             compiled.state_bytes);
+        return kTfLiteError;
+      }
+      memset(handle.data, 0, compiled.state_bytes);
+    }
+  }
+
+  const size_t head_size =
+      compiled_allocator.memory_allocator_->GetHeadUsedBytes();
+  TF_LITE_ENSURE_STATUS(
+      memory_allocator_->SetHeadBufferSize(head_size, kBufferAlignment));
+  max_head_buffer_usage_ = head_size;
+  const uint8_t* compiled_head =
+      compiled_allocator.memory_allocator_->GetHeadBuffer();
+  uint8_t* head = memory_allocator_->GetHeadBuffer();
+  auto rebase = [&](void* data) -> void* {
+    uint8_t* p = static_cast<uint8_t*>(data);
+    if (p >= compiled_head && p < compiled_head + head_size) {
+      return head + (p - compiled_head);
+    }
+    for (size_t i = 0; i < scratch_buffer_request_count_; ++i) {
+      const ScratchBufferHandle& compiled = compiled_scratch_buffer_handles[i];
+      if (compiled.state_bytes > 0 && p >= compiled.data &&
+          p < compiled.data + compiled.state_bytes) {
+        return (*scratch_buffer_handles)[i].data + (p - compiled.data);
+      }
+    }
+    return data;
+  };
+
+  const size_t tensor_count = subgraph->tensors()->size();
+  TfLiteEvalTensor* tensors =
+      reinterpret_cast<TfLiteEvalTensor*>(memory_allocator_->AllocateFromTail(
+          sizeof(TfLiteEvalTensor) * tensor_count, alignof(TfLiteEvalTensor)));
+  if (tensors == nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Failed to allocate memory for context->eval_tensors, "
+                         "%d bytes required",
+                         sizeof(TfLiteEvalTensor) * tensor_count);
+    return kTfLiteError;
+  }
+  for (size_t i = 0; i < tensor_count; ++i) {
+    tensors[i] = compiled_eval_tensors[i];
+    tensors[i].data.data = rebase(tensors[i].data.data);
+  }
+
+  for (size_t i = 0; i < scratch_buffer_request_count_; ++i) {
+    if ((*scratch_buffer_handles)[i].state_bytes == 0) {
+      (*scratch_buffer_handles)[i].data = static_cast<uint8_t*>(
+          rebase(compiled_scratch_buffer_handles[i].data));
+    }
+  }
+
+  // Variable tensors live in the compiled tail, each session gets its own.
+  batch_size_ = compiled_allocator.batch_size_;
+  TF_LITE_ENSURE_STATUS(AllocateVariables(subgraph, tensors));
+  *eval_tensors = tensors;
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroAllocator::AddTensorAlias(const Model* model,
+                                            int tensor_index,
+                                            int alias_index) {
+  if (!model_is_allocating_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "MicroAllocator: Tensor aliases can only be added "
+                         "while a model is allocating");
+    return kTfLiteError;
+  }
+  const SubGraph* subgraph = GetSubGraphFromModel(model);
+  TFLITE_DCHECK(subgraph != nullptr);
+  const int tensor_count = static_cast<int>(subgraph->tensors()->size());
+  if (tensor_index < 0 || tensor_index >= tensor_count || alias_index < 0 ||
+      alias_index >= tensor_count) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "MicroAllocator: Invalid tensor alias %d -> %d",
+                         tensor_index, alias_index);
+    return kTfLiteError;
+  }
+
+  // The aliases are only needed until the memory plan is committed, so they
+  // live in the temp section like the allocation info built from them.
+  if (tensor_aliases_ == nullptr) {
+    tensor_aliases_ =
+        reinterpret_cast<int32_t*>(memory_allocator_->AllocateTemp(
+            sizeof(int32_t) * tensor_count, alignof(int32_t)));
+    if (tensor_aliases_ == nullptr) {
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "Failed to allocate memory for tensor aliases, "
+                           "%d bytes required",
+                           sizeof(int32_t) * tensor_count);
+      return kTfLiteError;
+    }
+    for (int i = 0; i < tensor_count; ++i) {
+      tensor_aliases_[i] = -1;
+    }
+  }
+
+  // Every tensor of a group points directly at the group's root, so merging
+  // two groups re-points the members of one of them.
+  const int root = tensor_aliases_[alias_index] >= 0
+                       ? tensor_aliases_[alias_index]
+                       : alias_index;
+  const int merged_root = tensor_aliases_[tensor_index] >= 0
+                              ? tensor_aliases_[tensor_index]
+                              : tensor_index;
+  if (root == merged_root) {
+    return kTfLiteOk;
+  }
+  for (int i = 0; i < tensor_count; ++i) {
+    if (tensor_aliases_[i] == merged_root) {
+      tensor_aliases_[i] = root;
+    }
+  }
+  tensor_aliases_[merged_root] = root;
+  return kTfLiteOk;
+}
+
 void* MicroAllocator::AllocatePersistentBuffer(size_t bytes) {
   return memory_allocator_->AllocateFromTail(bytes, kBufferAlignment);
 }
@@ -735,6 +1014,24 @@ TfLiteStatus MicroAllocator::RequestScratchBufferInArena(size_t bytes,
   return kTfLiteOk;
 }
 
+void* MicroAllocator::AllocateStateBuffer(size_t bytes, int* buffer_idx) {
+  uint8_t* data = static_cast<uint8_t*>(
+      memory_allocator_->AllocateFromTail(bytes, kBufferAlignment));
+  internal::StateBuffer* state = reinterpret_cast<internal::StateBuffer*>(
+      memory_allocator_->AllocateFromTail(sizeof(internal::StateBuffer),
+                                          alignof(internal::StateBuffer)));
+  if (data == nullptr || state == nullptr ||
+      RequestScratchBufferInArena(bytes, buffer_idx) != kTfLiteOk) {
+    return nullptr;
+  }
+  memset(data, 0, bytes);
+  state->data = data;
+  state->buffer_idx = *buffer_idx;
+  state->next = state_buffers_;
+  state_buffers_ = state;
+  return data;
+}
+
 TfLiteStatus MicroAllocator::FinishPrepareNodeAllocations(int node_id) {
   // When a node has finished preparing, all temp allocations performed by the
   // kernel should be cleaned up:
@@ -909,6 +1206,9 @@ TfLiteTensor* MicroAllocator::AllocatePersistentTfLiteTensor(
     // TfLiteEvalTensors structs. These structs are the source of truth, simply
     // point the corresponding buffer to the new TfLiteTensor data value.
     tensor->data.data = eval_tensors[tensor_index].data.data;
+    if (ApplyBatchSize(eval_tensors[tensor_index], tensor) != kTfLiteOk) {
+      return nullptr;
+    }
   }
   return tensor;
 }
@@ -942,6 +1242,9 @@ TfLiteTensor* MicroAllocator::AllocateTempTfLiteTensor(
     // TfLiteEvalTensors structs. These structs are the source of truth, simply
     // point the corresponding buffer to the new TfLiteTensor data value.
     tensor->data.data = eval_tensors[tensor_index].data.data;
+    if (ApplyBatchSize(eval_tensors[tensor_index], tensor) != kTfLiteOk) {
+      return nullptr;
+    }
   }
   return tensor;
 }
@@ -979,6 +1282,7 @@ TfLiteStatus MicroAllocator::AllocateTfLiteEvalTensors(
       return kTfLiteError;
     }
   }
+  TF_LITE_ENSURE_STATUS(ApplyBatchSize(model, subgraph, tensors));
   *eval_tensors = tensors;
   return kTfLiteOk;
 }
@@ -1023,6 +1327,111 @@ TfLiteStatus MicroAllocator::PopulateTfLiteTensorFromFlatbuffer(
       model->buffers(), error_reporter_, tensor);
 }
 
+TfLiteStatus MicroAllocator::ApplyBatchSize(const Model* model,
+                                            const SubGraph* subgraph,
+                                            TfLiteEvalTensor* eval_tensors) {
+  if (batch_size_ == 1) {
+    return kTfLiteOk;
+  }
+  // Constant tensors (weights, biases, shapes) are shared by every sample, and
+  // so is every tensor that does not have a leading dimension of 1 to hold it.
+  auto can_batch = [eval_tensors](int index) {
+    const TfLiteEvalTensor& eval_tensor = eval_tensors[index];
+    return eval_tensor.data.data == nullptr && eval_tensor.dims->size >= 2 &&
+           eval_tensor.dims->data[0] == 1;
+  };
+  // A batched tensor had a leading dimension of 1 in the flatbuffer.
+  auto is_batched = [subgraph, eval_tensors](int index) {
+    if (index < 0) {
+      return false;
+    }
+    const auto* shape = subgraph->tensors()->Get(index)->shape();
+    return shape != nullptr && shape->size() >= 2 && shape->Get(0) == 1 &&
+           eval_tensors[index].dims->data[0] != 1;
+  };
+
+  for (size_t i = 0; i < subgraph->inputs()->size(); ++i) {
+    const int index = subgraph->inputs()->Get(i);
+    if (can_batch(index)) {
+      TF_LITE_ENSURE_STATUS(ApplyBatchSize(&eval_tensors[index]));
+    }
+  }
+
+  // Operators are stored in execution order, so a single pass carries the
+  // batch from the model inputs to every tensor computed from them.
+  for (size_t i = 0; i < subgraph->operators()->size(); ++i) {
+    const auto* op = subgraph->operators()->Get(i);
+    bool has_batched_input = false;
+    for (size_t n = 0; n < op->inputs()->size(); ++n) {
+      has_batched_input |= is_batched(op->inputs()->Get(n));
+    }
+    if (!has_batched_input) {
+      continue;
+    }
+    const BuiltinOperator op_type =
+        GetBuiltinCode(model->operator_codes()->Get(op->opcode_index()));
+    if (!PropagatesBatch(op_type)) {
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "MicroAllocator: %s (operator %d) can not run on "
+                           "batched inputs",
+                           EnumNameBuiltinOperator(op_type), i);
+      return kTfLiteError;
+    }
+    // Variable inputs (e.g. the SVDF state) hold per-sample state.
+    for (size_t n = 0; n < op->inputs()->size(); ++n) {
+      const int index = op->inputs()->Get(n);
+      if (index >= 0 && subgraph->tensors()->Get(index)->is_variable() &&
+          can_batch(index)) {
+        TF_LITE_ENSURE_STATUS(ApplyBatchSize(&eval_tensors[index]));
+      }
+    }
+    for (size_t n = 0; n < op->outputs()->size(); ++n) {
+      const int index = op->outputs()->Get(n);
+      if (is_batched(index)) {
+        continue;
+      }
+      if (!can_batch(index)) {
+        TF_LITE_REPORT_ERROR(error_reporter_,
+                             "MicroAllocator: Output %d of %s (operator %d) "
+                             "has no leading dimension of 1 to batch",
+                             index, EnumNameBuiltinOperator(op_type), i);
+        return kTfLiteError;
+      }
+      TF_LITE_ENSURE_STATUS(ApplyBatchSize(&eval_tensors[index]));
+    }
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroAllocator::ApplyBatchSize(TfLiteEvalTensor* eval_tensor) {
+  const int dims_size = eval_tensor->dims->size;
+  TfLiteIntArray* dims =
+      reinterpret_cast<TfLiteIntArray*>(memory_allocator_->AllocateFromTail(
+          TfLiteIntArrayGetSizeInBytes(dims_size), alignof(TfLiteIntArray)));
+  if (dims == nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Failed to allocate batched dims of size %d",
+                         dims_size);
+    return kTfLiteError;
+  }
+  dims->size = dims_size;
+  dims->data[0] = batch_size_;
+  for (int i = 1; i < dims_size; ++i) {
+    dims->data[i] = eval_tensor->dims->data[i];
+  }
+  eval_tensor->dims = dims;
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroAllocator::ApplyBatchSize(const TfLiteEvalTensor& eval_tensor,
+                                            TfLiteTensor* tensor) {
+  if (batch_size_ == 1 || tensor->allocation_type == kTfLiteMmapRo) {
+    return kTfLiteOk;
+  }
+  tensor->dims = eval_tensor.dims;
+  return TfLiteEvalTensorByteLength(&eval_tensor, &tensor->bytes);
+}
+
 ErrorReporter* MicroAllocator::error_reporter() const {
   return error_reporter_;
 }
@@ -1077,13 +1486,13 @@ TfLiteStatus MicroAllocator::CommitStaticMemoryPlan(
   const int32_t* offline_planner_offsets = nullptr;
   TF_LITE_ENSURE_STATUS(
       builder.GetOfflinePlannedOffsets(model, &offline_planner_offsets));
-  TF_LITE_ENSURE_STATUS(
-      builder.AddTensors(subgraph, offline_planner_offsets, eval_tensors));
+  TF_LITE_ENSURE_STATUS(builder.AddTensors(subgraph, offline_planner_offsets,
+                                           eval_tensors, tensor_aliases_));
   internal::ScratchBufferRequest* scratch_buffer_requests =
       GetScratchBufferRequests();
 
-  TF_LITE_ENSURE_STATUS(builder.AddScratchBuffers(scratch_buffer_requests,
-                                                  scratch_buffer_handles));
+  TF_LITE_ENSURE_STATUS(builder.AddScratchBuffers(
+      scratch_buffer_requests, state_buffers_, scratch_buffer_handles));
 
   // Remaining arena size that memory planner can use for calculating offsets.
   size_t remaining_arena_size =
@@ -1092,9 +1501,56 @@ TfLiteStatus MicroAllocator::CommitStaticMemoryPlan(
       memory_allocator_->AllocateTemp(remaining_arena_size, kBufferAlignment);
   TF_LITE_ENSURE(error_reporter_, planner_arena != nullptr);
 
-  GreedyMemoryPlanner planner(planner_arena, remaining_arena_size);
-  TF_LITE_ENSURE_STATUS(CreatePlan(error_reporter_, &planner, allocation_info,
-                                   allocation_info_count));
+  // A shared buffer is as large as the largest of its tensors for as long as
+  // any of them is live, so tensor aliases do not always shrink the plan. Only
+  // keep them if they do not grow it: a shared buffer also lets a folded
+  // activation skip its copy.
+  if (tensor_aliases_ != nullptr) {
+    size_t aliased_size = 0;
+    size_t unaliased_size = 0;
+    {
+      GreedyMemoryPlanner planner(planner_arena, remaining_arena_size);
+      TF_LITE_ENSURE_STATUS(CreatePlan(error_reporter_, &planner,
+                                       allocation_info, allocation_info_count));
+      aliased_size = planner.GetMaximumMemorySize();
+    }
+    TF_LITE_ENSURE_STATUS(builder.AddTensors(subgraph, offline_planner_offsets,
+                                             eval_tensors, nullptr));
+    {
+      GreedyMemoryPlanner planner(planner_arena, remaining_arena_size);
+      TF_LITE_ENSURE_STATUS(CreatePlan(error_reporter_, &planner,
+                                       allocation_info, allocation_info_count));
+      unaliased_size = planner.GetMaximumMemorySize();
+    }
+    if (aliased_size <= unaliased_size) {
+      TF_LITE_ENSURE_STATUS(builder.AddTensors(
+          subgraph, offline_planner_offsets, eval_tensors, tensor_aliases_));
+    } else {
+      tensor_aliases_ = nullptr;
+    }
+  }
+
+  GreedyMemoryPlanner greedy_planner(planner_arena, remaining_arena_size);
+  OptimalMemoryPlanner optimal_planner(planner_arena, remaining_arena_size,
+                                       memory_planner_search_steps_);
+  MemoryPlanner& planner =
+      memory_planner_search_steps_ > 0
+          ? static_cast<MemoryPlanner&>(optimal_planner)
+          : static_cast<MemoryPlanner&>(greedy_planner);
+  if (memory_planner_search_steps_ > 0) {
+    TF_LITE_ENSURE_STATUS(CreatePlan(error_reporter_, &optimal_planner,
+                                     allocation_info, allocation_info_count));
+    memory_plan_stats_.planned_bytes = optimal_planner.GetMaximumMemorySize();
+    memory_plan_stats_.greedy_bytes = optimal_planner.GetGreedyMemorySize();
+    memory_plan_stats_.lower_bound_bytes =
+        optimal_planner.GetLowerBoundMemorySize();
+    memory_plan_stats_.search_steps = optimal_planner.GetSearchSteps();
+    memory_plan_stats_.is_optimal = optimal_planner.IsPlanOptimal();
+  } else {
+    memory_plan_stats_ = {};
+    TF_LITE_ENSURE_STATUS(CreatePlan(error_reporter_, &greedy_planner,
+                                     allocation_info, allocation_info_count));
+  }
 
   // Reset all temp allocations used above:
   memory_allocator_->ResetTempAllocations();
@@ -1115,6 +1571,13 @@ TfLiteStatus MicroAllocator::CommitStaticMemoryPlan(
   TF_LITE_ENSURE_STATUS(CommitPlan(error_reporter_, &planner,
                                    memory_allocator_->GetHeadBuffer(),
                                    allocation_info, allocation_info_count));
+  if (tensor_aliases_ != nullptr) {
+    for (size_t i = 0; i < subgraph->tensors()->size(); ++i) {
+      if (tensor_aliases_[i] >= 0) {
+        eval_tensors[i].data.data = eval_tensors[tensor_aliases_[i]].data.data;
+      }
+    }
+  }
 
   head_usage = planner.GetMaximumMemorySize();
 
@@ -1158,6 +1621,7 @@ TfLiteStatus MicroAllocator::InitScratchBufferData() {
   // A model is preparing to allocate resources, ensure that scratch buffer
   // request counter is cleared:
   scratch_buffer_request_count_ = 0;
+  state_buffers_ = nullptr;
 
   // All requests will be stored in the head section. Each kernel is allowed at
   // most kMaxScratchBuffersPerOp requests. Adjust the head to reserve at most
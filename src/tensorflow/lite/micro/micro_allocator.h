@@ -60,6 +60,15 @@ typedef struct {
   int node_idx;
 } ScratchBufferRequest;
 
+// A scratch buffer request made through AllocateStateBuffer(). Its buffer is
+// allocated from the tail right away and is not planned. State buffers of a
+// model are kept in a list in the tail.
+typedef struct StateBuffer {
+  uint8_t* data;
+  int buffer_idx;
+  struct StateBuffer* next;
+} StateBuffer;
+
 }  // namespace internal
 
 typedef struct {
@@ -73,8 +82,27 @@ typedef struct {
 typedef struct {
   // Pointer to location of the scratch buffer:
   uint8_t* data;
+  // Size of a state buffer from AllocateStateBuffer(), which lives in the tail
+  // and keeps its contents between invocations. 0 for scratch buffers, which
+  // are planned in the head.
+  size_t state_bytes;
 } ScratchBufferHandle;
 
+// Describes the last memory plan made with an OptimalMemoryPlanner. All zero
+// when the greedy planner was used.
+typedef struct {
+  // High-water mark of the plan that was committed.
+  size_t planned_bytes;
+  // High-water mark of the greedy plan for the same buffers.
+  size_t greedy_bytes;
+  // Largest number of bytes live at the same time, which no plan goes below.
+  size_t lower_bound_bytes;
+  // Number of placements the search tried.
+  int search_steps;
+  // True if no smaller plan exists.
+  bool is_optimal;
+} MemoryPlanStats;
+
 // Allocator responsible for allocating memory for all intermediate tensors
 // necessary to invoke a model.
 //
@@ -114,6 +142,27 @@ class MicroAllocator {
   static MicroAllocator* Create(SimpleMemoryAllocator* memory_allocator,
                                 ErrorReporter* error_reporter);
 
+  // Plans every following model allocation for |batch_size| independent
+  // samples per Invoke(). Each model input whose leading dimension is 1 in the
+  // flatbuffer gets |batch_size| as its leading dimension instead, and so does
+  // every activation, output and variable tensor computed from a batched
+  // tensor by an operator that handles samples independently (elementwise ops,
+  // CONV_2D, DEPTHWISE_CONV_2D, FULLY_CONNECTED, SVDF, pooling, SOFTMAX,
+  // RESHAPE that keeps the leading 1, ...). Other tensors keep their shape.
+  // Must be called before StartModelAllocation().
+  TfLiteStatus SetBatchSize(int batch_size);
+  int batch_size() const { return batch_size_; }
+
+  // Plans the non-persistent buffers of every following model allocation with
+  // an OptimalMemoryPlanner limited to |max_search_steps| placements, instead
+  // of a GreedyMemoryPlanner. The plan is never larger than the greedy one;
+  // memory_plan_stats() compares the two. 0 restores the greedy planner. Must
+  // be called before StartModelAllocation().
+  TfLiteStatus SetMemoryPlannerSearchSteps(int max_search_steps);
+  const MemoryPlanStats& memory_plan_stats() const {
+    return memory_plan_stats_;
+  }
+
   // Begin allocating internal resources required for model inference.
   // This method will run through the flatbuffer data supplied in the model to
   // properly allocate tensor, node, and op registration data. This method is
@@ -138,6 +187,38 @@ class MicroAllocator {
       const Model* model, TfLiteEvalTensor* eval_tensors,
       ScratchBufferHandle** scratch_buffer_handles);
 
+  // Allocates the per-session state of a model that |compiled_allocator| has
+  // already allocated through FinishModelAllocation(), so that another
+  // interpreter can run the model without repeating StartModelAllocation().
+  // Only the TfLiteEvalTensor structs, the scratch buffer handles, variable
+  // tensor buffers, state buffers and a head section as large as the compiled
+  // memory plan are allocated from this allocator's arena. Tensors that point
+  // into a compiled state buffer point into the session's copy. Node and
+  // registration data, kernel op data and constant tensors stay in the
+  // compiled arena and are shared.
+  // The model must be the last one allocated through |compiled_allocator|.
+  // Results are stored in the out-params eval_tensors and
+  // scratch_buffer_handles.
+  TfLiteStatus AllocateSession(
+      const MicroAllocator& compiled_allocator, const Model* model,
+      const TfLiteEvalTensor* compiled_eval_tensors,
+      const ScratchBufferHandle* compiled_scratch_buffer_handles,
+      TfLiteEvalTensor** eval_tensors,
+      ScratchBufferHandle** scratch_buffer_handles);
+
+  // Makes the non-persistent tensors tensor_index and alias_index, and any
+  // tensors already aliased to either of them, share one buffer. The buffer is
+  // live from the first creation to the last use of any tensor in the group.
+  // The caller guarantees that at most one tensor of the group holds a live
+  // value at any time, e.g. because each one is only consumed by an operator
+  // that computes the next one in place. Tensors with offline planned offsets
+  // keep their own buffer. The aliases are kept unless they make the memory
+  // plan larger, in which case they are dropped altogether. Must be called
+  // after the last FinishPrepareNodeAllocations() and before
+  // FinishModelAllocation().
+  TfLiteStatus AddTensorAlias(const Model* model, int tensor_index,
+                              int alias_index);
+
   // Allocates a TfLiteTensor struct and populates the returned value with
   // properties from the model flatbuffer. This struct is allocated from
   // persistent arena memory is only guaranteed for the lifetime of the
@@ -173,6 +254,13 @@ class MicroAllocator {
   // buffers will be accessible by the out-param in that method.
   TfLiteStatus RequestScratchBufferInArena(size_t bytes, int* buffer_idx);
 
+  // Allocates a zeroed buffer of size `bytes` from the tail for state that a
+  // kernel keeps between invocations, and registers it like a scratch buffer
+  // so that it is looked up through the same `buffer_idx` after
+  // FinishModelAllocation(). AllocateSession() gives each session its own
+  // copy. Returns nullptr on failure.
+  void* AllocateStateBuffer(size_t bytes, int* buffer_idx);
+
   // Finish allocating a specific NodeAndRegistration prepare block (kernel
   // entry for a model) with a given node ID. This call ensures that any scratch
   // buffer requests and temporary allocations are handled and ready for the
@@ -183,6 +271,10 @@ class MicroAllocator {
   // `FinishModelAllocation`. Otherwise, it will return 0.
   size_t used_bytes() const;
 
+  // Returns the number of scratch and state buffer handles of the model
+  // allocated last, after FinishModelAllocation() or AllocateSession().
+  size_t scratch_buffer_count() const { return scratch_buffer_request_count_; }
+
  protected:
   MicroAllocator(SimpleMemoryAllocator* memory_allocator,
                  ErrorReporter* error_reporter);
@@ -258,6 +350,22 @@ class MicroAllocator {
   // the head section.
   internal::ScratchBufferRequest* GetScratchBufferRequests();
 
+  // Gives every model input with a leading dimension of 1, and every tensor
+  // computed from one by operators that keep the leading dimension as the
+  // batch, batch_size_ as its leading dimension. Fails if a batched tensor
+  // reaches an operator that mixes samples or an output that can't be batched.
+  TfLiteStatus ApplyBatchSize(const Model* model, const SubGraph* subgraph,
+                              TfLiteEvalTensor* eval_tensors);
+
+  // Replaces the dims of a tensor with a leading dimension of 1 by a
+  // persistent copy that has batch_size_ as its leading dimension.
+  TfLiteStatus ApplyBatchSize(TfLiteEvalTensor* eval_tensor);
+
+  // Makes a TfLiteTensor created from the flatbuffer agree with the batched
+  // shape and size of its TfLiteEvalTensor.
+  TfLiteStatus ApplyBatchSize(const TfLiteEvalTensor& eval_tensor,
+                              TfLiteTensor* tensor);
+
   // A simple memory allocator that always allocate from the arena tail or head.
   SimpleMemoryAllocator* memory_allocator_;
 
@@ -268,10 +376,26 @@ class MicroAllocator {
   // section when a model is allocating.
   size_t scratch_buffer_request_count_ = 0;
 
+  // State buffers allocated since the model started allocating.
+  internal::StateBuffer* state_buffers_ = nullptr;
+
   // Holds the byte length of the memory plan with the largest head usage. Used
   // to ensure that multi-tenant allocations can share the head for buffers.
   size_t max_head_buffer_usage_ = 0;
 
+  // Number of samples the batched tensors are planned for. See
+  // SetBatchSize().
+  int batch_size_ = 1;
+
+  // Placements the OptimalMemoryPlanner may try, or 0 to plan greedily.
+  int memory_planner_search_steps_ = 0;
+  MemoryPlanStats memory_plan_stats_ = {};
+
+  // For the model that is allocating, the tensor whose buffer each tensor
+  // shares, or -1. Allocated from the temp section on the first
+  // AddTensorAlias().
+  int32_t* tensor_aliases_ = nullptr;
+
   TF_LITE_REMOVE_VIRTUAL_DELETE
 };
 
@@ -19,6 +19,7 @@ limitations under the License.
 #include <cstdint>
 
 #include "flatbuffers/flatbuffers.h"  // from @flatbuffers
+#include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/core/api/error_reporter.h"
 #include "tensorflow/lite/core/api/tensor_utils.h"
@@ -41,6 +42,114 @@ const char* OpNameFromRegistration(const TfLiteRegistration* registration) {
 }
 #endif  // !defined(TF_LITE_STRIP_ERROR_STRINGS)
 
+// Returns true if the kernel for |op| writes each output element only after
+// reading the elements of its input number |input_index| at the same or a
+// lower offset, so that the output may overwrite that input.
+bool CanRunInPlace(BuiltinOperator op, size_t input_index,
+                   const TfLiteEvalTensor& input,
+                   const TfLiteEvalTensor& output) {
+  // RESHAPE leaves the bytes alone and skips its copy when both tensors share
+  // a buffer.
+  if (op == BuiltinOperator_RESHAPE) {
+    size_t input_bytes;
+    size_t output_bytes;
+    return input_index == 0 && input.type == output.type &&
+           TfLiteEvalTensorByteLength(&input, &input_bytes) == kTfLiteOk &&
+           TfLiteEvalTensorByteLength(&output, &output_bytes) == kTfLiteOk &&
+           input_bytes == output_bytes;
+  }
+  if (!TfLiteIntArrayEqual(input.dims, output.dims)) {
+    return false;
+  }
+  switch (op) {
+    // With equal shapes, the broadcasting kernels read this input at the
+    // offset of the output element they write.
+    case BuiltinOperator_ADD:
+    case BuiltinOperator_MAXIMUM:
+    case BuiltinOperator_MINIMUM:
+    case BuiltinOperator_MUL:
+    case BuiltinOperator_SUB:
+      return input_index < 2 && input.type == output.type;
+    case BuiltinOperator_ABS:
+    case BuiltinOperator_CEIL:
+    case BuiltinOperator_COS:
+    case BuiltinOperator_EXP:
+    case BuiltinOperator_FLOOR:
+    case BuiltinOperator_HARD_SWISH:
+    case BuiltinOperator_LEAKY_RELU:
+    case BuiltinOperator_LOG:
+    case BuiltinOperator_LOGICAL_NOT:
+    case BuiltinOperator_LOGISTIC:
+    case BuiltinOperator_NEG:
+    case BuiltinOperator_PRELU:
+    case BuiltinOperator_RELU:
+    case BuiltinOperator_RELU6:
+    case BuiltinOperator_ROUND:
+    case BuiltinOperator_RSQRT:
+    case BuiltinOperator_SIN:
+    case BuiltinOperator_SOFTMAX:
+    case BuiltinOperator_SQRT:
+    case BuiltinOperator_SQUARE:
+    case BuiltinOperator_TANH:
+      return input_index == 0 && input.type == output.type;
+    case BuiltinOperator_DEQUANTIZE:
+    case BuiltinOperator_QUANTIZE: {
+      size_t input_size;
+      size_t output_size;
+      return input_index == 0 &&
+             TfLiteTypeSizeOf(input.type, &input_size) == kTfLiteOk &&
+             TfLiteTypeSizeOf(output.type, &output_size) == kTfLiteOk &&
+             output_size <= input_size;
+    }
+    default:
+      return false;
+  }
+}
+
+// Returns the fused activation of an operator that applies it while
+// requantizing its output, or nullptr.
+TfLiteFusedActivation* FusedActivation(BuiltinOperator op, void* params) {
+  if (params == nullptr) {
+    return nullptr;
+  }
+  switch (op) {
+    case BuiltinOperator_ADD:
+      return &static_cast<TfLiteAddParams*>(params)->activation;
+    case BuiltinOperator_CONV_2D:
+      return &static_cast<TfLiteConvParams*>(params)->activation;
+    case BuiltinOperator_DEPTHWISE_CONV_2D:
+      return &static_cast<TfLiteDepthwiseConvParams*>(params)->activation;
+    case BuiltinOperator_FULLY_CONNECTED:
+      return &static_cast<TfLiteFullyConnectedParams*>(params)->activation;
+    default:
+      return nullptr;
+  }
+}
+
+// Returns true if the float or int8 tensors |a| and |b| hold the same values
+// for the same bytes.
+bool HaveSameEncoding(const Tensor* a, const Tensor* b) {
+  if (a->type() != b->type()) {
+    return false;
+  }
+  if (a->type() == TensorType_FLOAT32) {
+    return true;
+  }
+  if (a->type() != TensorType_INT8 || a->quantization() == nullptr ||
+      b->quantization() == nullptr) {
+    return false;
+  }
+  const auto* a_scale = a->quantization()->scale();
+  const auto* b_scale = b->quantization()->scale();
+  const auto* a_zero_point = a->quantization()->zero_point();
+  const auto* b_zero_point = b->quantization()->zero_point();
+  return a_scale != nullptr && b_scale != nullptr && a_zero_point != nullptr &&
+         b_zero_point != nullptr && a_scale->size() == 1 &&
+         b_scale->size() == 1 && a_zero_point->size() == 1 &&
+         b_zero_point->size() == 1 && a_scale->Get(0) == b_scale->Get(0) &&
+         a_zero_point->Get(0) == b_zero_point->Get(0);
+}
+
 }  // namespace
 
 namespace internal {
@@ -62,6 +171,12 @@ TfLiteStatus ContextHelper::RequestScratchBufferInArena(TfLiteContext* ctx,
   return helper->allocator_->RequestScratchBufferInArena(bytes, buffer_idx);
 }
 
+void* ContextHelper::AllocateStateBuffer(TfLiteContext* ctx, size_t bytes,
+                                         int* buffer_idx) {
+  ContextHelper* helper = reinterpret_cast<ContextHelper*>(ctx->impl_);
+  return helper->allocator_->AllocateStateBuffer(bytes, buffer_idx);
+}
+
 void* ContextHelper::GetScratchBuffer(TfLiteContext* ctx, int buffer_idx) {
   ContextHelper* helper = reinterpret_cast<ContextHelper*>(ctx->impl_);
   ScratchBufferHandle* handle = helper->scratch_buffer_handles_ + buffer_idx;
@@ -92,6 +207,25 @@ TfLiteEvalTensor* ContextHelper::GetEvalTensor(
   return &helper->eval_tensors_[tensor_idx];
 }
 
+TfLiteExternalContext* ContextHelper::GetExternalContext(
+    struct TfLiteContext* context, TfLiteExternalContextType type) {
+  ContextHelper* helper = static_cast<ContextHelper*>(context->impl_);
+  if (type < 0 || type >= kTfLiteMaxExternalContexts) {
+    return nullptr;
+  }
+  return helper->external_contexts_[type];
+}
+
+void ContextHelper::SetExternalContext(
+    struct TfLiteContext* context, TfLiteExternalContextType type,
+    TfLiteExternalContext* external_context) {
+  ContextHelper* helper = static_cast<ContextHelper*>(context->impl_);
+  if (type < 0 || type >= kTfLiteMaxExternalContexts) {
+    return;
+  }
+  helper->external_contexts_[type] = external_context;
+}
+
 void ContextHelper::SetTfLiteEvalTensors(TfLiteEvalTensor* eval_tensors) {
   eval_tensors_ = eval_tensors;
 }
@@ -151,8 +285,33 @@ MicroInterpreter::MicroInterpreter(const Model* model,
   Init(profiler);
 }
 
+MicroInterpreter::MicroInterpreter(const MicroInterpreter& compiled_model,
+                                   uint8_t* tensor_arena,
+                                   size_t tensor_arena_size,
+                                   ErrorReporter* error_reporter,
+                                   tflite::Profiler* profiler)
+    : model_(compiled_model.model_),
+      op_resolver_(compiled_model.op_resolver_),
+      error_reporter_(error_reporter),
+      allocator_(*MicroAllocator::Create(tensor_arena, tensor_arena_size,
+                                         error_reporter)),
+      compiled_model_(&compiled_model),
+      tensors_allocated_(false),
+      initialization_status_(kTfLiteError),
+      eval_tensors_(nullptr),
+      context_helper_(error_reporter_, &allocator_, model_) {
+  for (int i = 0; i < MAX_INPUT_TENSORS; i++) {
+    input_tensor_[i] = nullptr;
+  }
+  for (int i = 0; i < MAX_OUTPUT_TENSORS; i++) {
+    output_tensor_[i] = nullptr;
+  }
+  Init(profiler);
+}
+
 MicroInterpreter::~MicroInterpreter() {
-  if (node_and_registrations_ != nullptr) {
+  // Sessions leave the op data to the compiled model.
+  if (node_and_registrations_ != nullptr && compiled_model_ == nullptr) {
     for (size_t i = 0; i < subgraph_->operators()->size(); ++i) {
       TfLiteNode* node = &(node_and_registrations_[i].node);
       const TfLiteRegistration* registration =
@@ -181,6 +340,8 @@ void MicroInterpreter::Init(tflite::Profiler* profiler) {
   context_.ReportError = context_helper_.ReportOpError;
   context_.GetTensor = context_helper_.GetTensor;
   context_.GetEvalTensor = context_helper_.GetEvalTensor;
+  context_.GetExternalContext = context_helper_.GetExternalContext;
+  context_.SetExternalContext = context_helper_.SetExternalContext;
   context_.recommended_num_threads = 1;
   context_.profiler = profiler;
 
@@ -230,7 +391,74 @@ void MicroInterpreter::CorrectTensorDataEndianness(T* data, int32_t size) {
   }
 }
 
+TfLiteStatus MicroInterpreter::SetThreadPool(MicroThreadPool* thread_pool) {
+  if (tensors_allocated_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "SetThreadPool() must be called before "
+                         "AllocateTensors().\n");
+    return kTfLiteError;
+  }
+  context_.SetExternalContext(&context_, kTfLiteCpuBackendContext,
+                              thread_pool);
+  context_.recommended_num_threads =
+      thread_pool != nullptr ? thread_pool->num_threads() : 1;
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroInterpreter::SetBatchSize(int batch_size) {
+  if (tensors_allocated_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "SetBatchSize() must be called before "
+                         "AllocateTensors().\n");
+    return kTfLiteError;
+  }
+  if (compiled_model_ != nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "SetBatchSize() is taken from the compiled model "
+                         "by sessions.\n");
+    return kTfLiteError;
+  }
+  return allocator_.SetBatchSize(batch_size);
+}
+
+TfLiteStatus MicroInterpreter::SetOperatorFusion(bool enabled) {
+  if (tensors_allocated_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "SetOperatorFusion() must be called before "
+                         "AllocateTensors().\n");
+    return kTfLiteError;
+  }
+  if (compiled_model_ != nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "SetOperatorFusion() is taken from the compiled model "
+                         "by sessions.\n");
+    return kTfLiteError;
+  }
+  fuse_operators_ = enabled;
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroInterpreter::SetMemoryPlannerSearchSteps(
+    int max_search_steps) {
+  if (tensors_allocated_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "SetMemoryPlannerSearchSteps() must be called before "
+                         "AllocateTensors().\n");
+    return kTfLiteError;
+  }
+  if (compiled_model_ != nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "SetMemoryPlannerSearchSteps() is taken from the "
+                         "compiled model by sessions.\n");
+    return kTfLiteError;
+  }
+  return allocator_.SetMemoryPlannerSearchSteps(max_search_steps);
+}
+
 TfLiteStatus MicroInterpreter::AllocateTensors() {
+  if (compiled_model_ != nullptr) {
+    return AllocateSessionTensors();
+  }
   if (allocator_.StartModelAllocation(model_, op_resolver_,
                                       &node_and_registrations_,
                                       &eval_tensors_) != kTfLiteOk) {
@@ -272,6 +500,7 @@ TfLiteStatus MicroInterpreter::AllocateTensors() {
   // Only allow AllocatePersistentBuffer in Init stage.
   context_.AllocatePersistentBuffer = context_helper_.AllocatePersistentBuffer;
   context_.RequestScratchBufferInArena = nullptr;
+  context_.AllocateStateBuffer = nullptr;
   context_.GetScratchBuffer = nullptr;
 
   for (size_t i = 0; i < subgraph_->operators()->size(); ++i) {
@@ -292,10 +521,17 @@ TfLiteStatus MicroInterpreter::AllocateTensors() {
     }
   }
 
-  // Both AllocatePersistentBuffer and RequestScratchBufferInArena is
-  // available in Prepare stage.
+  // Activations have to be folded before their producers work out the
+  // clamping range in Prepare.
+  if (fuse_operators_) {
+    TF_LITE_ENSURE_STATUS(FoldActivations());
+  }
+
+  // AllocatePersistentBuffer, RequestScratchBufferInArena and
+  // AllocateStateBuffer are available in Prepare stage.
   context_.RequestScratchBufferInArena =
       context_helper_.RequestScratchBufferInArena;
+  context_.AllocateStateBuffer = context_helper_.AllocateStateBuffer;
   for (size_t i = 0; i < subgraph_->operators()->size(); ++i) {
     auto* node = &(node_and_registrations_[i].node);
     auto* registration = node_and_registrations_[i].registration;
@@ -312,22 +548,178 @@ TfLiteStatus MicroInterpreter::AllocateTensors() {
     allocator_.FinishPrepareNodeAllocations(/*node_id=*/i);
   }
 
+  if (fuse_operators_) {
+    TF_LITE_ENSURE_STATUS(FuseOperators());
+  }
+
   // Prepare is done, we're ready for Invoke. Memory allocation is no longer
   // allowed. Kernels can only fetch scratch buffers via GetScratchBuffer.
   context_.AllocatePersistentBuffer = nullptr;
   context_.RequestScratchBufferInArena = nullptr;
+  context_.AllocateStateBuffer = nullptr;
   context_.GetScratchBuffer = context_helper_.GetScratchBuffer;
 
   TF_LITE_ENSURE_OK(&context_,
                     allocator_.FinishModelAllocation(model_, eval_tensors_,
                                                      &scratch_buffer_handles_));
+  scratch_buffer_count_ = allocator_.scratch_buffer_count();
   // TODO(b/16157777): Remove this when ContextHelper is rolled into this class.
   context_helper_.SetScratchBufferHandles(scratch_buffer_handles_);
+  // A folded activation still has to copy its input if the memory plan did
+  // not keep its buffer shared with its output. Applying it twice is harmless.
+  for (size_t i = 0; folded_nodes_ != nullptr && i < operators_size(); ++i) {
+    const auto* op = subgraph_->operators()->Get(i);
+    folded_nodes_[i] &= eval_tensors_[op->inputs()->Get(0)].data.data ==
+                        eval_tensors_[op->outputs()->Get(0)].data.data;
+  }
   TF_LITE_ENSURE_STATUS(ResetVariableTensors());
   tensors_allocated_ = true;
   return kTfLiteOk;
 }
 
+TfLiteStatus MicroInterpreter::AllocateSessionTensors() {
+  if (!compiled_model_->tensors_allocated_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "AllocateTensors() must be called on the compiled "
+                         "model before its sessions.\n");
+    initialization_status_ = kTfLiteError;
+    return kTfLiteError;
+  }
+  // The compiled model already ran Init and Prepare, and corrected the
+  // endianness of the weights.
+  node_and_registrations_ = compiled_model_->node_and_registrations_;
+  folded_nodes_ = compiled_model_->folded_nodes_;
+  if (allocator_.AllocateSession(
+          compiled_model_->allocator_, model_, compiled_model_->eval_tensors_,
+          compiled_model_->scratch_buffer_handles_, &eval_tensors_,
+          &scratch_buffer_handles_) != kTfLiteOk) {
+    TF_LITE_REPORT_ERROR(error_reporter_, "Failed allocating session.\n");
+    initialization_status_ = kTfLiteError;
+    return kTfLiteError;
+  }
+  scratch_buffer_count_ = allocator_.scratch_buffer_count();
+  context_helper_.SetTfLiteEvalTensors(eval_tensors_);
+  context_helper_.SetScratchBufferHandles(scratch_buffer_handles_);
+  context_.tensors_size = subgraph_->tensors()->size();
+  context_.AllocatePersistentBuffer = nullptr;
+  context_.RequestScratchBufferInArena = nullptr;
+  context_.AllocateStateBuffer = nullptr;
+  context_.GetScratchBuffer = context_helper_.GetScratchBuffer;
+  TF_LITE_ENSURE_STATUS(ResetVariableTensors());
+  tensors_allocated_ = true;
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroInterpreter::FoldActivations() {
+  const auto* tensors = subgraph_->tensors();
+  for (size_t i = 0; i < operators_size(); ++i) {
+    const auto* op = subgraph_->operators()->Get(i);
+    const int32_t code = node_and_registrations_[i].registration->builtin_code;
+    TfLiteFusedActivation activation;
+    if (code == BuiltinOperator_RELU) {
+      activation = kTfLiteActRelu;
+    } else if (code == BuiltinOperator_RELU6) {
+      activation = kTfLiteActRelu6;
+    } else {
+      continue;
+    }
+    const int input_index = op->inputs()->Get(0);
+    const int output_index = op->outputs()->Get(0);
+    bool is_model_output = false;
+    for (size_t k = 0; k < outputs_size(); ++k) {
+      is_model_output |= outputs().Get(k) == input_index;
+    }
+    if (input_index < 0 || eval_tensors_[input_index].data.data != nullptr ||
+        tensors->Get(input_index)->is_variable() || is_model_output ||
+        !HasSingleConsumer(input_index) ||
+        !HaveSameEncoding(tensors->Get(input_index),
+                          tensors->Get(output_index))) {
+      continue;
+    }
+    // The producer clamps to the same range as RELU or RELU6 would, as long
+    // as it has no activation of its own.
+    for (size_t n = 0; n < operators_size(); ++n) {
+      const auto* producer = subgraph_->operators()->Get(n);
+      if (producer->outputs()->size() != 1 ||
+          producer->outputs()->Get(0) != input_index) {
+        continue;
+      }
+      TfLiteFusedActivation* producer_activation = FusedActivation(
+          BuiltinOperator(
+              node_and_registrations_[n].registration->builtin_code),
+          node_and_registrations_[n].node.builtin_data);
+      if (producer_activation == nullptr ||
+          *producer_activation != kTfLiteActNone) {
+        break;
+      }
+      if (folded_nodes_ == nullptr) {
+        folded_nodes_ = static_cast<bool*>(allocator_.AllocatePersistentBuffer(
+            sizeof(bool) * operators_size()));
+        TF_LITE_ENSURE(&context_, folded_nodes_ != nullptr);
+        for (size_t k = 0; k < operators_size(); ++k) {
+          folded_nodes_[k] = false;
+        }
+      }
+      *producer_activation = activation;
+      folded_nodes_[i] = true;
+      break;
+    }
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroInterpreter::FuseOperators() {
+  const auto* tensors = subgraph_->tensors();
+  for (size_t i = 0; i < subgraph_->operators()->size(); ++i) {
+    const auto* op = subgraph_->operators()->Get(i);
+    const TfLiteRegistration* registration =
+        node_and_registrations_[i].registration;
+    if (registration->builtin_code == BuiltinOperator_CUSTOM ||
+        op->outputs()->size() != 1) {
+      continue;
+    }
+    const int output_index = op->outputs()->Get(0);
+    if (output_index < 0 || eval_tensors_[output_index].data.data != nullptr ||
+        tensors->Get(output_index)->is_variable()) {
+      continue;
+    }
+    for (size_t n = 0; n < op->inputs()->size(); ++n) {
+      const int input_index = op->inputs()->Get(n);
+      // Constants and variables already have a buffer, and model outputs have
+      // to keep their value after Invoke().
+      if (input_index < 0 || eval_tensors_[input_index].data.data != nullptr ||
+          tensors->Get(input_index)->is_variable()) {
+        continue;
+      }
+      bool is_model_output = false;
+      for (size_t k = 0; k < outputs_size(); ++k) {
+        is_model_output |= outputs().Get(k) == input_index;
+      }
+      if (is_model_output || !HasSingleConsumer(input_index) ||
+          !CanRunInPlace(BuiltinOperator(registration->builtin_code), n,
+                         eval_tensors_[input_index],
+                         eval_tensors_[output_index])) {
+        continue;
+      }
+      TF_LITE_ENSURE_STATUS(
+          allocator_.AddTensorAlias(model_, input_index, output_index));
+      break;
+    }
+  }
+  return kTfLiteOk;
+}
+
+bool MicroInterpreter::HasSingleConsumer(int tensor_index) const {
+  int consumers = 0;
+  for (size_t i = 0; i < subgraph_->operators()->size(); ++i) {
+    const auto* inputs = subgraph_->operators()->Get(i)->inputs();
+    for (size_t n = 0; n < inputs->size(); ++n) {
+      consumers += inputs->Get(n) == tensor_index ? 1 : 0;
+    }
+  }
+  return consumers == 1;
+}
+
 TfLiteStatus MicroInterpreter::Invoke() {
   if (initialization_status_ != kTfLiteOk) {
     TF_LITE_REPORT_ERROR(error_reporter_,
@@ -341,9 +733,13 @@ TfLiteStatus MicroInterpreter::Invoke() {
     TF_LITE_ENSURE_OK(&context_, AllocateTensors());
   }
 
+  ScopedInvokeTrace scoped_trace(tracer_);
   for (size_t i = 0; i < subgraph_->operators()->size(); ++i) {
     auto* node = &(node_and_registrations_[i].node);
     auto* registration = node_and_registrations_[i].registration;
+    if (folded_nodes_ != nullptr && folded_nodes_[i]) {
+      continue;
+    }
 
     if (registration->invoke) {
       TfLiteStatus invoke_status;
@@ -355,8 +751,13 @@ TfLiteStatus MicroInterpreter::Invoke() {
       ScopedOperatorProfile scoped_profiler(
           profiler, OpNameFromRegistration(registration), i);
 #endif
-	  //int start_tick = get_current_ticks();
+      const uint64_t op_start_ns =
+          tracer_ != nullptr ? tracer_->BeginEvent() : 0;
       invoke_status = registration->invoke(&context_, node);
+      if (tracer_ != nullptr) {
+        tracer_->EndOperatorEvent(op_start_ns, i, registration, node,
+                                  eval_tensors_);
+      }
 
       // All TfLiteTensor structs used in the kernel are allocated from temp
       // memory in the allocator. This creates a chain of allocations in the
@@ -425,6 +826,12 @@ TfLiteTensor* MicroInterpreter::output(size_t index) {
     output_tensor_[index] = allocator_.AllocatePersistentTfLiteTensor(
         model_, eval_tensors_, outputs().Get(index));
   }
+  // Kernels may move an output between invocations (e.g. the ring
+  // CIRCULAR_BUFFER), so follow the TfLiteEvalTensor.
+  if (output_tensor_[index] != nullptr) {
+    output_tensor_[index]->data.data =
+        eval_tensors_[outputs().Get(index)].data.data;
+  }
   return output_tensor_[index];
 }
 
@@ -455,6 +862,12 @@ TfLiteStatus MicroInterpreter::ResetVariableTensors() {
       memset(eval_tensors_[i].data.raw, value, buffer_size);
     }
   }
+  for (size_t i = 0; i < scratch_buffer_count_; ++i) {
+    if (scratch_buffer_handles_[i].state_bytes > 0) {
+      memset(scratch_buffer_handles_[i].data, 0,
+             scratch_buffer_handles_[i].state_bytes);
+    }
+  }
 
   return kTfLiteOk;
 }
@@ -25,6 +25,8 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/micro/micro_allocator.h"
 #include "tensorflow/lite/micro/micro_op_resolver.h"
+#include "tensorflow/lite/micro/micro_thread_pool.h"
+#include "tensorflow/lite/micro/micro_tracer.h"
 #include "tensorflow/lite/portable_type_to_tflitetype.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 
@@ -46,6 +48,8 @@ class ContextHelper {
   static TfLiteStatus RequestScratchBufferInArena(TfLiteContext* ctx,
                                                   size_t bytes,
                                                   int* buffer_idx);
+  static void* AllocateStateBuffer(TfLiteContext* ctx, size_t bytes,
+                                   int* buffer_idx);
   static void* GetScratchBuffer(TfLiteContext* ctx, int buffer_idx);
   static void ReportOpError(struct TfLiteContext* context, const char* format,
                             ...);
@@ -53,6 +57,11 @@ class ContextHelper {
                                  int tensor_idx);
   static TfLiteEvalTensor* GetEvalTensor(const struct TfLiteContext* context,
                                          int tensor_idx);
+  static TfLiteExternalContext* GetExternalContext(
+      struct TfLiteContext* context, TfLiteExternalContextType type);
+  static void SetExternalContext(struct TfLiteContext* context,
+                                 TfLiteExternalContextType type,
+                                 TfLiteExternalContext* external_context);
 
   // Sets the pointer to a list of TfLiteEvalTensor instances.
   void SetTfLiteEvalTensors(TfLiteEvalTensor* eval_tensors);
@@ -66,6 +75,7 @@ class ContextHelper {
   const Model* model_ = nullptr;
   TfLiteEvalTensor* eval_tensors_ = nullptr;
   ScratchBufferHandle* scratch_buffer_handles_ = nullptr;
+  TfLiteExternalContext* external_contexts_[kTfLiteMaxExternalContexts] = {};
 };
 
 }  // namespace internal
@@ -95,6 +105,22 @@ class MicroInterpreter {
                    MicroAllocator* allocator, ErrorReporter* error_reporter,
                    tflite::Profiler* profiler = nullptr);
 
+  // Create a session interpreter that runs the model of |compiled_model|,
+  // which has to outlive it and must have completed AllocateTensors(). The
+  // session shares the compiled model's node and registration data, kernel op
+  // data and weights, and only allocates its own tensor structs, activations,
+  // scratch buffers, variable tensors (e.g. SVDF state) and kernel state
+  // buffers (see TfLiteContext::AllocateStateBuffer, e.g. CIRCULAR_BUFFER)
+  // from |tensor_arena|. This makes the arena of each additional session much
+  // smaller than that of an interpreter built from the model. Every session
+  // keeps its own stream state, so sessions can be invoked in any order. A
+  // kernel that writes to its op data during Invoke() would share that state
+  // between all sessions.
+  MicroInterpreter(const MicroInterpreter& compiled_model,
+                   uint8_t* tensor_arena, size_t tensor_arena_size,
+                   ErrorReporter* error_reporter,
+                   tflite::Profiler* profiler = nullptr);
+
   ~MicroInterpreter();
 
   // Runs through the model and allocates all necessary input, output and
@@ -106,6 +132,55 @@ class MicroInterpreter {
   // TODO(b/149795762): Add this to the TfLiteStatus enum.
   TfLiteStatus Invoke();
 
+  // Lets kernels that support it (CONV_2D, DEPTHWISE_CONV_2D and
+  // FULLY_CONNECTED) split their work across the threads of |thread_pool|.
+  // Kernels size their scratch buffers for the number of threads, so this has
+  // to be called before AllocateTensors(). Passing nullptr restores single
+  // threaded execution. The pool is not owned and must outlive the
+  // interpreter.
+  TfLiteStatus SetThreadPool(MicroThreadPool* thread_pool);
+
+  // Makes every Invoke() run |batch_size| independent samples at once. Inputs
+  // with a leading dimension of 1 in the model, and the activations, outputs
+  // and variable tensors computed from them, get |batch_size| as their leading
+  // dimension, so sample i of an input lives at offset i * (bytes /
+  // batch_size). Other inputs are shared by every sample. Kernels that support
+  // it (FULLY_CONNECTED, SVDF and CONV_2D) then read their weights once for the
+  // whole batch. AllocateTensors() fails if a batched tensor reaches an
+  // operator that mixes samples, e.g. a RESHAPE that drops the leading 1. See
+  // MicroAllocator::SetBatchSize(). Has to be called before AllocateTensors().
+  TfLiteStatus SetBatchSize(int batch_size);
+
+  // Lets AllocateTensors() fuse each operator that can compute its output in
+  // place (RESHAPE, elementwise activations and math, ADD, SUB, MUL, MAXIMUM,
+  // MINIMUM, and QUANTIZE or DEQUANTIZE to a type that is not wider) with the
+  // operator that produces its input, e.g. CONV_2D->ADD,
+  // FULLY_CONNECTED->SOFTMAX or CONV_2D->RESHAPE->FULLY_CONNECTED. The
+  // producer then writes straight into the consumer's output buffer and the
+  // intermediate tensor gets no memory of its own, which lowers the arena
+  // high-water mark. Only intermediates that have no other consumer and are
+  // not model outputs are fused; the contents of a fused model input are
+  // overwritten by Invoke(). A RELU or RELU6 whose input comes from a CONV_2D,
+  // DEPTHWISE_CONV_2D, FULLY_CONNECTED or ADD with no activation of its own,
+  // in the same float or per-tensor int8 encoding, is folded into that
+  // operator's output clamp instead and no longer runs at all. Has to be
+  // called before AllocateTensors().
+  TfLiteStatus SetOperatorFusion(bool enabled);
+
+  // Lets AllocateTensors() search for a smaller arena layout than the greedy
+  // memory planner finds, trying at most |max_search_steps| buffer placements.
+  // See MicroAllocator::SetMemoryPlannerSearchSteps(). Has to be called before
+  // AllocateTensors(). memory_plan_stats() then describes the plan found.
+  TfLiteStatus SetMemoryPlannerSearchSteps(int max_search_steps);
+  const MemoryPlanStats& memory_plan_stats() const {
+    return allocator_.memory_plan_stats();
+  }
+
+  // Records every operator and every Invoke() into |tracer|, in release builds
+  // as well. Can be changed at any time between Invoke() calls; nullptr stops
+  // tracing. The tracer is not owned and must outlive the interpreter.
+  void SetTracer(MicroTracer* tracer) { tracer_ = tracer; }
+
   size_t tensors_size() const { return context_.tensors_size; }
   TfLiteTensor* tensor(size_t tensor_index);
   template <class T>
@@ -150,7 +225,8 @@ class MicroInterpreter {
     return nullptr;
   }
 
-  // Reset all variable tensors to the default value.
+  // Reset all variable tensors to the default value, and zero the state
+  // buffers of the kernels.
   TfLiteStatus ResetVariableTensors();
 
   TfLiteStatus initialization_status() const { return initialization_status_; }
@@ -181,6 +257,21 @@ class MicroInterpreter {
 
   void CorrectTensorEndianness(TfLiteEvalTensor* tensorCorr);
 
+  // AllocateTensors() for an interpreter created from a compiled model.
+  TfLiteStatus AllocateSessionTensors();
+
+  // Folds each RELU and RELU6 found by SetOperatorFusion() into the fused
+  // activation of the CONV_2D, DEPTHWISE_CONV_2D, FULLY_CONNECTED or ADD that
+  // produces its input. Called between Init and Prepare.
+  TfLiteStatus FoldActivations();
+
+  // Registers the in place operators found by SetOperatorFusion() with the
+  // allocator. Called between Prepare and memory planning.
+  TfLiteStatus FuseOperators();
+
+  // Returns true if tensor_index is read by exactly one operator input.
+  bool HasSingleConsumer(int tensor_index) const;
+
   template <class T>
   void CorrectTensorDataEndianness(T* data, int32_t size);
 
@@ -191,13 +282,22 @@ class MicroInterpreter {
   ErrorReporter* error_reporter_;
   TfLiteContext context_ = {};
   MicroAllocator& allocator_;
+  // Set for session interpreters, which own none of node_and_registrations_.
+  const MicroInterpreter* compiled_model_ = nullptr;
   bool tensors_allocated_;
+  bool fuse_operators_ = false;
+  MicroTracer* tracer_ = nullptr;
 
   TfLiteStatus initialization_status_;
 
   const SubGraph* subgraph_ = nullptr;
   TfLiteEvalTensor* eval_tensors_ = nullptr;
   ScratchBufferHandle* scratch_buffer_handles_ = nullptr;
+  size_t scratch_buffer_count_ = 0;
+  // For each operator, whether its activation was folded into the operator
+  // that produces its input and shares its buffer, so Invoke() skips it. Null
+  // when no activation was folded.
+  bool* folded_nodes_ = nullptr;
 
   // TODO(b/16157777): Drop this reference:
   internal::ContextHelper context_helper_;
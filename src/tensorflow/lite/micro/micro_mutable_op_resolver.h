@@ -15,8 +15,10 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_MICRO_MICRO_MUTABLE_OP_RESOLVER_H_
 #define TENSORFLOW_LITE_MICRO_MICRO_MUTABLE_OP_RESOLVER_H_
 
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <type_traits>
 
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/core/api/error_reporter.h"
@@ -24,6 +26,8 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/compatibility.h"
 #include "tensorflow/lite/kernels/op_macros.h"
 #include "tensorflow/lite/micro/compatibility.h"
+#include "tensorflow/lite/micro/kernels/conv.h"
+#include "tensorflow/lite/micro/kernels/depthwise_conv.h"
 #include "tensorflow/lite/micro/kernels/ethosu.h"
 #include "tensorflow/lite/micro/kernels/fully_connected.h"
 #include "tensorflow/lite/micro/kernels/micro_ops.h"
@@ -40,35 +44,34 @@ class MicroMutableOpResolver : public MicroOpResolver {
       : error_reporter_(error_reporter) {}
 
   const TfLiteRegistration* FindOp(tflite::BuiltinOperator op) const override {
-    if (op == BuiltinOperator_CUSTOM) return nullptr;
-
-    for (unsigned int i = 0; i < registrations_len_; ++i) {
-      const TfLiteRegistration& registration = registrations_[i];
-      if (registration.builtin_code == op) {
-        return &registration;
-      }
+    if (op == BuiltinOperator_CUSTOM || op < BuiltinOperator_MIN ||
+        op > BuiltinOperator_MAX) {
+      return nullptr;
     }
-    return nullptr;
+    const OpIndex slot = builtin_slots_[op];
+    return slot == 0 ? nullptr : &registrations_[slot - 1];
   }
 
   const TfLiteRegistration* FindOp(const char* op) const override {
-    for (unsigned int i = 0; i < registrations_len_; ++i) {
-      const TfLiteRegistration& registration = registrations_[i];
-      if ((registration.builtin_code == BuiltinOperator_CUSTOM) &&
-          (strcmp(registration.custom_name, op) == 0)) {
-        return &registration;
+    for (unsigned int i = HashName(op);; i = (i + 1) & (kCustomSlots - 1)) {
+      const OpIndex slot = custom_slots_[i];
+      if (slot == 0) {
+        return nullptr;
+      }
+      if (strcmp(registrations_[slot - 1].custom_name, op) == 0) {
+        return &registrations_[slot - 1];
       }
     }
-    return nullptr;
   }
 
   MicroOpResolver::BuiltinParseFunction GetOpDataParser(
       BuiltinOperator op) const override {
-    TFLITE_DCHECK(num_buitin_ops_ <= tOpCount);
-    for (unsigned int i = 0; i < num_buitin_ops_; ++i) {
-      if (builtin_codes_[i] == op) return builtin_parsers_[i];
+    if (op == BuiltinOperator_CUSTOM || op < BuiltinOperator_MIN ||
+        op > BuiltinOperator_MAX) {
+      return nullptr;
     }
-    return nullptr;
+    const OpIndex slot = builtin_slots_[op];
+    return slot == 0 ? nullptr : builtin_parsers_[slot - 1];
   }
 
   // Registers a Custom Operator with the MicroOpResolver.
@@ -99,11 +102,19 @@ class MicroMutableOpResolver : public MicroOpResolver {
     }
 
     TfLiteRegistration* new_registration = &registrations_[registrations_len_];
+    builtin_parsers_[registrations_len_] = nullptr;
     registrations_len_ += 1;
 
     *new_registration = *registration;
     new_registration->builtin_code = BuiltinOperator_CUSTOM;
     new_registration->custom_name = name;
+
+    // The table is at most half full, so there always is an empty slot.
+    unsigned int i = HashName(name);
+    while (custom_slots_[i] != 0) {
+      i = (i + 1) & (kCustomSlots - 1);
+    }
+    custom_slots_[i] = static_cast<OpIndex>(registrations_len_);
     return kTfLiteOk;
   }
 
@@ -141,9 +152,10 @@ class MicroMutableOpResolver : public MicroOpResolver {
                       ParseCeil);
   }
 
-  TfLiteStatus AddCircularBuffer() {
-    return AddCustom("CIRCULAR_BUFFER",
-                     tflite::ops::micro::Register_CIRCULAR_BUFFER());
+  TfLiteStatus AddCircularBuffer(
+      TfLiteRegistration* registration =
+          tflite::ops::micro::Register_CIRCULAR_BUFFER()) {
+    return AddCustom("CIRCULAR_BUFFER", registration);
   }
 
   TfLiteStatus AddConcatenation() {
@@ -152,8 +164,9 @@ class MicroMutableOpResolver : public MicroOpResolver {
                       ParseConcatenation);
   }
 
-  TfLiteStatus AddConv2D() {
-    return AddBuiltin(BuiltinOperator_CONV_2D, Register_CONV_2D(), ParseConv2D);
+  TfLiteStatus AddConv2D(
+      const TfLiteRegistration& registration = Register_CONV_2D()) {
+    return AddBuiltin(BuiltinOperator_CONV_2D, registration, ParseConv2D);
   }
 
   TfLiteStatus AddCos() {
@@ -161,9 +174,10 @@ class MicroMutableOpResolver : public MicroOpResolver {
                       ParseCos);
   }
 
-  TfLiteStatus AddDepthwiseConv2D() {
-    return AddBuiltin(BuiltinOperator_DEPTHWISE_CONV_2D,
-                      Register_DEPTHWISE_CONV_2D(), ParseDepthwiseConv2D);
+  TfLiteStatus AddDepthwiseConv2D(
+      const TfLiteRegistration& registration = Register_DEPTHWISE_CONV_2D()) {
+    return AddBuiltin(BuiltinOperator_DEPTHWISE_CONV_2D, registration,
+                      ParseDepthwiseConv2D);
   }
 
   TfLiteStatus AddDequantize() {
@@ -424,8 +438,9 @@ class MicroMutableOpResolver : public MicroOpResolver {
                       ParseSub);
   }
 
-  TfLiteStatus AddSvdf() {
-    return AddBuiltin(BuiltinOperator_SVDF, Register_SVDF(), ParseSvdf);
+  TfLiteStatus AddSvdf(
+      const TfLiteRegistration& registration = Register_SVDF()) {
+    return AddBuiltin(BuiltinOperator_SVDF, registration, ParseSvdf);
   }
 
   TfLiteStatus AddTanh() {
@@ -446,11 +461,13 @@ class MicroMutableOpResolver : public MicroOpResolver {
   TfLiteStatus AddBuiltin(tflite::BuiltinOperator op,
                           const TfLiteRegistration& registration,
                           MicroOpResolver::BuiltinParseFunction parser) {
-    if (op == BuiltinOperator_CUSTOM) {
+    if (op == BuiltinOperator_CUSTOM || op < BuiltinOperator_MIN ||
+        op > BuiltinOperator_MAX) {
       if (error_reporter_ != nullptr) {
         TF_LITE_REPORT_ERROR(error_reporter_,
-                             "Invalid parameter BuiltinOperator_CUSTOM to the "
-                             "AddBuiltin function.");
+                             "Invalid parameter BuiltinOperator #%d to the "
+                             "AddBuiltin function.",
+                             op);
       }
       return kTfLiteError;
     }
@@ -479,23 +496,44 @@ class MicroMutableOpResolver : public MicroOpResolver {
     // Strictly speaking, the builtin_code is not necessary for TFLM but filling
     // it in regardless.
     registrations_[registrations_len_].builtin_code = op;
+    builtin_parsers_[registrations_len_] = parser;
     registrations_len_++;
-
-    builtin_codes_[num_buitin_ops_] = op;
-    builtin_parsers_[num_buitin_ops_] = parser;
-    num_buitin_ops_++;
+    builtin_slots_[op] = static_cast<OpIndex>(registrations_len_);
 
     return kTfLiteOk;
   }
 
+  // Smallest power of two that keeps the custom op table at most half full.
+  static constexpr unsigned int CustomSlots(unsigned int slots = 1) {
+    return slots >= 2 * tOpCount ? slots : CustomSlots(slots * 2);
+  }
+  static constexpr unsigned int kCustomSlots = CustomSlots();
+
+  // FNV-1a hash of a custom op name, reduced to a slot of the table.
+  static unsigned int HashName(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (; *name != '\0'; ++name) {
+      hash = (hash ^ static_cast<uint8_t>(*name)) * 16777619u;
+    }
+    return hash & (kCustomSlots - 1);
+  }
+
+  // Registration index + 1 in the lookup tables below, 0 for an empty slot.
+  typedef typename std::conditional<(tOpCount < 255), uint8_t, uint16_t>::type
+      OpIndex;
+
   TfLiteRegistration registrations_[tOpCount];
   unsigned int registrations_len_ = 0;
 
-  // Arrays (and counter) to store the builtin codes and their corresponding
-  // parse functions as these are registered with the Op Resolver.
-  BuiltinOperator builtin_codes_[tOpCount];
+  // Parse function of each registration, nullptr for custom ops.
   MicroOpResolver::BuiltinParseFunction builtin_parsers_[tOpCount];
-  unsigned int num_buitin_ops_ = 0;
+
+  // Registrations by builtin code, so that model loading does not have to
+  // scan all registrations for every operator.
+  OpIndex builtin_slots_[BuiltinOperator_MAX + 1] = {};
+
+  // Open addressing hash table of the custom op registrations by name.
+  OpIndex custom_slots_[kCustomSlots] = {};
 
   ErrorReporter* error_reporter_;
 };
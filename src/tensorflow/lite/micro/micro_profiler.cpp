@@ -15,28 +15,322 @@ limitations under the License.
 
 #include "tensorflow/lite/micro/micro_profiler.h"
 
+#include <cstring>
+
 #include "tensorflow/lite/kernels/internal/compatibility.h"
+#include "tensorflow/lite/micro/memory_helpers.h"
 #include "tensorflow/lite/micro/micro_time.h"
+#include "tensorflow/lite/micro/output_buffer.h"
 
 namespace tflite {
+namespace {
+
+using internal::OutputBuffer;
+
+// Histogram bin of a duration. The first kHistogramSubBins bins hold exact
+// values; after that every power of two is split into kHistogramSubBins bins.
+int HistogramBin(uint64_t duration_ns) {
+  constexpr int kSubBins = MicroProfiler::kHistogramSubBins;
+  constexpr int kSubBinBits = 3;
+  static_assert((1 << kSubBinBits) == kSubBins, "kSubBinBits mismatch");
+  if (duration_ns < kSubBins) {
+    return static_cast<int>(duration_ns);
+  }
+  int log2 = 0;
+  for (uint64_t v = duration_ns; v > 1; v >>= 1) {
+    ++log2;
+  }
+  const int bin = (log2 - kSubBinBits + 1) * kSubBins +
+                  static_cast<int>((duration_ns >> (log2 - kSubBinBits)) &
+                                   (kSubBins - 1));
+  return bin < MicroProfiler::kNumHistogramBins
+             ? bin
+             : MicroProfiler::kNumHistogramBins - 1;
+}
+
+// Largest duration that falls into a histogram bin.
+uint64_t HistogramBinUpperBound(int bin) {
+  constexpr int kSubBins = MicroProfiler::kHistogramSubBins;
+  if (bin < kSubBins) {
+    return bin;
+  }
+  const int shift = bin / kSubBins - 1;
+  const uint64_t lower = static_cast<uint64_t>(kSubBins + bin % kSubBins)
+                         << shift;
+  return lower + (static_cast<uint64_t>(1) << shift) - 1;
+}
+
+uint64_t Percentile(const MicroProfiler::Stats& stats, int percent) {
+  const uint64_t rank =
+      (static_cast<uint64_t>(stats.count) * percent + 99) / 100;
+  uint64_t seen = 0;
+  uint64_t value = stats.max_ns;
+  for (int i = 0; i < MicroProfiler::kNumHistogramBins; ++i) {
+    seen += stats.histogram[i];
+    if (seen >= rank) {
+      value = HistogramBinUpperBound(i);
+      break;
+    }
+  }
+  if (value > stats.max_ns) value = stats.max_ns;
+  if (value < stats.min_ns) value = stats.min_ns;
+  return value;
+}
+
+void AppendSummaryCsv(const MicroProfiler::Summary& summary,
+                      OutputBuffer* out) {
+  out->Append(summary.op_index == MicroProfiler::kNoOpIndex ? "type," : "op,");
+  out->AppendSigned(summary.op_index);
+  out->Append(",");
+  out->Append(summary.tag);
+  out->Append(",");
+  out->AppendUnsigned(summary.count);
+  out->Append(",");
+  out->AppendUnsigned(summary.min_ns);
+  out->Append(",");
+  out->AppendUnsigned(summary.mean_ns);
+  out->Append(",");
+  out->AppendUnsigned(summary.p99_ns);
+  out->Append(",");
+  out->AppendUnsigned(summary.max_ns);
+  out->Append("\n");
+}
+
+}  // namespace
 
-MicroProfiler::MicroProfiler(tflite::ErrorReporter* reporter)
-    : reporter_(reporter) {}
+MicroProfiler::MicroProfiler(uint8_t* stats_buffer, size_t stats_buffer_size,
+                             tflite::ErrorReporter* reporter)
+    : reporter_(reporter) {
+  uint8_t* aligned = AlignPointerUp(stats_buffer, alignof(Stats));
+  const size_t padding = aligned - stats_buffer;
+  stats_ = reinterpret_cast<Stats*>(aligned);
+  max_stats_ = stats_buffer_size > padding
+                   ? static_cast<int>((stats_buffer_size - padding) /
+                                      sizeof(Stats))
+                   : 0;
+}
 
 uint32_t MicroProfiler::BeginEvent(const char* tag, EventType event_type,
                                    int64_t event_metadata1,
                                    int64_t event_metadata2) {
-  start_time_ = GetCurrentTimeTicks();
   TFLITE_DCHECK(tag != nullptr);
-  event_tag_ = tag;
-  return 0;
+  if (num_open_events_ >= kMaxOpenEvents) {
+    ++dropped_events_;
+    return kMaxOpenEvents;
+  }
+  OpenEvent& event = open_events_[num_open_events_];
+  event.tag = tag;
+  event.op_index = event_type == EventType::OPERATOR_INVOKE_EVENT
+                       ? static_cast<int32_t>(event_metadata1)
+                       : kNoOpIndex;
+  // Read the clock last so that the bookkeeping above is not timed.
+  event.start_ns = GetTimeNanos();
+  return num_open_events_++;
 }
 
 void MicroProfiler::EndEvent(uint32_t event_handle) {
+  const uint64_t end_ns = GetTimeNanos();
+  if (event_handle >= static_cast<uint32_t>(num_open_events_)) {
+    return;
+  }
+  while (num_open_events_ > static_cast<int>(event_handle)) {
+    const OpenEvent& event = open_events_[--num_open_events_];
+    const uint64_t duration_ns = end_ns - event.start_ns;
+    Stats* tag_stats = FindOrAddStats(event.tag, kNoOpIndex);
+    Stats* op_stats = event.op_index == kNoOpIndex
+                          ? nullptr
+                          : FindOrAddStats(event.tag, event.op_index);
+    if (tag_stats == nullptr ||
+        (event.op_index != kNoOpIndex && op_stats == nullptr)) {
+      ++dropped_events_;
+    }
+    if (tag_stats != nullptr) {
+      Record(tag_stats, event.start_ns, duration_ns);
+    }
+    if (op_stats != nullptr) {
+      Record(op_stats, event.start_ns, duration_ns);
+    }
+  }
+}
+
+void MicroProfiler::Reset() {
+  num_stats_ = 0;
+  num_open_events_ = 0;
+  dropped_events_ = 0;
+}
+
+MicroProfiler::Summary MicroProfiler::GetSummary(int index) const {
+  TFLITE_DCHECK(index >= 0 && index < num_stats_);
+  const Stats& stats = stats_[index];
+  Summary summary;
+  summary.tag = stats.tag;
+  summary.op_index = stats.op_index;
+  summary.count = stats.count;
+  summary.min_ns = stats.min_ns;
+  summary.mean_ns = stats.total_ns / stats.count;
+  summary.p99_ns = Percentile(stats, 99);
+  summary.max_ns = stats.max_ns;
+  return summary;
+}
+
+TfLiteStatus MicroProfiler::GetOpSummary(int op_index,
+                                         Summary* summary) const {
+  for (int i = 0; i < num_stats_; ++i) {
+    if (stats_[i].op_index == op_index && op_index != kNoOpIndex) {
+      *summary = GetSummary(i);
+      return kTfLiteOk;
+    }
+  }
+  return kTfLiteError;
+}
+
+TfLiteStatus MicroProfiler::GetTagSummary(const char* tag,
+                                          Summary* summary) const {
+  const Stats* stats = FindStats(tag, kNoOpIndex);
+  if (stats == nullptr) {
+    return kTfLiteError;
+  }
+  *summary = GetSummary(static_cast<int>(stats - stats_));
+  return kTfLiteOk;
+}
+
+void MicroProfiler::Log() const {
 #ifndef TF_LITE_STRIP_ERROR_STRINGS
-  int32_t end_time = GetCurrentTimeTicks();
-  TF_LITE_REPORT_ERROR(reporter_, "%s took %d cycles\n", event_tag_,
-                       end_time - start_time_);
+  for (int i = 0; i < num_stats_; ++i) {
+    const Summary summary = GetSummary(i);
+    char line[160];
+    OutputBuffer out(line, sizeof(line));
+    if (summary.op_index != kNoOpIndex) {
+      out.Append("[");
+      out.AppendSigned(summary.op_index);
+      out.Append("] ");
+    }
+    out.Append(summary.tag);
+    out.Append(": count ");
+    out.AppendUnsigned(summary.count);
+    out.Append(" min ");
+    out.AppendMicros(summary.min_ns);
+    out.Append(" mean ");
+    out.AppendMicros(summary.mean_ns);
+    out.Append(" p99 ");
+    out.AppendMicros(summary.p99_ns);
+    out.Append(" max ");
+    out.AppendMicros(summary.max_ns);
+    out.Append(" us");
+    out.Finish();
+    TF_LITE_REPORT_ERROR(reporter_, "%s", line);
+  }
+  if (dropped_events_ > 0) {
+    TF_LITE_REPORT_ERROR(reporter_, "%d events dropped",
+                         static_cast<int>(dropped_events_));
+  }
 #endif
 }
+
+size_t MicroProfiler::ExportCsv(char* buffer, size_t buffer_size) const {
+  OutputBuffer out(buffer, buffer_size);
+  out.Append("kind,op_index,tag,count,min_ns,mean_ns,p99_ns,max_ns\n");
+  for (int i = 0; i < num_stats_; ++i) {
+    AppendSummaryCsv(GetSummary(i), &out);
+  }
+  return out.Finish();
+}
+
+size_t MicroProfiler::ExportChromeTrace(char* buffer,
+                                        size_t buffer_size) const {
+  // Timestamps are relative to the earliest event that is exported.
+  uint64_t origin_ns = 0;
+  bool has_origin = false;
+  for (int i = 0; i < num_stats_; ++i) {
+    if (stats_[i].op_index != kNoOpIndex &&
+        (!has_origin || stats_[i].last_start_ns < origin_ns)) {
+      origin_ns = stats_[i].last_start_ns;
+      has_origin = true;
+    }
+  }
+
+  OutputBuffer out(buffer, buffer_size);
+  out.Append("{\"traceEvents\":[");
+  bool first = true;
+  for (int i = 0; i < num_stats_; ++i) {
+    const Stats& stats = stats_[i];
+    if (stats.op_index == kNoOpIndex) {
+      continue;
+    }
+    const Summary summary = GetSummary(i);
+    out.Append(first ? "\n" : ",\n");
+    first = false;
+    out.Append("{\"name\":\"");
+    out.Append(summary.tag);
+    out.Append("\",\"cat\":\"op\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":");
+    out.AppendMicros(stats.last_start_ns - origin_ns);
+    out.Append(",\"dur\":");
+    out.AppendMicros(stats.last_duration_ns);
+    out.Append(",\"args\":{\"op_index\":");
+    out.AppendSigned(summary.op_index);
+    out.Append(",\"count\":");
+    out.AppendUnsigned(summary.count);
+    out.Append(",\"min_ns\":");
+    out.AppendUnsigned(summary.min_ns);
+    out.Append(",\"mean_ns\":");
+    out.AppendUnsigned(summary.mean_ns);
+    out.Append(",\"p99_ns\":");
+    out.AppendUnsigned(summary.p99_ns);
+    out.Append(",\"max_ns\":");
+    out.AppendUnsigned(summary.max_ns);
+    out.Append("}}");
+  }
+  out.Append("\n],\"displayTimeUnit\":\"ns\"}\n");
+  return out.Finish();
+}
+
+uint64_t MicroProfiler::GetTimeNanos() {
+  return TicksToNanos(GetCurrentTimeTicks64());
+}
+
+MicroProfiler::Stats* MicroProfiler::FindOrAddStats(const char* tag,
+                                                    int32_t op_index) {
+  Stats* stats = const_cast<Stats*>(FindStats(tag, op_index));
+  if (stats != nullptr || num_stats_ >= max_stats_) {
+    return stats;
+  }
+  stats = &stats_[num_stats_++];
+  memset(stats, 0, sizeof(Stats));
+  stats->tag = tag;
+  stats->op_index = op_index;
+  return stats;
+}
+
+const MicroProfiler::Stats* MicroProfiler::FindStats(const char* tag,
+                                                     int32_t op_index) const {
+  for (int i = 0; i < num_stats_; ++i) {
+    const Stats& stats = stats_[i];
+    if (stats.op_index != op_index) {
+      continue;
+    }
+    // Operator indices are unique; tags are usually the same pointer but are
+    // compared by value so that equal custom op names share an entry.
+    if (op_index != kNoOpIndex || stats.tag == tag ||
+        strcmp(stats.tag, tag) == 0) {
+      return &stats;
+    }
+  }
+  return nullptr;
+}
+
+void MicroProfiler::Record(Stats* stats, uint64_t start_ns,
+                           uint64_t duration_ns) {
+  if (stats->count == 0 || duration_ns < stats->min_ns) {
+    stats->min_ns = duration_ns;
+  }
+  if (duration_ns > stats->max_ns) {
+    stats->max_ns = duration_ns;
+  }
+  ++stats->count;
+  stats->total_ns += duration_ns;
+  stats->last_start_ns = start_ns;
+  stats->last_duration_ns = duration_ns;
+  ++stats->histogram[HistogramBin(duration_ns)];
+}
+
 }  // namespace tflite
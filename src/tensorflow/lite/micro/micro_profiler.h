@@ -16,6 +16,10 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_MICRO_MICRO_PROFILER_H_
 #define TENSORFLOW_LITE_MICRO_MICRO_PROFILER_H_
 
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/core/api/error_reporter.h"
 #include "tensorflow/lite/core/api/profiler.h"
 #include "tensorflow/lite/micro/compatibility.h"
@@ -27,8 +31,26 @@ namespace tflite {
 // sections. This can be used in conjunction with running the relevant micro
 // benchmark to evaluate end-to-end performance.
 //
+// Every event is timed with a nanosecond clock and folded into running
+// statistics, so the profiler can stay attached across many Invoke() calls.
+// Operator events (EventType::OPERATOR_INVOKE_EVENT, as emitted by
+// ScopedOperatorProfile) are aggregated both per operator index and per
+// operator type; other events are aggregated per tag. The statistics live in a
+// caller provided buffer, in the same way as the tensor arena, and each entry
+// takes sizeof(MicroProfiler::Stats) bytes.
+//
 // Usage example:
-// MicroProfiler profiler(error_reporter);
+// uint8_t profiler_buffer[kProfilerBufferSize];
+// MicroProfiler profiler(profiler_buffer, kProfilerBufferSize,
+//                        error_reporter);
+// MicroInterpreter interpreter(model, resolver, arena, arena_size,
+//                              error_reporter, &profiler);
+// ...
+// for (int i = 0; i < 100; ++i) interpreter.Invoke();
+// profiler.Log();
+// profiler.ExportCsv(csv, csv_size);
+//
+// Outside of the interpreter, events can be added with ScopedProfile:
 // {
 //   ScopedProfile scoped_profile(profiler, tag);
 //   work_to_profile();
@@ -40,7 +62,47 @@ namespace tflite {
 // profiler->EndEvent(event_handle)
 class MicroProfiler : public tflite::Profiler {
  public:
-  explicit MicroProfiler(tflite::ErrorReporter* reporter);
+  // Latencies are binned into a histogram with kHistogramSubBins bins per
+  // power of two, which bounds the error of the reported percentile to 12.5%.
+  static constexpr int kHistogramSubBins = 8;
+  static constexpr int kNumHistogramBins = 30 * kHistogramSubBins;
+
+  // Maximum depth of events that are open at the same time.
+  static constexpr int kMaxOpenEvents = 16;
+
+  // Value of Summary::op_index for entries that aggregate by tag.
+  static constexpr int kNoOpIndex = -1;
+
+  // Aggregated latency of one operator index, operator type or tag.
+  struct Summary {
+    const char* tag;
+    int op_index;
+    uint32_t count;
+    uint64_t min_ns;
+    uint64_t mean_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+  };
+
+  // Storage for one entry. Exposed only so that callers can size the buffer.
+  struct Stats {
+    const char* tag;
+    int32_t op_index;
+    uint32_t count;
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    // Start and duration of the most recent occurrence, for trace export.
+    uint64_t last_start_ns;
+    uint64_t last_duration_ns;
+    uint32_t histogram[kNumHistogramBins];
+  };
+
+  // The buffer must outlive the profiler. Entries are created on first use;
+  // once the buffer is full, events for new entries are counted in
+  // dropped_events() and otherwise ignored.
+  MicroProfiler(uint8_t* stats_buffer, size_t stats_buffer_size,
+                tflite::ErrorReporter* reporter);
   ~MicroProfiler() override = default;
 
   // AddEvent is unused for Tf Micro.
@@ -49,20 +111,70 @@ class MicroProfiler : public tflite::Profiler {
                 int64_t event_metadata2) override{};
 
   // BeginEvent followed by code followed by EndEvent will profile the code
-  // enclosed. Multiple concurrent events are unsupported, so the return value
-  // is always 0. Event_metadata1 and event_metadata2 are unused. The tag
-  // pointer must be valid until EndEvent is called.
+  // enclosed. Events may nest up to kMaxOpenEvents deep. For operator events
+  // event_metadata1 is the operator index; event_metadata2 is unused. The tag
+  // pointer must be valid for the lifetime of the profiler.
   uint32_t BeginEvent(const char* tag, EventType event_type,
                       int64_t event_metadata1,
                       int64_t event_metadata2) override;
 
-  // Event_handle is ignored since TF Micro does not support concurrent events.
+  // Ends the event and any events begun after it that are still open.
   void EndEvent(uint32_t event_handle) override;
 
+  // Discards all statistics, keeping the buffer.
+  void Reset();
+
+  // Number of entries, in the order they were first seen. Entries with an
+  // op_index of kNoOpIndex aggregate an operator type or tag.
+  int num_stats() const { return num_stats_; }
+  Summary GetSummary(int index) const;
+
+  // Looks up the statistics of an operator index or an operator type. Returns
+  // kTfLiteError if no event has been recorded for it.
+  TfLiteStatus GetOpSummary(int op_index, Summary* summary) const;
+  TfLiteStatus GetTagSummary(const char* tag, Summary* summary) const;
+
+  // Number of events that were not recorded because the buffer was full or
+  // too many events were open.
+  uint32_t dropped_events() const { return dropped_events_; }
+
+  // Reports one line per entry through the error reporter.
+  void Log() const;
+
+  // Writes the statistics as CSV with one row per entry. Like snprintf, the
+  // output is truncated to fit buffer_size including the terminating NUL, and
+  // the return value is the length of the complete output, so a call with a
+  // null buffer returns the size that is needed.
+  size_t ExportCsv(char* buffer, size_t buffer_size) const;
+
+  // Writes the most recent occurrence of every operator as a complete ("X")
+  // event in the Chrome trace-event JSON format, with the aggregated
+  // statistics in its args, so that the last Invoke() can be viewed in
+  // chrome://tracing or Perfetto. Truncates and returns like ExportCsv().
+  size_t ExportChromeTrace(char* buffer, size_t buffer_size) const;
+
+ protected:
+  // Monotonic time in nanoseconds. Virtual so that tests can inject a clock.
+  virtual uint64_t GetTimeNanos();
+
  private:
+  struct OpenEvent {
+    const char* tag;
+    int32_t op_index;
+    uint64_t start_ns;
+  };
+
+  Stats* FindOrAddStats(const char* tag, int32_t op_index);
+  const Stats* FindStats(const char* tag, int32_t op_index) const;
+  void Record(Stats* stats, uint64_t start_ns, uint64_t duration_ns);
+
   tflite::ErrorReporter* reporter_;
-  int32_t start_time_;
-  const char* event_tag_;
+  Stats* stats_;
+  int max_stats_;
+  int num_stats_ = 0;
+  OpenEvent open_events_[kMaxOpenEvents];
+  int num_open_events_ = 0;
+  uint32_t dropped_events_ = 0;
   TF_LITE_REMOVE_VIRTUAL_DELETE
 };
 
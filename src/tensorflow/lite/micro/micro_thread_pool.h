@@ -0,0 +1,90 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_THREAD_POOL_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_THREAD_POOL_H_
+
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+
+namespace tflite {
+
+// Interface for a pool of worker threads that kernels can use to split the
+// work of a single operator across cores. A pool is registered with the
+// interpreter through MicroInterpreter::SetThreadPool() and exposed to kernels
+// as the kTfLiteCpuBackendContext external context.
+//
+// The interpreter does not take ownership of the pool, and calls Run() from
+// the thread that calls Invoke(). Implementations only need to support one
+// Run() at a time.
+class MicroThreadPool : public TfLiteExternalContext {
+ public:
+  MicroThreadPool() {
+    type = kTfLiteCpuBackendContext;
+    Refresh = nullptr;
+  }
+  virtual ~MicroThreadPool() {}
+
+  // Number of threads that execute tasks, including the caller of Run().
+  virtual int num_threads() const = 0;
+
+  // Calls task(arg, i) for every i in [0, num_tasks) and returns once all of
+  // them have completed. Tasks may run concurrently and in any order, and the
+  // calling thread takes part in the work.
+  virtual void Run(int num_tasks, void (*task)(void* arg, int task_index),
+                   void* arg) = 0;
+};
+
+// Returns the thread pool registered with the context, or nullptr if kernels
+// should run single threaded.
+inline MicroThreadPool* GetMicroThreadPool(TfLiteContext* context) {
+  if (context->GetExternalContext == nullptr) {
+    return nullptr;
+  }
+  return static_cast<MicroThreadPool*>(
+      context->GetExternalContext(context, kTfLiteCpuBackendContext));
+}
+
+// Returns the number of tasks an operator with |work_units| independent units
+// of roughly |unit_cost| multiply-accumulates each should be split into. The
+// result is at most |max_tasks|, and 1 when there is no pool or when the op is
+// too small to pay for waking up the workers.
+inline int GetNumTasks(const MicroThreadPool* pool, int max_tasks,
+                       int work_units, int64_t unit_cost) {
+  constexpr int64_t kMinTaskCost = 32 * 1024;
+  if (pool == nullptr || max_tasks <= 1 || work_units <= 1) {
+    return 1;
+  }
+  int64_t num_tasks = static_cast<int64_t>(work_units) * unit_cost /
+                      kMinTaskCost;
+  if (num_tasks > pool->num_threads()) num_tasks = pool->num_threads();
+  if (num_tasks > max_tasks) num_tasks = max_tasks;
+  if (num_tasks > work_units) num_tasks = work_units;
+  return num_tasks < 1 ? 1 : static_cast<int>(num_tasks);
+}
+
+// Splits |size| units of work into |num_tasks| contiguous ranges whose lengths
+// differ by at most one, and returns the range [*start, *end) of |task_index|.
+inline void GetTaskRange(int size, int num_tasks, int task_index, int* start,
+                         int* end) {
+  *start = static_cast<int>(static_cast<int64_t>(size) * task_index /
+                            num_tasks);
+  *end = static_cast<int>(static_cast<int64_t>(size) * (task_index + 1) /
+                          num_tasks);
+}
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_THREAD_POOL_H_
@@ -26,6 +26,26 @@ int32_t ticks_per_second();
 // Return time in ticks.  The meaning of a tick varies per platform.
 int32_t GetCurrentTimeTicks();
 
+// Return time as a 64 bit count that does not wrap around in practice. Its
+// ticks can be finer than those of GetCurrentTimeTicks().
+uint64_t GetCurrentTimeTicks64();
+
+// Return how many GetCurrentTimeTicks64() ticks there are per second.
+uint64_t ticks64_per_second();
+
+// Converts a number of GetCurrentTimeTicks64() ticks to nanoseconds, or
+// returns 0 if the platform has no timer.
+inline uint64_t TicksToNanos(uint64_t ticks) {
+  const uint64_t per_second = ::tflite::ticks64_per_second();
+  if (per_second == 0) {
+    return 0;
+  }
+  // Split into seconds and a remainder so that nanosecond ticks do not
+  // overflow.
+  return ticks / per_second * 1000000000ull +
+         ticks % per_second * 1000000000ull / per_second;
+}
+
 }  // namespace tflite
 
 #endif  // TENSORFLOW_LITE_MICRO_MICRO_TIME_H_
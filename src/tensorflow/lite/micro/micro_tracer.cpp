@@ -0,0 +1,183 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/micro_tracer.h"
+
+#include "tensorflow/lite/kernels/internal/compatibility.h"
+#include "tensorflow/lite/micro/memory_helpers.h"
+#include "tensorflow/lite/micro/micro_time.h"
+#include "tensorflow/lite/micro/output_buffer.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace tflite {
+namespace {
+
+using internal::OutputBuffer;
+
+const char* EventName(const MicroTracer::Event& event) {
+  if (event.registration == nullptr) {
+    return "Invoke";
+  }
+  if (event.registration->builtin_code == BuiltinOperator_CUSTOM) {
+    return event.registration->custom_name != nullptr
+               ? event.registration->custom_name
+               : "CUSTOM";
+  }
+  return EnumNameBuiltinOperator(
+      BuiltinOperator(event.registration->builtin_code));
+}
+
+// Appends the shapes of |tensor_indices| as a JSON array of arrays, with null
+// for optional tensors that are absent, and adds their sizes to |bytes|.
+void AppendShapes(const TfLiteIntArray* tensor_indices,
+                  const TfLiteEvalTensor* tensors, size_t* bytes,
+                  OutputBuffer* out) {
+  out->Append("[");
+  for (int i = 0; i < tensor_indices->size; ++i) {
+    if (i > 0) {
+      out->Append(",");
+    }
+    const int tensor_index = tensor_indices->data[i];
+    if (tensor_index < 0) {
+      out->Append("null");
+      continue;
+    }
+    const TfLiteEvalTensor& tensor = tensors[tensor_index];
+    out->Append("[");
+    for (int d = 0; d < tensor.dims->size; ++d) {
+      if (d > 0) {
+        out->Append(",");
+      }
+      out->AppendSigned(tensor.dims->data[d]);
+    }
+    out->Append("]");
+    size_t tensor_bytes = 0;
+    if (TfLiteEvalTensorByteLength(&tensor, &tensor_bytes) == kTfLiteOk) {
+      *bytes += tensor_bytes;
+    }
+  }
+  out->Append("]");
+}
+
+}  // namespace
+
+MicroTracer::MicroTracer(uint8_t* event_buffer, size_t event_buffer_size) {
+  uint8_t* aligned = AlignPointerUp(event_buffer, alignof(Event));
+  const size_t padding = aligned - event_buffer;
+  events_ = reinterpret_cast<Event*>(aligned);
+  capacity_ = event_buffer_size > padding
+                  ? static_cast<int>((event_buffer_size - padding) /
+                                     sizeof(Event))
+                  : 0;
+}
+
+void MicroTracer::EndOperatorEvent(uint64_t start_ns, int node_index,
+                                   const TfLiteRegistration* registration,
+                                   const TfLiteNode* node,
+                                   const TfLiteEvalTensor* tensors) {
+  TFLITE_DCHECK(registration != nullptr);
+  Record(registration, node, tensors, node_index, start_ns);
+}
+
+void MicroTracer::EndInvokeEvent(uint64_t start_ns) {
+  Record(nullptr, nullptr, nullptr, -1, start_ns);
+}
+
+void MicroTracer::Reset() {
+  next_ = 0;
+  num_events_ = 0;
+  overwritten_events_ = 0;
+}
+
+const MicroTracer::Event& MicroTracer::GetEvent(int index) const {
+  TFLITE_DCHECK(index >= 0 && index < num_events_);
+  int slot = next_ - num_events_ + index;
+  if (slot < 0) {
+    slot += capacity_;
+  }
+  return events_[slot];
+}
+
+size_t MicroTracer::ExportChromeTrace(char* buffer, size_t buffer_size) const {
+  // Events are stored in the order they ended, so an Invoke() comes after its
+  // operators and the oldest start is not necessarily that of event 0.
+  uint64_t origin_ns = 0;
+  for (int i = 0; i < num_events_; ++i) {
+    const uint64_t start_ns = GetEvent(i).start_ns;
+    if (i == 0 || start_ns < origin_ns) {
+      origin_ns = start_ns;
+    }
+  }
+
+  OutputBuffer out(buffer, buffer_size);
+  out.Append("{\"traceEvents\":[");
+  for (int i = 0; i < num_events_; ++i) {
+    const Event& event = GetEvent(i);
+    out.Append(i == 0 ? "\n" : ",\n");
+    out.Append("{\"name\":\"");
+    out.Append(EventName(event));
+    out.Append(event.registration == nullptr ? "\",\"cat\":\"invoke\""
+                                             : "\",\"cat\":\"op\"");
+    out.Append(",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":");
+    out.AppendMicros(event.start_ns - origin_ns);
+    out.Append(",\"dur\":");
+    out.AppendMicros(event.duration_ns);
+    out.Append(",\"args\":{");
+    if (event.registration != nullptr) {
+      size_t bytes = 0;
+      out.Append("\"node_index\":");
+      out.AppendSigned(event.node_index);
+      out.Append(",\"inputs\":");
+      AppendShapes(event.node->inputs, event.tensors, &bytes, &out);
+      out.Append(",\"outputs\":");
+      AppendShapes(event.node->outputs, event.tensors, &bytes, &out);
+      out.Append(",\"bytes\":");
+      out.AppendUnsigned(bytes);
+    }
+    out.Append("}}");
+  }
+  out.Append("\n],\"displayTimeUnit\":\"ns\"}\n");
+  return out.Finish();
+}
+
+uint64_t MicroTracer::GetTimeNanos() {
+  return TicksToNanos(GetCurrentTimeTicks64());
+}
+
+void MicroTracer::Record(const TfLiteRegistration* registration,
+                         const TfLiteNode* node,
+                         const TfLiteEvalTensor* tensors, int node_index,
+                         uint64_t start_ns) {
+  const uint64_t end_ns = GetTimeNanos();
+  if (capacity_ == 0) {
+    ++overwritten_events_;
+    return;
+  }
+  Event& event = events_[next_];
+  event.registration = registration;
+  event.node = node;
+  event.tensors = tensors;
+  event.node_index = node_index;
+  event.start_ns = start_ns;
+  event.duration_ns = end_ns - start_ns;
+  next_ = next_ + 1 == capacity_ ? 0 : next_ + 1;
+  if (num_events_ < capacity_) {
+    ++num_events_;
+  } else {
+    ++overwritten_events_;
+  }
+}
+
+}  // namespace tflite
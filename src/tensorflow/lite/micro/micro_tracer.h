@@ -0,0 +1,142 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_TRACER_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_TRACER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/compatibility.h"
+
+namespace tflite {
+
+// MicroTracer records a timeline of every operator that MicroInterpreter runs,
+// and of every Invoke() as a whole, into a ring buffer in caller provided
+// memory. Unlike the Profiler hooks in Invoke(), which are compiled out of
+// release builds, tracing is available in every build and costs two clock
+// reads and one ring buffer store per operator when a tracer is attached, and
+// a single pointer check when none is.
+//
+// Once the ring buffer is full the oldest events are overwritten, so the
+// buffer always holds the most recent ones. ExportChromeTrace() turns them into
+// Chrome trace-event JSON that chrome://tracing and Perfetto can load, with the
+// operator name, node index, input and output shapes and the number of tensor
+// bytes each operator reads and writes. Shapes and sizes are looked up when
+// exporting, so the interpreter has to outlive the export.
+//
+// Usage example:
+// alignas(8) uint8_t trace_buffer[256 * sizeof(MicroTracer::Event)];
+// MicroTracer tracer(trace_buffer, sizeof(trace_buffer));
+// interpreter.SetTracer(&tracer);
+// while (true) {
+//   interpreter.Invoke();
+//   if (latency_was_unusual) {
+//     tracer.ExportChromeTrace(json, json_size);
+//   }
+// }
+//
+// A tracer records the events of one interpreter on one thread at a time.
+class MicroTracer {
+ public:
+  // Storage for one event. Exposed only so that callers can size the buffer.
+  struct Event {
+    // Null for an event that covers a whole Invoke().
+    const TfLiteRegistration* registration;
+    const TfLiteNode* node;
+    const TfLiteEvalTensor* tensors;
+    int32_t node_index;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+  };
+
+  // The buffer must outlive the tracer.
+  MicroTracer(uint8_t* event_buffer, size_t event_buffer_size);
+  virtual ~MicroTracer() = default;
+
+  // Returns the start time to pass to the End*Event() methods.
+  uint64_t BeginEvent() { return GetTimeNanos(); }
+
+  // Records the operator |node_index| of the interpreter, which reads and
+  // writes |tensors|, as having run since |start_ns|.
+  void EndOperatorEvent(uint64_t start_ns, int node_index,
+                        const TfLiteRegistration* registration,
+                        const TfLiteNode* node,
+                        const TfLiteEvalTensor* tensors);
+
+  // Records an Invoke() that started at |start_ns|.
+  void EndInvokeEvent(uint64_t start_ns);
+
+  // Discards all events, keeping the buffer.
+  void Reset();
+
+  // Number of events held, at most capacity().
+  int num_events() const { return num_events_; }
+  int capacity() const { return capacity_; }
+
+  // Number of events that were overwritten because the buffer was full.
+  uint32_t overwritten_events() const { return overwritten_events_; }
+
+  // Returns event |index|, counting from the oldest one held.
+  const Event& GetEvent(int index) const;
+
+  // Writes the events as complete ("X") events in the Chrome trace-event JSON
+  // format, with timestamps relative to the oldest event. Like snprintf, the
+  // output is truncated to fit buffer_size including the terminating NUL, and
+  // the return value is the length of the complete output, so a call with a
+  // null buffer returns the size that is needed.
+  size_t ExportChromeTrace(char* buffer, size_t buffer_size) const;
+
+ protected:
+  // Monotonic time in nanoseconds. Virtual so that tests can inject a clock.
+  virtual uint64_t GetTimeNanos();
+
+ private:
+  void Record(const TfLiteRegistration* registration, const TfLiteNode* node,
+              const TfLiteEvalTensor* tensors, int node_index,
+              uint64_t start_ns);
+
+  Event* events_;
+  int capacity_;
+  // Index of the slot the next event is written to.
+  int next_ = 0;
+  int num_events_ = 0;
+  uint32_t overwritten_events_ = 0;
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+// Records an Invoke() into |tracer|, if it is not null, when it goes out of
+// scope, so that the event also covers invokes that fail or are aborted.
+class ScopedInvokeTrace {
+ public:
+  explicit ScopedInvokeTrace(MicroTracer* tracer)
+      : tracer_(tracer),
+        start_ns_(tracer != nullptr ? tracer->BeginEvent() : 0) {}
+
+  ~ScopedInvokeTrace() {
+    if (tracer_ != nullptr) {
+      tracer_->EndInvokeEvent(start_ns_);
+    }
+  }
+
+ private:
+  MicroTracer* tracer_;
+  uint64_t start_ns_;
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_TRACER_H_
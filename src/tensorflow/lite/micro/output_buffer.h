@@ -0,0 +1,98 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_OUTPUT_BUFFER_H_
+#define TENSORFLOW_LITE_MICRO_OUTPUT_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tflite {
+namespace internal {
+
+// Appends text to a fixed size buffer, keeping track of the length the output
+// would have had without truncation. Used by the profiling exporters, which
+// follow the snprintf convention of returning the untruncated length.
+class OutputBuffer {
+ public:
+  OutputBuffer(char* buffer, size_t buffer_size)
+      : buffer_(buffer), buffer_size_(buffer_size) {}
+
+  void Append(const char* text) {
+    for (; *text != '\0'; ++text) {
+      AppendChar(*text);
+    }
+  }
+
+  void AppendUnsigned(uint64_t value) {
+    char digits[20];
+    int num_digits = 0;
+    do {
+      digits[num_digits++] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value != 0);
+    while (num_digits > 0) {
+      AppendChar(digits[--num_digits]);
+    }
+  }
+
+  void AppendSigned(int64_t value) {
+    if (value < 0) {
+      AppendChar('-');
+      AppendUnsigned(static_cast<uint64_t>(-(value + 1)) + 1);
+    } else {
+      AppendUnsigned(static_cast<uint64_t>(value));
+    }
+  }
+
+  // Appends a nanosecond value as microseconds with three decimals.
+  void AppendMicros(uint64_t ns) { AppendThousandths(ns); }
+
+  // Appends value / 1000 with three decimals.
+  void AppendThousandths(uint64_t value) {
+    AppendUnsigned(value / 1000);
+    AppendChar('.');
+    const int fraction = static_cast<int>(value % 1000);
+    AppendChar(static_cast<char>('0' + fraction / 100));
+    AppendChar(static_cast<char>('0' + fraction / 10 % 10));
+    AppendChar(static_cast<char>('0' + fraction % 10));
+  }
+
+  // Terminates the output and returns its untruncated length.
+  size_t Finish() {
+    if (buffer_size_ > 0) {
+      buffer_[length_ < buffer_size_ ? length_ : buffer_size_ - 1] = '\0';
+    }
+    return length_;
+  }
+
+ private:
+  void AppendChar(char c) {
+    // length_ + 1 < buffer_size_, phrased so that GCC sees it cannot wrap.
+    if (length_ < buffer_size_ && buffer_size_ - length_ > 1) {
+      buffer_[length_] = c;
+    }
+    ++length_;
+  }
+
+  char* buffer_;
+  size_t buffer_size_;
+  size_t length_ = 0;
+};
+
+}  // namespace internal
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_OUTPUT_BUFFER_H_
@@ -34,4 +34,8 @@ int32_t GetCurrentTimeTicks() {
   return static_cast<int32_t>(time_us_32());
 }
 
+uint64_t ticks64_per_second() { return kClocksPerSecond; }
+
+uint64_t GetCurrentTimeTicks64() { return time_us_64(); }
+
 }  // namespace tflite
@@ -341,6 +341,237 @@ const Model* BuildModelWithOfflinePlanning(int number_of_tensors,
       node_conn[0].input, node_conn[num_conns - 1].output, num_subgraph_inputs);
 }
 
+const Model* BuildSimpleInPlaceModel() {
+  using flatbuffers::Offset;
+  flatbuffers::FlatBufferBuilder* fb_builder = BuilderInstance();
+
+  ModelBuilder model_builder(fb_builder);
+
+  const int op_id =
+      model_builder.RegisterOp(BuiltinOperator_HARD_SWISH, nullptr);
+  const int t0 =
+      model_builder.AddTensor(TensorType_FLOAT32, {1, kSimpleInPlaceModelSize});
+  const int t1 =
+      model_builder.AddTensor(TensorType_FLOAT32, {1, kSimpleInPlaceModelSize});
+  const int t2 =
+      model_builder.AddTensor(TensorType_FLOAT32, {1, kSimpleInPlaceModelSize});
+  model_builder.AddNode(op_id, {t0}, {t1});
+  model_builder.AddNode(op_id, {t1}, {t2});
+  return model_builder.BuildModel({t0}, {t2});
+}
+
+const Model* BuildInPlaceReshapeModel() {
+  using flatbuffers::Offset;
+  flatbuffers::FlatBufferBuilder* fb_builder = BuilderInstance();
+
+  ModelBuilder model_builder(fb_builder);
+
+  const int relu_id = model_builder.RegisterOp(BuiltinOperator_RELU, nullptr);
+  const int reshape_id =
+      model_builder.RegisterOp(BuiltinOperator_RESHAPE, nullptr);
+  const int logistic_id =
+      model_builder.RegisterOp(BuiltinOperator_LOGISTIC, nullptr);
+  const int t0 =
+      model_builder.AddTensor(TensorType_FLOAT32, {1, kSimpleInPlaceModelSize});
+  const int t1 =
+      model_builder.AddTensor(TensorType_FLOAT32, {1, kSimpleInPlaceModelSize});
+  const int t2 = model_builder.AddTensor(TensorType_FLOAT32,
+                                         {32, kSimpleInPlaceModelSize / 32});
+  const int t3 = model_builder.AddTensor(TensorType_FLOAT32,
+                                         {32, kSimpleInPlaceModelSize / 32});
+  model_builder.AddNode(relu_id, {t0}, {t1});
+  model_builder.AddNode(reshape_id, {t1}, {t2});
+  model_builder.AddNode(logistic_id, {t2}, {t3});
+  return model_builder.BuildModel({t0}, {t3});
+}
+
+const Model* BuildBatchSharedReshapeModel() {
+  using flatbuffers::Offset;
+  flatbuffers::FlatBufferBuilder* fb_builder = BuilderInstance();
+
+  ModelBuilder model_builder(fb_builder);
+
+  const int reshape_id =
+      model_builder.RegisterOp(BuiltinOperator_RESHAPE, nullptr);
+  const int add_id = model_builder.RegisterOp(BuiltinOperator_ADD, nullptr);
+  const int t0 = model_builder.AddTensor(TensorType_FLOAT32, {2, 4});
+  const int t1 = model_builder.AddTensor(TensorType_FLOAT32, {1, 8});
+  const int t2 = model_builder.AddTensor(TensorType_FLOAT32, {1, 8});
+  const int t3 = model_builder.AddTensor(TensorType_FLOAT32, {1, 8});
+  model_builder.AddNode(reshape_id, {t0}, {t1});
+  model_builder.AddNode(add_id, {t1, t2}, {t3});
+  return model_builder.BuildModel({t0, t2}, {t3});
+}
+
+const Model* BuildCircularBufferModel() {
+  using flatbuffers::Offset;
+  flatbuffers::FlatBufferBuilder* fb_builder = BuilderInstance();
+
+  ModelBuilder model_builder(fb_builder);
+
+  const int circular_buffer_id =
+      model_builder.RegisterOp(BuiltinOperator_CUSTOM, "CIRCULAR_BUFFER");
+  const int reshape_id =
+      model_builder.RegisterOp(BuiltinOperator_RESHAPE, nullptr);
+  const int t0 = model_builder.AddTensor(
+      TensorType_INT8, {1, 1, 1, kCircularBufferModelDepth});
+  const int t1 = model_builder.AddTensor(
+      TensorType_INT8,
+      {1, kCircularBufferModelSlots, 1, kCircularBufferModelDepth});
+  const int t2 = model_builder.AddTensor(
+      TensorType_INT8,
+      {1, kCircularBufferModelSlots * kCircularBufferModelDepth});
+  model_builder.AddNode(circular_buffer_id, {t0}, {t1});
+  model_builder.AddNode(reshape_id, {t1}, {t2});
+  return model_builder.BuildModel({t0}, {t1, t2});
+}
+
+const Model* BuildFoldableActivationsModel() {
+  using flatbuffers::Offset;
+  flatbuffers::FlatBufferBuilder* builder = BuilderInstance();
+
+  constexpr int kWidth = 4;
+  constexpr int kDepth = 8;
+  constexpr int kFilterWidth = 3;
+  constexpr int kOutputs = 6;
+  int8_t dw_filter[kFilterWidth * kDepth];
+  for (int i = 0; i < kFilterWidth * kDepth; ++i) {
+    dw_filter[i] = static_cast<int8_t>(i * 29 % 41 - 20);
+  }
+  int32_t dw_bias[kDepth];
+  for (int i = 0; i < kDepth; ++i) {
+    dw_bias[i] = (i * 13 % 9 - 4) * 400;
+  }
+  int8_t fc_weights[kOutputs * kWidth * kDepth];
+  for (int i = 0; i < kOutputs * kWidth * kDepth; ++i) {
+    fc_weights[i] = static_cast<int8_t>(i * 53 % 61 - 30);
+  }
+  int32_t fc_bias[kOutputs];
+  for (int i = 0; i < kOutputs; ++i) {
+    fc_bias[i] = (i % 3 - 1) * 200;
+  }
+  constexpr size_t buffers_size = 5;
+  const Offset<Buffer> buffers[buffers_size] = {
+      CreateBuffer(*builder),
+      CreateBuffer(*builder,
+                   builder->CreateVector(
+                       reinterpret_cast<const uint8_t*>(dw_filter),
+                       sizeof(dw_filter))),
+      CreateBuffer(*builder,
+                   builder->CreateVector(
+                       reinterpret_cast<const uint8_t*>(dw_bias),
+                       sizeof(dw_bias))),
+      CreateBuffer(*builder,
+                   builder->CreateVector(
+                       reinterpret_cast<const uint8_t*>(fc_weights),
+                       sizeof(fc_weights))),
+      CreateBuffer(*builder,
+                   builder->CreateVector(
+                       reinterpret_cast<const uint8_t*>(fc_bias),
+                       sizeof(fc_bias))),
+  };
+
+  auto quantization = [builder](float scale, int64_t zero_point) {
+    return CreateQuantizationParameters(
+        *builder, 0, 0, builder->CreateVector(&scale, 1),
+        builder->CreateVector(&zero_point, 1));
+  };
+  float dw_filter_scales[kDepth];
+  int64_t dw_filter_zero_points[kDepth];
+  for (int i = 0; i < kDepth; ++i) {
+    dw_filter_scales[i] = 0.05f;
+    dw_filter_zero_points[i] = 0;
+  }
+  const Offset<QuantizationParameters> dw_filter_quantization =
+      CreateQuantizationParameters(
+          *builder, 0, 0, builder->CreateVector(dw_filter_scales, kDepth),
+          builder->CreateVector(dw_filter_zero_points, kDepth),
+          QuantizationDetails_NONE, 0, /*quantized_dimension=*/3);
+
+  const int32_t activation_shape[4] = {1, 1, kWidth, kDepth};
+  const int32_t dw_filter_shape[4] = {1, 1, kFilterWidth, kDepth};
+  const int32_t dw_bias_shape[1] = {kDepth};
+  const int32_t fc_weights_shape[2] = {kOutputs, kWidth * kDepth};
+  const int32_t fc_bias_shape[1] = {kOutputs};
+  const int32_t output_shape[2] = {1, kOutputs};
+  constexpr size_t tensors_size = 9;
+  const Offset<Tensor> tensors[tensors_size] = {
+      CreateTensor(*builder, builder->CreateVector(activation_shape, 4),
+                   TensorType_INT8, 0, 0, quantization(0.05f, -10)),
+      CreateTensor(*builder, builder->CreateVector(dw_filter_shape, 4),
+                   TensorType_INT8, 1, 0, dw_filter_quantization),
+      CreateTensor(*builder, builder->CreateVector(dw_bias_shape, 1),
+                   TensorType_INT32, 2, 0, quantization(0.05f * 0.05f, 0)),
+      CreateTensor(*builder, builder->CreateVector(activation_shape, 4),
+                   TensorType_INT8, 0, 0, quantization(0.25f, 5)),
+      CreateTensor(*builder, builder->CreateVector(activation_shape, 4),
+                   TensorType_INT8, 0, 0, quantization(0.25f, 5)),
+      CreateTensor(*builder, builder->CreateVector(fc_weights_shape, 2),
+                   TensorType_INT8, 3, 0, quantization(0.02f, 0)),
+      CreateTensor(*builder, builder->CreateVector(fc_bias_shape, 1),
+                   TensorType_INT32, 4, 0, quantization(0.25f * 0.02f, 0)),
+      CreateTensor(*builder, builder->CreateVector(output_shape, 2),
+                   TensorType_INT8, 0, 0, quantization(0.1f, -3)),
+      CreateTensor(*builder, builder->CreateVector(output_shape, 2),
+                   TensorType_INT8, 0, 0, quantization(0.1f, -3)),
+  };
+
+  const int32_t dw_inputs[3] = {0, 1, 2};
+  const int32_t dw_outputs[1] = {3};
+  const int32_t relu6_inputs[1] = {3};
+  const int32_t relu6_outputs[1] = {4};
+  const int32_t fc_inputs[3] = {4, 5, 6};
+  const int32_t fc_outputs[1] = {7};
+  const int32_t relu_inputs[1] = {7};
+  const int32_t relu_outputs[1] = {8};
+  constexpr size_t operators_size = 4;
+  const Offset<Operator> operators[operators_size] = {
+      CreateOperator(*builder, 0, builder->CreateVector(dw_inputs, 3),
+                     builder->CreateVector(dw_outputs, 1),
+                     BuiltinOptions_DepthwiseConv2DOptions,
+                     CreateDepthwiseConv2DOptions(*builder, Padding_SAME, 1, 1,
+                                                  /*depth_multiplier=*/1)
+                         .Union()),
+      CreateOperator(*builder, 1, builder->CreateVector(relu6_inputs, 1),
+                     builder->CreateVector(relu6_outputs, 1)),
+      CreateOperator(*builder, 2, builder->CreateVector(fc_inputs, 3),
+                     builder->CreateVector(fc_outputs, 1),
+                     BuiltinOptions_FullyConnectedOptions,
+                     CreateFullyConnectedOptions(*builder).Union()),
+      CreateOperator(*builder, 3, builder->CreateVector(relu_inputs, 1),
+                     builder->CreateVector(relu_outputs, 1)),
+  };
+  const int32_t inputs[1] = {0};
+  const int32_t outputs[1] = {8};
+  constexpr size_t subgraphs_size = 1;
+  const Offset<SubGraph> subgraphs[subgraphs_size] = {
+      CreateSubGraph(*builder, builder->CreateVector(tensors, tensors_size),
+                     builder->CreateVector(inputs, 1),
+                     builder->CreateVector(outputs, 1),
+                     builder->CreateVector(operators, operators_size),
+                     builder->CreateString("test_subgraph"))};
+  constexpr size_t operator_codes_size = 4;
+  const Offset<OperatorCode> operator_codes[operator_codes_size] = {
+      CreateOperatorCode(*builder, /*deprecated_builtin_code=*/0, 0,
+                         /*version=*/0, BuiltinOperator_DEPTHWISE_CONV_2D),
+      CreateOperatorCode(*builder, /*deprecated_builtin_code=*/0, 0,
+                         /*version=*/0, BuiltinOperator_RELU6),
+      CreateOperatorCode(*builder, /*deprecated_builtin_code=*/0, 0,
+                         /*version=*/0, BuiltinOperator_FULLY_CONNECTED),
+      CreateOperatorCode(*builder, /*deprecated_builtin_code=*/0, 0,
+                         /*version=*/0, BuiltinOperator_RELU),
+  };
+  const Offset<Model> model_offset = CreateModel(
+      *builder, 0, builder->CreateVector(operator_codes, operator_codes_size),
+      builder->CreateVector(subgraphs, subgraphs_size),
+      builder->CreateString("test_model"),
+      builder->CreateVector(buffers, buffers_size));
+  FinishModelBuffer(*builder, model_offset);
+  void* model_pointer = builder->GetBufferPointer();
+  const Model* model = flatbuffers::GetRoot<Model>(model_pointer);
+  return model;
+}
+
 const Model* BuildSimpleMockModel() {
   using flatbuffers::Offset;
   flatbuffers::FlatBufferBuilder* builder = BuilderInstance();
@@ -885,6 +1116,46 @@ const Model* GetSimpleStatefulModel() {
   return model;
 }
 
+const Model* GetSimpleInPlaceModel() {
+  static Model* model = nullptr;
+  if (!model) {
+    model = const_cast<Model*>(BuildSimpleInPlaceModel());
+  }
+  return model;
+}
+
+const Model* GetInPlaceReshapeModel() {
+  static Model* model = nullptr;
+  if (!model) {
+    model = const_cast<Model*>(BuildInPlaceReshapeModel());
+  }
+  return model;
+}
+
+const Model* GetBatchSharedReshapeModel() {
+  static Model* model = nullptr;
+  if (!model) {
+    model = const_cast<Model*>(BuildBatchSharedReshapeModel());
+  }
+  return model;
+}
+
+const Model* GetCircularBufferModel() {
+  static Model* model = nullptr;
+  if (!model) {
+    model = const_cast<Model*>(BuildCircularBufferModel());
+  }
+  return model;
+}
+
+const Model* GetFoldableActivationsModel() {
+  static Model* model = nullptr;
+  if (!model) {
+    model = const_cast<Model*>(BuildFoldableActivationsModel());
+  }
+  return model;
+}
+
 const Tensor* Create1dFlatbufferTensor(int size, bool is_variable) {
   using flatbuffers::Offset;
   flatbuffers::FlatBufferBuilder* builder = BuilderInstance();
@@ -971,6 +1242,11 @@ int TestStrcmp(const char* a, const char* b) {
          *reinterpret_cast<const unsigned char*>(b);
 }
 
+uint32_t NextRandom(uint32_t* seed) {
+  *seed = *seed * 1664525u + 1013904223u;
+  return *seed;
+}
+
 // Wrapper to forward kernel errors to the interpreter's error reporter.
 void ReportOpError(struct TfLiteContext* context, const char* format, ...) {
 #ifndef TF_LITE_STRIP_ERROR_STRINGS
@@ -129,6 +129,37 @@ const Model* GetModelWithOfflinePlanning(int num_tensors,
 // Returns a flatbuffer model with `simple_stateful_op`
 const Model* GetSimpleStatefulModel();
 
+// Returns a flatbuffer model with two chained HARD_SWISH operators on float
+// tensors of shape {1, kSimpleInPlaceModelSize}, which can both run in place.
+constexpr int kSimpleInPlaceModelSize = 1024;
+const Model* GetSimpleInPlaceModel();
+
+// Returns a flatbuffer model with two float inputs: a table of shape {2, 4}
+// that is RESHAPEd to {1, 8}, and features of shape {1, 8} that are ADDed to
+// the reshaped table to give the output of shape {1, 8}.
+const Model* GetBatchSharedReshapeModel();
+
+// Returns a flatbuffer model with RELU on a float tensor of shape
+// {1, kSimpleInPlaceModelSize}, a RESHAPE to {32, kSimpleInPlaceModelSize / 32}
+// and LOGISTIC on the result, which can all run in place.
+const Model* GetInPlaceReshapeModel();
+
+// Returns a flatbuffer model with a CIRCULAR_BUFFER from an int8 tensor of
+// shape {1, 1, 1, kCircularBufferModelDepth} to one of shape
+// {1, kCircularBufferModelSlots, 1, kCircularBufferModelDepth}, followed by a
+// RESHAPE of that history to {1, slots * depth}. The history is model output 0
+// and the reshaped copy output 1.
+constexpr int kCircularBufferModelSlots = 5;
+constexpr int kCircularBufferModelDepth = 8;
+const Model* GetCircularBufferModel();
+
+// Returns a flatbuffer model with an int8 DEPTHWISE_CONV_2D (1x3 filter, SAME
+// padding) from an input of shape {1, 1, 4, 8}, a RELU6 on its output, a
+// FULLY_CONNECTED to {1, 6} and a RELU on that. Neither producer has a fused
+// activation of its own, and the activations have nonzero zero points so that
+// both RELUs clamp.
+const Model* GetFoldableActivationsModel();
+
 // Builds a one-dimensional flatbuffer tensor of the given size.
 const Tensor* Create1dFlatbufferTensor(int size, bool is_variable = false);
 
@@ -146,6 +177,11 @@ CreateFlatbufferBuffers();
 // Performs a simple string comparison without requiring standard C library.
 int TestStrcmp(const char* a, const char* b);
 
+// Advances |seed| with a linear congruential generator and returns its new
+// value, for deterministic pseudo random test data. The high bits are the most
+// random ones.
+uint32_t NextRandom(uint32_t* seed);
+
 // Wrapper to forward kernel errors to the interpreter's error reporter.
 void ReportOpError(struct TfLiteContext* context, const char* format, ...);
 
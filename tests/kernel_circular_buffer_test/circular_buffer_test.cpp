@@ -30,6 +30,11 @@ constexpr int kRunPeriod = 2;
 // TODO(b/149795762): Add this to TfLiteStatus enum.
 constexpr int kTfLiteAbort = -9;
 
+// Custom options flexbuffer map of {"cycles_max": 1}.
+const uint8_t kCyclesMaxOneOptions[] = {99, 121, 99, 108, 101, 115, 95,
+                                        109, 97,  120, 0,   1,   12,  1,
+                                        1,   1,   1,   4,   2,   36,  1};
+
 }  // namespace
 }  // namespace testing
 }  // namespace tflite
@@ -172,4 +177,66 @@ TF_LITE_MICRO_TEST(OutputTensorLength5) {
   }
 }
 
+TF_LITE_MICRO_TEST(OutputTensorLength4WithCyclesMaxOption) {
+  constexpr int depth = 3;
+  constexpr int num_slots = 4;
+  int8_t input_data[depth];
+  int8_t output_data[depth * num_slots];
+
+  memset(output_data, 0, sizeof(output_data));
+  const int input_dims[] = {4, 1, 1, 1, depth};
+  const int output_dims[] = {4, 1, num_slots, 1, depth};
+  TfLiteIntArray* input_tensor_dims =
+      tflite::testing::IntArrayFromInts(input_dims);
+  TfLiteIntArray* output_tensor_dims =
+      tflite::testing::IntArrayFromInts(output_dims);
+
+  const int output_dims_count = tflite::ElementCount(*output_tensor_dims);
+
+  constexpr int tensors_size = 2;
+  TfLiteTensor tensors[tensors_size] = {
+      tflite::testing::CreateQuantizedTensor(input_data, input_tensor_dims, 1,
+                                             0),
+      tflite::testing::CreateQuantizedTensor(output_data, output_tensor_dims, 1,
+                                             0),
+  };
+
+  const int inputs_array_data[] = {1, 0};
+  TfLiteIntArray* inputs_array =
+      tflite::testing::IntArrayFromInts(inputs_array_data);
+  const int outputs_array_data[] = {1, 1};
+  TfLiteIntArray* outputs_array =
+      tflite::testing::IntArrayFromInts(outputs_array_data);
+
+  const TfLiteRegistration* registration =
+      tflite::ops::micro::Register_CIRCULAR_BUFFER();
+  tflite::micro::KernelRunner runner = tflite::micro::KernelRunner(
+      *registration, tensors, tensors_size, inputs_array, outputs_array,
+      /*builtin_data=*/nullptr, micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk,
+      runner.InitAndPrepare(
+          reinterpret_cast<const char*>(tflite::testing::kCyclesMaxOneOptions),
+          sizeof(tflite::testing::kCyclesMaxOneOptions)));
+
+  const int8_t goldens[5][12] = {{0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3},
+                                 {0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6},
+                                 {0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
+                                 {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12},
+                                 {4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}};
+
+  // The period from the custom options overrides the one the shape based
+  // heuristic picks for 4xN outputs, so the circular buffer runs every cycle.
+  for (int i = 0; i < 5; i++) {
+    for (int j = 0; j < depth; j++) {
+      input_data[j] = i * depth + j + 1;
+    }
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.Invoke());
+
+    for (int j = 0; j < output_dims_count; ++j) {
+      TF_LITE_MICRO_EXPECT_EQ(goldens[i][j], output_data[j]);
+    }
+  }
+}
+
 TF_LITE_MICRO_TESTS_END
@@ -15,7 +15,12 @@ limitations under the License.
 
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/conv.h"
 #include "tensorflow/lite/micro/kernels/kernel_runner.h"
+#include "tensorflow/lite/micro/linux/pthread_thread_pool.h"
 #include "tensorflow/lite/micro/micro_utils.h"
 #include "tensorflow/lite/micro/test_helpers.h"
 #include "tensorflow/lite/micro/testing/micro_test.h"
@@ -55,16 +60,19 @@ static TfLiteConvParams common_conv_params = {
 
 template <typename T>
 TfLiteStatus InvokeConv(TfLiteTensor* tensors, int tensors_size, T* output_data,
-                        int output_length, TfLiteConvParams* conv_params) {
+                        int output_length, TfLiteConvParams* conv_params,
+                        MicroThreadPool* thread_pool = nullptr,
+                        const TfLiteRegistration& registration =
+                            Register_CONV_2D()) {
   int inputs_array_data[] = {3, 0, 1, 2};
   TfLiteIntArray* inputs_array = IntArrayFromInts(inputs_array_data);
   int outputs_array_data[] = {1, 3};
   TfLiteIntArray* outputs_array = IntArrayFromInts(outputs_array_data);
 
-  const TfLiteRegistration registration = Register_CONV_2D();
   micro::KernelRunner runner(
       registration, tensors, tensors_size, inputs_array, outputs_array,
       reinterpret_cast<void*>(conv_params), micro_test::reporter);
+  runner.SetThreadPool(thread_pool);
 
   const char* init_data = reinterpret_cast<const char*>(conv_params);
   TfLiteStatus status = runner.InitAndPrepare(init_data);
@@ -227,6 +235,133 @@ void TestConvQuantizedPerChannel(
                           output_data, output_dims_count, conv_params,
                           1.0 /* tolerance */));
 }
+
+// Runs the int8 kernel on deterministic pseudo-random data and checks that the
+// result is bit-exact with reference_integer_ops::ConvPerChannel. With
+// |pack_weights|, the filter and bias are marked constant and the packed
+// kernel variant is used.
+void TestConvQuantizedPerChannelMatchesReference(
+    const int* input_dims_data, const int* filter_dims_data,
+    const int* output_dims_data, TfLiteConvParams* conv_params,
+    MicroThreadPool* thread_pool = nullptr, bool pack_weights = false) {
+  constexpr int kMaxElements = 4096;
+  constexpr int kMaxChannels = 32;
+  TfLiteIntArray* input_dims = IntArrayFromInts(input_dims_data);
+  TfLiteIntArray* filter_dims = IntArrayFromInts(filter_dims_data);
+  TfLiteIntArray* output_dims = IntArrayFromInts(output_dims_data);
+  const int input_size = ElementCount(*input_dims);
+  const int filter_size = ElementCount(*filter_dims);
+  const int output_size = ElementCount(*output_dims);
+  const int output_depth = filter_dims->data[0];
+  TF_LITE_MICRO_EXPECT_LE(input_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(filter_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(output_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(output_depth, kMaxChannels);
+
+  const float input_scale = 0.05f;
+  const int input_zero_point = -3;
+  const float output_scale = 0.4f;
+  const int output_zero_point = 5;
+
+  static int8_t input_data[kMaxElements];
+  static int8_t filter_data[kMaxElements];
+  static int8_t output_data[kMaxElements];
+  static int8_t expected_data[kMaxElements];
+  int32_t bias_data[kMaxChannels];
+  for (int i = 0; i < input_size; ++i) {
+    input_data[i] = static_cast<int8_t>((i * 37 + 11) % 256 - 128);
+  }
+  for (int i = 0; i < filter_size; ++i) {
+    filter_data[i] = static_cast<int8_t>((i * 53 + 7) % 255 - 127);
+  }
+  for (int i = 0; i < output_depth; ++i) {
+    bias_data[i] = (i * 977) % 4001 - 2000;
+  }
+
+  float filter_scales[kMaxChannels + 1] = {static_cast<float>(output_depth)};
+  int filter_zero_points[kMaxChannels + 1] = {output_depth};
+  for (int i = 0; i < output_depth; ++i) {
+    filter_scales[i + 1] = 0.002f + 0.0005f * i;
+    filter_zero_points[i + 1] = 0;
+  }
+  TfLiteAffineQuantization filter_quant = {
+      FloatArrayFromFloats(filter_scales), IntArrayFromInts(filter_zero_points),
+      0};
+
+  float input_scales[] = {1, input_scale};
+  int input_zero_points[] = {1, input_zero_point};
+  TfLiteAffineQuantization input_quant = {FloatArrayFromFloats(input_scales),
+                                          IntArrayFromInts(input_zero_points),
+                                          0};
+  float output_scales[] = {1, output_scale};
+  int output_zero_points[] = {1, output_zero_point};
+  TfLiteAffineQuantization output_quant = {FloatArrayFromFloats(output_scales),
+                                           IntArrayFromInts(output_zero_points),
+                                           0};
+
+  int bias_dims_data[] = {1, output_depth};
+  TfLiteTensor tensors[] = {
+      CreateQuantizedTensor(input_data, input_dims, input_scale,
+                            input_zero_point),
+      CreateQuantizedTensor(filter_data, filter_dims, 1.0f, 0),
+      CreateTensor(bias_data, IntArrayFromInts(bias_dims_data)),
+      CreateQuantizedTensor(output_data, output_dims, output_scale,
+                            output_zero_point),
+  };
+  tensors[0].quantization = {kTfLiteAffineQuantization, &input_quant};
+  tensors[1].quantization = {kTfLiteAffineQuantization, &filter_quant};
+  tensors[3].quantization = {kTfLiteAffineQuantization, &output_quant};
+  if (pack_weights) {
+    tensors[1].allocation_type = kTfLiteMmapRo;
+    tensors[2].allocation_type = kTfLiteMmapRo;
+  }
+
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk,
+      InvokeConv(tensors, 4, output_data, output_size, conv_params,
+                 thread_pool,
+                 pack_weights ? Register_CONV_2D_PACKED() : Register_CONV_2D()));
+
+  int32_t multipliers[kMaxChannels];
+  int32_t shifts[kMaxChannels];
+  for (int i = 0; i < output_depth; ++i) {
+    int shift;
+    QuantizeMultiplier(static_cast<double>(input_scale) *
+                           static_cast<double>(filter_scales[i + 1]) /
+                           static_cast<double>(output_scale),
+                       &multipliers[i], &shift);
+    shifts[i] = shift;
+  }
+  int out_height, out_width;
+  TfLitePaddingValues padding = ComputePaddingHeightWidth(
+      conv_params->stride_height, conv_params->stride_width,
+      conv_params->dilation_height_factor, conv_params->dilation_width_factor,
+      input_dims->data[1], input_dims->data[2], filter_dims->data[1],
+      filter_dims->data[2], conv_params->padding, &out_height, &out_width);
+  TF_LITE_MICRO_EXPECT_EQ(output_dims->data[1], out_height);
+  TF_LITE_MICRO_EXPECT_EQ(output_dims->data[2], out_width);
+
+  ConvParams op_params;
+  op_params.input_offset = -input_zero_point;
+  op_params.output_offset = output_zero_point;
+  op_params.stride_height = conv_params->stride_height;
+  op_params.stride_width = conv_params->stride_width;
+  op_params.dilation_height_factor = conv_params->dilation_height_factor;
+  op_params.dilation_width_factor = conv_params->dilation_width_factor;
+  op_params.padding_values.height = padding.height;
+  op_params.padding_values.width = padding.width;
+  op_params.quantized_activation_min = std::numeric_limits<int8_t>::min();
+  op_params.quantized_activation_max = std::numeric_limits<int8_t>::max();
+  reference_integer_ops::ConvPerChannel(
+      op_params, multipliers, shifts, RuntimeShape(4, &input_dims->data[0]),
+      input_data, RuntimeShape(4, &filter_dims->data[0]), filter_data,
+      RuntimeShape(1, &output_depth), bias_data,
+      RuntimeShape(4, &output_dims->data[0]), expected_data);
+
+  for (int i = 0; i < output_size; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(expected_data[i], output_data[i]);
+  }
+}
 #endif  // !defined(XTENSA)
 
 }  // namespace
@@ -885,4 +1020,76 @@ TF_LITE_MICRO_TEST(Int8Input32x1Filter32x32ShouldMatchGolden) {
                      output_dims_count, &conv_params, kQuantizationTolerance));
 }
 
+#if !defined(XTENSA)
+TF_LITE_MICRO_TEST(QuantizedPerChannelPaddedStridedMatchesReference) {
+  const int input_shape[] = {4, 2, 7, 9, 19};
+  const int filter_shape[] = {4, 7, 3, 3, 19};
+  const int output_shape[] = {4, 2, 4, 5, 7};
+  TfLiteConvParams conv_params = {kTfLitePaddingSame, 2, 2,
+                                  kTfLiteActNone,     1, 1};
+  tflite::testing::TestConvQuantizedPerChannelMatchesReference(
+      input_shape, filter_shape, output_shape, &conv_params);
+}
+
+TF_LITE_MICRO_TEST(QuantizedPerChannelDilatedMatchesReference) {
+  const int input_shape[] = {4, 1, 8, 8, 24};
+  const int filter_shape[] = {4, 12, 3, 3, 24};
+  const int output_shape[] = {4, 1, 4, 4, 12};
+  TfLiteConvParams conv_params = {kTfLitePaddingValid, 1, 1,
+                                  kTfLiteActNone,      2, 2};
+  tflite::testing::TestConvQuantizedPerChannelMatchesReference(
+      input_shape, filter_shape, output_shape, &conv_params);
+}
+
+TF_LITE_MICRO_TEST(QuantizedPerChannelMultiThreadedMatchesReference) {
+  tflite::PthreadThreadPool thread_pool(4);
+  // Odd input height with SAME padding and stride 2 gives the row bands of
+  // the first and last task different amounts of padding.
+  const int input_shape[] = {4, 1, 15, 16, 16};
+  const int filter_shape[] = {4, 24, 3, 3, 16};
+  const int output_shape[] = {4, 1, 8, 8, 24};
+  TfLiteConvParams conv_params = {kTfLitePaddingSame, 2, 2,
+                                  kTfLiteActNone,     1, 1};
+  tflite::testing::TestConvQuantizedPerChannelMatchesReference(
+      input_shape, filter_shape, output_shape, &conv_params, &thread_pool);
+}
+
+TF_LITE_MICRO_TEST(QuantizedPerChannelMultiThreadedBatchesMatchReference) {
+  tflite::PthreadThreadPool thread_pool(4);
+  // 18 output rows over 4 tasks, so some tasks span the batch boundary.
+  const int input_shape[] = {4, 2, 9, 12, 16};
+  const int filter_shape[] = {4, 16, 3, 3, 16};
+  const int output_shape[] = {4, 2, 9, 12, 16};
+  TfLiteConvParams conv_params = {kTfLitePaddingSame, 1, 1,
+                                  kTfLiteActNone,     1, 1};
+  tflite::testing::TestConvQuantizedPerChannelMatchesReference(
+      input_shape, filter_shape, output_shape, &conv_params, &thread_pool);
+}
+
+TF_LITE_MICRO_TEST(QuantizedPerChannelPackedMatchesReference) {
+  // Neither the patch depth of 171 nor the 7 output channels fill whole
+  // packed blocks, and SAME padding exercises the zero point fill.
+  const int input_shape[] = {4, 2, 7, 9, 19};
+  const int filter_shape[] = {4, 7, 3, 3, 19};
+  const int output_shape[] = {4, 2, 4, 5, 7};
+  TfLiteConvParams conv_params = {kTfLitePaddingSame, 2, 2,
+                                  kTfLiteActNone,     1, 1};
+  tflite::testing::TestConvQuantizedPerChannelMatchesReference(
+      input_shape, filter_shape, output_shape, &conv_params,
+      /*thread_pool=*/nullptr, /*pack_weights=*/true);
+}
+
+TF_LITE_MICRO_TEST(QuantizedPerChannelPackedMultiThreadedMatchesReference) {
+  tflite::PthreadThreadPool thread_pool(4);
+  const int input_shape[] = {4, 2, 9, 12, 16};
+  const int filter_shape[] = {4, 16, 3, 3, 16};
+  const int output_shape[] = {4, 2, 9, 12, 16};
+  TfLiteConvParams conv_params = {kTfLitePaddingSame, 1, 1,
+                                  kTfLiteActNone,     1, 1};
+  tflite::testing::TestConvQuantizedPerChannelMatchesReference(
+      input_shape, filter_shape, output_shape, &conv_params, &thread_pool,
+      /*pack_weights=*/true);
+}
+#endif  // !defined(XTENSA)
+
 TF_LITE_MICRO_TESTS_END
@@ -15,8 +15,12 @@ limitations under the License.
 
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
+#include "tensorflow/lite/kernels/padding.h"
 #include "tensorflow/lite/micro/kernels/kernel_runner.h"
+#include "tensorflow/lite/micro/linux/pthread_thread_pool.h"
 #include "tensorflow/lite/micro/test_helpers.h"
 #include "tensorflow/lite/micro/testing/micro_test.h"
 
@@ -229,6 +233,324 @@ void TestDepthwiseConvQuantizedPerChannel(
                                               1.0, tensors_size, tensors));
 }
 
+// Runs an int8 per-channel depthwise convolution on deterministic data once
+// single threaded and once on |thread_pool|, and expects identical outputs.
+void TestDepthwiseConvQuantizedPerChannelMultiThreaded(
+    const int* input_dims_data, const int* filter_dims_data,
+    const int* output_dims_data, TfLiteDepthwiseConvParams* conv_params,
+    MicroThreadPool* thread_pool) {
+  constexpr int kMaxElements = 32 * 32 * 32;
+  TfLiteIntArray* input_dims = IntArrayFromInts(input_dims_data);
+  TfLiteIntArray* filter_dims = IntArrayFromInts(filter_dims_data);
+  TfLiteIntArray* output_dims = IntArrayFromInts(output_dims_data);
+  const int input_size = ElementCount(*input_dims);
+  const int filter_size = ElementCount(*filter_dims);
+  const int output_size = ElementCount(*output_dims);
+  const int output_depth = filter_dims->data[3];
+  TF_LITE_MICRO_EXPECT_LE(input_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(filter_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(output_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(output_depth, kMaxFilterChannels);
+
+  static int8_t input_data[kMaxElements];
+  static int8_t filter_data[kMaxElements];
+  static int8_t output_data[kMaxElements];
+  static int8_t threaded_output_data[kMaxElements];
+  int32_t bias_data[kMaxBiasChannels];
+  for (int i = 0; i < input_size; ++i) {
+    input_data[i] = static_cast<int8_t>((i * 37 + 11) % 256 - 128);
+  }
+  for (int i = 0; i < filter_size; ++i) {
+    filter_data[i] = static_cast<int8_t>((i * 53 + 7) % 255 - 127);
+  }
+  for (int i = 0; i < output_depth; ++i) {
+    bias_data[i] = (i * 977) % 4001 - 2000;
+  }
+
+  float filter_scales[kMaxFilterChannels + 1] = {
+      static_cast<float>(output_depth)};
+  int filter_zero_points[kMaxFilterChannels + 1] = {output_depth};
+  for (int i = 0; i < output_depth; ++i) {
+    filter_scales[i + 1] = 0.002f + 0.0005f * i;
+    filter_zero_points[i + 1] = 0;
+  }
+  TfLiteAffineQuantization filter_quant = {
+      FloatArrayFromFloats(filter_scales), IntArrayFromInts(filter_zero_points),
+      3};
+  float input_scales[] = {1, 0.05f};
+  int input_zero_points[] = {1, -3};
+  TfLiteAffineQuantization input_quant = {FloatArrayFromFloats(input_scales),
+                                          IntArrayFromInts(input_zero_points),
+                                          0};
+  float output_scales[] = {1, 0.4f};
+  int output_zero_points[] = {1, 5};
+  TfLiteAffineQuantization output_quant = {FloatArrayFromFloats(output_scales),
+                                           IntArrayFromInts(output_zero_points),
+                                           0};
+
+  int inputs_array_data[] = {3, 0, 1, 2};
+  int outputs_array_data[] = {1, 3};
+  int bias_dims_data[] = {1, output_depth};
+  int8_t* outputs[] = {output_data, threaded_output_data};
+  MicroThreadPool* thread_pools[] = {nullptr, thread_pool};
+  for (int run = 0; run < 2; ++run) {
+    TfLiteTensor tensors[] = {
+        CreateQuantizedTensor(input_data, input_dims, input_scales[1],
+                              input_zero_points[1]),
+        CreateQuantizedTensor(filter_data, filter_dims, 1.0f, 0),
+        CreateTensor(bias_data, IntArrayFromInts(bias_dims_data)),
+        CreateQuantizedTensor(outputs[run], output_dims, output_scales[1],
+                              output_zero_points[1]),
+    };
+    tensors[0].quantization = {kTfLiteAffineQuantization, &input_quant};
+    tensors[1].quantization = {kTfLiteAffineQuantization, &filter_quant};
+    tensors[3].quantization = {kTfLiteAffineQuantization, &output_quant};
+
+    const TfLiteRegistration registration = Register_DEPTHWISE_CONV_2D();
+    micro::KernelRunner runner(registration, tensors, 4,
+                               IntArrayFromInts(inputs_array_data),
+                               IntArrayFromInts(outputs_array_data),
+                               reinterpret_cast<void*>(conv_params),
+                               micro_test::reporter);
+    runner.SetThreadPool(thread_pools[run]);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.InitAndPrepare());
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.Invoke());
+  }
+
+  for (int i = 0; i < output_size; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(output_data[i], threaded_output_data[i]);
+  }
+}
+
+// Runs an int8 per-channel depthwise convolution on a batch of |batches|
+// inputs of shape |input_dims_data| (whose batch dimension is 1), and once on
+// each of them alone, and expects identical outputs.
+void TestDepthwiseConvQuantizedPerChannelBatchesMatchSingle(
+    int batches, const int* input_dims_data, const int* filter_dims_data,
+    const int* output_dims_data, TfLiteDepthwiseConvParams* conv_params) {
+  constexpr int kMaxElements = 4096;
+  const int input_size = ElementCount(*IntArrayFromInts(input_dims_data));
+  const int filter_size = ElementCount(*IntArrayFromInts(filter_dims_data));
+  const int output_size = ElementCount(*IntArrayFromInts(output_dims_data));
+  const int output_depth = filter_dims_data[4];
+  TF_LITE_MICRO_EXPECT_LE(batches * input_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(filter_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(batches * output_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(output_depth, kMaxFilterChannels);
+
+  static int8_t input_data[kMaxElements];
+  static int8_t filter_data[kMaxElements];
+  static int8_t output_data[kMaxElements];
+  static int8_t single_output_data[kMaxElements];
+  int32_t bias_data[kMaxBiasChannels];
+  for (int i = 0; i < batches * input_size; ++i) {
+    input_data[i] = static_cast<int8_t>((i * 37 + 11) % 256 - 128);
+  }
+  for (int i = 0; i < filter_size; ++i) {
+    filter_data[i] = static_cast<int8_t>((i * 53 + 7) % 255 - 127);
+  }
+  for (int i = 0; i < output_depth; ++i) {
+    bias_data[i] = (i * 977) % 4001 - 2000;
+  }
+
+  float filter_scales[kMaxFilterChannels + 1] = {
+      static_cast<float>(output_depth)};
+  int filter_zero_points[kMaxFilterChannels + 1] = {output_depth};
+  for (int i = 0; i < output_depth; ++i) {
+    filter_scales[i + 1] = 0.002f + 0.0005f * i;
+    filter_zero_points[i + 1] = 0;
+  }
+  TfLiteAffineQuantization filter_quant = {
+      FloatArrayFromFloats(filter_scales), IntArrayFromInts(filter_zero_points),
+      3};
+  float input_scales[] = {1, 0.05f};
+  int input_zero_points[] = {1, -3};
+  TfLiteAffineQuantization input_quant = {FloatArrayFromFloats(input_scales),
+                                          IntArrayFromInts(input_zero_points),
+                                          0};
+  float output_scales[] = {1, 0.4f};
+  int output_zero_points[] = {1, 5};
+  TfLiteAffineQuantization output_quant = {FloatArrayFromFloats(output_scales),
+                                           IntArrayFromInts(output_zero_points),
+                                           0};
+
+  int batched_input_dims_data[5];
+  int batched_output_dims_data[5];
+  for (int i = 0; i < 5; ++i) {
+    batched_input_dims_data[i] = input_dims_data[i];
+    batched_output_dims_data[i] = output_dims_data[i];
+  }
+  batched_input_dims_data[1] = batches;
+  batched_output_dims_data[1] = batches;
+
+  int inputs_array_data[] = {3, 0, 1, 2};
+  int outputs_array_data[] = {1, 3};
+  int bias_dims_data[] = {1, output_depth};
+  // Run -1 computes the whole batch, run b only batch b.
+  for (int run = -1; run < batches; ++run) {
+    const bool batched = run < 0;
+    TfLiteTensor tensors[] = {
+        CreateQuantizedTensor(
+            input_data + (batched ? 0 : run * input_size),
+            IntArrayFromInts(batched ? batched_input_dims_data
+                                     : input_dims_data),
+            input_scales[1], input_zero_points[1]),
+        CreateQuantizedTensor(filter_data, IntArrayFromInts(filter_dims_data),
+                              1.0f, 0),
+        CreateTensor(bias_data, IntArrayFromInts(bias_dims_data)),
+        CreateQuantizedTensor(
+            batched ? output_data : single_output_data,
+            IntArrayFromInts(batched ? batched_output_dims_data
+                                     : output_dims_data),
+            output_scales[1], output_zero_points[1]),
+    };
+    tensors[0].quantization = {kTfLiteAffineQuantization, &input_quant};
+    tensors[1].quantization = {kTfLiteAffineQuantization, &filter_quant};
+    tensors[3].quantization = {kTfLiteAffineQuantization, &output_quant};
+
+    const TfLiteRegistration registration = Register_DEPTHWISE_CONV_2D();
+    micro::KernelRunner runner(registration, tensors, 4,
+                               IntArrayFromInts(inputs_array_data),
+                               IntArrayFromInts(outputs_array_data),
+                               reinterpret_cast<void*>(conv_params),
+                               micro_test::reporter);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.InitAndPrepare());
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.Invoke());
+    for (int i = 0; !batched && i < output_size; ++i) {
+      TF_LITE_MICRO_EXPECT_EQ(single_output_data[i],
+                              output_data[run * output_size + i]);
+    }
+  }
+}
+
+// Runs the int8 per-channel kernel with a depth multiplier of 1 on
+// deterministic pseudo-random data and checks that the result is bit-exact
+// with reference_integer_ops::DepthwiseConvPerChannel.
+void TestDepthwiseConvQuantizedPerChannelMatchesReference(
+    const int* input_dims_data, const int* filter_dims_data,
+    const int* output_dims_data, TfLiteDepthwiseConvParams* conv_params,
+    int input_zero_point) {
+  constexpr int kMaxElements = 4096;
+  TfLiteIntArray* input_dims = IntArrayFromInts(input_dims_data);
+  TfLiteIntArray* filter_dims = IntArrayFromInts(filter_dims_data);
+  TfLiteIntArray* output_dims = IntArrayFromInts(output_dims_data);
+  const int input_size = ElementCount(*input_dims);
+  const int filter_size = ElementCount(*filter_dims);
+  const int output_size = ElementCount(*output_dims);
+  const int output_depth = filter_dims->data[3];
+  TF_LITE_MICRO_EXPECT_LE(input_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(filter_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(output_size, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(output_depth, kMaxFilterChannels);
+
+  const float input_scale = 0.05f;
+  const float output_scale = 0.004f;
+  const int output_zero_point = 5;
+
+  static int8_t input_data[kMaxElements];
+  static int8_t filter_data[kMaxElements];
+  static int8_t output_data[kMaxElements];
+  static int8_t expected_data[kMaxElements];
+  int32_t bias_data[kMaxBiasChannels];
+  for (int i = 0; i < input_size; ++i) {
+    input_data[i] = static_cast<int8_t>((i * 37 + 11) % 256 - 128);
+  }
+  for (int i = 0; i < filter_size; ++i) {
+    filter_data[i] = static_cast<int8_t>((i * 53 + 7) % 255 - 127);
+  }
+  for (int i = 0; i < output_depth; ++i) {
+    bias_data[i] = (i * 977) % 4001 - 2000;
+  }
+
+  // Output multipliers range from about 0.004 to 2, so channels cover both
+  // right and left shifts.
+  float filter_scales[kMaxFilterChannels + 1] = {
+      static_cast<float>(output_depth)};
+  int filter_zero_points[kMaxFilterChannels + 1] = {output_depth};
+  for (int i = 0; i < output_depth; ++i) {
+    filter_scales[i + 1] = 0.0003f * (1 << (i % 10));
+    filter_zero_points[i + 1] = 0;
+  }
+  TfLiteAffineQuantization filter_quant = {
+      FloatArrayFromFloats(filter_scales), IntArrayFromInts(filter_zero_points),
+      3};
+  float input_scales[] = {1, input_scale};
+  int input_zero_points[] = {1, input_zero_point};
+  TfLiteAffineQuantization input_quant = {FloatArrayFromFloats(input_scales),
+                                          IntArrayFromInts(input_zero_points),
+                                          0};
+  float output_scales[] = {1, output_scale};
+  int output_zero_points[] = {1, output_zero_point};
+  TfLiteAffineQuantization output_quant = {FloatArrayFromFloats(output_scales),
+                                           IntArrayFromInts(output_zero_points),
+                                           0};
+
+  int inputs_array_data[] = {3, 0, 1, 2};
+  int outputs_array_data[] = {1, 3};
+  int bias_dims_data[] = {1, output_depth};
+  TfLiteTensor tensors[] = {
+      CreateQuantizedTensor(input_data, input_dims, input_scale,
+                            input_zero_point),
+      CreateQuantizedTensor(filter_data, filter_dims, 1.0f, 0),
+      CreateTensor(bias_data, IntArrayFromInts(bias_dims_data)),
+      CreateQuantizedTensor(output_data, output_dims, output_scale,
+                            output_zero_point),
+  };
+  tensors[0].quantization = {kTfLiteAffineQuantization, &input_quant};
+  tensors[1].quantization = {kTfLiteAffineQuantization, &filter_quant};
+  tensors[3].quantization = {kTfLiteAffineQuantization, &output_quant};
+
+  const TfLiteRegistration registration = Register_DEPTHWISE_CONV_2D();
+  micro::KernelRunner runner(registration, tensors, 4,
+                             IntArrayFromInts(inputs_array_data),
+                             IntArrayFromInts(outputs_array_data),
+                             reinterpret_cast<void*>(conv_params),
+                             micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.InitAndPrepare());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.Invoke());
+
+  int32_t multipliers[kMaxFilterChannels];
+  int32_t shifts[kMaxFilterChannels];
+  for (int i = 0; i < output_depth; ++i) {
+    int shift;
+    QuantizeMultiplier(static_cast<double>(input_scale) *
+                           static_cast<double>(filter_scales[i + 1]) /
+                           static_cast<double>(output_scale),
+                       &multipliers[i], &shift);
+    shifts[i] = shift;
+  }
+  int out_height, out_width;
+  TfLitePaddingValues padding = ComputePaddingHeightWidth(
+      conv_params->stride_height, conv_params->stride_width,
+      conv_params->dilation_height_factor, conv_params->dilation_width_factor,
+      input_dims->data[1], input_dims->data[2], filter_dims->data[1],
+      filter_dims->data[2], conv_params->padding, &out_height, &out_width);
+  TF_LITE_MICRO_EXPECT_EQ(output_dims->data[1], out_height);
+  TF_LITE_MICRO_EXPECT_EQ(output_dims->data[2], out_width);
+
+  DepthwiseParams op_params;
+  op_params.input_offset = -input_zero_point;
+  op_params.output_offset = output_zero_point;
+  op_params.stride_height = conv_params->stride_height;
+  op_params.stride_width = conv_params->stride_width;
+  op_params.dilation_height_factor = conv_params->dilation_height_factor;
+  op_params.dilation_width_factor = conv_params->dilation_width_factor;
+  op_params.padding_values.height = padding.height;
+  op_params.padding_values.width = padding.width;
+  op_params.depth_multiplier = conv_params->depth_multiplier;
+  op_params.quantized_activation_min = std::numeric_limits<int8_t>::min();
+  op_params.quantized_activation_max = std::numeric_limits<int8_t>::max();
+  reference_integer_ops::DepthwiseConvPerChannel(
+      op_params, multipliers, shifts, RuntimeShape(4, &input_dims->data[0]),
+      input_data, RuntimeShape(4, &filter_dims->data[0]), filter_data,
+      RuntimeShape(1, &output_depth), bias_data,
+      RuntimeShape(4, &output_dims->data[0]), expected_data);
+
+  for (int i = 0; i < output_size; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(expected_data[i], output_data[i]);
+  }
+}
+
 #endif  // !defined(XTENSA)
 
 }  // namespace
@@ -773,6 +1095,81 @@ TF_LITE_MICRO_TEST(PerChannelBroadcastQuantizationParams) {
                      tensors_size, tensors));
 }
 
+
+TF_LITE_MICRO_TEST(QuantizedPerChannelMultiThreadedMatchesSingleThreaded) {
+  tflite::PthreadThreadPool thread_pool(4);
+  const int input_shape[] = {4, 1, 32, 32, 32};
+  const int filter_shape[] = {4, 1, 3, 3, 32};
+  const int output_shape[] = {4, 1, 32, 32, 32};
+  TfLiteDepthwiseConvParams conv_params = {kTfLitePaddingSame, 1, 1, 1,
+                                           kTfLiteActNone,     1, 1};
+  tflite::testing::TestDepthwiseConvQuantizedPerChannelMultiThreaded(
+      input_shape, filter_shape, output_shape, &conv_params, &thread_pool);
+}
+
+TF_LITE_MICRO_TEST(
+    QuantizedPerChannelMultiThreadedStridedMultiplierMatchesSingleThreaded) {
+  tflite::PthreadThreadPool thread_pool(4);
+  const int input_shape[] = {4, 1, 31, 32, 16};
+  const int filter_shape[] = {4, 1, 5, 5, 32};
+  const int output_shape[] = {4, 1, 16, 16, 32};
+  TfLiteDepthwiseConvParams conv_params = {kTfLitePaddingSame, 2, 2, 2,
+                                           kTfLiteActNone,     1, 1};
+  tflite::testing::TestDepthwiseConvQuantizedPerChannelMultiThreaded(
+      input_shape, filter_shape, output_shape, &conv_params, &thread_pool);
+}
+TF_LITE_MICRO_TEST(QuantizedPerChannelDepthMultiplier2BatchesMatchSingle) {
+  // A depth multiplier of 2 always runs the CMSIS-NN kernels, which handle a
+  // single batch per call.
+  const int input_shape[] = {4, 1, 6, 5, 8};
+  const int filter_shape[] = {4, 1, 3, 3, 16};
+  const int output_shape[] = {4, 1, 6, 5, 16};
+  TfLiteDepthwiseConvParams conv_params = {kTfLitePaddingSame, 1, 1, 2,
+                                           kTfLiteActNone,     1, 1};
+  tflite::testing::TestDepthwiseConvQuantizedPerChannelBatchesMatchSingle(
+      3, input_shape, filter_shape, output_shape, &conv_params);
+}
+
+TF_LITE_MICRO_TEST(QuantizedPerChannel3x3MatchesReference) {
+  const int input_shape[] = {4, 1, 9, 9, 20};
+  const int filter_shape[] = {4, 1, 3, 3, 20};
+  const int output_shape[] = {4, 1, 9, 9, 20};
+  TfLiteDepthwiseConvParams conv_params = {kTfLitePaddingSame, 1, 1, 1,
+                                           kTfLiteActNone,     1, 1};
+  tflite::testing::TestDepthwiseConvQuantizedPerChannelMatchesReference(
+      input_shape, filter_shape, output_shape, &conv_params, -3);
+}
+
+TF_LITE_MICRO_TEST(QuantizedPerChannel3x3Stride2MatchesReference) {
+  const int input_shape[] = {4, 2, 10, 9, 16};
+  const int filter_shape[] = {4, 1, 3, 3, 16};
+  const int output_shape[] = {4, 2, 5, 5, 16};
+  TfLiteDepthwiseConvParams conv_params = {kTfLitePaddingSame, 2, 2, 1,
+                                           kTfLiteActNone,     1, 1};
+  // The extreme zero point makes input + input_offset reach 255.
+  tflite::testing::TestDepthwiseConvQuantizedPerChannelMatchesReference(
+      input_shape, filter_shape, output_shape, &conv_params, -128);
+}
+
+TF_LITE_MICRO_TEST(QuantizedPerChannelGenericFilterMatchesReference) {
+  const int input_shape[] = {4, 1, 8, 11, 13};
+  const int filter_shape[] = {4, 1, 5, 4, 13};
+  const int output_shape[] = {4, 1, 4, 8, 13};
+  TfLiteDepthwiseConvParams conv_params = {kTfLitePaddingValid, 1, 1, 1,
+                                           kTfLiteActNone,      1, 1};
+  tflite::testing::TestDepthwiseConvQuantizedPerChannelMatchesReference(
+      input_shape, filter_shape, output_shape, &conv_params, 127);
+}
+
+TF_LITE_MICRO_TEST(QuantizedPerChannelDilated3x3MatchesReference) {
+  const int input_shape[] = {4, 1, 9, 7, 24};
+  const int filter_shape[] = {4, 1, 3, 3, 24};
+  const int output_shape[] = {4, 1, 5, 3, 24};
+  TfLiteDepthwiseConvParams conv_params = {kTfLitePaddingValid, 1, 1, 1,
+                                           kTfLiteActNone,      2, 2};
+  tflite::testing::TestDepthwiseConvQuantizedPerChannelMatchesReference(
+      input_shape, filter_shape, output_shape, &conv_params, 10);
+}
 #endif  // !defined(XTENSA)
 
 TF_LITE_MICRO_TEST(FilterDimsNotMatchingAffineQuantization) {
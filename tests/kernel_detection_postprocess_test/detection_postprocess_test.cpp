@@ -13,10 +13,14 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <cmath>
+
 #include "flatbuffers/flexbuffers.h"
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/micro/kernels/kernel_runner.h"
+#include "tensorflow/lite/micro/linux/pthread_thread_pool.h"
 #include "tensorflow/lite/micro/test_helpers.h"
 #include "tensorflow/lite/micro/testing/micro_test.h"
 
@@ -209,6 +213,334 @@ void TestDetectionPostprocess(
     TF_LITE_MICRO_EXPECT_NEAR(golden4[i], output_data4[i], tolerance);
   }
 }
+
+// A larger case with an 8x8 grid of overlapping anchors and eight classes plus
+// background, checked against a straightforward O(N^2) non-max suppression.
+// The options are max_detections = 16, max_classes_per_detection = 1,
+// detections_per_class = 8, nms_score_threshold = 0.1,
+// nms_iou_threshold = 0.3, num_classes = 8, y_scale = x_scale = 10 and
+// h_scale = w_scale = 5, with use_regular_nms false and true.
+constexpr int kManyAnchors = 64;
+constexpr int kManyClasses = 8;
+constexpr int kManyMaxDetections = 16;
+constexpr int kManyDetectionsPerClass = 8;
+constexpr float kManyScoreThreshold = 0.1f;
+constexpr float kManyIouThreshold = 0.3f;
+
+const unsigned char kManyAnchorsFastNmsOptions[] = {
+    0x6d, 0x61, 0x78, 0x5f, 0x64, 0x65, 0x74, 0x65, 0x63, 0x74, 0x69, 0x6f,
+    0x6e, 0x73, 0x00, 0x6d, 0x61, 0x78, 0x5f, 0x63, 0x6c, 0x61, 0x73, 0x73,
+    0x65, 0x73, 0x5f, 0x70, 0x65, 0x72, 0x5f, 0x64, 0x65, 0x74, 0x65, 0x63,
+    0x74, 0x69, 0x6f, 0x6e, 0x00, 0x64, 0x65, 0x74, 0x65, 0x63, 0x74, 0x69,
+    0x6f, 0x6e, 0x73, 0x5f, 0x70, 0x65, 0x72, 0x5f, 0x63, 0x6c, 0x61, 0x73,
+    0x73, 0x00, 0x75, 0x73, 0x65, 0x5f, 0x72, 0x65, 0x67, 0x75, 0x6c, 0x61,
+    0x72, 0x5f, 0x6e, 0x6d, 0x73, 0x00, 0x6e, 0x6d, 0x73, 0x5f, 0x73, 0x63,
+    0x6f, 0x72, 0x65, 0x5f, 0x74, 0x68, 0x72, 0x65, 0x73, 0x68, 0x6f, 0x6c,
+    0x64, 0x00, 0x6e, 0x6d, 0x73, 0x5f, 0x69, 0x6f, 0x75, 0x5f, 0x74, 0x68,
+    0x72, 0x65, 0x73, 0x68, 0x6f, 0x6c, 0x64, 0x00, 0x6e, 0x75, 0x6d, 0x5f,
+    0x63, 0x6c, 0x61, 0x73, 0x73, 0x65, 0x73, 0x00, 0x79, 0x5f, 0x73, 0x63,
+    0x61, 0x6c, 0x65, 0x00, 0x78, 0x5f, 0x73, 0x63, 0x61, 0x6c, 0x65, 0x00,
+    0x68, 0x5f, 0x73, 0x63, 0x61, 0x6c, 0x65, 0x00, 0x77, 0x5f, 0x73, 0x63,
+    0x61, 0x6c, 0x65, 0x00, 0x0b, 0x78, 0x12, 0x94, 0xa4, 0x43, 0x58, 0x33,
+    0x6a, 0x11, 0x22, 0x2b, 0x0b, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x0b, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa0, 0x40,
+    0x01, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x9a, 0x99, 0x99, 0x3e,
+    0xcd, 0xcc, 0xcc, 0x3d, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xa0, 0x40, 0x00, 0x00, 0x20, 0x41, 0x00, 0x00, 0x20, 0x41,
+    0x06, 0x0e, 0x06, 0x06, 0x0e, 0x0e, 0x06, 0x6a, 0x0e, 0x0e, 0x0e, 0x37,
+    0x26, 0x01,
+};
+
+const unsigned char kManyAnchorsRegularNmsOptions[] = {
+    0x6d, 0x61, 0x78, 0x5f, 0x64, 0x65, 0x74, 0x65, 0x63, 0x74, 0x69, 0x6f,
+    0x6e, 0x73, 0x00, 0x6d, 0x61, 0x78, 0x5f, 0x63, 0x6c, 0x61, 0x73, 0x73,
+    0x65, 0x73, 0x5f, 0x70, 0x65, 0x72, 0x5f, 0x64, 0x65, 0x74, 0x65, 0x63,
+    0x74, 0x69, 0x6f, 0x6e, 0x00, 0x64, 0x65, 0x74, 0x65, 0x63, 0x74, 0x69,
+    0x6f, 0x6e, 0x73, 0x5f, 0x70, 0x65, 0x72, 0x5f, 0x63, 0x6c, 0x61, 0x73,
+    0x73, 0x00, 0x75, 0x73, 0x65, 0x5f, 0x72, 0x65, 0x67, 0x75, 0x6c, 0x61,
+    0x72, 0x5f, 0x6e, 0x6d, 0x73, 0x00, 0x6e, 0x6d, 0x73, 0x5f, 0x73, 0x63,
+    0x6f, 0x72, 0x65, 0x5f, 0x74, 0x68, 0x72, 0x65, 0x73, 0x68, 0x6f, 0x6c,
+    0x64, 0x00, 0x6e, 0x6d, 0x73, 0x5f, 0x69, 0x6f, 0x75, 0x5f, 0x74, 0x68,
+    0x72, 0x65, 0x73, 0x68, 0x6f, 0x6c, 0x64, 0x00, 0x6e, 0x75, 0x6d, 0x5f,
+    0x63, 0x6c, 0x61, 0x73, 0x73, 0x65, 0x73, 0x00, 0x79, 0x5f, 0x73, 0x63,
+    0x61, 0x6c, 0x65, 0x00, 0x78, 0x5f, 0x73, 0x63, 0x61, 0x6c, 0x65, 0x00,
+    0x68, 0x5f, 0x73, 0x63, 0x61, 0x6c, 0x65, 0x00, 0x77, 0x5f, 0x73, 0x63,
+    0x61, 0x6c, 0x65, 0x00, 0x0b, 0x78, 0x12, 0x94, 0xa4, 0x43, 0x58, 0x33,
+    0x6a, 0x11, 0x22, 0x2b, 0x0b, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x0b, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa0, 0x40,
+    0x01, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x9a, 0x99, 0x99, 0x3e,
+    0xcd, 0xcc, 0xcc, 0x3d, 0x08, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xa0, 0x40, 0x00, 0x00, 0x20, 0x41, 0x00, 0x00, 0x20, 0x41,
+    0x06, 0x0e, 0x06, 0x06, 0x0e, 0x0e, 0x06, 0x6a, 0x0e, 0x0e, 0x0e, 0x37,
+    0x26, 0x01,
+};
+
+void DecodeManyAnchorsBoxes(const float* box_encodings, const float* anchors,
+                            float* boxes) {
+  for (int i = 0; i < kManyAnchors; ++i) {
+    const float* box = box_encodings + i * 4;
+    const float* anchor = anchors + i * 4;
+    const float ycenter = box[0] / 10.0f * anchor[2] + anchor[0];
+    const float xcenter = box[1] / 10.0f * anchor[3] + anchor[1];
+    const float half_h =
+        0.5f * static_cast<float>(std::exp(box[2] / 5.0f)) * anchor[2];
+    const float half_w =
+        0.5f * static_cast<float>(std::exp(box[3] / 5.0f)) * anchor[3];
+    boxes[i * 4 + 0] = ycenter - half_h;
+    boxes[i * 4 + 1] = xcenter - half_w;
+    boxes[i * 4 + 2] = ycenter + half_h;
+    boxes[i * 4 + 3] = xcenter + half_w;
+  }
+}
+
+float ManyAnchorsIou(const float* boxes, int i, int j) {
+  const float* a = boxes + i * 4;
+  const float* b = boxes + j * 4;
+  const float area_a = (a[2] - a[0]) * (a[3] - a[1]);
+  const float area_b = (b[2] - b[0]) * (b[3] - b[1]);
+  const float intersection =
+      std::max(std::min(a[2], b[2]) - std::max(a[0], b[0]), 0.0f) *
+      std::max(std::min(a[3], b[3]) - std::max(a[1], b[1]), 0.0f);
+  return intersection / (area_a + area_b - intersection);
+}
+
+// Greedy NMS that suppresses every lower-scoring box overlapping a selected
+// one. Boxes with equal scores are visited in anchor order.
+int ReferenceNonMaxSuppression(const float* boxes, const float* scores,
+                               int max_detections, int* selected) {
+  int order[kManyAnchors];
+  bool active[kManyAnchors];
+  int count = 0;
+  for (int i = 0; i < kManyAnchors; ++i) {
+    if (scores[i] >= kManyScoreThreshold) {
+      int j = count++;
+      for (; j > 0 && scores[order[j - 1]] < scores[i]; --j) {
+        order[j] = order[j - 1];
+      }
+      order[j] = i;
+    }
+    active[i] = true;
+  }
+  int num_selected = 0;
+  for (int i = 0; i < count && num_selected < max_detections; ++i) {
+    if (!active[order[i]]) continue;
+    selected[num_selected++] = order[i];
+    for (int j = i + 1; j < count; ++j) {
+      if (ManyAnchorsIou(boxes, order[i], order[j]) > kManyIouThreshold) {
+        active[order[j]] = false;
+      }
+    }
+  }
+  return num_selected;
+}
+
+// Quantizes |data| into |quantized| and replaces |data| with the dequantized
+// values, which are the values the kernel works with.
+template <typename T>
+TfLiteTensor CreateManyAnchorsTensor(float* data, T* quantized,
+                                     TfLiteIntArray* dims, float min,
+                                     float max) {
+  const float scale = ScaleFromMinMax<T>(min, max);
+  const int zero_point = ZeroPointFromMinMax<T>(min, max);
+  TfLiteTensor tensor =
+      CreateQuantizedTensor(data, quantized, dims, scale, zero_point);
+  for (int i = 0; i < ElementCount(*dims); ++i) {
+    data[i] = (static_cast<float>(quantized[i]) - zero_point) * scale;
+  }
+  return tensor;
+}
+
+TfLiteTensor CreateManyAnchorsTensor(float* data, float* quantized,
+                                     TfLiteIntArray* dims, float min,
+                                     float max) {
+  return CreateTensor(data, dims);
+}
+
+// Runs the many anchors case with inputs of type T. Quantized scores can be
+// equal, in which case the lower anchor and class indices come first.
+template <typename T>
+void TestDetectionPostprocessManyAnchors(bool use_regular_nms,
+                                         MicroThreadPool* thread_pool) {
+  float box_encodings[kManyAnchors * 4];
+  float class_predictions[kManyAnchors * (kManyClasses + 1)];
+  float anchors[kManyAnchors * 4];
+  for (int i = 0; i < kManyAnchors; ++i) {
+    box_encodings[i * 4 + 0] = ((i * 7) % 5 - 2) * 0.5f;
+    box_encodings[i * 4 + 1] = ((i * 11) % 5 - 2) * 0.5f;
+    box_encodings[i * 4 + 2] = ((i * 3) % 5 - 2) * 0.25f;
+    box_encodings[i * 4 + 3] = ((i * 13) % 5 - 2) * 0.25f;
+    anchors[i * 4 + 0] = 0.1f * (i / 8) + 0.05f;
+    anchors[i * 4 + 1] = 0.1f * (i % 8) + 0.05f;
+    anchors[i * 4 + 2] = 0.2f;
+    anchors[i * 4 + 3] = 0.2f;
+  }
+  for (int i = 0; i < kManyAnchors * (kManyClasses + 1); ++i) {
+    class_predictions[i] = ((i * 7919) % 1000) / 1000.0f;
+  }
+  const int input_dims_data1[] = {3, 1, kManyAnchors, 4};
+  const int input_dims_data2[] = {3, 1, kManyAnchors, kManyClasses + 1};
+  const int input_dims_data3[] = {2, kManyAnchors, 4};
+  T quantized_box_encodings[kManyAnchors * 4];
+  T quantized_class_predictions[kManyAnchors * (kManyClasses + 1)];
+  T quantized_anchors[kManyAnchors * 4];
+  const TfLiteTensor input_tensors[] = {
+      CreateManyAnchorsTensor(box_encodings, quantized_box_encodings,
+                              IntArrayFromInts(input_dims_data1), -1.0f, 1.0f),
+      CreateManyAnchorsTensor(class_predictions, quantized_class_predictions,
+                              IntArrayFromInts(input_dims_data2), 0.0f, 1.0f),
+      CreateManyAnchorsTensor(anchors, quantized_anchors,
+                              IntArrayFromInts(input_dims_data3), 0.0f, 1.0f),
+  };
+
+  // Expected detections as (anchor, class, score), best first.
+  float boxes[kManyAnchors * 4];
+  DecodeManyAnchorsBoxes(box_encodings, anchors, boxes);
+  int expected_anchors[kManyClasses * kManyDetectionsPerClass];
+  int expected_classes[kManyClasses * kManyDetectionsPerClass];
+  float expected_scores[kManyClasses * kManyDetectionsPerClass];
+  int num_expected = 0;
+  float class_scores[kManyAnchors];
+  int selected[kManyAnchors];
+  for (int c = 0; c < (use_regular_nms ? kManyClasses : 1); ++c) {
+    int classes[kManyAnchors];
+    for (int i = 0; i < kManyAnchors; ++i) {
+      const float* scores = class_predictions + i * (kManyClasses + 1) + 1;
+      classes[i] = c;
+      if (!use_regular_nms) {
+        for (int k = 1; k < kManyClasses; ++k) {
+          if (scores[k] > scores[classes[i]]) classes[i] = k;
+        }
+      }
+      class_scores[i] = scores[classes[i]];
+    }
+    const int num_selected = ReferenceNonMaxSuppression(
+        boxes, class_scores,
+        use_regular_nms ? kManyDetectionsPerClass : kManyMaxDetections,
+        selected);
+    for (int i = 0; i < num_selected; ++i) {
+      int j = num_expected++;
+      for (; j > 0 && expected_scores[j - 1] < class_scores[selected[i]];
+           --j) {
+        expected_anchors[j] = expected_anchors[j - 1];
+        expected_classes[j] = expected_classes[j - 1];
+        expected_scores[j] = expected_scores[j - 1];
+      }
+      expected_anchors[j] = selected[i];
+      expected_classes[j] = classes[selected[i]];
+      expected_scores[j] = class_scores[selected[i]];
+    }
+  }
+  num_expected = std::min(num_expected, kManyMaxDetections);
+
+  const int output_dims_data1[] = {3, 1, kManyMaxDetections, 4};
+  const int output_dims_data2[] = {2, 1, kManyMaxDetections};
+  const int output_dims_data4[] = {1, 1};
+  float output_boxes[kManyMaxDetections * 4];
+  float output_classes[kManyMaxDetections];
+  float output_scores[kManyMaxDetections];
+  float output_num_detections[1];
+  TfLiteTensor tensors[] = {
+      input_tensors[0],
+      input_tensors[1],
+      input_tensors[2],
+      CreateTensor(output_boxes, IntArrayFromInts(output_dims_data1)),
+      CreateTensor(output_classes, IntArrayFromInts(output_dims_data2)),
+      CreateTensor(output_scores, IntArrayFromInts(output_dims_data2)),
+      CreateTensor(output_num_detections, IntArrayFromInts(output_dims_data4)),
+  };
+
+  int inputs_array_data[] = {3, 0, 1, 2};
+  int outputs_array_data[] = {4, 3, 4, 5, 6};
+  ::tflite::AllOpsResolver resolver;
+  const TfLiteRegistration* registration =
+      resolver.FindOp("TFLite_Detection_PostProcess");
+  TF_LITE_MICRO_EXPECT_NE(nullptr, registration);
+  micro::KernelRunner runner(*registration, tensors, 7,
+                             IntArrayFromInts(inputs_array_data),
+                             IntArrayFromInts(outputs_array_data), nullptr,
+                             micro_test::reporter);
+  runner.SetThreadPool(thread_pool);
+  const unsigned char* init_data = use_regular_nms
+                                       ? kManyAnchorsRegularNmsOptions
+                                       : kManyAnchorsFastNmsOptions;
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, runner.InitAndPrepare(reinterpret_cast<const char*>(init_data),
+                                       sizeof(kManyAnchorsFastNmsOptions)));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.Invoke());
+
+  TF_LITE_MICRO_EXPECT_EQ(num_expected,
+                          static_cast<int>(output_num_detections[0]));
+  for (int i = 0; i < num_expected; ++i) {
+    for (int k = 0; k < 4; ++k) {
+      TF_LITE_MICRO_EXPECT_NEAR(boxes[expected_anchors[i] * 4 + k],
+                                output_boxes[i * 4 + k], 1e-6f);
+    }
+    TF_LITE_MICRO_EXPECT_EQ(expected_classes[i],
+                            static_cast<int>(output_classes[i]));
+    TF_LITE_MICRO_EXPECT_NEAR(expected_scores[i], output_scores[i], 1e-6f);
+  }
+}
+// Runs the float many anchors case with a box that has no height, on an anchor
+// whose scores are all below the threshold. Every box is validated, so the op
+// fails even though NMS never looks at that anchor.
+void TestDetectionPostprocessRejectsInvalidBox(bool use_regular_nms) {
+  float box_encodings[kManyAnchors * 4] = {};
+  float class_predictions[kManyAnchors * (kManyClasses + 1)];
+  float anchors[kManyAnchors * 4];
+  for (int i = 0; i < kManyAnchors; ++i) {
+    anchors[i * 4 + 0] = 0.1f * (i / 8) + 0.05f;
+    anchors[i * 4 + 1] = 0.1f * (i % 8) + 0.05f;
+    anchors[i * 4 + 2] = 0.2f;
+    anchors[i * 4 + 3] = 0.2f;
+  }
+  for (int i = 0; i < kManyAnchors * (kManyClasses + 1); ++i) {
+    class_predictions[i] = 0.5f;
+  }
+  constexpr int kInvalidAnchor = 5;
+  anchors[kInvalidAnchor * 4 + 2] = 0.0f;
+  for (int k = 0; k <= kManyClasses; ++k) {
+    class_predictions[kInvalidAnchor * (kManyClasses + 1) + k] = 0.0f;
+  }
+
+  const int input_dims_data1[] = {3, 1, kManyAnchors, 4};
+  const int input_dims_data2[] = {3, 1, kManyAnchors, kManyClasses + 1};
+  const int input_dims_data3[] = {2, kManyAnchors, 4};
+  const int output_dims_data1[] = {3, 1, kManyMaxDetections, 4};
+  const int output_dims_data2[] = {2, 1, kManyMaxDetections};
+  const int output_dims_data4[] = {1, 1};
+  float output_boxes[kManyMaxDetections * 4];
+  float output_classes[kManyMaxDetections];
+  float output_scores[kManyMaxDetections];
+  float output_num_detections[1];
+  TfLiteTensor tensors[] = {
+      CreateTensor(box_encodings, IntArrayFromInts(input_dims_data1)),
+      CreateTensor(class_predictions, IntArrayFromInts(input_dims_data2)),
+      CreateTensor(anchors, IntArrayFromInts(input_dims_data3)),
+      CreateTensor(output_boxes, IntArrayFromInts(output_dims_data1)),
+      CreateTensor(output_classes, IntArrayFromInts(output_dims_data2)),
+      CreateTensor(output_scores, IntArrayFromInts(output_dims_data2)),
+      CreateTensor(output_num_detections, IntArrayFromInts(output_dims_data4)),
+  };
+
+  int inputs_array_data[] = {3, 0, 1, 2};
+  int outputs_array_data[] = {4, 3, 4, 5, 6};
+  ::tflite::AllOpsResolver resolver;
+  const TfLiteRegistration* registration =
+      resolver.FindOp("TFLite_Detection_PostProcess");
+  TF_LITE_MICRO_EXPECT_NE(nullptr, registration);
+  micro::KernelRunner runner(*registration, tensors, 7,
+                             IntArrayFromInts(inputs_array_data),
+                             IntArrayFromInts(outputs_array_data), nullptr,
+                             micro_test::reporter);
+  const unsigned char* init_data = use_regular_nms
+                                       ? kManyAnchorsRegularNmsOptions
+                                       : kManyAnchorsFastNmsOptions;
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, runner.InitAndPrepare(reinterpret_cast<const char*>(init_data),
+                                       sizeof(kManyAnchorsFastNmsOptions)));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError, runner.Invoke());
+}
+
 }  // namespace
 }  // namespace testing
 }  // namespace tflite
@@ -476,4 +808,45 @@ TF_LITE_MICRO_TEST(
       /* input3 min/max */ 0.0, 100.5);
 }
 
+TF_LITE_MICRO_TEST(DetectionPostprocessFastNMSManyAnchors) {
+  tflite::testing::TestDetectionPostprocessManyAnchors<float>(
+      /* Use regular NMS: */ false, nullptr);
+}
+
+TF_LITE_MICRO_TEST(DetectionPostprocessRegularNMSManyAnchors) {
+  tflite::testing::TestDetectionPostprocessManyAnchors<float>(
+      /* Use regular NMS: */ true, nullptr);
+}
+
+TF_LITE_MICRO_TEST(DetectionPostprocessRegularNMSManyAnchorsThreaded) {
+  tflite::PthreadThreadPool thread_pool(2);
+  tflite::testing::TestDetectionPostprocessManyAnchors<float>(
+      /* Use regular NMS: */ true, &thread_pool);
+}
+
+TF_LITE_MICRO_TEST(DetectionPostprocessUInt8FastNMSManyAnchors) {
+  tflite::testing::TestDetectionPostprocessManyAnchors<uint8_t>(
+      /* Use regular NMS: */ false, nullptr);
+}
+
+TF_LITE_MICRO_TEST(DetectionPostprocessInt8FastNMSManyAnchors) {
+  tflite::testing::TestDetectionPostprocessManyAnchors<int8_t>(
+      /* Use regular NMS: */ false, nullptr);
+}
+
+TF_LITE_MICRO_TEST(DetectionPostprocessInt8RegularNMSManyAnchors) {
+  tflite::testing::TestDetectionPostprocessManyAnchors<int8_t>(
+      /* Use regular NMS: */ true, nullptr);
+}
+
+TF_LITE_MICRO_TEST(DetectionPostprocessFastNMSRejectsInvalidBox) {
+  tflite::testing::TestDetectionPostprocessRejectsInvalidBox(
+      /* Use regular NMS: */ false);
+}
+
+TF_LITE_MICRO_TEST(DetectionPostprocessRegularNMSRejectsInvalidBox) {
+  tflite::testing::TestDetectionPostprocessRejectsInvalidBox(
+      /* Use regular NMS: */ true);
+}
+
 TF_LITE_MICRO_TESTS_END
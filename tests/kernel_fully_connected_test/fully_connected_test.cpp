@@ -19,7 +19,9 @@ limitations under the License.
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/kernels/fully_connected.h"
 #include "tensorflow/lite/micro/kernels/kernel_runner.h"
+#include "tensorflow/lite/micro/linux/pthread_thread_pool.h"
 #include "tensorflow/lite/micro/micro_utils.h"
 #include "tensorflow/lite/micro/test_helpers.h"
 #include "tensorflow/lite/micro/testing/micro_test.h"
@@ -327,6 +329,208 @@ TfLiteStatus TestFullyConnectedQuantized(
                                        output_data);
 }
 
+// Runs an int8 fully connected op on deterministic data once single threaded
+// and once on |thread_pool|, and expects identical outputs.
+void TestFullyConnectedInt8MultiThreaded(int batches, int accum_depth,
+                                         int output_depth,
+                                         MicroThreadPool* thread_pool) {
+  constexpr int kMaxElements = 64 * 1024;
+  constexpr int kMaxOutputs = 1024;
+  TF_LITE_MICRO_EXPECT_LE(batches * accum_depth, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(output_depth * accum_depth, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(batches * output_depth, kMaxOutputs);
+
+  static int8_t input_data[kMaxElements];
+  static int8_t weights_data[kMaxElements];
+  static int32_t bias_data[kMaxOutputs];
+  static int8_t output_data[kMaxOutputs];
+  static int8_t threaded_output_data[kMaxOutputs];
+  for (int i = 0; i < batches * accum_depth; ++i) {
+    input_data[i] = static_cast<int8_t>((i * 37 + 11) % 256 - 128);
+  }
+  for (int i = 0; i < output_depth * accum_depth; ++i) {
+    weights_data[i] = static_cast<int8_t>((i * 53 + 7) % 255 - 127);
+  }
+  for (int i = 0; i < output_depth; ++i) {
+    bias_data[i] = (i * 977) % 4001 - 2000;
+  }
+
+  int input_dims_data[] = {2, batches, accum_depth};
+  int weights_dims_data[] = {2, output_depth, accum_depth};
+  int bias_dims_data[] = {1, output_depth};
+  int output_dims_data[] = {2, batches, output_depth};
+  int inputs_array_data[] = {3, 0, 1, 2};
+  int outputs_array_data[] = {1, 3};
+  TfLiteFullyConnectedParams builtin_data = {
+      kTfLiteActNone, kTfLiteFullyConnectedWeightsFormatDefault, false, false};
+
+  int8_t* outputs[] = {output_data, threaded_output_data};
+  MicroThreadPool* thread_pools[] = {nullptr, thread_pool};
+  for (int run = 0; run < 2; ++run) {
+    TfLiteTensor tensors[] = {
+        CreateQuantizedTensor(input_data, IntArrayFromInts(input_dims_data),
+                              0.05f, -3),
+        CreateQuantizedTensor(weights_data, IntArrayFromInts(weights_dims_data),
+                              0.01f, 0),
+        CreateTensor(bias_data, IntArrayFromInts(bias_dims_data)),
+        CreateQuantizedTensor(outputs[run], IntArrayFromInts(output_dims_data),
+                              2.0f, 5),
+    };
+    tensors[2].params.scale = 0.05f * 0.01f;
+
+    const TfLiteRegistration registration = Register_FULLY_CONNECTED();
+    micro::KernelRunner runner(registration, tensors, 4,
+                               IntArrayFromInts(inputs_array_data),
+                               IntArrayFromInts(outputs_array_data),
+                               reinterpret_cast<void*>(&builtin_data),
+                               micro_test::reporter);
+    runner.SetThreadPool(thread_pools[run]);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.InitAndPrepare());
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.Invoke());
+  }
+
+  for (int i = 0; i < batches * output_depth; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(output_data[i], threaded_output_data[i]);
+  }
+}
+
+// Runs an int8 fully connected op on |batches| samples at once and on every
+// sample by itself, and expects identical outputs.
+void TestFullyConnectedInt8BatchedMatchesSingleSamples(int batches,
+                                                       int accum_depth,
+                                                       int output_depth) {
+  constexpr int kMaxElements = 16 * 1024;
+  constexpr int kMaxOutputs = 1024;
+  TF_LITE_MICRO_EXPECT_LE(batches * accum_depth, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(output_depth * accum_depth, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(batches * output_depth, kMaxOutputs);
+
+  static int8_t input_data[kMaxElements];
+  static int8_t weights_data[kMaxElements];
+  static int32_t bias_data[kMaxOutputs];
+  static int8_t batched_output_data[kMaxOutputs];
+  static int8_t output_data[kMaxOutputs];
+  for (int i = 0; i < batches * accum_depth; ++i) {
+    input_data[i] = static_cast<int8_t>((i * 37 + 11) % 256 - 128);
+  }
+  for (int i = 0; i < output_depth * accum_depth; ++i) {
+    weights_data[i] = static_cast<int8_t>((i * 53 + 7) % 255 - 127);
+  }
+  for (int i = 0; i < output_depth; ++i) {
+    bias_data[i] = (i * 977) % 4001 - 2000;
+  }
+
+  int weights_dims_data[] = {2, output_depth, accum_depth};
+  int bias_dims_data[] = {1, output_depth};
+  int inputs_array_data[] = {3, 0, 1, 2};
+  int outputs_array_data[] = {1, 3};
+  TfLiteFullyConnectedParams builtin_data = {
+      kTfLiteActRelu, kTfLiteFullyConnectedWeightsFormatDefault, false, false};
+
+  // Run 0 covers the whole batch, run 1 + b only sample b.
+  for (int run = 0; run <= batches; ++run) {
+    const int run_batches = run == 0 ? batches : 1;
+    const int sample = run == 0 ? 0 : run - 1;
+    int input_dims_data[] = {2, run_batches, accum_depth};
+    int output_dims_data[] = {2, run_batches, output_depth};
+    int8_t* output =
+        run == 0 ? batched_output_data : output_data + sample * output_depth;
+    TfLiteTensor tensors[] = {
+        CreateQuantizedTensor(input_data + sample * accum_depth,
+                              IntArrayFromInts(input_dims_data), 0.05f, -3),
+        CreateQuantizedTensor(weights_data, IntArrayFromInts(weights_dims_data),
+                              0.01f, 0),
+        CreateTensor(bias_data, IntArrayFromInts(bias_dims_data)),
+        CreateQuantizedTensor(output, IntArrayFromInts(output_dims_data), 2.0f,
+                              5),
+    };
+    tensors[2].params.scale = 0.05f * 0.01f;
+
+    const TfLiteRegistration registration = Register_FULLY_CONNECTED();
+    micro::KernelRunner runner(registration, tensors, 4,
+                               IntArrayFromInts(inputs_array_data),
+                               IntArrayFromInts(outputs_array_data),
+                               reinterpret_cast<void*>(&builtin_data),
+                               micro_test::reporter);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.InitAndPrepare());
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.Invoke());
+  }
+
+  for (int i = 0; i < batches * output_depth; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(output_data[i], batched_output_data[i]);
+  }
+}
+
+// Runs an int8 fully connected op on deterministic data once with the weights
+// as stored and once with the packed kernel variant on |thread_pool|, and
+// expects identical outputs.
+void TestFullyConnectedInt8PackedMatchesUnpacked(
+    int batches, int accum_depth, int output_depth,
+    MicroThreadPool* thread_pool = nullptr) {
+  constexpr int kMaxElements = 16 * 1024;
+  constexpr int kMaxOutputs = 1024;
+  TF_LITE_MICRO_EXPECT_LE(batches * accum_depth, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(output_depth * accum_depth, kMaxElements);
+  TF_LITE_MICRO_EXPECT_LE(batches * output_depth, kMaxOutputs);
+
+  static int8_t input_data[kMaxElements];
+  static int8_t weights_data[kMaxElements];
+  static int32_t bias_data[kMaxOutputs];
+  static int8_t output_data[kMaxOutputs];
+  static int8_t packed_output_data[kMaxOutputs];
+  for (int i = 0; i < batches * accum_depth; ++i) {
+    input_data[i] = static_cast<int8_t>((i * 37 + 11) % 256 - 128);
+  }
+  for (int i = 0; i < output_depth * accum_depth; ++i) {
+    weights_data[i] = static_cast<int8_t>((i * 53 + 7) % 255 - 127);
+  }
+  for (int i = 0; i < output_depth; ++i) {
+    bias_data[i] = (i * 977) % 4001 - 2000;
+  }
+
+  int input_dims_data[] = {2, batches, accum_depth};
+  int weights_dims_data[] = {2, output_depth, accum_depth};
+  int bias_dims_data[] = {1, output_depth};
+  int output_dims_data[] = {2, batches, output_depth};
+  int inputs_array_data[] = {3, 0, 1, 2};
+  int outputs_array_data[] = {1, 3};
+  TfLiteFullyConnectedParams builtin_data = {
+      kTfLiteActRelu, kTfLiteFullyConnectedWeightsFormatDefault, false, false};
+
+  int8_t* outputs[] = {output_data, packed_output_data};
+  for (int run = 0; run < 2; ++run) {
+    TfLiteTensor tensors[] = {
+        CreateQuantizedTensor(input_data, IntArrayFromInts(input_dims_data),
+                              0.05f, -3),
+        CreateQuantizedTensor(weights_data, IntArrayFromInts(weights_dims_data),
+                              0.01f, 0),
+        CreateTensor(bias_data, IntArrayFromInts(bias_dims_data)),
+        CreateQuantizedTensor(outputs[run], IntArrayFromInts(output_dims_data),
+                              2.0f, 5),
+    };
+    tensors[2].params.scale = 0.05f * 0.01f;
+    // Only constant weights and bias get packed.
+    tensors[1].allocation_type = kTfLiteMmapRo;
+    tensors[2].allocation_type = kTfLiteMmapRo;
+
+    const TfLiteRegistration registration =
+        run == 0 ? Register_FULLY_CONNECTED()
+                 : Register_FULLY_CONNECTED_PACKED();
+    micro::KernelRunner runner(registration, tensors, 4,
+                               IntArrayFromInts(inputs_array_data),
+                               IntArrayFromInts(outputs_array_data),
+                               reinterpret_cast<void*>(&builtin_data),
+                               micro_test::reporter);
+    runner.SetThreadPool(run == 0 ? nullptr : thread_pool);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.InitAndPrepare());
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.Invoke());
+  }
+
+  for (int i = 0; i < batches * output_depth; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(output_data[i], packed_output_data[i]);
+  }
+}
+
 }  // namespace
 }  // namespace testing
 }  // namespace tflite
@@ -625,4 +829,31 @@ TF_LITE_MICRO_TEST(Representative1x64Input1x16OutputQuantizedInt8) {
       kTfLiteOk);
 }
 
+TF_LITE_MICRO_TEST(QuantizedInt8MultiThreadedMatchesSingleThreaded) {
+  tflite::PthreadThreadPool thread_pool(4);
+  tflite::testing::TestFullyConnectedInt8MultiThreaded(3, 512, 100,
+                                                       &thread_pool);
+}
+
+TF_LITE_MICRO_TEST(QuantizedInt8BatchedMatchesSingleSamples) {
+  // Seven samples cover a full block of four and a partial block of three,
+  // and the odd depth covers the scalar tail of the dot products.
+  tflite::testing::TestFullyConnectedInt8BatchedMatchesSingleSamples(7, 37, 10);
+  tflite::testing::TestFullyConnectedInt8BatchedMatchesSingleSamples(2, 64, 16);
+}
+
+TF_LITE_MICRO_TEST(QuantizedInt8PackedMatchesUnpacked) {
+  // Odd depth and output count leave partial packed chunks and blocks, and
+  // three samples cover both the paired and the single sample kernel.
+  tflite::testing::TestFullyConnectedInt8PackedMatchesUnpacked(3, 37, 10);
+  tflite::testing::TestFullyConnectedInt8PackedMatchesUnpacked(1, 64, 16);
+}
+
+TF_LITE_MICRO_TEST(QuantizedInt8PackedMultiThreadedMatchesUnpacked) {
+  tflite::PthreadThreadPool thread_pool(4);
+  // Enough samples to split the eight row blocks across threads.
+  tflite::testing::TestFullyConnectedInt8PackedMatchesUnpacked(32, 96, 30,
+                                                               &thread_pool);
+}
+
 TF_LITE_MICRO_TESTS_END
@@ -13,8 +13,13 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <cstdint>
+#include <limits>
+
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/mul.h"
 #include "tensorflow/lite/micro/kernels/kernel_runner.h"
 #include "tensorflow/lite/micro/test_helpers.h"
 #include "tensorflow/lite/micro/testing/micro_test.h"
@@ -121,6 +126,84 @@ void TestMulQuantized(const int* input1_dims_data, const float* input1_data,
                      output_dims_count, 1.0f, output_data);
 }
 
+// Runs the int8 kernel on pseudo random inputs of the given shapes and checks
+// that its output is identical to reference_integer_ops::BroadcastMul4DSlow.
+// With |in_place| the output is written over input 1, which must have the
+// output's shape.
+void TestMulInt8MatchesReference(const int* input1_dims_data,
+                                 const int* input2_dims_data,
+                                 const int* output_dims_data, bool in_place) {
+  constexpr int kMaxSize = 2 * 3 * 5 * 19;
+  const float input1_scale = 0.1f;
+  const int input1_zero_point = -10;
+  const float input2_scale = 0.04f;
+  const int input2_zero_point = 5;
+  const float output_scale = 0.3f;
+  const int output_zero_point = 7;
+
+  TfLiteIntArray* input1_dims = IntArrayFromInts(input1_dims_data);
+  TfLiteIntArray* input2_dims = IntArrayFromInts(input2_dims_data);
+  TfLiteIntArray* output_dims = IntArrayFromInts(output_dims_data);
+  const int input1_size = ElementCount(*input1_dims);
+  const int input2_size = ElementCount(*input2_dims);
+  const int output_size = ElementCount(*output_dims);
+  TFLITE_DCHECK_LE(input1_size, kMaxSize);
+  TFLITE_DCHECK_LE(input2_size, kMaxSize);
+  TFLITE_DCHECK_LE(output_size, kMaxSize);
+
+  int8_t input1_data[kMaxSize];
+  int8_t input2_data[kMaxSize];
+  int8_t output_data[kMaxSize];
+  uint32_t seed = 11;
+  for (int i = 0; i < input1_size; ++i) {
+    input1_data[i] = static_cast<int8_t>(NextRandom(&seed) >> 24);
+  }
+  for (int i = 0; i < input2_size; ++i) {
+    input2_data[i] = static_cast<int8_t>(NextRandom(&seed) >> 24);
+  }
+
+  // Same parameters as the kernel computes in Prepare.
+  ArithmeticParams params;
+  params.input1_offset = -input1_zero_point;
+  params.input2_offset = -input2_zero_point;
+  params.output_offset = output_zero_point;
+  QuantizeMultiplier(static_cast<double>(input1_scale * input2_scale) /
+                         static_cast<double>(output_scale),
+                     &params.output_multiplier, &params.output_shift);
+  params.quantized_activation_min = std::numeric_limits<int8_t>::min();
+  params.quantized_activation_max = std::numeric_limits<int8_t>::max();
+  int8_t expected[kMaxSize];
+  reference_integer_ops::BroadcastMul4DSlow(
+      params, RuntimeShape(input1_dims->size, input1_dims->data), input1_data,
+      RuntimeShape(input2_dims->size, input2_dims->data), input2_data,
+      RuntimeShape(output_dims->size, output_dims->data), expected);
+
+  int8_t* output = in_place ? input1_data : output_data;
+  TfLiteTensor tensors[] = {
+      CreateQuantizedTensor(input1_data, input1_dims, input1_scale,
+                            input1_zero_point),
+      CreateQuantizedTensor(input2_data, input2_dims, input2_scale,
+                            input2_zero_point),
+      CreateQuantizedTensor(output, output_dims, output_scale,
+                            output_zero_point),
+  };
+  int inputs_array_data[] = {2, 0, 1};
+  int outputs_array_data[] = {1, 2};
+  TfLiteMulParams builtin_data = {
+      .activation = kTfLiteActNone,
+  };
+  const TfLiteRegistration registration = tflite::ops::micro::Register_MUL();
+  micro::KernelRunner runner(registration, tensors, 3,
+                             IntArrayFromInts(inputs_array_data),
+                             IntArrayFromInts(outputs_array_data),
+                             &builtin_data, micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.InitAndPrepare());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.Invoke());
+  for (int i = 0; i < output_size; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(expected[i], output[i]);
+  }
+}
+
 }  // namespace
 
 }  // namespace testing
@@ -230,4 +313,29 @@ TF_LITE_MICRO_TEST(BroadcastUInt8NoAcativationShouldMatchGolden) {
       output_data, kTfLiteActNone);
 }
 
+TF_LITE_MICRO_TEST(Int8BroadcastPatternsShouldMatchReference) {
+  const int full[] = {4, 2, 3, 5, 19};
+  const int scalar[] = {1, 1};
+  const int channels[] = {4, 1, 1, 1, 19};
+  const int squeeze[] = {4, 2, 1, 1, 19};
+  const int last_dim[] = {4, 2, 3, 5, 1};
+  const int rows[] = {4, 2, 3, 1, 19};
+  const int columns[] = {4, 1, 1, 5, 19};
+  const int generic1[] = {4, 2, 1, 5, 1};
+  const int generic2[] = {4, 1, 3, 1, 19};
+
+  // Same shapes, then every broadcast pattern with the broadcast input on
+  // either side, then patterns where both inputs broadcast.
+  tflite::testing::TestMulInt8MatchesReference(full, full, full, false);
+  tflite::testing::TestMulInt8MatchesReference(full, full, full, true);
+  const int* patterns[] = {scalar, channels, squeeze, last_dim};
+  for (const int* pattern : patterns) {
+    tflite::testing::TestMulInt8MatchesReference(full, pattern, full, false);
+    tflite::testing::TestMulInt8MatchesReference(full, pattern, full, true);
+    tflite::testing::TestMulInt8MatchesReference(pattern, full, full, false);
+  }
+  tflite::testing::TestMulInt8MatchesReference(rows, columns, full, false);
+  tflite::testing::TestMulInt8MatchesReference(generic1, generic2, full, false);
+}
+
 TF_LITE_MICRO_TESTS_END
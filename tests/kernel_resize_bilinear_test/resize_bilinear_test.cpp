@@ -0,0 +1,293 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/reference/resize_bilinear.h"
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/kernels/kernel_runner.h"
+#include "tensorflow/lite/micro/test_helpers.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+
+namespace tflite {
+namespace testing {
+namespace {
+
+TfLiteTensor TestCreateTensor(const float* data, TfLiteIntArray* dims) {
+  return CreateTensor(data, dims);
+}
+
+TfLiteTensor TestCreateTensor(const uint8_t* data, TfLiteIntArray* dims) {
+  return CreateQuantizedTensor(data, dims, 0, 255);
+}
+
+TfLiteTensor TestCreateTensor(const int8_t* data, TfLiteIntArray* dims) {
+  return CreateQuantizedTensor(data, dims, -128, 127);
+}
+
+// Input data expects a 4-D tensor of [batch, height, width, channels]
+// Output data should match input datas batch and channels
+// Expected sizes should be a 1-D tensor with 2 elements: new_height & new_width
+template <typename T>
+void TestResizeBilinear(const int* input_dims_data, const T* input_data,
+                        const int32_t* expected_size_data,
+                        const T* expected_output_data,
+                        const int* output_dims_data, T* output_data,
+                        bool align_corners = false,
+                        bool half_pixel_centers = false,
+                        float tolerance = 0.0f) {
+  TfLiteIntArray* input_dims = IntArrayFromInts(input_dims_data);
+
+  int expected_size_dims_data[] = {1, 2};
+  TfLiteIntArray* expected_size_dims =
+      IntArrayFromInts(expected_size_dims_data);
+
+  TfLiteIntArray* output_dims = IntArrayFromInts(output_dims_data);
+
+  const int output_dims_count = ElementCount(*output_dims);
+
+  constexpr int tensors_size = 3;
+  TfLiteTensor tensors[tensors_size] = {
+      TestCreateTensor(input_data, input_dims),
+      CreateTensor(expected_size_data, expected_size_dims),
+      TestCreateTensor(output_data, output_dims),
+  };
+
+  tensors[1].allocation_type = kTfLiteMmapRo;
+
+  TfLiteResizeBilinearParams builtin_data = {align_corners,
+                                             half_pixel_centers};
+
+  int inputs_array_data[] = {2, 0, 1};
+  TfLiteIntArray* inputs_array = IntArrayFromInts(inputs_array_data);
+  int outputs_array_data[] = {1, 2};
+  TfLiteIntArray* outputs_array = IntArrayFromInts(outputs_array_data);
+
+  const TfLiteRegistration registration =
+      tflite::ops::micro::Register_RESIZE_BILINEAR();
+  micro::KernelRunner runner(registration, tensors, tensors_size, inputs_array,
+                             outputs_array, &builtin_data,
+                             micro_test::reporter);
+
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.InitAndPrepare());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.Invoke());
+
+  // compare results
+  for (int i = 0; i < output_dims_count; ++i) {
+    TF_LITE_MICRO_EXPECT_NEAR(expected_output_data[i], output_data[i],
+                              tolerance);
+  }
+}
+
+// Resizes a [2, 5, 7, 6] tensor of pseudo random values to [2, 9, 13, 6],
+// which is large enough for the vectorized loops and their tails, and checks
+// the result against the reference kernel.
+template <typename T>
+void TestResizeBilinearMatchesReference(bool align_corners,
+                                        bool half_pixel_centers,
+                                        float tolerance) {
+  const int input_dims[] = {4, 2, 5, 7, 6};
+  const int output_dims[] = {4, 2, 9, 13, 6};
+  const int32_t size_data[] = {9, 13};
+  constexpr int input_size = 2 * 5 * 7 * 6;
+  constexpr int output_size = 2 * 9 * 13 * 6;
+
+  T input_data[input_size];
+  uint32_t state = 12345;
+  for (int i = 0; i < input_size; ++i) {
+    state = state * 1103515245u + 12345u;
+    input_data[i] = static_cast<T>(state >> 16);
+  }
+
+  tflite::ResizeBilinearParams op_params;
+  op_params.align_corners = align_corners;
+  op_params.half_pixel_centers = half_pixel_centers;
+  T expected_output_data[output_size];
+  const int size_dims[] = {1, 2};
+  reference_ops::ResizeBilinearInteger(
+      op_params, RuntimeShape(4, input_dims + 1), input_data,
+      RuntimeShape(1, size_dims + 1), size_data,
+      RuntimeShape(4, output_dims + 1), expected_output_data);
+
+  T output_data[output_size];
+  TestResizeBilinear(input_dims, input_data, size_data, expected_output_data,
+                     output_dims, output_data, align_corners,
+                     half_pixel_centers, tolerance);
+}
+
+template <>
+void TestResizeBilinearMatchesReference<float>(bool align_corners,
+                                               bool half_pixel_centers,
+                                               float tolerance) {
+  const int input_dims[] = {4, 2, 5, 7, 6};
+  const int output_dims[] = {4, 2, 9, 13, 6};
+  const int32_t size_data[] = {9, 13};
+  constexpr int input_size = 2 * 5 * 7 * 6;
+  constexpr int output_size = 2 * 9 * 13 * 6;
+
+  float input_data[input_size];
+  uint32_t state = 12345;
+  for (int i = 0; i < input_size; ++i) {
+    state = state * 1103515245u + 12345u;
+    input_data[i] = static_cast<float>((state >> 16) % 2001) / 100.0f - 10.0f;
+  }
+
+  tflite::ResizeBilinearParams op_params;
+  op_params.align_corners = align_corners;
+  op_params.half_pixel_centers = half_pixel_centers;
+  float expected_output_data[output_size];
+  const int size_dims[] = {1, 2};
+  reference_ops::ResizeBilinear(op_params, RuntimeShape(4, input_dims + 1),
+                                input_data, RuntimeShape(1, size_dims + 1),
+                                size_data, RuntimeShape(4, output_dims + 1),
+                                expected_output_data);
+
+  float output_data[output_size];
+  TestResizeBilinear(input_dims, input_data, size_data, expected_output_data,
+                     output_dims, output_data, align_corners,
+                     half_pixel_centers, tolerance);
+}
+
+}  // namespace
+}  // namespace testing
+}  // namespace tflite
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(HorizontalResize) {
+  const int input_dims[] = {4, 1, 1, 2, 1};
+  const float input_data[] = {3, 6};
+  const int32_t expected_size_data[] = {1, 3};
+  const float expected_output_data[] = {3, 5, 6};
+  const int output_dims[] = {4, 1, 1, 3, 1};
+  float output_data[3];
+
+  tflite::testing::TestResizeBilinear<float>(
+      input_dims, input_data, expected_size_data, expected_output_data,
+      output_dims, output_data, false, false, 1e-5f);
+}
+TF_LITE_MICRO_TEST(HorizontalResizeUInt8) {
+  const int input_dims[] = {4, 1, 1, 2, 1};
+  const uint8_t input_data[] = {3, 6};
+  const int32_t expected_size_data[] = {1, 3};
+  const uint8_t expected_output_data[] = {3, 5, 6};
+  const int output_dims[] = {4, 1, 1, 3, 1};
+  uint8_t output_data[3];
+
+  tflite::testing::TestResizeBilinear<uint8_t>(
+      input_dims, input_data, expected_size_data, expected_output_data,
+      output_dims, output_data);
+}
+TF_LITE_MICRO_TEST(HorizontalResizeInt8) {
+  const int input_dims[] = {4, 1, 1, 2, 1};
+  const int8_t input_data[] = {-3, 6};
+  const int32_t expected_size_data[] = {1, 3};
+  const int8_t expected_output_data[] = {-3, 3, 6};
+  const int output_dims[] = {4, 1, 1, 3, 1};
+  int8_t output_data[3];
+
+  tflite::testing::TestResizeBilinear<int8_t>(
+      input_dims, input_data, expected_size_data, expected_output_data,
+      output_dims, output_data);
+}
+TF_LITE_MICRO_TEST(VerticalResize) {
+  const int input_dims[] = {4, 1, 2, 1, 1};
+  const float input_data[] = {3, 9};
+  const int32_t expected_size_data[] = {3, 1};
+  const float expected_output_data[] = {3, 7, 9};
+  const int output_dims[] = {4, 1, 3, 1, 1};
+  float output_data[3];
+
+  tflite::testing::TestResizeBilinear<float>(
+      input_dims, input_data, expected_size_data, expected_output_data,
+      output_dims, output_data, false, false, 1e-5f);
+}
+TF_LITE_MICRO_TEST(TwoDimensionalResizeUInt8) {
+  const int input_dims[] = {4, 1, 2, 2, 1};
+  const uint8_t input_data[] = {3, 6, 9, 12};
+  const int32_t expected_size_data[] = {3, 3};
+  const uint8_t expected_output_data[] = {3, 5, 6, 7, 9, 10, 9, 11, 12};
+  const int output_dims[] = {4, 1, 3, 3, 1};
+  uint8_t output_data[9];
+
+  tflite::testing::TestResizeBilinear<uint8_t>(
+      input_dims, input_data, expected_size_data, expected_output_data,
+      output_dims, output_data);
+}
+TF_LITE_MICRO_TEST(TwoDimensionalResizeWithTwoBatchesInt8) {
+  const int input_dims[] = {4, 2, 2, 2, 1};
+  const int8_t input_data[] = {3, 6, 9, 12, 4, 10, 10, 16};
+  const int32_t expected_size_data[] = {3, 3};
+  const int8_t expected_output_data[] = {3, 5, 6,  7,  9,  10, 9,  11, 12,
+                                         4, 8, 10, 8,  12, 14, 10, 14, 16};
+  const int output_dims[] = {4, 2, 3, 3, 1};
+  int8_t output_data[18];
+
+  tflite::testing::TestResizeBilinear<int8_t>(
+      input_dims, input_data, expected_size_data, expected_output_data,
+      output_dims, output_data);
+}
+TF_LITE_MICRO_TEST(ThreeDimensionalResize) {
+  const int input_dims[] = {4, 1, 2, 2, 2};
+  const float input_data[] = {3, 4, 6, 10, 9, 10, 12, 16};
+  const int32_t expected_size_data[] = {3, 3};
+  const float expected_output_data[] = {3, 4,  5,  8,  6,  10, 7,  8,  9,
+                                        12, 10, 14, 9, 10, 11, 14, 12, 16};
+  const int output_dims[] = {4, 1, 3, 3, 2};
+  float output_data[18];
+
+  tflite::testing::TestResizeBilinear<float>(
+      input_dims, input_data, expected_size_data, expected_output_data,
+      output_dims, output_data, false, false, 1e-5f);
+}
+TF_LITE_MICRO_TEST(AlignCorners) {
+  const int input_dims[] = {4, 1, 2, 2, 1};
+  const float input_data[] = {1, 2, 3, 4};
+  const int32_t expected_size_data[] = {3, 3};
+  const float expected_output_data[] = {1, 1.5, 2, 2, 2.5, 3, 3, 3.5, 4};
+  const int output_dims[] = {4, 1, 3, 3, 1};
+  float output_data[9];
+
+  tflite::testing::TestResizeBilinear<float>(
+      input_dims, input_data, expected_size_data, expected_output_data,
+      output_dims, output_data, /*align_corners=*/true,
+      /*half_pixel_centers=*/false, 1e-5f);
+}
+TF_LITE_MICRO_TEST(HalfPixelCenters) {
+  const int input_dims[] = {4, 1, 2, 2, 1};
+  const float input_data[] = {1, 2, 3, 4};
+  const int32_t expected_size_data[] = {3, 3};
+  const float expected_output_data[] = {1, 1.5, 2, 2, 2.5, 3, 3, 3.5, 4};
+  const int output_dims[] = {4, 1, 3, 3, 1};
+  float output_data[9];
+
+  tflite::testing::TestResizeBilinear<float>(
+      input_dims, input_data, expected_size_data, expected_output_data,
+      output_dims, output_data, /*align_corners=*/false,
+      /*half_pixel_centers=*/true, 1e-5f);
+}
+TF_LITE_MICRO_TEST(LargeResizeMatchesReference) {
+  for (int mode = 0; mode < 3; ++mode) {
+    const bool align_corners = mode == 1;
+    const bool half_pixel_centers = mode == 2;
+    tflite::testing::TestResizeBilinearMatchesReference<float>(
+        align_corners, half_pixel_centers, 1e-4f);
+    tflite::testing::TestResizeBilinearMatchesReference<uint8_t>(
+        align_corners, half_pixel_centers, 0.0f);
+    tflite::testing::TestResizeBilinearMatchesReference<int8_t>(
+        align_corners, half_pixel_centers, 0.0f);
+  }
+}
+
+TF_LITE_MICRO_TESTS_END
@@ -13,9 +13,15 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <cstring>
+
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/micro/kernels/kernel_runner.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
 #include "tensorflow/lite/micro/test_helpers.h"
 #include "tensorflow/lite/micro/testing/micro_test.h"
 namespace tflite {
@@ -486,7 +492,9 @@ void ValidateSVDFGoldens(const int batch_size, const int num_units,
                          TfLiteFusedActivation activaiton,
                          const T* input_sequences_data,
                          const int input_sequences_len, T* output_data,
-                         const T* expected_output, float tolerance = 1e-5f) {
+                         const T* expected_output, float tolerance = 1e-5f,
+                         const TfLiteRegistration& registration =
+                             Register_SVDF()) {
   TfLiteSVDFParams params;
   params.rank = rank;
   params.activation = activaiton;
@@ -497,7 +505,6 @@ void ValidateSVDFGoldens(const int batch_size, const int num_units,
   int outputs_array_data[] = {1, 5};
   TfLiteIntArray* outputs_array = IntArrayFromInts(outputs_array_data);
 
-  const TfLiteRegistration registration = Register_SVDF();
   micro::KernelRunner runner(registration, tensors, tensor_count, inputs_array,
                              outputs_array, &params, micro_test::reporter);
 
@@ -600,7 +607,8 @@ inline void TestIntegerSVDF(
     int8_t* output_data, float output_scale, int output_zero_point,
     const float* input_sequences_data, int8_t* input_sequences_quantized,
     const int input_sequences_len, const float* golden_output,
-    int8_t* golden_output_quantized, int golden_output_len) {
+    int8_t* golden_output_quantized, int golden_output_len,
+    const TfLiteRegistration& registration = Register_SVDF()) {
   const int num_filters = num_units * rank;
 
   const int input_dims_arg[] = {2, batch_size, input_size};
@@ -650,7 +658,158 @@ inline void TestIntegerSVDF(
   ValidateSVDFGoldens(batch_size, num_units, input_size, rank, tensors,
                       tensor_count, activation, input_sequences_quantized,
                       input_sequences_len, output_data, golden_output_quantized,
-                      /*tolerance*/ 1);
+                      /*tolerance*/ 1, registration);
+}
+
+// Deterministic pseudo random values in [min, max].
+int RandomInRange(uint32_t* seed, int min, int max) {
+  return min + static_cast<int>((NextRandom(seed) >> 8) % (max - min + 1));
+}
+
+// Runs |num_steps| invocations of the int8 SVDF kernel and of its ring variant
+// on random data, and checks that both match a plain implementation that
+// shifts the state, exactly, for every output of every step.
+void TestIntegerSVDFRingMatchesReference(int batch_size, int num_units,
+                                         int input_size, int memory_size,
+                                         int rank, int num_steps) {
+  constexpr int kMaxBatches = 3;
+  constexpr int kMaxUnits = 5;
+  constexpr int kMaxRank = 2;
+  constexpr int kMaxFilters = kMaxUnits * kMaxRank;
+  constexpr int kMaxInputSize = 40;
+  constexpr int kMaxMemorySize = 12;
+  TFLITE_DCHECK_LE(batch_size, kMaxBatches);
+  TFLITE_DCHECK_LE(num_units, kMaxUnits);
+  TFLITE_DCHECK_LE(rank, kMaxRank);
+  TFLITE_DCHECK_LE(input_size, kMaxInputSize);
+  TFLITE_DCHECK_LE(memory_size, kMaxMemorySize);
+  const int num_filters = num_units * rank;
+
+  const float input_scale = 0.05f;
+  const int input_zero_point = 3;
+  const float feature_weights_scale = 0.01f;
+  const float time_weights_scale = 0.5f / INT16_MAX;
+  const float activation_state_scale = 0.002f;
+  const float output_scale = 0.05f;
+  const int output_zero_point = -4;
+
+  uint32_t seed = 1;
+  int8_t input[kMaxBatches * kMaxInputSize];
+  int8_t feature_weights[kMaxFilters * kMaxInputSize];
+  int16_t time_weights[kMaxFilters * kMaxMemorySize];
+  int32_t bias[kMaxUnits];
+  for (int i = 0; i < num_filters * input_size; ++i) {
+    feature_weights[i] = RandomInRange(&seed, INT8_MIN, INT8_MAX);
+  }
+  for (int i = 0; i < num_filters * memory_size; ++i) {
+    time_weights[i] = RandomInRange(&seed, INT16_MIN, INT16_MAX);
+  }
+  for (int i = 0; i < num_units; ++i) {
+    bias[i] = RandomInRange(&seed, -(1 << 20), 1 << 20);
+  }
+
+  const int input_dims_data[] = {2, batch_size, input_size};
+  const int feature_weights_dims_data[] = {2, num_filters, input_size};
+  const int time_weights_dims_data[] = {2, num_filters, memory_size};
+  const int bias_dims_data[] = {1, num_units};
+  const int activation_state_dims_data[] = {2, batch_size,
+                                            memory_size * num_filters};
+  const int output_dims_data[] = {2, batch_size, num_units};
+  int inputs_array_data[] = {5, 0, 1, 2, 3, 4};
+  int outputs_array_data[] = {1, 5};
+  TfLiteSVDFParams params;
+  params.rank = rank;
+  params.activation = kTfLiteActNone;
+
+  int16_t state_data[kMaxBatches * kMaxFilters * kMaxMemorySize] = {};
+  int16_t ring_state_data[kMaxBatches * kMaxFilters * kMaxMemorySize] = {};
+  int8_t output_data[kMaxBatches * kMaxUnits];
+  int8_t ring_output_data[kMaxBatches * kMaxUnits];
+  TfLiteTensor tensors[] = {
+      CreateQuantizedTensor(input, IntArrayFromInts(input_dims_data),
+                            input_scale, input_zero_point),
+      CreateQuantizedTensor(feature_weights,
+                            IntArrayFromInts(feature_weights_dims_data),
+                            feature_weights_scale, 0),
+      CreateQuantizedTensor(time_weights,
+                            IntArrayFromInts(time_weights_dims_data),
+                            time_weights_scale, 0),
+      CreateQuantizedTensor(bias, IntArrayFromInts(bias_dims_data),
+                            activation_state_scale * time_weights_scale, 0),
+      CreateQuantizedTensor(state_data,
+                            IntArrayFromInts(activation_state_dims_data),
+                            activation_state_scale, 0, /*is_variable=*/true),
+      CreateQuantizedTensor(output_data, IntArrayFromInts(output_dims_data),
+                            output_scale, output_zero_point)};
+  constexpr int tensor_count = sizeof(tensors) / sizeof(tensors[0]);
+  TfLiteTensor ring_tensors[tensor_count];
+  memcpy(ring_tensors, tensors, sizeof(tensors));
+  ring_tensors[4].data.i16 = ring_state_data;
+  ring_tensors[5].data.int8 = ring_output_data;
+
+  const TfLiteRegistration registration = Register_SVDF();
+  const TfLiteRegistration ring_registration = Register_SVDF_RING();
+  micro::KernelRunner runner(registration, tensors, tensor_count,
+                             IntArrayFromInts(inputs_array_data),
+                             IntArrayFromInts(outputs_array_data), &params,
+                             micro_test::reporter);
+  micro::KernelRunner ring_runner(ring_registration, ring_tensors,
+                                  tensor_count,
+                                  IntArrayFromInts(inputs_array_data),
+                                  IntArrayFromInts(outputs_array_data), &params,
+                                  micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.InitAndPrepare());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, ring_runner.InitAndPrepare());
+
+  int32_t feature_multiplier;
+  int feature_shift;
+  QuantizeMultiplier(static_cast<double>(input_scale * feature_weights_scale /
+                                         activation_state_scale),
+                     &feature_multiplier, &feature_shift);
+  int32_t output_multiplier;
+  int output_shift;
+  QuantizeMultiplier(static_cast<double>(activation_state_scale *
+                                         time_weights_scale / output_scale),
+                     &output_multiplier, &output_shift);
+
+  int16_t state[kMaxBatches * kMaxFilters * kMaxMemorySize] = {};
+  for (int step = 0; step < num_steps; ++step) {
+    for (int i = 0; i < batch_size * input_size; ++i) {
+      input[i] = RandomInRange(&seed, INT8_MIN, INT8_MAX);
+    }
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, runner.Invoke());
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, ring_runner.Invoke());
+
+    for (int b = 0; b < batch_size; ++b) {
+      for (int unit = 0; unit < num_units; ++unit) {
+        int32_t sum = bias[unit];
+        for (int f = unit * rank; f < (unit + 1) * rank; ++f) {
+          int16_t* row = state + (b * num_filters + f) * memory_size;
+          memmove(row, row + 1, (memory_size - 1) * sizeof(int16_t));
+          int32_t dot = 0;
+          for (int c = 0; c < input_size; ++c) {
+            dot += feature_weights[f * input_size + c] *
+                   (input[b * input_size + c] - input_zero_point);
+          }
+          dot = MultiplyByQuantizedMultiplier(dot, feature_multiplier,
+                                              feature_shift);
+          row[memory_size - 1] = static_cast<int16_t>(
+              std::min<int32_t>(std::max<int32_t>(dot, INT16_MIN), INT16_MAX));
+          for (int j = 0; j < memory_size; ++j) {
+            sum += time_weights[f * memory_size + j] * row[j];
+          }
+        }
+        int32_t expected = MultiplyByQuantizedMultiplier(sum, output_multiplier,
+                                                         output_shift) +
+                           output_zero_point;
+        expected =
+            std::min<int32_t>(std::max<int32_t>(expected, INT8_MIN), INT8_MAX);
+        TF_LITE_MICRO_EXPECT_EQ(expected, output_data[b * num_units + unit]);
+        TF_LITE_MICRO_EXPECT_EQ(expected,
+                                ring_output_data[b * num_units + unit]);
+      }
+    }
+  }
 }
 
 }  // namespace
@@ -925,4 +1084,71 @@ TF_LITE_MICRO_TEST(SvdfQuantized1x16Input64x1OutputReluShouldMatchGolden) {
       sizeof(tflite::testing::golden_output_relu_16x1x1) / sizeof(float));
 }
 
+TF_LITE_MICRO_TEST(SvdfQuantized2x2Input2x4OutputRingShouldMatchGolden) {
+  constexpr int batch_size = 2;
+  constexpr int num_units = 4;
+  constexpr int input_size = 2;
+  constexpr int memory_size = 10;
+  constexpr int rank = 2;
+  constexpr int num_filters = num_units * rank;
+
+  const int input_size_dims_count = batch_size * input_size;
+
+  const int activation_state_dims_count =
+      batch_size * memory_size * num_filters;
+
+  const int output_dims_count = batch_size * num_units;
+  int8_t output_data[output_dims_count];
+
+  float input_scale = 2.5f / INT8_MAX;              // Range is [-2.5, 2.5]
+  float feature_weights_scale = 1.f / INT8_MAX;     // Range is [-1, 1]
+  float time_weights_scale = 1.f / INT16_MAX;       // Range is [-1, 1]
+  float activation_state_scale = 16.f / INT16_MAX;  // Range is [-16, 16]
+  float output_scale = 1.f / INT8_MAX;              // Range is [-1, 1]
+
+  int input_zero_point = 0;
+  int output_zero_point = 0;
+
+  int8_t input_quantized[input_size_dims_count];
+  int8_t input_sequences_quantized[sizeof(tflite::testing::input_data_2x2x10) /
+                                   sizeof(float)];
+  int8_t feature_weights_quantized
+      [sizeof(tflite::testing::feature_weights_data_2x2x10) / sizeof(float)];
+  int16_t
+      time_weights_quantized[sizeof(tflite::testing::time_weights_data_2x2x10) /
+                             sizeof(float)];
+  int16_t activation_state_quantized[activation_state_dims_count];
+  int32_t
+      bias_quantized[sizeof(tflite::testing::bias_data_2x2x10) / sizeof(float)];
+  int8_t golden_quantized[sizeof(tflite::testing::golden_output_2x2x10) /
+                          sizeof(float)];
+
+  tflite::testing::TestIntegerSVDF(
+      batch_size, num_units, input_size, memory_size, rank, kTfLiteActRelu,
+      input_quantized, input_scale, input_zero_point,
+      tflite::testing::feature_weights_data_2x2x10, feature_weights_quantized,
+      feature_weights_scale, tflite::testing::time_weights_data_2x2x10,
+      time_weights_quantized, time_weights_scale,
+      tflite::testing::bias_data_2x2x10, bias_quantized,
+      tflite::testing::initial_activation_state_data_2x2x10,
+      activation_state_quantized, activation_state_scale, output_data,
+      output_scale, output_zero_point, tflite::testing::input_data_2x2x10,
+      input_sequences_quantized,
+      sizeof(tflite::testing::input_data_2x2x10) / sizeof(float),
+      tflite::testing::golden_output_2x2x10, golden_quantized,
+      sizeof(tflite::testing::golden_output_2x2x10) / sizeof(float),
+      tflite::Register_SVDF_RING());
+}
+
+TF_LITE_MICRO_TEST(SvdfQuantizedRingMatchesReferenceAcrossWraps) {
+  // Three batches leave a partial batch block, 37 inputs leave a tail after
+  // the vector loops, and 23 steps wrap the ring twice.
+  tflite::testing::TestIntegerSVDFRingMatchesReference(
+      /*batch_size=*/3, /*num_units=*/5, /*input_size=*/37,
+      /*memory_size=*/10, /*rank=*/2, /*num_steps=*/23);
+  tflite::testing::TestIntegerSVDFRingMatchesReference(
+      /*batch_size=*/1, /*num_units=*/4, /*input_size=*/16,
+      /*memory_size=*/12, /*rank=*/1, /*num_steps=*/13);
+}
+
 TF_LITE_MICRO_TESTS_END
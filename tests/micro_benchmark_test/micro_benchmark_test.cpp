@@ -0,0 +1,136 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/benchmarks/micro_benchmark.h"
+
+#include <cstring>
+
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+
+namespace {
+
+// Suite whose clock only moves when the benchmarked function advances it.
+class FakeClockSuite : public MicroBenchmarkSuite {
+ public:
+  FakeClockSuite(tflite::ErrorReporter* reporter,
+                 const MicroBenchmarkOptions& options)
+      : MicroBenchmarkSuite(reporter, options) {}
+
+  void Advance(uint64_t ns) { now_ns_ += ns; }
+
+ protected:
+  uint64_t GetTimeNanos() override { return now_ns_; }
+
+ private:
+  uint64_t now_ns_ = 0;
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+constexpr uint64_t kMillis = 1000000;
+
+// Long enough for the 100 tick floor of a millisecond platform timer, so that
+// the batch sizes below do not depend on the platform.
+MicroBenchmarkOptions TestOptions() {
+  MicroBenchmarkOptions options;
+  options.warmup_calls = 0;
+  options.min_sample_ns = 100 * kMillis;
+  options.min_time_ns = 0;
+  return options;
+}
+
+}  // namespace
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(TestReportsLatencyPercentiles) {
+  tflite::MicroErrorReporter reporter;
+  MicroBenchmarkOptions options = TestOptions();
+  options.min_samples = MicroBenchmarkSuite::kMaxSamples;
+  FakeClockSuite suite(&reporter, options);
+
+  // The first call sizes the batch, and then calls take 101 to 200 ms.
+  uint64_t call_ms = 100;
+  const MicroBenchmarkResult* result = suite.Run("Slow", [&]() {
+    suite.Advance(call_ms * kMillis);
+    ++call_ms;
+  });
+  TF_LITE_MICRO_EXPECT_NE(nullptr, result);
+  TF_LITE_MICRO_EXPECT_EQ(1, suite.num_results());
+  TF_LITE_MICRO_EXPECT_EQ(0, strcmp("Slow", result->name));
+  TF_LITE_MICRO_EXPECT_EQ(MicroBenchmarkSuite::kMaxSamples, result->samples);
+  TF_LITE_MICRO_EXPECT_EQ(1, result->calls_per_sample);
+  TF_LITE_MICRO_EXPECT_EQ(101 * kMillis, result->min_ns);
+  TF_LITE_MICRO_EXPECT_EQ(150500000u, result->median_ns);
+  TF_LITE_MICRO_EXPECT_EQ(190 * kMillis, result->p90_ns);
+  TF_LITE_MICRO_EXPECT_EQ(199 * kMillis, result->p99_ns);
+  TF_LITE_MICRO_EXPECT_EQ(200 * kMillis, result->max_ns);
+  TF_LITE_MICRO_EXPECT_EQ(150500000u, result->mean_ns);
+  TF_LITE_MICRO_EXPECT_NEAR(6.645f, result->ops_per_second, 0.001f);
+}
+
+TF_LITE_MICRO_TEST(TestBatchesFastCalls) {
+  tflite::MicroErrorReporter reporter;
+  FakeClockSuite suite(&reporter, TestOptions());
+
+  // Every call processes a batch of 4 items in 1 us.
+  const MicroBenchmarkResult* result =
+      suite.Run("Fast", [&]() { suite.Advance(1000); }, 4);
+  TF_LITE_MICRO_EXPECT_NE(nullptr, result);
+  TF_LITE_MICRO_EXPECT_EQ(10, result->samples);
+  TF_LITE_MICRO_EXPECT_EQ(100000, result->calls_per_sample);
+  TF_LITE_MICRO_EXPECT_EQ(1000u, result->min_ns);
+  TF_LITE_MICRO_EXPECT_EQ(1000u, result->median_ns);
+  TF_LITE_MICRO_EXPECT_EQ(1000u, result->p99_ns);
+  TF_LITE_MICRO_EXPECT_NEAR(4000000.0f, result->ops_per_second, 1.0f);
+}
+
+TF_LITE_MICRO_TEST(TestExportJsonAndCompareWithBaseline) {
+  tflite::MicroErrorReporter reporter;
+  FakeClockSuite suite(&reporter, TestOptions());
+  suite.Run("Fixed", [&]() { suite.Advance(2 * kMillis); });
+
+  const char* expected =
+      "{\"benchmarks\":[\n"
+      "{\"name\":\"Fixed\",\"samples\":10,\"calls_per_sample\":61,"
+      "\"min_ns\":2000000,\"median_ns\":2000000,\"p90_ns\":2000000,"
+      "\"p99_ns\":2000000,\"max_ns\":2000000,\"mean_ns\":2000000,"
+      "\"ops_per_second\":500.000}\n"
+      "]}\n";
+  char json[512];
+  const size_t length = suite.ExportJson(json, sizeof(json));
+  TF_LITE_MICRO_EXPECT_EQ(strlen(expected), length);
+  TF_LITE_MICRO_EXPECT_EQ(0, strcmp(expected, json));
+  TF_LITE_MICRO_EXPECT_EQ(length, suite.ExportJson(nullptr, 0));
+
+  // An identical run is not a regression.
+  TF_LITE_MICRO_EXPECT_EQ(0, suite.CompareWithBaseline(json, 0));
+
+  // Only the benchmark with the same name is compared, and 2 ms is 5.2%
+  // slower than 1.9 ms.
+  const char* baseline =
+      "{\"benchmarks\":[\n"
+      "{\"name\":\"FixedOld\",\"median_ns\":1},\n"
+      "{\"name\":\"Fixed\",\"samples\":10,\"median_ns\":1900000}\n"
+      "]}\n";
+  TF_LITE_MICRO_EXPECT_EQ(0, suite.CompareWithBaseline(baseline, 10));
+  TF_LITE_MICRO_EXPECT_EQ(1, suite.CompareWithBaseline(baseline, 5));
+
+  // Benchmarks missing from the baseline are reported but do not fail.
+  TF_LITE_MICRO_EXPECT_EQ(
+      0, suite.CompareWithBaseline("{\"benchmarks\":[]}", 0));
+}
+
+TF_LITE_MICRO_TESTS_END
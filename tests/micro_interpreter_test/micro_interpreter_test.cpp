@@ -15,14 +15,25 @@ limitations under the License.
 
 #include "tensorflow/lite/micro/micro_interpreter.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 
 #include "tensorflow/lite/core/api/flatbuffer_conversions.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/packed_weights.h"
 #include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/benchmarks/keyword_scrambled_model_data.h"
+#include "tensorflow/lite/micro/kernels/conv.h"
+#include "tensorflow/lite/micro/kernels/fully_connected.h"
+#include "tensorflow/lite/micro/linux/pthread_thread_pool.h"
+#include "tensorflow/lite/micro/memory_planner/optimal_memory_planner.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
 #include "tensorflow/lite/micro/micro_utils.h"
 #include "tensorflow/lite/micro/recording_micro_allocator.h"
 #include "tensorflow/lite/micro/test_helpers.h"
 #include "tensorflow/lite/micro/testing/micro_test.h"
+#include "tensorflow/lite/micro/testing/test_conv_model.h"
+#include "tensorflow/lite/schema/schema_utils.h"
 
 namespace tflite {
 namespace {
@@ -60,6 +71,13 @@ class MockProfiler : public tflite::Profiler {
   TF_LITE_REMOVE_VIRTUAL_DELETE
 };
 
+// Status returned by StoppingInvoke().
+TfLiteStatus stopping_invoke_status = kTfLiteOk;
+
+TfLiteStatus StoppingInvoke(TfLiteContext* context, TfLiteNode* node) {
+  return stopping_invoke_status;
+}
+
 }  // namespace
 }  // namespace tflite
 
@@ -380,13 +398,84 @@ TF_LITE_MICRO_TEST(InterpreterWithProfilerShouldProfileOps) {
 #endif
 }
 
+// Test that an interpreter with a tracer records every operator and the
+// Invoke() itself, in release builds as well.
+TF_LITE_MICRO_TEST(InterpreterWithTracerShouldTraceOps) {
+  const tflite::Model* model = tflite::testing::GetComplexMockModel();
+  TF_LITE_MICRO_EXPECT_NE(nullptr, model);
+
+  tflite::AllOpsResolver op_resolver = tflite::testing::GetOpResolver();
+
+  constexpr size_t allocator_buffer_size = 2048;
+  uint8_t allocator_buffer[allocator_buffer_size];
+  alignas(8) uint8_t trace_buffer[8 * sizeof(tflite::MicroTracer::Event)];
+  tflite::MicroTracer tracer(trace_buffer, sizeof(trace_buffer));
+  tflite::MicroInterpreter interpreter(model, op_resolver, allocator_buffer,
+                                       allocator_buffer_size,
+                                       micro_test::reporter);
+  interpreter.SetTracer(&tracer);
+
+  TF_LITE_MICRO_EXPECT_EQ(interpreter.AllocateTensors(), kTfLiteOk);
+  TF_LITE_MICRO_EXPECT_EQ(interpreter.Invoke(), kTfLiteOk);
+  TF_LITE_MICRO_EXPECT_EQ(4, tracer.num_events());
+  for (int i = 0; i < 3; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(i, tracer.GetEvent(i).node_index);
+    TF_LITE_MICRO_EXPECT_TRUE(tracer.GetEvent(i).registration != nullptr);
+  }
+  TF_LITE_MICRO_EXPECT_TRUE(tracer.GetEvent(3).registration == nullptr);
+  TF_LITE_MICRO_EXPECT_GT(tracer.ExportChromeTrace(nullptr, 0), 0u);
+
+  interpreter.SetTracer(nullptr);
+  TF_LITE_MICRO_EXPECT_EQ(interpreter.Invoke(), kTfLiteOk);
+  TF_LITE_MICRO_EXPECT_EQ(4, tracer.num_events());
+}
+
+// Test that an Invoke() that an operator fails or stops early is still
+// recorded, so that its operator events have an enclosing Invoke() event. This
+// tree has no kTfLiteAbort, so a status other than kTfLiteOk and kTfLiteError
+// (as returned by partial graph runs) stands in for it.
+TF_LITE_MICRO_TEST(InterpreterWithTracerShouldTraceStoppedInvokes) {
+  const tflite::Model* model = tflite::testing::GetComplexMockModel();
+  TF_LITE_MICRO_EXPECT_NE(nullptr, model);
+
+  TfLiteRegistration registration =
+      *tflite::testing::MockCustom::GetMutableRegistration();
+  registration.invoke = tflite::StoppingInvoke;
+  tflite::MicroMutableOpResolver<1> op_resolver;
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          op_resolver.AddCustom("mock_custom", &registration));
+
+  constexpr size_t allocator_buffer_size = 2048;
+  uint8_t allocator_buffer[allocator_buffer_size];
+  alignas(8) uint8_t trace_buffer[8 * sizeof(tflite::MicroTracer::Event)];
+  tflite::MicroTracer tracer(trace_buffer, sizeof(trace_buffer));
+  tflite::MicroInterpreter interpreter(model, op_resolver, allocator_buffer,
+                                       allocator_buffer_size,
+                                       micro_test::reporter);
+  interpreter.SetTracer(&tracer);
+  TF_LITE_MICRO_EXPECT_EQ(interpreter.AllocateTensors(), kTfLiteOk);
+
+  const TfLiteStatus statuses[] = {kTfLiteError, kTfLiteDelegateError};
+  for (TfLiteStatus status : statuses) {
+    tracer.Reset();
+    tflite::stopping_invoke_status = status;
+    TF_LITE_MICRO_EXPECT_EQ(interpreter.Invoke(), status);
+    TF_LITE_MICRO_EXPECT_EQ(2, tracer.num_events());
+    TF_LITE_MICRO_EXPECT_EQ(0, tracer.GetEvent(0).node_index);
+    TF_LITE_MICRO_EXPECT_TRUE(tracer.GetEvent(0).registration != nullptr);
+    TF_LITE_MICRO_EXPECT_TRUE(tracer.GetEvent(1).registration == nullptr);
+    TF_LITE_MICRO_EXPECT_GE(tracer.GetEvent(1).duration_ns,
+                            tracer.GetEvent(0).duration_ns);
+  }
+}
+
 TF_LITE_MICRO_TEST(TestIncompleteInitializationAllocationsWithSmallArena) {
   const tflite::Model* model = tflite::testing::GetComplexMockModel();
   TF_LITE_MICRO_EXPECT_NE(nullptr, model);
 
   tflite::AllOpsResolver op_resolver = tflite::testing::GetOpResolver();
 
-  constexpr size_t allocator_buffer_size = 512;
+  constexpr size_t allocator_buffer_size = 560;
   uint8_t allocator_buffer[allocator_buffer_size];
 
   tflite::RecordingMicroAllocator* allocator =
@@ -558,4 +647,761 @@ TF_LITE_MICRO_TEST(TestInterpreterMultipleInputs) {
   TF_LITE_MICRO_EXPECT_EQ(tflite::testing::MultipleInputs::freed_, true);
 }
 
+TF_LITE_MICRO_TEST(TestInterpreterWithThreadPoolMatchesSingleThreaded) {
+  const tflite::Model* model = tflite::GetModel(kTestConvModelData);
+  tflite::AllOpsResolver op_resolver;
+  tflite::PthreadThreadPool thread_pool(4);
+
+  constexpr size_t allocator_buffer_size = 16 * 1024;
+  uint8_t single_threaded_buffer[allocator_buffer_size];
+  uint8_t multi_threaded_buffer[allocator_buffer_size];
+  tflite::MicroInterpreter single_threaded(model, op_resolver,
+                                           single_threaded_buffer,
+                                           allocator_buffer_size,
+                                           micro_test::reporter);
+  tflite::MicroInterpreter multi_threaded(model, op_resolver,
+                                          multi_threaded_buffer,
+                                          allocator_buffer_size,
+                                          micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, multi_threaded.SetThreadPool(&thread_pool));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, single_threaded.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, multi_threaded.AllocateTensors());
+
+  // Kernels size their scratch buffers in AllocateTensors(), so the pool can't
+  // be swapped afterwards.
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError,
+                          single_threaded.SetThreadPool(&thread_pool));
+
+  TfLiteTensor* single_threaded_input = single_threaded.input(0);
+  TfLiteTensor* multi_threaded_input = multi_threaded.input(0);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteFloat32, single_threaded_input->type);
+  const size_t input_size = single_threaded_input->bytes / sizeof(float);
+  for (size_t i = 0; i < input_size; ++i) {
+    const float value = static_cast<float>((i * 37 + 11) % 251) / 251.0f;
+    single_threaded_input->data.f[i] = value;
+    multi_threaded_input->data.f[i] = value;
+  }
+
+  for (int invoke = 0; invoke < 3; ++invoke) {
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, single_threaded.Invoke());
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, multi_threaded.Invoke());
+
+    TfLiteTensor* expected = single_threaded.output(0);
+    TfLiteTensor* actual = multi_threaded.output(0);
+    TF_LITE_MICRO_EXPECT_EQ(expected->bytes, actual->bytes);
+    for (size_t i = 0; i < expected->bytes; ++i) {
+      TF_LITE_MICRO_EXPECT_EQ(expected->data.uint8[i], actual->data.uint8[i]);
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(TestInterpreterBatchedConvModelMatchesSingleSamples) {
+  constexpr int kBatchSize = 3;
+  const tflite::Model* model = tflite::GetModel(kTestConvModelData);
+  tflite::AllOpsResolver op_resolver;
+
+  constexpr size_t single_buffer_size = 16 * 1024;
+  constexpr size_t batched_buffer_size = 48 * 1024;
+  uint8_t single_buffer[single_buffer_size];
+  uint8_t batched_buffer[batched_buffer_size];
+  tflite::MicroInterpreter single(model, op_resolver, single_buffer,
+                                  single_buffer_size, micro_test::reporter);
+  tflite::MicroInterpreter batched(model, op_resolver, batched_buffer,
+                                   batched_buffer_size, micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError, batched.SetBatchSize(0));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, batched.SetBatchSize(kBatchSize));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, single.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, batched.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError, single.SetBatchSize(kBatchSize));
+
+  TfLiteTensor* single_input = single.input(0);
+  TfLiteTensor* batched_input = batched.input(0);
+  TF_LITE_MICRO_EXPECT_EQ(kBatchSize, batched_input->dims->data[0]);
+  TF_LITE_MICRO_EXPECT_EQ(kBatchSize * single_input->bytes,
+                          batched_input->bytes);
+  const size_t input_size = single_input->bytes / sizeof(float);
+  for (int b = 0; b < kBatchSize; ++b) {
+    for (size_t i = 0; i < input_size; ++i) {
+      batched_input->data.f[b * input_size + i] =
+          static_cast<float>((i * 37 + b * 101 + 11) % 251) / 251.0f;
+    }
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, batched.Invoke());
+
+  TfLiteTensor* single_output = single.output(0);
+  TfLiteTensor* batched_output = batched.output(0);
+  TF_LITE_MICRO_EXPECT_EQ(kBatchSize * single_output->bytes,
+                          batched_output->bytes);
+  for (int b = 0; b < kBatchSize; ++b) {
+    for (size_t i = 0; i < input_size; ++i) {
+      single_input->data.f[i] =
+          static_cast<float>((i * 37 + b * 101 + 11) % 251) / 251.0f;
+    }
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, single.Invoke());
+    for (size_t i = 0; i < single_output->bytes; ++i) {
+      TF_LITE_MICRO_EXPECT_EQ(
+          single_output->data.uint8[i],
+          batched_output->data.uint8[b * single_output->bytes + i]);
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(TestInterpreterBatchedKeywordModelMatchesSingleStreams) {
+  // Every sample of the batch carries its own SVDF state, so each one has to
+  // match a separate single-sample interpreter over several invocations.
+  constexpr int kBatchSize = 3;
+  constexpr int kInvocations = 3;
+  const tflite::Model* model = tflite::GetModel(g_keyword_scrambled_model_data);
+  tflite::AllOpsResolver op_resolver;
+
+  constexpr size_t single_buffer_size = 24 * 1024;
+  constexpr size_t batched_buffer_size = 64 * 1024;
+  uint8_t single_buffer[single_buffer_size];
+  uint8_t batched_buffer[batched_buffer_size];
+  tflite::MicroInterpreter batched(model, op_resolver, batched_buffer,
+                                   batched_buffer_size, micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, batched.SetBatchSize(kBatchSize));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, batched.AllocateTensors());
+  TfLiteTensor* batched_input = batched.input(0);
+  TfLiteTensor* batched_output = batched.output(0);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteInt16, batched_input->type);
+  const size_t input_size =
+      batched_input->bytes / sizeof(int16_t) / kBatchSize;
+  const size_t output_bytes = batched_output->bytes / kBatchSize;
+
+  uint8_t expected[kInvocations][kBatchSize][16];
+  TF_LITE_MICRO_EXPECT_LE(output_bytes, sizeof(expected[0][0]));
+  for (int b = 0; b < kBatchSize; ++b) {
+    tflite::MicroInterpreter single(model, op_resolver, single_buffer,
+                                    single_buffer_size, micro_test::reporter);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, single.AllocateTensors());
+    TfLiteTensor* single_input = single.input(0);
+    TfLiteTensor* single_output = single.output(0);
+    TF_LITE_MICRO_EXPECT_EQ(output_bytes, single_output->bytes);
+    for (int invoke = 0; invoke < kInvocations; ++invoke) {
+      for (size_t i = 0; i < input_size; ++i) {
+        single_input->data.i16[i] = static_cast<int16_t>(
+            ((i * 131 + b * 977 + invoke * 4099) % 65536) - 32768);
+      }
+      TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, single.Invoke());
+      for (size_t i = 0; i < output_bytes; ++i) {
+        expected[invoke][b][i] = single_output->data.uint8[i];
+      }
+    }
+  }
+
+  for (int invoke = 0; invoke < kInvocations; ++invoke) {
+    for (int b = 0; b < kBatchSize; ++b) {
+      for (size_t i = 0; i < input_size; ++i) {
+        batched_input->data.i16[b * input_size + i] = static_cast<int16_t>(
+            ((i * 131 + b * 977 + invoke * 4099) % 65536) - 32768);
+      }
+    }
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, batched.Invoke());
+    for (int b = 0; b < kBatchSize; ++b) {
+      for (size_t i = 0; i < output_bytes; ++i) {
+        TF_LITE_MICRO_EXPECT_EQ(expected[invoke][b][i],
+                                batched_output->data.uint8[b * output_bytes + i]);
+      }
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(TestInterpreterBatchesOnlyTensorsComputedFromInputs) {
+  constexpr int kBatchSize = 3;
+  tflite::AllOpsResolver op_resolver;
+
+  constexpr size_t allocator_buffer_size = 32 * 1024;
+  uint8_t allocator_buffer[allocator_buffer_size];
+  {
+    // The {2, 4} table has no leading 1, so it is shared by every sample, and
+    // so is its RESHAPE to {1, 8}. ADD broadcasts it over the batch.
+    tflite::MicroInterpreter interpreter(
+        tflite::testing::GetBatchSharedReshapeModel(), op_resolver,
+        allocator_buffer, allocator_buffer_size, micro_test::reporter);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.SetBatchSize(kBatchSize));
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+    TfLiteTensor* table = interpreter.input(0);
+    TfLiteTensor* features = interpreter.input(1);
+    TfLiteTensor* output = interpreter.output(0);
+    TF_LITE_MICRO_EXPECT_EQ(2, table->dims->data[0]);
+    TF_LITE_MICRO_EXPECT_EQ(8 * sizeof(float), table->bytes);
+    TF_LITE_MICRO_EXPECT_EQ(kBatchSize, features->dims->data[0]);
+    TF_LITE_MICRO_EXPECT_EQ(kBatchSize, output->dims->data[0]);
+    TF_LITE_MICRO_EXPECT_EQ(kBatchSize * 8 * sizeof(float), output->bytes);
+
+    for (int i = 0; i < 8; ++i) {
+      table->data.f[i] = 0.5f * i;
+    }
+    for (int i = 0; i < kBatchSize * 8; ++i) {
+      features->data.f[i] = 10.0f * (i / 8) - 3.0f * (i % 8);
+    }
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+    for (int i = 0; i < kBatchSize * 8; ++i) {
+      TF_LITE_MICRO_EXPECT_NEAR(10.0f * (i / 8) - 2.5f * (i % 8),
+                                output->data.f[i], 1e-5f);
+    }
+  }
+
+  // RESHAPE from {1, 1024} to {32, 32} has no leading 1 to carry the batch.
+  tflite::MicroInterpreter interpreter(
+      tflite::testing::GetInPlaceReshapeModel(), op_resolver, allocator_buffer,
+      allocator_buffer_size, micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.SetBatchSize(kBatchSize));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError, interpreter.AllocateTensors());
+}
+
+TF_LITE_MICRO_TEST(TestInterpreterFusesInPlaceOperators) {
+  const tflite::Model* model = tflite::testing::GetSimpleInPlaceModel();
+  tflite::AllOpsResolver op_resolver;
+  constexpr int kSize = tflite::testing::kSimpleInPlaceModelSize;
+
+  constexpr size_t allocator_buffer_size = 32 * 1024;
+  uint8_t allocator_buffer[allocator_buffer_size];
+  size_t unfused_used_bytes = 0;
+  {
+    tflite::MicroInterpreter interpreter(model, op_resolver, allocator_buffer,
+                                         allocator_buffer_size,
+                                         micro_test::reporter);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+    unfused_used_bytes = interpreter.arena_used_bytes();
+  }
+
+  tflite::MicroInterpreter interpreter(model, op_resolver, allocator_buffer,
+                                       allocator_buffer_size,
+                                       micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.SetOperatorFusion(true));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError, interpreter.SetOperatorFusion(false));
+
+  // Both operators run in place, so the three activations share one buffer
+  // instead of needing two at a time.
+  TF_LITE_MICRO_EXPECT_LE(interpreter.arena_used_bytes() + kSize * sizeof(float),
+                          unfused_used_bytes);
+  TfLiteTensor* input = interpreter.input(0);
+  TfLiteTensor* output = interpreter.output(0);
+  TF_LITE_MICRO_EXPECT(input->data.f == output->data.f);
+
+  float expected[kSize];
+  for (int i = 0; i < kSize; ++i) {
+    float value = static_cast<float>(i % 97) / 12.0f - 4.0f;
+    input->data.f[i] = value;
+    for (int op = 0; op < 2; ++op) {
+      const float relu6 = std::min(std::max(value + 3.0f, 0.0f), 6.0f);
+      value = value * relu6 / 6.0f;
+    }
+    expected[i] = value;
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+  for (int i = 0; i < kSize; ++i) {
+    TF_LITE_MICRO_EXPECT_NEAR(expected[i], output->data.f[i], 1e-5f);
+  }
+}
+
+TF_LITE_MICRO_TEST(TestInterpreterFusesReshapeAndActivations) {
+  const tflite::Model* model = tflite::testing::GetInPlaceReshapeModel();
+  tflite::AllOpsResolver op_resolver;
+  constexpr int kSize = tflite::testing::kSimpleInPlaceModelSize;
+
+  constexpr size_t allocator_buffer_size = 32 * 1024;
+  uint8_t allocator_buffer[allocator_buffer_size];
+  size_t unfused_used_bytes = 0;
+  {
+    tflite::MicroInterpreter interpreter(model, op_resolver, allocator_buffer,
+                                         allocator_buffer_size,
+                                         micro_test::reporter);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+    unfused_used_bytes = interpreter.arena_used_bytes();
+  }
+
+  tflite::MicroInterpreter interpreter(model, op_resolver, allocator_buffer,
+                                       allocator_buffer_size,
+                                       micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.SetOperatorFusion(true));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+
+  // RELU, RESHAPE and LOGISTIC all run in place, so the four tensors share
+  // one buffer instead of needing two at a time.
+  TF_LITE_MICRO_EXPECT_LE(interpreter.arena_used_bytes() + kSize * sizeof(float),
+                          unfused_used_bytes);
+  TfLiteTensor* input = interpreter.input(0);
+  TfLiteTensor* output = interpreter.output(0);
+  TF_LITE_MICRO_EXPECT(input->data.f == output->data.f);
+  TF_LITE_MICRO_EXPECT_EQ(2, output->dims->size);
+  TF_LITE_MICRO_EXPECT_EQ(32, output->dims->data[0]);
+
+  float expected[kSize];
+  for (int i = 0; i < kSize; ++i) {
+    const float value = static_cast<float>(i % 97) / 12.0f - 4.0f;
+    input->data.f[i] = value;
+    expected[i] = 1.0f / (1.0f + std::exp(-std::max(value, 0.0f)));
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+  for (int i = 0; i < kSize; ++i) {
+    TF_LITE_MICRO_EXPECT_NEAR(expected[i], output->data.f[i], 1e-5f);
+  }
+}
+
+TF_LITE_MICRO_TEST(TestInterpreterWithOperatorFusionMatchesConvModel) {
+  const tflite::Model* model = tflite::GetModel(kTestConvModelData);
+  tflite::AllOpsResolver op_resolver;
+
+  constexpr size_t allocator_buffer_size = 16 * 1024;
+  uint8_t unfused_buffer[allocator_buffer_size];
+  uint8_t fused_buffer[allocator_buffer_size];
+  tflite::MicroInterpreter unfused(model, op_resolver, unfused_buffer,
+                                   allocator_buffer_size,
+                                   micro_test::reporter);
+  tflite::MicroInterpreter fused(model, op_resolver, fused_buffer,
+                                 allocator_buffer_size, micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, fused.SetOperatorFusion(true));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, unfused.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, fused.AllocateTensors());
+
+  TfLiteTensor* unfused_input = unfused.input(0);
+  TfLiteTensor* fused_input = fused.input(0);
+  const size_t input_size = unfused_input->bytes / sizeof(float);
+  for (int invoke = 0; invoke < 2; ++invoke) {
+    // A fused model input is overwritten by Invoke(), so refill it each time.
+    for (size_t i = 0; i < input_size; ++i) {
+      const float value =
+          static_cast<float>((i * 37 + invoke * 101 + 11) % 251) / 251.0f;
+      unfused_input->data.f[i] = value;
+      fused_input->data.f[i] = value;
+    }
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, unfused.Invoke());
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, fused.Invoke());
+
+    TfLiteTensor* expected = unfused.output(0);
+    TfLiteTensor* actual = fused.output(0);
+    TF_LITE_MICRO_EXPECT_EQ(expected->bytes, actual->bytes);
+    for (size_t i = 0; i < expected->bytes; ++i) {
+      TF_LITE_MICRO_EXPECT_EQ(expected->data.uint8[i], actual->data.uint8[i]);
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(TestInterpreterFoldsActivationsIntoProducers) {
+  const tflite::Model* model = tflite::testing::GetFoldableActivationsModel();
+  tflite::AllOpsResolver op_resolver;
+
+  constexpr size_t allocator_buffer_size = 8 * 1024;
+  uint8_t unfused_buffer[allocator_buffer_size];
+  uint8_t fused_buffer[allocator_buffer_size];
+  alignas(8) uint8_t unfused_trace_buffer[8 *
+                                          sizeof(tflite::MicroTracer::Event)];
+  alignas(8) uint8_t fused_trace_buffer[8 * sizeof(tflite::MicroTracer::Event)];
+  tflite::MicroTracer unfused_tracer(unfused_trace_buffer,
+                                     sizeof(unfused_trace_buffer));
+  tflite::MicroTracer fused_tracer(fused_trace_buffer,
+                                   sizeof(fused_trace_buffer));
+  tflite::MicroInterpreter unfused(model, op_resolver, unfused_buffer,
+                                   allocator_buffer_size,
+                                   micro_test::reporter);
+  tflite::MicroInterpreter fused(model, op_resolver, fused_buffer,
+                                 allocator_buffer_size, micro_test::reporter);
+  unfused.SetTracer(&unfused_tracer);
+  fused.SetTracer(&fused_tracer);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, fused.SetOperatorFusion(true));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, unfused.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, fused.AllocateTensors());
+
+  TfLiteTensor* unfused_input = unfused.input(0);
+  TfLiteTensor* fused_input = fused.input(0);
+  for (size_t i = 0; i < unfused_input->bytes; ++i) {
+    const int8_t value = static_cast<int8_t>((i * 37 + 11) % 256 - 128);
+    unfused_input->data.int8[i] = value;
+    fused_input->data.int8[i] = value;
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, unfused.Invoke());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, fused.Invoke());
+
+  // RELU6 and RELU no longer run: DEPTHWISE_CONV_2D and FULLY_CONNECTED clamp
+  // their outputs to the same ranges while requantizing.
+  TF_LITE_MICRO_EXPECT_EQ(5, unfused_tracer.num_events());
+  TF_LITE_MICRO_EXPECT_EQ(3, fused_tracer.num_events());
+  TF_LITE_MICRO_EXPECT_EQ(0, fused_tracer.GetEvent(0).node_index);
+  TF_LITE_MICRO_EXPECT_EQ(2, fused_tracer.GetEvent(1).node_index);
+
+  TfLiteTensor* expected = unfused.output(0);
+  TfLiteTensor* actual = fused.output(0);
+  TF_LITE_MICRO_EXPECT_EQ(expected->bytes, actual->bytes);
+  int clamped = 0;
+  for (size_t i = 0; i < expected->bytes; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(expected->data.int8[i], actual->data.int8[i]);
+    clamped += expected->data.int8[i] == expected->params.zero_point;
+  }
+  TF_LITE_MICRO_EXPECT_GT(clamped, 0);
+  TF_LITE_MICRO_EXPECT_LT(clamped, static_cast<int>(expected->bytes));
+}
+
+TF_LITE_MICRO_TEST(TestInterpreterWithPackedWeightsMatchesConvModel) {
+  const tflite::Model* model = tflite::GetModel(kTestConvModelData);
+  tflite::AllOpsResolver op_resolver;
+  tflite::MicroMutableOpResolver<6> packed_op_resolver;
+  packed_op_resolver.AddQuantize();
+  packed_op_resolver.AddConv2D(tflite::Register_CONV_2D_PACKED());
+  packed_op_resolver.AddMaxPool2D();
+  packed_op_resolver.AddReshape();
+  packed_op_resolver.AddFullyConnected(
+      tflite::Register_FULLY_CONNECTED_PACKED());
+  packed_op_resolver.AddDequantize();
+
+  constexpr size_t allocator_buffer_size = 32 * 1024;
+  uint8_t unpacked_buffer[allocator_buffer_size];
+  uint8_t packed_buffer[allocator_buffer_size];
+  tflite::RecordingMicroAllocator* unpacked_allocator =
+      tflite::RecordingMicroAllocator::Create(
+          unpacked_buffer, allocator_buffer_size, micro_test::reporter);
+  tflite::RecordingMicroAllocator* packed_allocator =
+      tflite::RecordingMicroAllocator::Create(
+          packed_buffer, allocator_buffer_size, micro_test::reporter);
+  tflite::MicroInterpreter unpacked(model, op_resolver, unpacked_allocator,
+                                    micro_test::reporter);
+  tflite::MicroInterpreter packed(model, packed_op_resolver, packed_allocator,
+                                  micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, unpacked.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, packed.AllocateTensors());
+
+  // Every CONV_2D and FULLY_CONNECTED op adds its packed filter and folded
+  // bias to the persistent buffers, if the host can run the packed kernels.
+  size_t packed_bytes = 0;
+  const tflite::SubGraph* subgraph = model->subgraphs()->Get(0);
+  for (size_t i = 0; i < subgraph->operators()->size(); ++i) {
+    const tflite::Operator* op = subgraph->operators()->Get(i);
+    const tflite::BuiltinOperator code = tflite::GetBuiltinCode(
+        model->operator_codes()->Get(op->opcode_index()));
+    if (code != tflite::BuiltinOperator_CONV_2D &&
+        code != tflite::BuiltinOperator_FULLY_CONNECTED) {
+      continue;
+    }
+    const auto* shape =
+        subgraph->tensors()->Get(op->inputs()->Get(1))->shape();
+    int depth = 1;
+    for (size_t d = 1; d < shape->size(); ++d) {
+      depth *= shape->Get(d);
+    }
+    packed_bytes += tflite::optimized_integer_ops::PackedWeightsSize(
+                        shape->Get(0), depth) +
+                    shape->Get(0) * sizeof(int32_t);
+  }
+  if (!tflite::optimized_integer_ops::HasPackedWeights()) {
+    packed_bytes = 0;
+  }
+  TF_LITE_MICRO_EXPECT_EQ(
+      unpacked_allocator
+              ->GetRecordedAllocation(
+                  tflite::RecordedAllocationType::kPersistentBufferData)
+              .requested_bytes +
+          packed_bytes,
+      packed_allocator
+          ->GetRecordedAllocation(
+              tflite::RecordedAllocationType::kPersistentBufferData)
+          .requested_bytes);
+
+  TfLiteTensor* unpacked_input = unpacked.input(0);
+  TfLiteTensor* packed_input = packed.input(0);
+  const size_t input_size = unpacked_input->bytes / sizeof(float);
+  for (size_t i = 0; i < input_size; ++i) {
+    const float value = static_cast<float>((i * 37 + 11) % 251) / 251.0f;
+    unpacked_input->data.f[i] = value;
+    packed_input->data.f[i] = value;
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, unpacked.Invoke());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, packed.Invoke());
+
+  TfLiteTensor* expected = unpacked.output(0);
+  TfLiteTensor* actual = packed.output(0);
+  TF_LITE_MICRO_EXPECT_EQ(expected->bytes, actual->bytes);
+  for (size_t i = 0; i < expected->bytes; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(expected->data.uint8[i], actual->data.uint8[i]);
+  }
+}
+
+TF_LITE_MICRO_TEST(TestSessionsShareCompiledKeywordModel) {
+  // Each session carries its own SVDF state, so sessions fed different streams
+  // have to match separate interpreters over several invocations.
+  constexpr int kInvocations = 3;
+  const tflite::Model* model = tflite::GetModel(g_keyword_scrambled_model_data);
+  tflite::AllOpsResolver op_resolver;
+
+  constexpr size_t buffer_size = 24 * 1024;
+  uint8_t compiled_buffer[buffer_size];
+  uint8_t reference_buffer[buffer_size];
+  uint8_t session_buffers[2][buffer_size];
+  tflite::MicroInterpreter compiled(model, op_resolver, compiled_buffer,
+                                    buffer_size, micro_test::reporter);
+  tflite::MicroInterpreter reference(model, op_resolver, reference_buffer,
+                                     buffer_size, micro_test::reporter);
+  tflite::MicroInterpreter early_session(compiled, session_buffers[0],
+                                         buffer_size, micro_test::reporter);
+  tflite::MicroInterpreter session1(compiled, session_buffers[1], buffer_size,
+                                    micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError, early_session.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, compiled.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, reference.AllocateTensors());
+  tflite::MicroInterpreter session0(compiled, session_buffers[0], buffer_size,
+                                    micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError, session0.SetBatchSize(2));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, session0.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, session1.AllocateTensors());
+
+  // Node data, op data and weights stay in the compiled arena.
+  TF_LITE_MICRO_EXPECT_LT(session0.arena_used_bytes(),
+                          compiled.arena_used_bytes());
+  TF_LITE_MICRO_EXPECT(session0.node_and_registration(1).node.user_data ==
+                       compiled.node_and_registration(1).node.user_data);
+
+  tflite::MicroInterpreter* interpreters[] = {&compiled, &session0,
+                                              &reference, &session1};
+  const size_t input_size = compiled.input(0)->bytes / sizeof(int16_t);
+  for (int invoke = 0; invoke < kInvocations; ++invoke) {
+    for (int n = 0; n < 4; ++n) {
+      // The compiled model and the first session get one stream, the
+      // reference interpreter and the second session another one.
+      const int stream = n / 2;
+      TfLiteTensor* input = interpreters[n]->input(0);
+      for (size_t i = 0; i < input_size; ++i) {
+        input->data.i16[i] = static_cast<int16_t>(
+            ((i * 131 + stream * 977 + invoke * 4099) % 65536) - 32768);
+      }
+      TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreters[n]->Invoke());
+    }
+    for (int n = 1; n < 4; n += 2) {
+      TfLiteTensor* expected = interpreters[n - 1]->output(0);
+      TfLiteTensor* actual = interpreters[n]->output(0);
+      TF_LITE_MICRO_EXPECT_EQ(expected->bytes, actual->bytes);
+      TF_LITE_MICRO_EXPECT(expected->data.raw != actual->data.raw);
+      for (size_t i = 0; i < expected->bytes; ++i) {
+        TF_LITE_MICRO_EXPECT_EQ(expected->data.uint8[i],
+                                actual->data.uint8[i]);
+      }
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(TestSessionsKeepTheirOwnKernelState) {
+  // SVDF_RING advances a head in a kernel state buffer on every Invoke(), so
+  // two sessions run in turn must each match a separate interpreter, down to
+  // the rotated SVDF state.
+  constexpr int kInvocations = 12;
+  const tflite::Model* model = tflite::GetModel(g_keyword_scrambled_model_data);
+  tflite::MicroMutableOpResolver<5> op_resolver;
+  op_resolver.AddDequantize();
+  op_resolver.AddFullyConnected();
+  op_resolver.AddQuantize();
+  op_resolver.AddSoftmax();
+  op_resolver.AddSvdf(tflite::Register_SVDF_RING());
+
+  constexpr size_t buffer_size = 24 * 1024;
+  uint8_t compiled_buffer[buffer_size];
+  uint8_t reference_buffers[2][buffer_size];
+  uint8_t session_buffers[2][buffer_size];
+  tflite::MicroInterpreter compiled(model, op_resolver, compiled_buffer,
+                                    buffer_size, micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, compiled.AllocateTensors());
+  tflite::MicroInterpreter reference0(model, op_resolver, reference_buffers[0],
+                                      buffer_size, micro_test::reporter);
+  tflite::MicroInterpreter reference1(model, op_resolver, reference_buffers[1],
+                                      buffer_size, micro_test::reporter);
+  tflite::MicroInterpreter session0(compiled, session_buffers[0], buffer_size,
+                                    micro_test::reporter);
+  tflite::MicroInterpreter session1(compiled, session_buffers[1], buffer_size,
+                                    micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, reference0.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, reference1.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, session0.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, session1.AllocateTensors());
+
+  tflite::MicroInterpreter* interpreters[] = {&session0, &reference0,
+                                              &session1, &reference1};
+  // Compare the output and the variable tensors. tensor() allocates from the
+  // tail, so look them up once.
+  constexpr int kMaxCompared = 8;
+  TfLiteTensor* compared[4][kMaxCompared];
+  int compared_count = 0;
+  const auto* tensors = model->subgraphs()->Get(0)->tensors();
+  for (size_t t = 0; t < tensors->size(); ++t) {
+    if (static_cast<int32_t>(t) != session0.outputs()[0] &&
+        !tensors->Get(t)->is_variable()) {
+      continue;
+    }
+    TF_LITE_MICRO_EXPECT_LT(compared_count, kMaxCompared);
+    for (int n = 0; n < 4; ++n) {
+      compared[n][compared_count] = interpreters[n]->tensor(t);
+    }
+    ++compared_count;
+  }
+  TF_LITE_MICRO_EXPECT_GT(compared_count, 1);
+  auto expect_same_state = [&](int session) {
+    for (int c = 0; c < compared_count; ++c) {
+      const TfLiteTensor* actual = compared[session][c];
+      const TfLiteTensor* expected = compared[session + 1][c];
+      TF_LITE_MICRO_EXPECT_EQ(expected->bytes, actual->bytes);
+      for (size_t i = 0; i < expected->bytes; ++i) {
+        TF_LITE_MICRO_EXPECT_EQ(expected->data.uint8[i],
+                                actual->data.uint8[i]);
+      }
+    }
+  };
+  const size_t input_size = session0.input(0)->bytes / sizeof(int16_t);
+  for (int invoke = 0; invoke < kInvocations; ++invoke) {
+    // The second session skips every third invocation, so that the heads of
+    // the two sessions drift apart.
+    for (int n = 0; n < 4; ++n) {
+      const int stream = n / 2;
+      if (stream == 1 && invoke % 3 == 2) {
+        continue;
+      }
+      TfLiteTensor* input = interpreters[n]->input(0);
+      for (size_t i = 0; i < input_size; ++i) {
+        input->data.i16[i] = static_cast<int16_t>(
+            ((i * 131 + stream * 977 + invoke * 4099) % 65536) - 32768);
+      }
+      TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreters[n]->Invoke());
+    }
+    expect_same_state(0);
+    expect_same_state(2);
+  }
+
+  // Resetting a session clears its head along with the SVDF state.
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, session0.ResetVariableTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, reference0.ResetVariableTensors());
+  for (int invoke = 0; invoke < 2; ++invoke) {
+    for (int n = 0; n < 2; ++n) {
+      TfLiteTensor* input = interpreters[n]->input(0);
+      for (size_t i = 0; i < input_size; ++i) {
+        input->data.i16[i] = static_cast<int16_t>(i * 37 + invoke);
+      }
+      TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreters[n]->Invoke());
+    }
+    expect_same_state(0);
+  }
+}
+
+TF_LITE_MICRO_TEST(TestInterpreterWithMemoryPlanSearchMatchesConvModel) {
+  const tflite::Model* model = tflite::GetModel(kTestConvModelData);
+  tflite::AllOpsResolver op_resolver;
+
+  // Both interpreters use the same arena in turn, so that they lose the same
+  // number of bytes to alignment.
+  constexpr size_t allocator_buffer_size = 16 * 1024;
+  uint8_t allocator_buffer[allocator_buffer_size];
+  size_t greedy_used_bytes = 0;
+  uint8_t expected[64];
+  size_t expected_bytes = 0;
+  for (int search = 0; search < 2; ++search) {
+    tflite::MicroInterpreter interpreter(model, op_resolver, allocator_buffer,
+                                         allocator_buffer_size,
+                                         micro_test::reporter);
+    if (search) {
+      TF_LITE_MICRO_EXPECT_EQ(kTfLiteError,
+                              interpreter.SetMemoryPlannerSearchSteps(-1));
+      TF_LITE_MICRO_EXPECT_EQ(
+          kTfLiteOk,
+          interpreter.SetMemoryPlannerSearchSteps(
+              tflite::OptimalMemoryPlanner::kDefaultMaxSearchSteps));
+    }
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+    const tflite::MemoryPlanStats& stats = interpreter.memory_plan_stats();
+    if (search) {
+      TF_LITE_MICRO_EXPECT_LE(interpreter.arena_used_bytes(),
+                              greedy_used_bytes);
+      TF_LITE_MICRO_EXPECT_GT(stats.search_steps, 0);
+      TF_LITE_MICRO_EXPECT_GT(stats.planned_bytes, 0u);
+      TF_LITE_MICRO_EXPECT_LE(stats.lower_bound_bytes, stats.planned_bytes);
+      TF_LITE_MICRO_EXPECT_LE(stats.planned_bytes, stats.greedy_bytes);
+      if (stats.planned_bytes == stats.lower_bound_bytes) {
+        TF_LITE_MICRO_EXPECT_TRUE(stats.is_optimal);
+      }
+    } else {
+      greedy_used_bytes = interpreter.arena_used_bytes();
+      TF_LITE_MICRO_EXPECT_EQ(0, stats.search_steps);
+      TF_LITE_MICRO_EXPECT_EQ(0u, stats.planned_bytes);
+    }
+
+    TfLiteTensor* input = interpreter.input(0);
+    const size_t input_size = input->bytes / sizeof(float);
+    for (size_t i = 0; i < input_size; ++i) {
+      input->data.f[i] = static_cast<float>((i * 37 + 11) % 251) / 251.0f;
+    }
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+
+    TfLiteTensor* output = interpreter.output(0);
+    TF_LITE_MICRO_EXPECT_LE(output->bytes, sizeof(expected));
+    if (search) {
+      TF_LITE_MICRO_EXPECT_EQ(expected_bytes, output->bytes);
+      for (size_t i = 0; i < expected_bytes; ++i) {
+        TF_LITE_MICRO_EXPECT_EQ(expected[i], output->data.uint8[i]);
+      }
+    } else {
+      expected_bytes = output->bytes;
+      for (size_t i = 0; i < expected_bytes; ++i) {
+        expected[i] = output->data.uint8[i];
+      }
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(TestInterpreterWithRingCircularBuffer) {
+  const tflite::Model* model = tflite::testing::GetCircularBufferModel();
+  constexpr int kSlots = tflite::testing::kCircularBufferModelSlots;
+  constexpr int kDepth = tflite::testing::kCircularBufferModelDepth;
+
+  tflite::MicroMutableOpResolver<2> shift_resolver;
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, shift_resolver.AddCircularBuffer());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, shift_resolver.AddReshape());
+  tflite::MicroMutableOpResolver<2> ring_resolver;
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, ring_resolver.AddCircularBuffer(
+                     tflite::ops::micro::Register_CIRCULAR_BUFFER_RING()));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, ring_resolver.AddReshape());
+
+  constexpr size_t allocator_buffer_size = 4 * 1024;
+  uint8_t shift_buffer[allocator_buffer_size];
+  uint8_t ring_buffer[allocator_buffer_size];
+  uint8_t session_buffer[allocator_buffer_size];
+  tflite::MicroInterpreter shift(model, shift_resolver, shift_buffer,
+                                 allocator_buffer_size, micro_test::reporter);
+  tflite::MicroInterpreter ring(model, ring_resolver, ring_buffer,
+                                allocator_buffer_size, micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, shift.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, ring.AllocateTensors());
+  tflite::MicroInterpreter session(ring, session_buffer, allocator_buffer_size,
+                                   micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, session.AllocateTensors());
+  // The shifting history lives in the planned output tensor, the ring in a
+  // state buffer instead of a planned output.
+  memset(shift.output(0)->data.int8, 0, kSlots * kDepth);
+
+  // Wrap around the ring a few times, checking the history after each step.
+  // The session gets a different stream and runs in turn with the model it
+  // was created from.
+  tflite::MicroInterpreter* interpreters[] = {&shift, &ring, &session};
+  for (int step = 0; step < 3 * kSlots + 2; ++step) {
+    for (int n = 0; n < 3; ++n) {
+      const int offset = n == 2 ? 64 : 0;
+      for (int i = 0; i < kDepth; ++i) {
+        interpreters[n]->input(0)->data.int8[i] =
+            static_cast<int8_t>(offset + step * kDepth + i);
+      }
+      TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreters[n]->Invoke());
+    }
+    for (int n = 0; n < 3; ++n) {
+      const int offset = n == 2 ? 64 : 0;
+      const int8_t* history = interpreters[n]->output(0)->data.int8;
+      const int8_t* reshaped = interpreters[n]->output(1)->data.int8;
+      for (int i = 0; i < kSlots * kDepth; ++i) {
+        const int slot_step = step - (kSlots - 1) + i / kDepth;
+        const int8_t expected =
+            slot_step < 0 ? 0
+                          : static_cast<int8_t>(offset + slot_step * kDepth +
+                                                i % kDepth);
+        TF_LITE_MICRO_EXPECT_EQ(expected, history[i]);
+        TF_LITE_MICRO_EXPECT_EQ(expected, reshaped[i]);
+      }
+    }
+  }
+}
+
 TF_LITE_MICRO_TESTS_END
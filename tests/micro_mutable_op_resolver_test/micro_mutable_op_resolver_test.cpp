@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
 
+#include <cstring>
+
 #include "tensorflow/lite/micro/micro_op_resolver.h"
 #include "tensorflow/lite/micro/testing/micro_test.h"
 
@@ -129,4 +131,72 @@ TF_LITE_MICRO_TEST(TestErrorReporting) {
   mock_reporter.ResetState();
 }
 
+TF_LITE_MICRO_TEST(TestLookupWithManyOperations) {
+  using tflite::BuiltinOperator;
+  using tflite::BuiltinOperator_ADD;
+  using tflite::BuiltinOperator_CONV_2D;
+  using tflite::BuiltinOperator_CUSTOM;
+  using tflite::BuiltinOperator_MAX;
+  using tflite::BuiltinOperator_RELU;
+  using tflite::BuiltinOperator_SOFTMAX;
+  using tflite::MicroMutableOpResolver;
+
+  static TfLiteRegistration r = {};
+  r.init = tflite::MockInit;
+  r.free = tflite::MockFree;
+  r.prepare = tflite::MockPrepare;
+  r.invoke = tflite::MockInvoke;
+
+  MicroMutableOpResolver<16> micro_op_resolver;
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, micro_op_resolver.AddRelu());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, micro_op_resolver.AddConv2D());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, micro_op_resolver.AddSoftmax());
+
+  const char* const custom_names[] = {"custom_0", "custom_1", "custom_2",
+                                      "custom_3", "custom_4", "custom_5",
+                                      "custom_6", "custom_7", "custom_8",
+                                      "custom_9", "custom_10", "custom_11",
+                                      "custom_12"};
+  const int custom_count = sizeof(custom_names) / sizeof(custom_names[0]);
+  for (int i = 0; i < custom_count; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                            micro_op_resolver.AddCustom(custom_names[i], &r));
+  }
+  TF_LITE_MICRO_EXPECT_EQ(static_cast<size_t>(16),
+                          micro_op_resolver.GetRegistrationLength());
+
+  // Duplicates are still rejected once the resolver is full.
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError, micro_op_resolver.AddRelu());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError,
+                          micro_op_resolver.AddCustom("custom_4", &r));
+
+  tflite::MicroOpResolver* resolver = &micro_op_resolver;
+  const BuiltinOperator builtins[] = {BuiltinOperator_RELU,
+                                      BuiltinOperator_CONV_2D,
+                                      BuiltinOperator_SOFTMAX};
+  for (BuiltinOperator op : builtins) {
+    const TfLiteRegistration* registration = resolver->FindOp(op);
+    TF_LITE_MICRO_EXPECT(nullptr != registration);
+    TF_LITE_MICRO_EXPECT_EQ(op, registration->builtin_code);
+    TF_LITE_MICRO_EXPECT(nullptr != resolver->GetOpDataParser(op));
+  }
+  for (int i = 0; i < custom_count; ++i) {
+    const TfLiteRegistration* registration = resolver->FindOp(custom_names[i]);
+    TF_LITE_MICRO_EXPECT(nullptr != registration);
+    TF_LITE_MICRO_EXPECT_EQ(0,
+                            strcmp(custom_names[i], registration->custom_name));
+  }
+
+  TF_LITE_MICRO_EXPECT(nullptr == resolver->FindOp(BuiltinOperator_ADD));
+  TF_LITE_MICRO_EXPECT(nullptr ==
+                       resolver->GetOpDataParser(BuiltinOperator_ADD));
+  TF_LITE_MICRO_EXPECT(nullptr == resolver->FindOp(BuiltinOperator_CUSTOM));
+  TF_LITE_MICRO_EXPECT(nullptr == resolver->FindOp(static_cast<BuiltinOperator>(
+                                      BuiltinOperator_MAX + 1)));
+  TF_LITE_MICRO_EXPECT(nullptr ==
+                       resolver->FindOp(static_cast<BuiltinOperator>(-1)));
+  TF_LITE_MICRO_EXPECT(nullptr == resolver->FindOp("custom_13"));
+  TF_LITE_MICRO_EXPECT(nullptr == resolver->FindOp(""));
+}
+
 TF_LITE_MICRO_TESTS_END
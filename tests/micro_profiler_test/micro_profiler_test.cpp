@@ -0,0 +1,193 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/micro_profiler.h"
+
+#include <cstring>
+
+#include "tensorflow/lite/micro/testing/micro_test.h"
+
+namespace {
+
+// Profiler whose clock only moves when the test advances it.
+class FakeClockProfiler : public tflite::MicroProfiler {
+ public:
+  FakeClockProfiler(uint8_t* buffer, size_t buffer_size)
+      : tflite::MicroProfiler(buffer, buffer_size, micro_test::reporter) {}
+
+  void Advance(uint64_t ns) { now_ns_ += ns; }
+
+ protected:
+  uint64_t GetTimeNanos() override { return now_ns_; }
+
+ private:
+  uint64_t now_ns_ = 0;
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+constexpr size_t kBufferSize = 8 * sizeof(tflite::MicroProfiler::Stats);
+alignas(8) uint8_t profiler_buffer[kBufferSize];
+
+void RunOp(FakeClockProfiler* profiler, const char* tag, int op_index,
+           uint64_t duration_ns) {
+  tflite::ScopedOperatorProfile scoped_profile(profiler, tag, op_index);
+  profiler->Advance(duration_ns);
+}
+
+}  // namespace
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(TestAggregatesPerOpIndexAndType) {
+  FakeClockProfiler profiler(profiler_buffer, kBufferSize);
+  for (int i = 0; i < 100; ++i) {
+    RunOp(&profiler, "CONV_2D", 0, i < 98 ? 1000 : 8000);
+    RunOp(&profiler, "FULLY_CONNECTED", 1, 300);
+    RunOp(&profiler, "CONV_2D", 2, 2000);
+  }
+  TF_LITE_MICRO_EXPECT_EQ(5, profiler.num_stats());
+  TF_LITE_MICRO_EXPECT_EQ(0u, profiler.dropped_events());
+
+  tflite::MicroProfiler::Summary summary;
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, profiler.GetOpSummary(0, &summary));
+  TF_LITE_MICRO_EXPECT_EQ(0, strcmp("CONV_2D", summary.tag));
+  TF_LITE_MICRO_EXPECT_EQ(0, summary.op_index);
+  TF_LITE_MICRO_EXPECT_EQ(100u, summary.count);
+  TF_LITE_MICRO_EXPECT_EQ(1000u, summary.min_ns);
+  TF_LITE_MICRO_EXPECT_EQ(1140u, summary.mean_ns);
+  TF_LITE_MICRO_EXPECT_EQ(8000u, summary.p99_ns);
+  TF_LITE_MICRO_EXPECT_EQ(8000u, summary.max_ns);
+
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, profiler.GetOpSummary(1, &summary));
+  TF_LITE_MICRO_EXPECT_EQ(300u, summary.min_ns);
+  TF_LITE_MICRO_EXPECT_EQ(300u, summary.p99_ns);
+  TF_LITE_MICRO_EXPECT_EQ(300u, summary.max_ns);
+
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          profiler.GetTagSummary("CONV_2D", &summary));
+  TF_LITE_MICRO_EXPECT_EQ(tflite::MicroProfiler::kNoOpIndex, summary.op_index);
+  TF_LITE_MICRO_EXPECT_EQ(200u, summary.count);
+  TF_LITE_MICRO_EXPECT_EQ(1000u, summary.min_ns);
+  TF_LITE_MICRO_EXPECT_EQ(1570u, summary.mean_ns);
+  TF_LITE_MICRO_EXPECT_EQ(8000u, summary.max_ns);
+  // The 198th of 200 sorted samples is 2000ns; the histogram bin that holds it
+  // spans [1920, 2047].
+  TF_LITE_MICRO_EXPECT_GE(summary.p99_ns, 2000u);
+  TF_LITE_MICRO_EXPECT_LE(summary.p99_ns, 2047u);
+
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError, profiler.GetOpSummary(3, &summary));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError,
+                          profiler.GetTagSummary("SOFTMAX", &summary));
+
+  profiler.Reset();
+  TF_LITE_MICRO_EXPECT_EQ(0, profiler.num_stats());
+}
+
+TF_LITE_MICRO_TEST(TestNestedEvents) {
+  FakeClockProfiler profiler(profiler_buffer, kBufferSize);
+  const uint32_t outer = profiler.BeginEvent(
+      "Invoke", tflite::Profiler::EventType::DEFAULT, 0, 0);
+  profiler.Advance(10);
+  RunOp(&profiler, "ADD", 0, 100);
+  profiler.Advance(10);
+  profiler.EndEvent(outer);
+
+  tflite::MicroProfiler::Summary summary;
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          profiler.GetTagSummary("Invoke", &summary));
+  TF_LITE_MICRO_EXPECT_EQ(120u, summary.max_ns);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, profiler.GetOpSummary(0, &summary));
+  TF_LITE_MICRO_EXPECT_EQ(100u, summary.max_ns);
+
+  // Ending an outer event also ends the events still open inside it.
+  const uint32_t first = profiler.BeginEvent(
+      "Outer", tflite::Profiler::EventType::DEFAULT, 0, 0);
+  profiler.BeginEvent("Inner", tflite::Profiler::EventType::DEFAULT, 0, 0);
+  profiler.Advance(50);
+  profiler.EndEvent(first);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, profiler.GetTagSummary("Inner", &summary));
+  TF_LITE_MICRO_EXPECT_EQ(50u, summary.max_ns);
+  TF_LITE_MICRO_EXPECT_EQ(0u, profiler.dropped_events());
+}
+
+TF_LITE_MICRO_TEST(TestDropsEventsWhenFull) {
+  FakeClockProfiler profiler(profiler_buffer,
+                             2 * sizeof(tflite::MicroProfiler::Stats));
+  RunOp(&profiler, "ADD", 0, 100);
+  RunOp(&profiler, "ADD", 1, 100);
+  TF_LITE_MICRO_EXPECT_EQ(2, profiler.num_stats());
+  TF_LITE_MICRO_EXPECT_EQ(1u, profiler.dropped_events());
+
+  uint32_t handles[tflite::MicroProfiler::kMaxOpenEvents + 1];
+  for (int i = 0; i <= tflite::MicroProfiler::kMaxOpenEvents; ++i) {
+    handles[i] = profiler.BeginEvent(
+        "ADD", tflite::Profiler::EventType::DEFAULT, 0, 0);
+  }
+  TF_LITE_MICRO_EXPECT_EQ(2u, profiler.dropped_events());
+  // Ending the dropped event is a no-op.
+  profiler.EndEvent(handles[tflite::MicroProfiler::kMaxOpenEvents]);
+  profiler.EndEvent(handles[0]);
+
+  tflite::MicroProfiler::Summary summary;
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, profiler.GetTagSummary("ADD", &summary));
+  TF_LITE_MICRO_EXPECT_EQ(
+      static_cast<uint32_t>(2 + tflite::MicroProfiler::kMaxOpenEvents),
+      summary.count);
+}
+
+TF_LITE_MICRO_TEST(TestExportCsv) {
+  FakeClockProfiler profiler(profiler_buffer, kBufferSize);
+  RunOp(&profiler, "CONV_2D", 0, 1500);
+  RunOp(&profiler, "CONV_2D", 0, 2500);
+
+  const char* expected =
+      "kind,op_index,tag,count,min_ns,mean_ns,p99_ns,max_ns\n"
+      "type,-1,CONV_2D,2,1500,2000,2500,2500\n"
+      "op,0,CONV_2D,2,1500,2000,2500,2500\n";
+  char csv[256];
+  const size_t length = profiler.ExportCsv(csv, sizeof(csv));
+  TF_LITE_MICRO_EXPECT_EQ(strlen(expected), length);
+  TF_LITE_MICRO_EXPECT_EQ(0, strcmp(expected, csv));
+
+  // Truncated output is still terminated and reports the full length.
+  char small[16];
+  TF_LITE_MICRO_EXPECT_EQ(length, profiler.ExportCsv(small, sizeof(small)));
+  TF_LITE_MICRO_EXPECT_EQ(sizeof(small) - 1, strlen(small));
+  TF_LITE_MICRO_EXPECT_EQ(length, profiler.ExportCsv(nullptr, 0));
+}
+
+TF_LITE_MICRO_TEST(TestExportChromeTrace) {
+  FakeClockProfiler profiler(profiler_buffer, kBufferSize);
+  profiler.Advance(5000);
+  RunOp(&profiler, "CONV_2D", 0, 1500);
+  profiler.Advance(250);
+  RunOp(&profiler, "SOFTMAX", 1, 750);
+
+  const char* expected =
+      "{\"traceEvents\":[\n"
+      "{\"name\":\"CONV_2D\",\"cat\":\"op\",\"ph\":\"X\",\"pid\":0,\"tid\":0,"
+      "\"ts\":0.000,\"dur\":1.500,\"args\":{\"op_index\":0,\"count\":1,"
+      "\"min_ns\":1500,\"mean_ns\":1500,\"p99_ns\":1500,\"max_ns\":1500}},\n"
+      "{\"name\":\"SOFTMAX\",\"cat\":\"op\",\"ph\":\"X\",\"pid\":0,\"tid\":0,"
+      "\"ts\":1.750,\"dur\":0.750,\"args\":{\"op_index\":1,\"count\":1,"
+      "\"min_ns\":750,\"mean_ns\":750,\"p99_ns\":750,\"max_ns\":750}}\n"
+      "],\"displayTimeUnit\":\"ns\"}\n";
+  char trace[1024];
+  const size_t length = profiler.ExportChromeTrace(trace, sizeof(trace));
+  TF_LITE_MICRO_EXPECT_EQ(strlen(expected), length);
+  TF_LITE_MICRO_EXPECT_EQ(0, strcmp(expected, trace));
+}
+
+TF_LITE_MICRO_TESTS_END
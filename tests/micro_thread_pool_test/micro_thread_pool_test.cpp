@@ -0,0 +1,94 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/linux/pthread_thread_pool.h"
+
+#include "tensorflow/lite/micro/testing/micro_test.h"
+
+namespace {
+
+constexpr int kMaxTasks = 64;
+
+struct TaskCounts {
+  int calls[kMaxTasks];
+};
+
+void CountTask(void* arg, int task_index) {
+  // Each index is handed out once, so tasks never write the same slot.
+  static_cast<TaskCounts*>(arg)->calls[task_index]++;
+}
+
+void ExpectEachTaskRunsOnce(tflite::MicroThreadPool* pool, int num_tasks) {
+  TaskCounts counts = {};
+  pool->Run(num_tasks, CountTask, &counts);
+  for (int i = 0; i < kMaxTasks; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(i < num_tasks ? 1 : 0, counts.calls[i]);
+  }
+}
+
+}  // namespace
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(PthreadThreadPoolRunsEveryTaskOnce) {
+  tflite::PthreadThreadPool pool(4);
+  TF_LITE_MICRO_EXPECT_EQ(4, pool.num_threads());
+  for (int num_tasks = 0; num_tasks <= kMaxTasks; num_tasks += 7) {
+    ExpectEachTaskRunsOnce(&pool, num_tasks);
+  }
+  // Back-to-back runs reuse the same workers.
+  for (int i = 0; i < 100; ++i) {
+    ExpectEachTaskRunsOnce(&pool, 4);
+  }
+}
+
+TF_LITE_MICRO_TEST(PthreadThreadPoolClampsThreadCount) {
+  tflite::PthreadThreadPool single(0);
+  TF_LITE_MICRO_EXPECT_EQ(1, single.num_threads());
+  ExpectEachTaskRunsOnce(&single, 9);
+
+  tflite::PthreadThreadPool many(1000);
+  TF_LITE_MICRO_EXPECT_EQ(tflite::PthreadThreadPool::kMaxThreads,
+                          many.num_threads());
+  ExpectEachTaskRunsOnce(&many, kMaxTasks);
+}
+
+TF_LITE_MICRO_TEST(TaskRangesCoverWorkWithoutOverlap) {
+  const int sizes[] = {0, 1, 5, 16, 97};
+  for (int size : sizes) {
+    for (int num_tasks = 1; num_tasks <= 8; ++num_tasks) {
+      int expected_start = 0;
+      for (int i = 0; i < num_tasks; ++i) {
+        int start, end;
+        tflite::GetTaskRange(size, num_tasks, i, &start, &end);
+        TF_LITE_MICRO_EXPECT_EQ(expected_start, start);
+        TF_LITE_MICRO_EXPECT_LE(end - start, size / num_tasks + 1);
+        expected_start = end;
+      }
+      TF_LITE_MICRO_EXPECT_EQ(size, expected_start);
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(SmallWorkloadsRunInline) {
+  tflite::PthreadThreadPool pool(4);
+  TF_LITE_MICRO_EXPECT_EQ(1, tflite::GetNumTasks(nullptr, 4, 1000, 1 << 20));
+  TF_LITE_MICRO_EXPECT_EQ(1, tflite::GetNumTasks(&pool, 4, 16, 16));
+  TF_LITE_MICRO_EXPECT_EQ(1, tflite::GetNumTasks(&pool, 1, 1000, 1 << 20));
+  TF_LITE_MICRO_EXPECT_EQ(4, tflite::GetNumTasks(&pool, 8, 1000, 1 << 20));
+  TF_LITE_MICRO_EXPECT_EQ(3, tflite::GetNumTasks(&pool, 8, 3, 1 << 20));
+}
+
+TF_LITE_MICRO_TESTS_END
@@ -45,4 +45,30 @@ TF_LITE_MICRO_TEST(TestBasicTimerFunctionality) {
                        tflite::GetCurrentTimeTicks() - start_time > 0);
 }
 
+TF_LITE_MICRO_TEST(TestTimer64IsMonotonicAndConvertsToNanos) {
+  const uint64_t ticks_per_second = tflite::ticks64_per_second();
+  if (ticks_per_second == 0) {
+    TF_LITE_MICRO_EXPECT_EQ(0u, tflite::TicksToNanos(1000));
+  } else {
+    TF_LITE_MICRO_EXPECT_TRUE(tflite::TicksToNanos(ticks_per_second) ==
+                              1000000000ull);
+    // About a century of ticks converts without overflowing, even though
+    // multiplying the count by 1e9 first would.
+    const uint64_t century = 3000000000ull * ticks_per_second + 7;
+    TF_LITE_MICRO_EXPECT_TRUE(tflite::TicksToNanos(century) ==
+                              3000000000ull * 1000000000ull +
+                                  7 * 1000000000ull / ticks_per_second);
+
+    constexpr int kMaxRetries = 1e6;
+    const uint64_t start_ticks = tflite::GetCurrentTimeTicks64();
+    uint64_t ticks = start_ticks;
+    for (int i = 0; i < kMaxRetries && ticks == start_ticks; i++) {
+      const uint64_t next_ticks = tflite::GetCurrentTimeTicks64();
+      TF_LITE_MICRO_EXPECT_TRUE(next_ticks >= ticks);
+      ticks = next_ticks;
+    }
+    TF_LITE_MICRO_EXPECT_TRUE(ticks > start_ticks);
+  }
+}
+
 TF_LITE_MICRO_TESTS_END
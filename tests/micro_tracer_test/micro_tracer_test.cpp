@@ -0,0 +1,158 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/micro_tracer.h"
+
+#include <cstring>
+
+#include "tensorflow/lite/micro/test_helpers.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace {
+
+// Tracer whose clock only moves when the test advances it.
+class FakeClockTracer : public tflite::MicroTracer {
+ public:
+  FakeClockTracer(uint8_t* buffer, size_t buffer_size)
+      : tflite::MicroTracer(buffer, buffer_size) {}
+
+  void Advance(uint64_t ns) { now_ns_ += ns; }
+
+ protected:
+  uint64_t GetTimeNanos() override { return now_ns_; }
+
+ private:
+  uint64_t now_ns_ = 0;
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+constexpr size_t kBufferSize = 8 * sizeof(tflite::MicroTracer::Event);
+alignas(8) uint8_t trace_buffer[kBufferSize];
+
+// A CONV_2D that reads an int8 1x4x4x2 input and an optional tensor that is
+// absent, and writes an int8 1x2x2x3 output.
+struct FakeGraph {
+  FakeGraph() {
+    static int input_dims[] = {4, 1, 4, 4, 2};
+    static int output_dims[] = {4, 1, 2, 2, 3};
+    static int inputs[] = {2, 0, -1};
+    static int outputs[] = {1, 1};
+    tensors[0] = {{nullptr}, tflite::testing::IntArrayFromInts(input_dims),
+                  kTfLiteInt8};
+    tensors[1] = {{nullptr}, tflite::testing::IntArrayFromInts(output_dims),
+                  kTfLiteInt8};
+    registration = {};
+    registration.builtin_code = tflite::BuiltinOperator_CONV_2D;
+    node = {};
+    node.inputs = tflite::testing::IntArrayFromInts(inputs);
+    node.outputs = tflite::testing::IntArrayFromInts(outputs);
+  }
+
+  TfLiteEvalTensor tensors[2];
+  TfLiteRegistration registration;
+  TfLiteNode node;
+};
+
+void RunOp(FakeClockTracer* tracer, const FakeGraph& graph, int node_index,
+           uint64_t duration_ns) {
+  const uint64_t start_ns = tracer->BeginEvent();
+  tracer->Advance(duration_ns);
+  tracer->EndOperatorEvent(start_ns, node_index, &graph.registration,
+                           &graph.node, graph.tensors);
+}
+
+}  // namespace
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(TestRecordsOperatorsAndInvokes) {
+  FakeClockTracer tracer(trace_buffer, kBufferSize);
+  FakeGraph graph;
+  TF_LITE_MICRO_EXPECT_EQ(8, tracer.capacity());
+
+  tracer.Advance(1000);
+  const uint64_t invoke_start_ns = tracer.BeginEvent();
+  RunOp(&tracer, graph, 0, 300);
+  tracer.Advance(20);
+  RunOp(&tracer, graph, 1, 500);
+  tracer.EndInvokeEvent(invoke_start_ns);
+
+  TF_LITE_MICRO_EXPECT_EQ(3, tracer.num_events());
+  TF_LITE_MICRO_EXPECT_EQ(0u, tracer.overwritten_events());
+  TF_LITE_MICRO_EXPECT_EQ(0, tracer.GetEvent(0).node_index);
+  TF_LITE_MICRO_EXPECT_EQ(1000u, tracer.GetEvent(0).start_ns);
+  TF_LITE_MICRO_EXPECT_EQ(300u, tracer.GetEvent(0).duration_ns);
+  TF_LITE_MICRO_EXPECT_EQ(1, tracer.GetEvent(1).node_index);
+  TF_LITE_MICRO_EXPECT_EQ(1320u, tracer.GetEvent(1).start_ns);
+  TF_LITE_MICRO_EXPECT_TRUE(tracer.GetEvent(2).registration == nullptr);
+  TF_LITE_MICRO_EXPECT_EQ(820u, tracer.GetEvent(2).duration_ns);
+
+  tracer.Reset();
+  TF_LITE_MICRO_EXPECT_EQ(0, tracer.num_events());
+}
+
+TF_LITE_MICRO_TEST(TestOverwritesOldestEventsWhenFull) {
+  FakeClockTracer tracer(trace_buffer, 4 * sizeof(tflite::MicroTracer::Event));
+  FakeGraph graph;
+  for (int i = 0; i < 6; ++i) {
+    RunOp(&tracer, graph, i, 100);
+  }
+  TF_LITE_MICRO_EXPECT_EQ(4, tracer.num_events());
+  TF_LITE_MICRO_EXPECT_EQ(2u, tracer.overwritten_events());
+  for (int i = 0; i < 4; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(i + 2, tracer.GetEvent(i).node_index);
+    TF_LITE_MICRO_EXPECT_EQ(static_cast<uint64_t>((i + 2) * 100),
+                            tracer.GetEvent(i).start_ns);
+  }
+
+  // A buffer too small for a single event counts every event as overwritten.
+  FakeClockTracer empty(trace_buffer, sizeof(tflite::MicroTracer::Event) - 1);
+  RunOp(&empty, graph, 0, 100);
+  TF_LITE_MICRO_EXPECT_EQ(0, empty.num_events());
+  TF_LITE_MICRO_EXPECT_EQ(1u, empty.overwritten_events());
+}
+
+TF_LITE_MICRO_TEST(TestExportChromeTrace) {
+  FakeClockTracer tracer(trace_buffer, kBufferSize);
+  FakeGraph graph;
+  tracer.Advance(5000);
+  const uint64_t invoke_start_ns = tracer.BeginEvent();
+  tracer.Advance(250);
+  RunOp(&tracer, graph, 0, 1500);
+  tracer.EndInvokeEvent(invoke_start_ns);
+
+  const char* expected =
+      "{\"traceEvents\":[\n"
+      "{\"name\":\"CONV_2D\",\"cat\":\"op\",\"ph\":\"X\",\"pid\":0,\"tid\":0,"
+      "\"ts\":0.250,\"dur\":1.500,\"args\":{\"node_index\":0,"
+      "\"inputs\":[[1,4,4,2],null],\"outputs\":[[1,2,2,3]],\"bytes\":44}},\n"
+      "{\"name\":\"Invoke\",\"cat\":\"invoke\",\"ph\":\"X\",\"pid\":0,"
+      "\"tid\":0,\"ts\":0.000,\"dur\":1.750,\"args\":{}}\n"
+      "],\"displayTimeUnit\":\"ns\"}\n";
+  char trace[1024];
+  const size_t length = tracer.ExportChromeTrace(trace, sizeof(trace));
+  TF_LITE_MICRO_EXPECT_EQ(strlen(expected), length);
+  TF_LITE_MICRO_EXPECT_EQ(0, strcmp(expected, trace));
+
+  // Truncated output is still terminated and reports the full length.
+  char small[16];
+  TF_LITE_MICRO_EXPECT_EQ(length,
+                          tracer.ExportChromeTrace(small, sizeof(small)));
+  TF_LITE_MICRO_EXPECT_EQ(sizeof(small) - 1, strlen(small));
+  TF_LITE_MICRO_EXPECT_EQ(length, tracer.ExportChromeTrace(nullptr, 0));
+}
+
+TF_LITE_MICRO_TESTS_END
@@ -0,0 +1,160 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Checks that FftCompute() matches kiss_fftr bit for bit. The sizes cover
+// every supported power of two, so both the radix 4 only factorizations and
+// the ones that end in a radix 2 stage are run, and input sizes that are odd
+// or shorter than the FFT, which are padded with zeros.
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "tensorflow/lite/experimental/microfrontend/lib/fft.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/fft_util.h"
+#include "tensorflow/lite/micro/test_helpers.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+
+#define FIXED_POINT 16
+#include "kiss_fft.h"
+#include "tools/kiss_fftr.h"
+
+namespace {
+
+constexpr size_t kMaxFftSize = 131072;
+
+int16_t fft_input[kMaxFftSize];
+int16_t kiss_input[kMaxFftSize];
+kiss_fft_cpx kiss_output[kMaxFftSize / 2 + 1];
+
+// kiss_fft is patched not to allocate, so the memory is passed in.
+kiss_fftr_cfg KissFftrAlloc(size_t fft_size) {
+  size_t memory_size = 0;
+  kiss_fftr_alloc(fft_size, 0, nullptr, &memory_size);
+  return kiss_fftr_alloc(fft_size, 0, malloc(memory_size), &memory_size);
+}
+
+using tflite::testing::NextRandom;
+
+// Full scale values most of the time, where the fixed-point rounding and
+// wrap-around in the butterflies matter most, and random ones otherwise.
+int16_t EdgeSample(uint32_t* seed) {
+  static const int16_t kEdges[] = {0, 1, -1, 32767, -32768, 16384, -16384};
+  constexpr int kNumEdges = sizeof(kEdges) / sizeof(kEdges[0]);
+  const uint32_t r = NextRandom(seed);
+  if (r % 2 == 0) {
+    return static_cast<int16_t>(NextRandom(seed) >> 16);
+  }
+  return kEdges[(r >> 8) % kNumEdges];
+}
+
+// Runs both FFTs on the same input and returns the number of bins that differ.
+int CountMismatches(size_t input_size, int shift, uint32_t* seed) {
+  struct FftState state;
+  if (!FftPopulateState(&state, input_size)) {
+    return -1;
+  }
+  const size_t fft_size = state.fft_size;
+  kiss_fftr_cfg kiss_config = KissFftrAlloc(fft_size);
+  if (kiss_config == nullptr) {
+    FftFreeStateContents(&state);
+    return -1;
+  }
+
+  size_t i;
+  for (i = 0; i < input_size; ++i) {
+    fft_input[i] = EdgeSample(seed) >> shift;
+    kiss_input[i] = static_cast<int16_t>(static_cast<uint16_t>(fft_input[i])
+                                         << shift);
+  }
+  for (; i < fft_size; ++i) {
+    kiss_input[i] = 0;
+  }
+  FftCompute(&state, fft_input, shift);
+  kiss_fftr(kiss_config, kiss_input, kiss_output);
+
+  int mismatches = 0;
+  for (i = 0; i < fft_size / 2 + 1; ++i) {
+    if (state.output[i].real != kiss_output[i].r ||
+        state.output[i].imag != kiss_output[i].i) {
+      ++mismatches;
+    }
+  }
+  free(kiss_config);
+  FftFreeStateContents(&state);
+  return mismatches;
+}
+
+}  // namespace
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(FftMatchesKissFftrForEverySupportedSize) {
+  uint32_t seed = 1;
+  // kiss_fftr can't compute a 2 point FFT, so the sizes start at 4.
+  for (size_t fft_size = 4; fft_size <= kMaxFftSize; fft_size *= 2) {
+    TF_LITE_MICRO_EXPECT_EQ(0, CountMismatches(fft_size, 0, &seed));
+  }
+}
+
+TF_LITE_MICRO_TEST(FftMatchesKissFftrForPaddedInputs) {
+  uint32_t seed = 2;
+  // The frontend's 30 ms window at 16 kHz, and odd and small sizes.
+  const size_t input_sizes[] = {480, 3, 5, 7, 9, 17, 33, 63, 65, 255, 257,
+                                1023, 1025, 4097, 65537};
+  const int shifts[] = {0, 3, 7};
+  for (size_t input_size : input_sizes) {
+    for (int shift : shifts) {
+      TF_LITE_MICRO_EXPECT_EQ(0, CountMismatches(input_size, shift, &seed));
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(FftMatchesKissFftrForRepeatedFrames) {
+  // The same state is reused across frames by the frontend.
+  struct FftState state;
+  TF_LITE_MICRO_EXPECT_EQ(1, FftPopulateState(&state, 480));
+  kiss_fftr_cfg kiss_config = KissFftrAlloc(state.fft_size);
+  TF_LITE_MICRO_EXPECT(kiss_config != nullptr);
+  uint32_t seed = 3;
+  for (int frame = 0; frame < 8; ++frame) {
+    size_t i;
+    for (i = 0; i < state.input_size; ++i) {
+      fft_input[i] = EdgeSample(&seed) >> 4;
+      kiss_input[i] = static_cast<int16_t>(
+          static_cast<uint16_t>(fft_input[i]) << 4);
+    }
+    for (; i < state.fft_size; ++i) {
+      kiss_input[i] = 0;
+    }
+    FftCompute(&state, fft_input, 4);
+    kiss_fftr(kiss_config, kiss_input, kiss_output);
+    for (i = 0; i < state.fft_size / 2 + 1; ++i) {
+      TF_LITE_MICRO_EXPECT_EQ(kiss_output[i].r, state.output[i].real);
+      TF_LITE_MICRO_EXPECT_EQ(kiss_output[i].i, state.output[i].imag);
+    }
+  }
+  free(kiss_config);
+  FftFreeStateContents(&state);
+}
+
+TF_LITE_MICRO_TEST(FftRejectsUnsupportedSizes) {
+  struct FftState state;
+  // Rounds up to 262144, a complex FFT of more than 65536 points.
+  TF_LITE_MICRO_EXPECT_EQ(0, FftPopulateState(&state, kMaxFftSize + 1));
+  // Rounds up to 1, which leaves no complex FFT to compute.
+  TF_LITE_MICRO_EXPECT_EQ(0, FftPopulateState(&state, 1));
+}
+
+TF_LITE_MICRO_TESTS_END
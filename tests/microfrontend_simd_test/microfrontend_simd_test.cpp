@@ -0,0 +1,288 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Runs the microfrontend stages that have x86 SIMD paths and their scalar
+// builds from scalar_frontend.c on the same edge case inputs, at widths that
+// are not multiples of the vector length, and checks that the results are
+// identical. On CPUs without AVX2 both sides run the scalar loops.
+
+#include <cstdint>
+#include <cstring>
+
+#include "scalar_frontend.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/filterbank.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/log_scale.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/noise_reduction.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/pcan_gain_control.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/pcan_gain_control_util.h"
+#include "tensorflow/lite/micro/test_helpers.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+
+namespace {
+
+constexpr int kMaxChannels = 41;
+
+using tflite::testing::NextRandom;
+
+// Returns one of the values where saturation and wrap-around happen most of
+// the time, and a random value of random magnitude otherwise.
+uint32_t EdgeValue(uint32_t* seed) {
+  static const uint32_t kEdges[] = {
+      0,      1,       2,          3,          4,          0x7FFF,
+      0x8000, 0xFFFF,  0x10000,    0x7FFFFFFF, 0x80000000, 0xFFFFFFFE,
+      0xFFFFFFFF};
+  constexpr int kNumEdges = sizeof(kEdges) / sizeof(kEdges[0]);
+  const uint32_t r = NextRandom(seed);
+  if (r % 3 == 0) {
+    return NextRandom(seed) >> (r >> 27);
+  }
+  return kEdges[(r >> 8) % kNumEdges];
+}
+
+// Like EdgeValue() for 64 bit filterbank sums, including values around the
+// squares that Sqrt32() rounds differently and values that need Sqrt64().
+uint64_t EdgeValue64(uint32_t* seed) {
+  const uint32_t r = NextRandom(seed);
+  const uint64_t root = r % 4 == 0 ? 0xFFFF : NextRandom(seed) >> 16;
+  switch ((r >> 8) % 8) {
+    case 0:
+      return root * root;
+    case 1:
+      return root * root + root;
+    case 2:
+      return root * root + root + 1;
+    case 3:
+      return root * root - 1;
+    case 4:
+      return 0xFFFFFFFFull + (r >> 31);
+    case 5:
+      return (static_cast<uint64_t>(NextRandom(seed)) << 32) | NextRandom(seed);
+    case 6:
+      return ~0ull;
+    default:
+      return EdgeValue(seed);
+  }
+}
+
+}  // namespace
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(FilterbankEnergyMatchesScalar) {
+  uint32_t seed = 1;
+  struct complex_int16_t fft_output[kMaxChannels + 8];
+  int32_t energy[kMaxChannels + 8];
+  int32_t scalar_energy[kMaxChannels + 8];
+  for (int start = 0; start < 4; ++start) {
+    for (int end = start; end <= kMaxChannels; ++end) {
+      for (int i = 0; i < end; ++i) {
+        fft_output[i].real = static_cast<int16_t>(EdgeValue(&seed));
+        fft_output[i].imag = static_cast<int16_t>(EdgeValue(&seed));
+      }
+      memset(energy, 0, sizeof(energy));
+      memset(scalar_energy, 0, sizeof(scalar_energy));
+      struct FilterbankState state = {};
+      state.start_index = start;
+      state.end_index = end;
+      FilterbankConvertFftComplexToEnergy(&state, fft_output, energy);
+      ScalarFilterbankConvertFftComplexToEnergy(&state, fft_output,
+                                                scalar_energy);
+      for (int i = 0; i < end; ++i) {
+        TF_LITE_MICRO_EXPECT_EQ(scalar_energy[i], energy[i]);
+      }
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(FilterbankAccumulateChannelsMatchesScalar) {
+  constexpr int kMaxWidth = 13;
+  constexpr int kMaxBins = kMaxChannels * kMaxWidth;
+  uint32_t seed = 2;
+  int16_t frequency_starts[kMaxChannels + 1];
+  int16_t weight_starts[kMaxChannels + 1];
+  int16_t widths[kMaxChannels + 1];
+  int16_t weights[kMaxBins];
+  int16_t unweights[kMaxBins];
+  int32_t energy[kMaxBins];
+  uint64_t work[kMaxChannels + 1];
+  uint64_t scalar_work[kMaxChannels + 1];
+  for (int num_channels = 1; num_channels < kMaxChannels; ++num_channels) {
+    // Channels of every width up to kMaxWidth, each starting on the last bin
+    // of the previous one like the mel channels do.
+    int bin = 0;
+    for (int i = 0; i <= num_channels; ++i) {
+      widths[i] = (i * 5 + num_channels) % kMaxWidth;
+      frequency_starts[i] = bin;
+      weight_starts[i] = bin;
+      bin += widths[i] > 0 ? widths[i] - 1 : 0;
+    }
+    for (int i = 0; i < kMaxBins; ++i) {
+      weights[i] = static_cast<int16_t>(EdgeValue(&seed));
+      unweights[i] = static_cast<int16_t>(EdgeValue(&seed));
+      energy[i] = static_cast<int32_t>(EdgeValue(&seed));
+    }
+    struct FilterbankState state = {};
+    state.num_channels = num_channels;
+    state.channel_frequency_starts = frequency_starts;
+    state.channel_weight_starts = weight_starts;
+    state.channel_widths = widths;
+    state.weights = weights;
+    state.unweights = unweights;
+    state.work = work;
+    FilterbankAccumulateChannels(&state, energy);
+    state.work = scalar_work;
+    ScalarFilterbankAccumulateChannels(&state, energy);
+    for (int i = 0; i <= num_channels; ++i) {
+      TF_LITE_MICRO_EXPECT_TRUE(scalar_work[i] == work[i]);
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(FilterbankSqrtMatchesScalar) {
+  uint32_t seed = 3;
+  uint64_t work[kMaxChannels + 1];
+  uint64_t scalar_work[kMaxChannels + 1];
+  const int scale_down_shifts[] = {0, 1, 7};
+  for (int scale_down_shift : scale_down_shifts) {
+    for (int num_channels = 1; num_channels < kMaxChannels; ++num_channels) {
+      // Most groups of four stay below 2^32, so that both the vector square
+      // root and its fallback to Sqrt64() are covered.
+      for (int i = 0; i <= num_channels; ++i) {
+        work[i] = NextRandom(&seed) % 8 == 0 ? EdgeValue64(&seed)
+                                         : EdgeValue64(&seed) & 0xFFFFFFFF;
+      }
+      memcpy(scalar_work, work, sizeof(work));
+      struct FilterbankState state = {};
+      state.num_channels = num_channels;
+      state.work = work;
+      const uint32_t* output = FilterbankSqrt(&state, scale_down_shift);
+      state.work = scalar_work;
+      const uint32_t* scalar_output =
+          ScalarFilterbankSqrt(&state, scale_down_shift);
+      for (int i = 0; i < num_channels; ++i) {
+        TF_LITE_MICRO_EXPECT_EQ(scalar_output[i], output[i]);
+      }
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(NoiseReductionMatchesScalar) {
+  struct Smoothing {
+    int bits;
+    uint16_t even;
+    uint16_t odd;
+    uint16_t min_signal_remaining;
+  };
+  const Smoothing smoothings[] = {
+      {10, 5243, 1638, 1638},
+      {0, 0, 1 << kNoiseReductionBits, 0},
+      {16, 1 << kNoiseReductionBits, 0, 1 << kNoiseReductionBits},
+  };
+  uint32_t seed = 4;
+  uint32_t signal[kMaxChannels];
+  uint32_t scalar_signal[kMaxChannels];
+  uint32_t estimate[kMaxChannels];
+  uint32_t scalar_estimate[kMaxChannels];
+  for (const Smoothing& smoothing : smoothings) {
+    for (int num_channels = 1; num_channels < kMaxChannels; ++num_channels) {
+      for (int i = 0; i < num_channels; ++i) {
+        estimate[i] = EdgeValue(&seed);
+      }
+      memcpy(scalar_estimate, estimate, sizeof(estimate));
+      struct NoiseReductionState state = {};
+      state.smoothing_bits = smoothing.bits;
+      state.even_smoothing = smoothing.even;
+      state.odd_smoothing = smoothing.odd;
+      state.min_signal_remaining = smoothing.min_signal_remaining;
+      state.num_channels = num_channels;
+      struct NoiseReductionState scalar_state = state;
+      state.estimate = estimate;
+      scalar_state.estimate = scalar_estimate;
+      // A few frames, so that the estimates carry over.
+      for (int frame = 0; frame < 3; ++frame) {
+        for (int i = 0; i < num_channels; ++i) {
+          signal[i] = EdgeValue(&seed);
+        }
+        memcpy(scalar_signal, signal, sizeof(signal));
+        NoiseReductionApply(&state, signal);
+        ScalarNoiseReductionApply(&scalar_state, scalar_signal);
+        for (int i = 0; i < num_channels; ++i) {
+          TF_LITE_MICRO_EXPECT_EQ(scalar_signal[i], signal[i]);
+          TF_LITE_MICRO_EXPECT_EQ(scalar_estimate[i], estimate[i]);
+        }
+      }
+    }
+  }
+}
+
+TF_LITE_MICRO_TEST(PcanGainControlMatchesScalar) {
+  struct PcanGainControlConfig config;
+  PcanGainControlFillConfigWithDefaults(&config);
+  config.enable_pcan = 1;
+  uint32_t seed = 5;
+  uint32_t noise_estimate[kMaxChannels];
+  uint32_t signal[kMaxChannels];
+  uint32_t scalar_signal[kMaxChannels];
+  const int input_correction_bits[] = {3, -2};
+  for (int correction_bits : input_correction_bits) {
+    struct PcanGainControlState state;
+    TF_LITE_MICRO_EXPECT_EQ(
+        1, PcanGainControlPopulateState(&config, &state, noise_estimate,
+                                        kMaxChannels, 10, correction_bits));
+    for (int num_channels = 1; num_channels < kMaxChannels; ++num_channels) {
+      for (int i = 0; i < num_channels; ++i) {
+        noise_estimate[i] = EdgeValue(&seed);
+        signal[i] = EdgeValue(&seed);
+      }
+      memcpy(scalar_signal, signal, sizeof(signal));
+      state.num_channels = num_channels;
+      PcanGainControlApply(&state, signal);
+      ScalarPcanGainControlApply(&state, scalar_signal);
+      for (int i = 0; i < num_channels; ++i) {
+        TF_LITE_MICRO_EXPECT_EQ(scalar_signal[i], signal[i]);
+      }
+    }
+    PcanGainControlFreeStateContents(&state);
+  }
+}
+
+TF_LITE_MICRO_TEST(LogScaleMatchesScalar) {
+  uint32_t seed = 6;
+  uint32_t signal[kMaxChannels];
+  uint32_t scalar_signal[kMaxChannels];
+  const int correction_bits[] = {-3, 0, 3};
+  for (int enable_log = 0; enable_log < 2; ++enable_log) {
+    for (int correction : correction_bits) {
+      for (int size = 1; size < kMaxChannels; ++size) {
+        for (int i = 0; i < size; ++i) {
+          signal[i] = EdgeValue(&seed);
+        }
+        memcpy(scalar_signal, signal, sizeof(signal));
+        struct LogScaleState state;
+        state.enable_log = enable_log;
+        state.scale_shift = 6;
+        const uint16_t* output =
+            LogScaleApply(&state, signal, size, correction);
+        const uint16_t* scalar_output =
+            ScalarLogScaleApply(&state, scalar_signal, size, correction);
+        for (int i = 0; i < size; ++i) {
+          TF_LITE_MICRO_EXPECT_EQ(scalar_output[i], output[i]);
+        }
+      }
+    }
+  }
+}
+
+TF_LITE_MICRO_TESTS_END
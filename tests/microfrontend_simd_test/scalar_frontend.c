@@ -0,0 +1,37 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Compiles the frontend stages that have x86 SIMD paths a second time, with
+// those paths compiled out and every exported function renamed, so that the
+// test can run both on the same input whatever the CPU supports.
+
+#define TF_LITE_DISABLE_X86_SIMD
+
+#define FilterbankConvertFftComplexToEnergy \
+  ScalarFilterbankConvertFftComplexToEnergy
+#define FilterbankAccumulateChannels ScalarFilterbankAccumulateChannels
+#define FilterbankSqrt ScalarFilterbankSqrt
+#define FilterbankReset ScalarFilterbankReset
+#define NoiseReductionApply ScalarNoiseReductionApply
+#define NoiseReductionReset ScalarNoiseReductionReset
+#define WideDynamicFunction ScalarWideDynamicFunction
+#define PcanShrink ScalarPcanShrink
+#define PcanGainControlApply ScalarPcanGainControlApply
+#define LogScaleApply ScalarLogScaleApply
+
+#include "tensorflow/lite/experimental/microfrontend/lib/filterbank.c"
+#include "tensorflow/lite/experimental/microfrontend/lib/log_scale.c"
+#include "tensorflow/lite/experimental/microfrontend/lib/noise_reduction.c"
+#include "tensorflow/lite/experimental/microfrontend/lib/pcan_gain_control.c"
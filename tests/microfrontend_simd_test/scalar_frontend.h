@@ -0,0 +1,47 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TESTS_MICROFRONTEND_SIMD_TEST_SCALAR_FRONTEND_H_
+#define TESTS_MICROFRONTEND_SIMD_TEST_SCALAR_FRONTEND_H_
+
+#include "tensorflow/lite/experimental/microfrontend/lib/filterbank.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/log_scale.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/noise_reduction.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/pcan_gain_control.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The frontend stages built without their x86 SIMD paths, see
+// scalar_frontend.c.
+void ScalarFilterbankConvertFftComplexToEnergy(
+    struct FilterbankState* state, struct complex_int16_t* fft_output,
+    int32_t* energy);
+void ScalarFilterbankAccumulateChannels(struct FilterbankState* state,
+                                        const int32_t* energy);
+uint32_t* ScalarFilterbankSqrt(struct FilterbankState* state,
+                               int scale_down_shift);
+void ScalarNoiseReductionApply(struct NoiseReductionState* state,
+                               uint32_t* signal);
+void ScalarPcanGainControlApply(struct PcanGainControlState* state,
+                                uint32_t* signal);
+uint16_t* ScalarLogScaleApply(struct LogScaleState* state, uint32_t* signal,
+                              int signal_size, int correction_bits);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // TESTS_MICROFRONTEND_SIMD_TEST_SCALAR_FRONTEND_H_
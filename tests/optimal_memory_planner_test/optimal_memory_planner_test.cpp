@@ -0,0 +1,225 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/memory_planner/optimal_memory_planner.h"
+
+#include "tensorflow/lite/micro/memory_planner/greedy_memory_planner.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+
+namespace {
+constexpr int kScratchBufferSize = 4096;
+unsigned char g_scratch_buffer[kScratchBufferSize];
+unsigned char g_greedy_scratch_buffer[kScratchBufferSize];
+
+// Seven buffers for which the greedy planner needs 220 bytes, while 180 bytes
+// are live at the same time at most.
+template <typename Planner>
+void AddFragmentingBuffers(tflite::ErrorReporter* error_reporter,
+                           Planner* planner) {
+  const int buffers[][3] = {{60, 1, 2}, {60, 0, 1}, {40, 2, 4}, {30, 0, 0},
+                            {60, 1, 3}, {50, 4, 5}, {60, 3, 4}};
+  for (const auto& buffer : buffers) {
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                            planner->AddBuffer(error_reporter, buffer[0],
+                                               buffer[1], buffer[2]));
+  }
+}
+
+}  // namespace
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(TestOptimalBasics) {
+  tflite::MicroErrorReporter micro_error_reporter;
+
+  tflite::OptimalMemoryPlanner planner(g_scratch_buffer, kScratchBufferSize);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          planner.AddBuffer(&micro_error_reporter, 10, 0, 1));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          planner.AddBuffer(&micro_error_reporter, 20, 2, 3));
+
+  TF_LITE_MICRO_EXPECT_EQ(false,
+                          planner.DoAnyBuffersOverlap(&micro_error_reporter));
+  TF_LITE_MICRO_EXPECT_EQ(static_cast<size_t>(20),
+                          planner.GetMaximumMemorySize());
+  TF_LITE_MICRO_EXPECT_EQ(static_cast<size_t>(20),
+                          planner.GetLowerBoundMemorySize());
+  TF_LITE_MICRO_EXPECT(planner.IsPlanOptimal());
+
+  int offset = -1;
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.GetOffsetForBuffer(&micro_error_reporter, 0, &offset));
+  TF_LITE_MICRO_EXPECT_EQ(0, offset);
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.GetOffsetForBuffer(&micro_error_reporter, 1, &offset));
+  TF_LITE_MICRO_EXPECT_EQ(0, offset);
+}
+
+TF_LITE_MICRO_TEST(TestOptimalBeatsGreedy) {
+  tflite::MicroErrorReporter micro_error_reporter;
+
+  tflite::OptimalMemoryPlanner planner(g_scratch_buffer, kScratchBufferSize);
+  AddFragmentingBuffers(&micro_error_reporter, &planner);
+  tflite::GreedyMemoryPlanner greedy_planner(g_greedy_scratch_buffer,
+                                             kScratchBufferSize);
+  AddFragmentingBuffers(&micro_error_reporter, &greedy_planner);
+
+  TF_LITE_MICRO_EXPECT_EQ(false,
+                          planner.DoAnyBuffersOverlap(&micro_error_reporter));
+  TF_LITE_MICRO_EXPECT_EQ(static_cast<size_t>(220),
+                          greedy_planner.GetMaximumMemorySize());
+  TF_LITE_MICRO_EXPECT_EQ(greedy_planner.GetMaximumMemorySize(),
+                          planner.GetGreedyMemorySize());
+  TF_LITE_MICRO_EXPECT_EQ(static_cast<size_t>(180),
+                          planner.GetLowerBoundMemorySize());
+  TF_LITE_MICRO_EXPECT_EQ(static_cast<size_t>(180),
+                          planner.GetMaximumMemorySize());
+  TF_LITE_MICRO_EXPECT(planner.IsPlanOptimal());
+}
+
+TF_LITE_MICRO_TEST(TestSearchBudgetKeepsGreedyPlan) {
+  tflite::MicroErrorReporter micro_error_reporter;
+
+  // The first layout is always completed, and it is the greedy one.
+  tflite::OptimalMemoryPlanner planner(g_scratch_buffer, kScratchBufferSize,
+                                       /*max_search_steps=*/1);
+  AddFragmentingBuffers(&micro_error_reporter, &planner);
+
+  TF_LITE_MICRO_EXPECT_EQ(false,
+                          planner.DoAnyBuffersOverlap(&micro_error_reporter));
+  TF_LITE_MICRO_EXPECT_EQ(static_cast<size_t>(220),
+                          planner.GetMaximumMemorySize());
+  TF_LITE_MICRO_EXPECT_EQ(static_cast<size_t>(220),
+                          planner.GetGreedyMemorySize());
+  TF_LITE_MICRO_EXPECT_EQ(7, planner.GetSearchSteps());
+  TF_LITE_MICRO_EXPECT_EQ(false, planner.IsPlanOptimal());
+}
+
+TF_LITE_MICRO_TEST(TestOfflinePlannedBuffersKeepTheirOffset) {
+  tflite::MicroErrorReporter micro_error_reporter;
+
+  tflite::OptimalMemoryPlanner planner(g_scratch_buffer, kScratchBufferSize);
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 30, 0, 2, 20));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          planner.AddBuffer(&micro_error_reporter, 20, 0, 1));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          planner.AddBuffer(&micro_error_reporter, 10, 1, 2));
+
+  TF_LITE_MICRO_EXPECT_EQ(false,
+                          planner.DoAnyBuffersOverlap(&micro_error_reporter));
+  int offset = -1;
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.GetOffsetForBuffer(&micro_error_reporter, 0, &offset));
+  TF_LITE_MICRO_EXPECT_EQ(20, offset);
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.GetOffsetForBuffer(&micro_error_reporter, 1, &offset));
+  TF_LITE_MICRO_EXPECT_EQ(0, offset);
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.GetOffsetForBuffer(&micro_error_reporter, 2, &offset));
+  TF_LITE_MICRO_EXPECT_EQ(50, offset);
+  TF_LITE_MICRO_EXPECT_EQ(static_cast<size_t>(60),
+                          planner.GetMaximumMemorySize());
+  TF_LITE_MICRO_EXPECT(planner.IsPlanOptimal());
+}
+
+TF_LITE_MICRO_TEST(TestPersonDetectionModel) {
+  tflite::MicroErrorReporter micro_error_reporter;
+
+  tflite::OptimalMemoryPlanner planner(g_scratch_buffer, kScratchBufferSize);
+  // These buffer sizes and time ranges are taken from the 250KB MobileNet model
+  // used in the person detection example.
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 9216, 0, 29));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          planner.AddBuffer(&micro_error_reporter, 3, 28, 29));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 256, 27, 28));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 2304, 26, 27));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 2304, 25, 26));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 2304, 24, 25));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 1152, 23, 24));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 4608, 22, 23));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 4608, 21, 22));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 4608, 20, 21));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 4608, 19, 20));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 4608, 18, 19));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 4608, 17, 18));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 4608, 16, 17));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 4608, 15, 16));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 4608, 14, 15));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 4608, 13, 14));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 4608, 12, 13));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 2304, 11, 12));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 9216, 10, 11));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 9216, 9, 10));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          planner.AddBuffer(&micro_error_reporter, 9216, 8, 9));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          planner.AddBuffer(&micro_error_reporter, 4608, 7, 8));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 18432, 6, 7));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 18432, 5, 6));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 18432, 4, 5));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          planner.AddBuffer(&micro_error_reporter, 9216, 3, 4));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 36864, 2, 3));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 18432, 1, 2));
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteOk, planner.AddBuffer(&micro_error_reporter, 18432, 0, 1));
+
+  TF_LITE_MICRO_EXPECT_EQ(false,
+                          planner.DoAnyBuffersOverlap(&micro_error_reporter));
+  TF_LITE_MICRO_EXPECT_LE(planner.GetLowerBoundMemorySize(),
+                          planner.GetMaximumMemorySize());
+  TF_LITE_MICRO_EXPECT_LE(planner.GetMaximumMemorySize(),
+                          planner.GetGreedyMemorySize());
+}
+
+TF_LITE_MICRO_TEST(TestSmallScratch) {
+  tflite::MicroErrorReporter micro_error_reporter;
+
+  constexpr int scratch_buffer_size = 40;
+  unsigned char scratch_buffer[scratch_buffer_size];
+  tflite::OptimalMemoryPlanner planner(scratch_buffer, scratch_buffer_size);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          planner.AddBuffer(&micro_error_reporter, 100, 0, 1));
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError,
+                          planner.AddBuffer(&micro_error_reporter, 50, 2, 3));
+}
+
+TF_LITE_MICRO_TESTS_END